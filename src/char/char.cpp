@@ -11,6 +11,8 @@
 #include <ctime>
 #include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <common/cbasetypes.hpp>
 #include <common/cli.hpp>
@@ -60,6 +62,7 @@ struct fame_list chemist_fame_list[MAX_FAME_LIST];
 struct fame_list taekwon_fame_list[MAX_FAME_LIST];
 
 #define CHAR_MAX_MSG 300	//max number of msg_conf
+#define ITEM_SAVE_BATCH 100	//max number of rows per item save statement
 static char* msg_table[CHAR_MAX_MSG]; // Login Server messages_conf
 
 // check for exit signal
@@ -529,15 +532,122 @@ int32 char_mmo_char_tosql(uint32 char_id, struct mmo_charstatus* p){
 	return 0;
 }
 
+/**
+ * Executes a batched item statement and starts a new one.
+ * @param buf: statement, cleared afterwards
+ * @param count: amount of rows in the statement, reset afterwards
+ * @param suffix: appended to the statement before it is executed
+ * @return true on success
+ */
+static bool char_memitemdata_flush(StringBuf& buf, int32& count, const char* suffix) {
+	if( count == 0 )
+		return true;
+
+	StringBuf_AppendStr(&buf, suffix);
+	count = 0;
+
+	if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) ) {
+		Sql_ShowDebug(sql_handle);
+		StringBuf_Clear(&buf);
+		return false;
+	}
+
+	StringBuf_Clear(&buf);
+	return true;
+}
+
+/// Starts a multi-row INSERT into an item table.
+static void char_memitemdata_insert_header(StringBuf& buf, const char* tablename, const char* selectoption, enum storage_type tableswitch) {
+	int32 j;
+
+	StringBuf_Printf(&buf, "INSERT INTO `%s`(`%s`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`, `enchantgrade`", tablename, selectoption);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(&buf, ", `card%d`", j);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(&buf, ", `option_id%d`", j);
+		StringBuf_Printf(&buf, ", `option_val%d`", j);
+		StringBuf_Printf(&buf, ", `option_parm%d`", j);
+	}
+	StringBuf_AppendStr(&buf, ") VALUES ");
+}
+
+/// Appends the values of an item row, starting with its owner, and closes the row.
+static void char_memitemdata_insert_values(StringBuf& buf, int32 id, const struct item& it, enum storage_type tableswitch) {
+	int32 j;
+
+	StringBuf_Printf(&buf, "'%d', '%u', '%d', '%u', '%d', '%d', '%d', '%u', '%d', '%" PRIu64 "', '%d'",
+		id, it.nameid, it.amount, it.equip, it.identify, it.refine, it.attribute, it.expire_time, it.bound, it.unique_id, it.enchantgrade);
+	if (tableswitch == TABLE_INVENTORY)
+		StringBuf_Printf(&buf, ", '%d', '%u'", it.favorite, it.equipSwitch);
+	for( j = 0; j < MAX_SLOTS; ++j )
+		StringBuf_Printf(&buf, ", '%u'", it.card[j]);
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		StringBuf_Printf(&buf, ", '%d'", it.option[j].id);
+		StringBuf_Printf(&buf, ", '%d'", it.option[j].value);
+		StringBuf_Printf(&buf, ", '%d'", it.option[j].param);
+	}
+	StringBuf_AppendStr(&buf, ")");
+}
+
+/// Appends a changed item as a row of the derived table the batched UPDATE joins with.
+/// The first row names the columns.
+static void char_memitemdata_update_values(StringBuf& buf, int32 db_id, const struct item& it, enum storage_type tableswitch, bool first) {
+	char name[32];
+	bool separator = false;
+	int32 j;
+
+	auto column = [&buf, first, &separator]( const char* column_name, auto value ){
+		StringBuf_Printf(&buf, "%s%s", separator ? ", " : "", std::to_string(value).c_str());
+		if( first )
+			StringBuf_Printf(&buf, " AS `%s`", column_name);
+		separator = true;
+	};
+
+	StringBuf_AppendStr(&buf, "SELECT ");
+	column("id", db_id);
+	column("amount", it.amount);
+	column("equip", it.equip);
+	column("identify", it.identify);
+	column("refine", it.refine);
+	column("attribute", it.attribute);
+	column("expire_time", it.expire_time);
+	column("bound", it.bound);
+	column("unique_id", it.unique_id);
+	column("enchantgrade", it.enchantgrade);
+	if (tableswitch == TABLE_INVENTORY) {
+		column("favorite", it.favorite);
+		column("equip_switch", it.equipSwitch);
+	}
+	for( j = 0; j < MAX_SLOTS; ++j ) {
+		safesnprintf(name, sizeof(name), "card%d", j);
+		column(name, it.card[j]);
+	}
+	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
+		safesnprintf(name, sizeof(name), "option_id%d", j);
+		column(name, it.option[j].id);
+		safesnprintf(name, sizeof(name), "option_val%d", j);
+		column(name, it.option[j].value);
+		safesnprintf(name, sizeof(name), "option_parm%d", j);
+		column(name, it.option[j].param);
+	}
+}
+
 /// Saves an array of 'item' entries into the specified table.
+/// Changed, removed and new items are written in batched statements.
+/// With SQL_INNODB the statements run inside one transaction, MyISAM tables ignore transactions.
 int32 char_memitemdata_to_sql(const struct item items[], int32 max, int32 id, enum storage_type tableswitch, uint8 stor_id) {
-	StringBuf buf;
+	StringBuf buf, suffix;
 	SqlStmt stmt{ *sql_handle };
-	int32 i, j, offset = 0, errors = 0;
+	int32 i, j, offset = 0, errors = 0, count = 0, inserted = 0;
 	const char *tablename, *selectoption, *printname;
 	struct item item; // temp storage variable
 	bool* flag; // bit array for inventory matching
 	bool found;
+	std::vector<int32> deleted; // database ids of removed items
+	std::vector<std::pair<int32, int32>> updated; // database id and index of changed items
+	t_tick start = gettick_nocache();
 
 	switch (tableswitch) {
 		case TABLE_INVENTORY:
@@ -652,28 +762,7 @@ int32 char_memitemdata_to_sql(const struct item items[], int32 max, int32 id, en
 					(tableswitch != TABLE_INVENTORY || (items[i].favorite == item.favorite && items[i].equipSwitch == item.equipSwitch)) )
 				;	//Do nothing.
 				else
-				{
-					// update all fields.
-					StringBuf_Clear(&buf);
-					StringBuf_Printf(&buf, "UPDATE `%s` SET `amount`='%d', `equip`='%u', `identify`='%d', `refine`='%d',`attribute`='%d', `expire_time`='%u', `bound`='%d', `unique_id`='%" PRIu64 "', `enchantgrade`='%d'",
-						tablename, items[i].amount, items[i].equip, items[i].identify, items[i].refine, items[i].attribute, items[i].expire_time, items[i].bound, items[i].unique_id, items[i].enchantgrade);
-					if (tableswitch == TABLE_INVENTORY)
-						StringBuf_Printf(&buf, ", `favorite`='%d', `equip_switch`='%u'", items[i].favorite, items[i].equipSwitch);
-					for( j = 0; j < MAX_SLOTS; ++j )
-						StringBuf_Printf(&buf, ", `card%d`=%u", j, items[i].card[j]);
-					for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-						StringBuf_Printf(&buf, ", `option_id%d`=%d", j, items[i].option[j].id);
-						StringBuf_Printf(&buf, ", `option_val%d`=%d", j, items[i].option[j].value);
-						StringBuf_Printf(&buf, ", `option_parm%d`=%d", j, items[i].option[j].param);
-					}
-					StringBuf_Printf(&buf, " WHERE `id`='%d' LIMIT 1", item.id);
-
-					if( SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
-					{
-						Sql_ShowDebug(sql_handle);
-						errors++;
-					}
-				}
+					updated.emplace_back( (int32)item.id, i );
 
 				found = flag[i] = true; //Item dealt with,
 				break; //skip to next item in the db.
@@ -681,28 +770,66 @@ int32 char_memitemdata_to_sql(const struct item items[], int32 max, int32 id, en
 		}
 		if( !found )
 		{// Item not present in inventory, remove it.
-			if( SQL_ERROR == Sql_Query(sql_handle, "DELETE from `%s` where `id`='%d' LIMIT 1", tablename, item.id) )
-			{
-				Sql_ShowDebug(sql_handle);
-				errors++;
-			}
+			deleted.push_back( item.id );
 		}
 	}
 
+	stmt.FreeResult();
+
+#ifdef SQL_INNODB
+	if( SQL_ERROR == Sql_QueryStr(sql_handle, "START TRANSACTION") )
+	{
+		Sql_ShowDebug(sql_handle);
+		aFree(flag);
+		return 1;
+	}
+#endif
+
+	// Removed items
 	StringBuf_Clear(&buf);
-	StringBuf_Printf(&buf, "INSERT INTO `%s`(`%s`, `nameid`, `amount`, `equip`, `identify`, `refine`, `attribute`, `expire_time`, `bound`, `unique_id`, `enchantgrade`", tablename, selectoption);
+	for( int32 db_id : deleted )
+	{
+		if( count == 0 )
+			StringBuf_Printf(&buf, "DELETE FROM `%s` WHERE `id` IN (", tablename);
+		else
+			StringBuf_AppendStr(&buf, ",");
+
+		StringBuf_Printf(&buf, "'%d'", db_id);
+
+		if( ++count >= ITEM_SAVE_BATCH && !char_memitemdata_flush(buf, count, ")") )
+			errors++;
+	}
+	if( !char_memitemdata_flush(buf, count, ")") )
+		errors++;
+
+	// Changed items, joined by id like the former single row UPDATE, so rows removed in the meantime are not added again
+	StringBuf_Init(&suffix);
+	StringBuf_AppendStr(&suffix, ") AS `changed` ON `item`.`id` = `changed`.`id` SET `item`.`amount`=`changed`.`amount`, `item`.`equip`=`changed`.`equip`, `item`.`identify`=`changed`.`identify`, `item`.`refine`=`changed`.`refine`, `item`.`attribute`=`changed`.`attribute`, `item`.`expire_time`=`changed`.`expire_time`, `item`.`bound`=`changed`.`bound`, `item`.`unique_id`=`changed`.`unique_id`, `item`.`enchantgrade`=`changed`.`enchantgrade`");
 	if (tableswitch == TABLE_INVENTORY)
-		StringBuf_Printf(&buf, ", `favorite`, `equip_switch`");
+		StringBuf_AppendStr(&suffix, ", `item`.`favorite`=`changed`.`favorite`, `item`.`equip_switch`=`changed`.`equip_switch`");
 	for( j = 0; j < MAX_SLOTS; ++j )
-		StringBuf_Printf(&buf, ", `card%d`", j);
+		StringBuf_Printf(&suffix, ", `item`.`card%d`=`changed`.`card%d`", j, j);
 	for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-		StringBuf_Printf(&buf, ", `option_id%d`", j);
-		StringBuf_Printf(&buf, ", `option_val%d`", j);
-		StringBuf_Printf(&buf, ", `option_parm%d`", j);
+		StringBuf_Printf(&suffix, ", `item`.`option_id%d`=`changed`.`option_id%d`", j, j);
+		StringBuf_Printf(&suffix, ", `item`.`option_val%d`=`changed`.`option_val%d`", j, j);
+		StringBuf_Printf(&suffix, ", `item`.`option_parm%d`=`changed`.`option_parm%d`", j, j);
 	}
-	StringBuf_AppendStr(&buf, ") VALUES ");
 
-	found = false;
+	for( const auto& update : updated )
+	{
+		if( count == 0 )
+			StringBuf_Printf(&buf, "UPDATE `%s` AS `item` INNER JOIN (", tablename);
+		else
+			StringBuf_AppendStr(&buf, " UNION ALL ");
+
+		char_memitemdata_update_values(buf, update.first, items[update.second], tableswitch, count == 0);
+
+		if( ++count >= ITEM_SAVE_BATCH && !char_memitemdata_flush(buf, count, StringBuf_Value(&suffix)) )
+			errors++;
+	}
+	if( !char_memitemdata_flush(buf, count, StringBuf_Value(&suffix)) )
+		errors++;
+
 	// insert non-matched items into the db as new items
 	for( i = 0; i < max; ++i )
 	{
@@ -710,32 +837,39 @@ int32 char_memitemdata_to_sql(const struct item items[], int32 max, int32 id, en
 		if( items[i].nameid == 0 || flag[i] )
 			continue;
 
-		if( found )
-			StringBuf_AppendStr(&buf, ",");
+		if( count == 0 )
+			char_memitemdata_insert_header(buf, tablename, selectoption, tableswitch);
 		else
-			found = true;
-
-		StringBuf_Printf(&buf, "('%d', '%u', '%d', '%u', '%d', '%d', '%d', '%u', '%d', '%" PRIu64 "', '%d'",
-			id, items[i].nameid, items[i].amount, items[i].equip, items[i].identify, items[i].refine, items[i].attribute, items[i].expire_time, items[i].bound, items[i].unique_id, items[i].enchantgrade);
-		if (tableswitch == TABLE_INVENTORY)
-			StringBuf_Printf(&buf, ", '%d', '%u'", items[i].favorite, items[i].equipSwitch);
-		for( j = 0; j < MAX_SLOTS; ++j )
-			StringBuf_Printf(&buf, ", '%u'", items[i].card[j]);
-		for( j = 0; j < MAX_ITEM_RDM_OPT; ++j ) {
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].id);
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].value);
-			StringBuf_Printf(&buf, ", '%d'", items[i].option[j].param);
-		}
-		StringBuf_AppendStr(&buf, ")");
+			StringBuf_AppendStr(&buf, ",");
+
+		StringBuf_AppendStr(&buf, "(");
+		char_memitemdata_insert_values(buf, id, items[i], tableswitch);
+		inserted++;
+
+		if( ++count >= ITEM_SAVE_BATCH && !char_memitemdata_flush(buf, count, "") )
+			errors++;
 	}
+	if( !char_memitemdata_flush(buf, count, "") )
+		errors++;
 
-	if( found && SQL_ERROR == Sql_QueryStr(sql_handle, StringBuf_Value(&buf)) )
+#ifdef SQL_INNODB
+	if( errors || SQL_ERROR == Sql_QueryStr(sql_handle, "COMMIT") )
 	{
-		Sql_ShowDebug(sql_handle);
-		errors++;
+		if( !errors )
+		{
+			Sql_ShowDebug(sql_handle);
+			errors++;
+		}
+		if( SQL_ERROR == Sql_QueryStr(sql_handle, "ROLLBACK") )
+			Sql_ShowDebug(sql_handle);
 	}
+#endif
+
+	if( errors )
+		ShowError("Failed to save %s (%d) data to table %s for %s: %d\n", printname, stor_id, tablename, selectoption, id);
+	else
+		ShowInfo("Saved %s (%d) data to table %s for %s: %d (%d changed, %d removed, %d added in %" PRtf " ms)\n", printname, stor_id, tablename, selectoption, id, (int32)updated.size(), (int32)deleted.size(), inserted, DIFF_TICK(gettick_nocache(), start));
 
-	ShowInfo("Saved %s (%d) data to table %s for %s: %d\n", printname, stor_id, tablename, selectoption, id);
 	aFree(flag);
 
 	return errors;
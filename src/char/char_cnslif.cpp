@@ -8,6 +8,7 @@
 
 #include <common/cli.hpp>
 #include <common/ers.hpp>
+#include <common/profiler.hpp>
 #include <common/showmsg.hpp>
 #include <common/socket.hpp>
 #include <common/timer.hpp>
@@ -86,12 +87,16 @@ int32 cnslif_parse(const char* buf)
 	else if( strcmpi("ers_report", type) == 0 ){
 		ers_report();
 	}
+	else if( strcmpi("profiler", type) == 0 ){
+		profiler_console(command);
+	}
 	else if( strcmpi("help", type) == 0 ){
 		ShowInfo("Available commands:\n");
 		ShowInfo("\t server:shutdown => Stops the server.\n");
 		ShowInfo("\t server:alive => Checks if the server is running.\n");
 		ShowInfo("\t server:reloadconf => Reload config file: \"%s\"\n", CHAR_CONF_NAME);
 		ShowInfo("\t ers_report => Displays database usage.\n");
+		ShowInfo("\t profiler:<on|off|reset|show|latency|dump> => Controls the timer function profiler.\n");
 	}
 
 	return 0;
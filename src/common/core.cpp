@@ -11,6 +11,7 @@
 #ifndef MINICORE
 #include "database.hpp"
 #include "ers.hpp"
+#include "profiler.hpp"
 #include "socket.hpp"
 #include "timer.hpp"
 #include "sql.hpp"
@@ -52,6 +53,8 @@ char conf_path[12] = "conf"; /// relative path for conf from server
 
 char *SERVER_NAME = nullptr;
 
+volatile sig_atomic_t sig_reopen_logs = 0;
+
 #ifndef MINICORE	// minimalist Core
 // Added by Gabuzomeu
 //
@@ -141,6 +144,10 @@ static void sig_proc(int32 sn) {
 	case SIGPIPE:
 		//ShowInfo ("Broken pipe found... closing socket\n");	// set to eof in socket.cpp
 		break;	// does nothing here
+	case SIGHUP:
+		// log files were rotated, they are reopened on the next flush
+		sig_reopen_logs = 1;
+		break;
 #endif
 	}
 }
@@ -160,6 +167,14 @@ void signals_init (void) {
 	compat_signal(SIGTRAP, SIG_DFL);
 #endif
 }
+
+/// Makes SIGHUP set sig_reopen_logs instead of terminating the server.
+/// Only for servers that keep log files open and reopen them on their next flush.
+void signals_init_reopen_logs(void) {
+#ifndef _WIN32
+	compat_signal(SIGHUP, sig_proc);
+#endif
+}
 #endif
 
 const char* get_svn_revision(void) {
@@ -368,6 +383,7 @@ int32 Core::start( int32 argc, char **argv ){
 #endif
 	timer_init();
 	socket_init();
+	profiler_init();
 #endif
 
 	this->set_status( e_core_status::CORE_INITIALIZED );
@@ -386,9 +402,16 @@ int32 Core::start( int32 argc, char **argv ){
 		if( !this->m_run_once ){
 			// Main runtime cycle
 			while( this->get_status() == e_core_status::RUNNING ){
+				uint64 start = profiler_begin();
 				t_tick next = do_timer( gettick_nocache() );
+				uint64 timer_end = profiler_begin();
 
 				this->handle_main( next );
+
+				// the profiler can be switched on or off by a console command in between
+				if( start != 0 && timer_end != 0 ){
+					profiler_loop( start, timer_end, gettick_precise() );
+				}
 			}
 		}
 #endif
@@ -401,6 +424,7 @@ int32 Core::start( int32 argc, char **argv ){
 
 	this->set_status( e_core_status::CORE_FINALIZING );
 #ifndef MINICORE
+	profiler_final();
 	timer_final();
 	socket_final();
 	db_final();
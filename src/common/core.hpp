@@ -4,6 +4,7 @@
 #ifndef CORE_HPP
 #define CORE_HPP
 
+#include <csignal>
 #include <string>
 #include <vector>
 
@@ -27,8 +28,10 @@
 extern char *SERVER_NAME;
 extern char db_path[12]; /// relative path for db from servers
 extern char conf_path[12]; /// relative path for conf from servers
+extern volatile sig_atomic_t sig_reopen_logs; /// set by SIGHUP, log files should be reopened
 
 extern int32 parse_console(const char* buf);
+void signals_init_reopen_logs(void);
 const char *get_svn_revision(void);
 const char *get_git_hash(void);
 
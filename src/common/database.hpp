@@ -101,7 +101,7 @@ public:
 	}
 
 	bool exists( keytype key ){
-		return this->find( key ) != nullptr;
+		return this->findRaw( key ) != nullptr;
 	}
 
 	virtual std::shared_ptr<datatype> find( keytype key ){
@@ -114,6 +114,18 @@ public:
 		}
 	}
 
+	/// Same as find, but without copying the shared pointer.
+	/// The entry is not kept alive by the result, so it must not be stored beyond a database reload.
+	virtual datatype* findRaw( keytype key ){
+		auto it = this->data.find( key );
+
+		if( it != this->data.end() ){
+			return it->second.get();
+		}else{
+			return nullptr;
+		}
+	}
+
 	virtual void put( keytype key, std::shared_ptr<datatype> ptr ){
 		this->data[key] = ptr;
 	}
@@ -172,6 +184,14 @@ public:
 		}
 	}
 
+	datatype* findRaw( keytype key ) override{
+		if( this->cache.empty() || key >= this->cache.size() ){
+			return TypesafeYamlDatabase<keytype, datatype>::findRaw( key );
+		}else{
+			return cache[this->calculateCacheKey( key )].get();
+		}
+	}
+
 	std::vector<std::shared_ptr<datatype>> getCache() {
 		return this->cache;
 	}
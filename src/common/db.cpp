@@ -47,6 +47,7 @@
  *  - create a db that organizes itself by splaying
  *
  *  HISTORY:
+ *    2026/10/18 - Added the open addressing index (DB_OPT_HASH_INDEX).
  *    2013/08/25 - Added int64/uint64 support for keys [Ind/Hercules]
  *    2013/04/27 - Added ERS to speed up iterator memory allocation [Ind/Hercules]
  *    2012/03/09 - Added enum for data types (int32, uint32, void*)
@@ -88,6 +89,7 @@
  *  DBNColor        - Enumeration of colors of the nodes.                    *
  *  DBNode          - Structure of a node in RED-BLACK trees.                *
  *  struct db_free  - Structure that holds a deleted node to be freed.       *
+ *  struct db_index_slot - Slot of the open addressing index of the nodes.   *
  *  DBMap_impl      - Structure of the database.                             *
  *  stats           - Statistics about the database system.                  *
 \*****************************************************************************/
@@ -158,6 +160,28 @@ struct db_free {
 	DBNode **root;
 };
 
+/**
+ * Slot of the open addressing index of a database.
+ * The index is a robin hood hashtable that maps the keys to the nodes of the
+ * RED-BLACK trees, so lookups don't have to descend a tree.
+ * @param node Indexed node or nullptr if the slot is empty
+ * @param hash Mixed hash of the key of the node
+ * @private
+ * @see DBOptions#DB_OPT_HASH_INDEX
+ * @see DBMap_impl#index
+ */
+struct db_index_slot {
+	DBNode *node;
+	uint32 hash;
+};
+
+/**
+ * Minimum capacity of the index of a database.
+ * @private
+ * @see DBMap_impl#index
+ */
+#define DB_INDEX_MIN_SIZE 16
+
 /**
  * Complete database structure.
  * @param vtable Interface of the database
@@ -172,11 +196,15 @@ struct db_free {
  * @param hash Hasher of the database
  * @param release Releaser of the database
  * @param ht Hashtable of RED-BLACK trees
+ * @param index Open addressing index of the nodes (DB_OPT_HASH_INDEX), nullptr while empty or disabled
+ * @param index_mask Capacity of the index minus one
+ * @param index_count Number of nodes in the index
  * @param type Type of the database
  * @param options Options of the database
  * @param item_count Number of items in the database
  * @param maxlen Maximum length of strings in DB_STRING and DB_ISTRING databases
  * @param global_lock Global lock of the database
+ * @param index_paused Nodes are not added to the index while it is rebuilt
  * @private
  * @see #db_alloc(const char*,int32,DBType,DBOptions,uint16)
  */
@@ -197,12 +225,16 @@ typedef struct DBMap_impl {
 	DBHasher hash;
 	DBReleaser release;
 	DBNode *ht[HASH_SIZE];
+	struct db_index_slot *index;
+	uint32 index_mask;
+	uint32 index_count;
 	DBNode *cache;
 	DBType type;
 	DBOptions options;
 	uint32 item_count;
 	uint16 maxlen;
 	unsigned global_lock : 1;
+	unsigned index_paused : 1;
 } DBMap_impl;
 
 /**
@@ -347,6 +379,12 @@ struct eri *db_alloc_ers;
  *  db_is_key_null     - Returns not 0 if the key is considered nullptr.     *
  *  db_dup_key         - Duplicate a key for internal use.                   *
  *  db_dup_key_free    - Free the duplicated key.                            *
+ *  db_index_hash      - Hash of a key for the index of a database.          *
+ *  db_index_resize    - Change the capacity of the index of a database.     *
+ *  db_index_add       - Add a node to the index of a database.              *
+ *  db_index_find      - Find the node of a key in the index of a database.  *
+ *  db_index_remove    - Remove a node from the index of a database.         *
+ *  db_index_rebuild   - Rebuild the index of a database from the trees.     *
  *  db_free_add        - Add a node to the free_list of a database.          *
  *  db_free_remove     - Remove a node from the free_list of a database.     *
  *  db_free_lock       - Increment the free_lock of a database.              *
@@ -696,6 +734,215 @@ static void db_dup_key_free(DBMap_impl* db, DBKey key)
 	}
 }
 
+/**
+ * Hash of a key for the index of a database.
+ * The hash of the database is mixed, because the default numeric hashers
+ * return the key itself and the index uses the lowest bits.
+ * @param db Target database
+ * @param key Key to be hashed
+ * @return Mixed hash of the key
+ * @private
+ * @see DBMap_impl#index
+ */
+static uint32 db_index_hash(DBMap_impl* db, DBKey key)
+{
+	uint64 hash = db->hash(key, db->maxlen);
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return (uint32)hash;
+}
+
+/**
+ * Puts a node into a slot array of an index, robin hood style:
+ * a node that is farther away from its home slot takes the place of
+ * a node that is closer to its own.
+ * @param index Slot array
+ * @param mask Capacity of the slot array minus one
+ * @param node Node to be added
+ * @param hash Mixed hash of the key of the node
+ * @private
+ */
+static void db_index_put(struct db_index_slot *index, uint32 mask, DBNode *node, uint32 hash)
+{
+	struct db_index_slot cur = { node, hash };
+	uint32 pos = hash & mask;
+	uint32 dist = 0;
+
+	for (;;) {
+		struct db_index_slot *slot = &index[pos];
+		uint32 slot_dist;
+
+		if (slot->node == nullptr) {
+			*slot = cur;
+			return;
+		}
+		slot_dist = (pos - slot->hash) & mask;
+		if (slot_dist < dist) {
+			struct db_index_slot tmp = *slot;
+			*slot = cur;
+			cur = tmp;
+			dist = slot_dist;
+		}
+		pos = (pos + 1) & mask;
+		dist++;
+	}
+}
+
+/**
+ * Change the capacity of the index of a database.
+ * @param db Target database
+ * @param size New capacity, must be a power of 2
+ * @private
+ * @see DBMap_impl#index
+ */
+static void db_index_resize(DBMap_impl* db, uint32 size)
+{
+	struct db_index_slot *old_index = db->index;
+	uint32 old_size = (old_index ? db->index_mask + 1 : 0);
+	uint32 i;
+
+	CREATE(db->index, struct db_index_slot, size);
+	db->index_mask = size - 1;
+	for (i = 0; i < old_size; i++) {
+		if (old_index[i].node)
+			db_index_put(db->index, db->index_mask, old_index[i].node, old_index[i].hash);
+	}
+	if (old_index)
+		aFree(old_index);
+}
+
+/**
+ * Add a node to the index of a database.
+ * The index grows when it becomes 3/4 full.
+ * @param db Target database
+ * @param node Node to be added, its key must be set
+ * @private
+ * @see DBMap_impl#index
+ */
+static void db_index_add(DBMap_impl* db, DBNode *node)
+{
+	if (!(db->options&DB_OPT_HASH_INDEX) || db->index_paused)
+		return;
+
+	if (db->index == nullptr)
+		db_index_resize(db, DB_INDEX_MIN_SIZE);
+	else if ((uint64)(db->index_count + 1) * 4 > (uint64)(db->index_mask + 1) * 3)
+		db_index_resize(db, (db->index_mask + 1) * 2);
+	db_index_put(db->index, db->index_mask, node, db_index_hash(db, node->key));
+	db->index_count++;
+}
+
+/**
+ * Find the node of a key in the index of a database.
+ * Like the tree search, it also returns nodes that are marked as deleted.
+ * @param db Target database, its index must exist
+ * @param key Key of the node
+ * @return Node of the key or nullptr if not found
+ * @private
+ * @see DBMap_impl#index
+ */
+static DBNode* db_index_find(DBMap_impl* db, DBKey key)
+{
+	uint32 hash = db_index_hash(db, key);
+	uint32 mask = db->index_mask;
+	uint32 pos = hash & mask;
+	uint32 dist = 0;
+
+	for (;;) {
+		struct db_index_slot *slot = &db->index[pos];
+
+		if (slot->node == nullptr || ((pos - slot->hash) & mask) < dist)
+			return nullptr; // a node with this key would have been placed before
+		if (slot->hash == hash && db->cmp(key, slot->node->key, db->maxlen) == 0)
+			return slot->node;
+		pos = (pos + 1) & mask;
+		dist++;
+	}
+}
+
+/**
+ * Remove a node from the index of a database.
+ * The following nodes are shifted back, so no tombstones are needed.
+ * The index shrinks when it becomes less than 1/8 full.
+ * @param db Target database
+ * @param node Node to be removed, its key must still be valid
+ * @private
+ * @see DBMap_impl#index
+ */
+static void db_index_remove(DBMap_impl* db, DBNode *node)
+{
+	uint32 mask = db->index_mask;
+	uint32 pos;
+
+	if (db->index == nullptr)
+		return;
+
+	pos = db_index_hash(db, node->key) & mask;
+	while (db->index[pos].node != node) {
+		if (db->index[pos].node == nullptr) {
+			ShowWarning("db_index_remove: node was not found - database allocated at %s:%d\n", db->alloc_file, db->alloc_line);
+			return;
+		}
+		pos = (pos + 1) & mask;
+	}
+	for (;;) {
+		uint32 next = (pos + 1) & mask;
+
+		if (db->index[next].node == nullptr || ((next - db->index[next].hash) & mask) == 0) {
+			db->index[pos].node = nullptr;
+			break;
+		}
+		db->index[pos] = db->index[next];
+		pos = next;
+	}
+	db->index_count--;
+
+	if (db->index_count == 0) {
+		aFree(db->index);
+		db->index = nullptr;
+		db->index_mask = 0;
+	} else if (mask + 1 > DB_INDEX_MIN_SIZE && db->index_count * 8 < mask + 1)
+		db_index_resize(db, (mask + 1) / 2);
+}
+
+/**
+ * Add the nodes of a tree to the index of a database.
+ * @param db Target database
+ * @param node Root of the tree
+ * @private
+ * @see #db_index_rebuild(DBMap_impl*)
+ */
+static void db_index_add_tree(DBMap_impl* db, DBNode *node)
+{
+	while (node) {
+		db_index_add(db, node);
+		db_index_add_tree(db, node->left);
+		node = node->right;
+	}
+}
+
+/**
+ * Rebuild the index of a database from its trees.
+ * @param db Target database
+ * @private
+ * @see DBMap_impl#index
+ */
+static void db_index_rebuild(DBMap_impl* db)
+{
+	uint32 i;
+
+	if (db->index) {
+		aFree(db->index);
+		db->index = nullptr;
+	}
+	db->index_mask = 0;
+	db->index_count = 0;
+	for (i = 0; i < HASH_SIZE; i++)
+		db_index_add_tree(db, db->ht[i]);
+}
+
 /**
  * Add a node to the free_list of the database.
  * Marks the node as deleted.
@@ -828,6 +1075,7 @@ static void db_free_unlock(DBMap_impl* db)
 		return; // Not last lock
 
 	for (i = 0; i < db->free_count ; i++) {
+		db_index_remove(db, db->free_list[i].node);
 		db_rebalance_erase(db->free_list[i].node, db->free_list[i].root);
 		db_dup_key_free(db, db->free_list[i].node->key);
 		DB_COUNTSTAT(db_node_free);
@@ -1511,6 +1759,34 @@ static DBIterator* db_obj_iterator(DBMap* self)
 	return &it->vtable;
 }
 
+/**
+ * Find the node of a key, through the index if the database has one.
+ * Nodes marked as deleted are returned as well.
+ * @param db Target database
+ * @param key Key of the node
+ * @return Node of the key or nullptr if not found
+ * @private
+ */
+static DBNode* db_find_node(DBMap_impl* db, DBKey key)
+{
+	DBNode *node;
+
+	if (db->index)
+		return db_index_find(db, key);
+
+	node = db->ht[db->hash(key, db->maxlen)%HASH_SIZE];
+	while (node) {
+		int32 c = db->cmp(key, node->key, db->maxlen);
+		if (c == 0)
+			break;
+		if (c < 0)
+			node = node->left;
+		else
+			node = node->right;
+	}
+	return node;
+}
+
 /**
  * Returns true if the entry exists.
  * @param self Interface of the database
@@ -1542,20 +1818,10 @@ static bool db_obj_exists(DBMap* self, DBKey key)
 	}
 
 	db_free_lock(db);
-	node = db->ht[db->hash(key, db->maxlen)%HASH_SIZE];
-	while (node) {
-		int32 c = db->cmp(key, node->key, db->maxlen);
-		if (c == 0) {
-			if (!(node->deleted)) {
-				db->cache = node;
-				found = true;
-			}
-			break;
-		}
-		if (c < 0)
-			node = node->left;
-		else
-			node = node->right;
+	node = db_find_node(db, key);
+	if (node && !(node->deleted)) {
+		db->cache = node;
+		found = true;
 	}
 	db_free_unlock(db);
 	return found;
@@ -1593,20 +1859,10 @@ static DBData* db_obj_get(DBMap* self, DBKey key)
 	}
 
 	db_free_lock(db);
-	node = db->ht[db->hash(key, db->maxlen)%HASH_SIZE];
-	while (node) {
-		int32 c = db->cmp(key, node->key, db->maxlen);
-		if (c == 0) {
-			if (!(node->deleted)) {
-				data = &node->data;
-				db->cache = node;
-			}
-			break;
-		}
-		if (c < 0)
-			node = node->left;
-		else
-			node = node->right;
+	node = db_find_node(db, key);
+	if (node && !(node->deleted)) {
+		data = &node->data;
+		db->cache = node;
 	}
 	db_free_unlock(db);
 	return data;
@@ -1751,17 +2007,19 @@ static DBData* db_obj_vensure(DBMap* self, DBKey key, DBCreateData create, va_li
 
 	db_free_lock(db);
 	hash = db->hash(key, db->maxlen)%HASH_SIZE;
-	node = db->ht[hash];
-	while (node) {
-		c = db->cmp(key, node->key, db->maxlen);
-		if (c == 0) {
-			break;
+	if (db->index == nullptr || (node = db_index_find(db, key)) == nullptr) {
+		node = db->ht[hash];
+		while (node) {
+			c = db->cmp(key, node->key, db->maxlen);
+			if (c == 0) {
+				break;
+			}
+			parent = node;
+			if (c < 0)
+				node = node->left;
+			else
+				node = node->right;
 		}
-		parent = node;
-		if (c < 0)
-			node = node->left;
-		else
-			node = node->right;
 	}
 	// Create node if necessary
 	if (node == nullptr) {
@@ -1805,6 +2063,7 @@ static DBData* db_obj_vensure(DBMap* self, DBKey key, DBCreateData create, va_li
 		va_copy(argscopy, args);
 		node->data = create(key, argscopy);
 		va_end(argscopy);
+		db_index_add(db, node);
 	}
 	data = &node->data;
 	db->cache = node;
@@ -1862,6 +2121,7 @@ static int32 db_obj_put(DBMap* self, DBKey key, DBData data, DBData *out_data)
 	DBNode *parent = nullptr;
 	int32 c = 0, retval = 0;
 	uint32 hash;
+	bool created = false;
 
 	DB_COUNTSTAT(db_put);
 	if (db == nullptr) return 0; // nullpo candidate
@@ -1889,29 +2149,31 @@ static int32 db_obj_put(DBMap* self, DBKey key, DBData data, DBData *out_data)
 	// search for an equal node
 	db_free_lock(db);
 	hash = db->hash(key, db->maxlen)%HASH_SIZE;
-	for (node = db->ht[hash]; node; ) {
-		c = db->cmp(key, node->key, db->maxlen);
-		if (c == 0) { // equal entry, replace
-			if (node->deleted) {
-				db_free_remove(db, node);
+	if (db->index == nullptr || (node = db_index_find(db, key)) == nullptr) {
+		for (node = db->ht[hash]; node; ) {
+			c = db->cmp(key, node->key, db->maxlen);
+			if (c == 0)
+				break;
+			parent = node;
+			if (c < 0) {
+				node = node->left;
 			} else {
-				db->release(node->key, node->data, DB_RELEASE_BOTH);
-				if (out_data)
-					memcpy(out_data, &node->data, sizeof(*out_data));
-				retval = 1;
+				node = node->right;
 			}
-			break;
 		}
-		parent = node;
-		if (c < 0) {
-			node = node->left;
+	}
+	if (node) { // equal entry, replace
+		if (node->deleted) {
+			db_free_remove(db, node);
 		} else {
-			node = node->right;
+			db->release(node->key, node->data, DB_RELEASE_BOTH);
+			if (out_data)
+				memcpy(out_data, &node->data, sizeof(*out_data));
+			retval = 1;
 		}
-	}
-	// allocate a new node if necessary
-	if (node == nullptr) {
+	} else { // allocate a new node
 		DB_COUNTSTAT(db_node_alloc);
+		created = true;
 		node = ers_alloc(db->nodes, struct dbn);
 		node->left = nullptr;
 		node->right = nullptr;
@@ -1943,6 +2205,8 @@ static int32 db_obj_put(DBMap* self, DBKey key, DBData data, DBData *out_data)
 		node->key = key;
 	}
 	node->data = data;
+	if (created)
+		db_index_add(db, node);
 	db->cache = node;
 	db_free_unlock(db);
 	return retval;
@@ -1982,24 +2246,15 @@ static int32 db_obj_remove(DBMap* self, DBKey key, DBData *out_data)
 
 	db_free_lock(db);
 	hash = db->hash(key, db->maxlen)%HASH_SIZE;
-	for(node = db->ht[hash]; node; ){
-		int32 c = db->cmp(key, node->key, db->maxlen);
-		if (c == 0) {
-			if (!(node->deleted)) {
-				if (db->cache == node)
-					db->cache = nullptr;
-				db->release(node->key, node->data, DB_RELEASE_DATA);
-				if (out_data)
-					memcpy(out_data, &node->data, sizeof(*out_data));
-				retval = 1;
-				db_free_add(db, node, &db->ht[hash]);
-			}
-			break;
-		}
-		if (c < 0)
-			node = node->left;
-		else
-			node = node->right;
+	node = db_find_node(db, key);
+	if (node && !(node->deleted)) {
+		if (db->cache == node)
+			db->cache = nullptr;
+		db->release(node->key, node->data, DB_RELEASE_DATA);
+		if (out_data)
+			memcpy(out_data, &node->data, sizeof(*out_data));
+		retval = 1;
+		db_free_add(db, node, &db->ht[hash]);
 	}
 	db_free_unlock(db);
 	return retval;
@@ -2114,6 +2369,12 @@ static int32 db_obj_vclear(DBMap* self, DBApply func, va_list args)
 
 	db_free_lock(db);
 	db->cache = nullptr;
+	// The nodes are freed tree by tree, lookups from func have to use the trees until the index is rebuilt
+	if (db->index) {
+		aFree(db->index);
+		db->index = nullptr;
+	}
+	db->index_paused = 1;
 	for (i = 0; i < HASH_SIZE; i++) {
 		// Apply the func and delete in the order: left tree, right tree, current node
 		node = db->ht[i];
@@ -2155,6 +2416,8 @@ static int32 db_obj_vclear(DBMap* self, DBApply func, va_list args)
 	}
 	db->free_count = 0;
 	db->item_count = 0;
+	db->index_paused = 0;
+	db_index_rebuild(db);
 	db_free_unlock(db);
 	return sum;
 }
@@ -2233,6 +2496,8 @@ static int32 db_obj_vdestroy(DBMap* self, DBApply func, va_list args)
 	db_free_lock(db);
 	db->global_lock = 1;
 	sum = self->vclear(self, func, args);
+	if (db->index)
+		aFree(db->index);
 	aFree(db->free_list);
 	db->free_list = nullptr;
 	db->free_max = 0;
@@ -2573,6 +2838,10 @@ DBMap* db_alloc(const char *file, const char *func, int32 line, DBType type, DBO
 	db->release = db_default_release(type, options);
 	for (i = 0; i < HASH_SIZE; i++)
 		db->ht[i] = nullptr;
+	db->index = nullptr;
+	db->index_mask = 0;
+	db->index_count = 0;
+	db->index_paused = 0;
 	db->cache = nullptr;
 	db->type = type;
 	db->options = options;
@@ -122,6 +122,9 @@ typedef enum DBType {
  * @param DB_OPT_RELEASE_BOTH Releases both key and data.
  * @param DB_OPT_ALLOW_NULL_KEY Allow nullptr keys in the database.
  * @param DB_OPT_ALLOW_NULL_DATA Allow nullptr data in the database.
+ * @param DB_OPT_HASH_INDEX Keeps an open addressing index of the entries, so
+ *          lookups don't descend a tree. Meant for large databases with many
+ *          lookups, it costs 16 bytes per slot and makes insertions slower.
  * @public
  * @see #db_fix_options(DBType,DBOptions)
  * @see #db_default_release(DBType,DBOptions)
@@ -135,6 +138,7 @@ typedef enum DBOptions {
 	DB_OPT_RELEASE_BOTH    = DB_OPT_RELEASE_KEY|DB_OPT_RELEASE_DATA,
 	DB_OPT_ALLOW_NULL_KEY  = 0x08,
 	DB_OPT_ALLOW_NULL_DATA = 0x10,
+	DB_OPT_HASH_INDEX      = 0x20,
 } DBOptions;
 
 /**
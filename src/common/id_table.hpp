@@ -0,0 +1,128 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#ifndef ID_TABLE_HPP
+#define ID_TABLE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "cbasetypes.hpp"
+
+namespace rathena {
+	namespace util {
+		/**
+		 * Direct-indexed table for object ids that are handed out by a counter, starting at a base id.
+		 * The objects are looked up by their int32 member id.
+		 * The low bits of an id select the slot, the remaining bits act as a generation tag:
+		 * a stale id whose slot has been reused by a newer object does not match and resolves to nullptr.
+		 */
+		template <typename T> class id_table{
+		private:
+			struct s_slot{
+				int32 id;
+				T* object;
+			};
+
+			std::vector<s_slot> slots;
+			int32 base;
+			uint32 mask;
+			size_t count;
+
+			void resize( size_t size ){
+				std::vector<s_slot> old;
+
+				old.swap( this->slots );
+				this->slots.assign( size, s_slot{ 0, nullptr } );
+				this->mask = static_cast<uint32>( size - 1 );
+
+				// Slots that were distinct with the old mask are still distinct with a larger one
+				for( const s_slot& slot : old ){
+					if( slot.object != nullptr ){
+						this->slots[this->index( slot.id )] = slot;
+					}
+				}
+			}
+
+			uint32 index( int32 id ) const{
+				return static_cast<uint32>( id - this->base ) & this->mask;
+			}
+
+		public:
+			id_table( int32 base ) : base( base ), mask( 0 ), count( 0 ){
+			}
+
+			/// Whether the id lies in the range that is managed by this table
+			bool contains( int32 id, int32 end ) const{
+				return id >= this->base && id < end;
+			}
+
+			T* find( int32 id ) const{
+				if( this->slots.empty() ){
+					return nullptr;
+				}
+
+				const s_slot& slot = this->slots[this->index( id )];
+
+				return slot.id == id ? slot.object : nullptr;
+			}
+
+			/// Whether a new object may use the id without evicting a live one
+			bool available( int32 id ) const{
+				return this->slots.empty() || this->slots[this->index( id )].object == nullptr;
+			}
+
+			void insert( T* object ){
+				if( this->slots.empty() ){
+					this->resize( 4096 );
+				}
+
+				// Keep the load below 1/2 so that the id allocators find free slots quickly
+				if( ( this->count + 1 ) * 2 > this->slots.size() ){
+					this->resize( this->slots.size() * 2 );
+				}
+
+				// An id that was not checked with available() may collide with a live object
+				while( this->slots[this->index( object->id )].object != nullptr && this->slots[this->index( object->id )].id != object->id ){
+					this->resize( this->slots.size() * 2 );
+				}
+
+				s_slot& slot = this->slots[this->index( object->id )];
+
+				if( slot.object == nullptr ){
+					this->count++;
+				}
+
+				slot.id = object->id;
+				slot.object = object;
+			}
+
+			void erase( T* object ){
+				if( this->slots.empty() ){
+					return;
+				}
+
+				s_slot& slot = this->slots[this->index( object->id )];
+
+				if( slot.object != nullptr && slot.id == object->id ){
+					slot.id = 0;
+					slot.object = nullptr;
+					this->count--;
+				}
+			}
+
+			size_t size() const{
+				return this->count;
+			}
+
+			void clear(){
+				this->slots.clear();
+				this->slots.shrink_to_fit();
+				this->mask = 0;
+				this->count = 0;
+			}
+		};
+	}
+}
+
+#endif /* ID_TABLE_HPP */
@@ -6,6 +6,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <mutex>
 
 #include "core.hpp"
 #include "showmsg.hpp"
@@ -199,8 +200,15 @@ static struct unit_head_large *unit_head_large_first = nullptr;
 
 static struct block* block_malloc(uint16 hash);
 static void          block_free(struct block* p);
+static void          memmgr_free(void *ptr, const char *file, int32 line, const char *func);
 static size_t        memmgr_usage_bytes;
 
+/// Set by servers that allocate from more than one thread, serializes all memory manager calls
+static bool memmgr_threadsafe = false;
+static std::mutex memmgr_mutex;
+
+#define memmgr_lock() std::unique_lock<std::mutex> memmgr_guard( memmgr_mutex, std::defer_lock ); if( memmgr_threadsafe ) memmgr_guard.lock()
+
 #define block2unit(p, n) ((struct unit_head*)(&(p)->data[ p->unit_size * (n) ]))
 #define memmgr_assert(v) do { if(!(v)) { ShowError("Memory manager: assertion '" #v "' failed!\n"); } } while(0)
 
@@ -225,7 +233,7 @@ static size_t hash2size( uint16 hash )
 	}
 }
 
-void* _mmalloc(size_t size, const char *file, int32 line, const char *func )
+static void* memmgr_alloc(size_t size, const char *file, int32 line, const char *func )
 {
 	struct block *block;
 	int16 size_hash = size2hash( size );
@@ -327,9 +335,18 @@ void* _mmalloc(size_t size, const char *file, int32 line, const char *func )
 	return (char *)head + sizeof(struct unit_head) - sizeof(long);
 }
 
+void* _mmalloc(size_t size, const char *file, int32 line, const char *func )
+{
+	memmgr_lock();
+
+	return memmgr_alloc(size,file,line,func);
+}
+
 void* _mcalloc(size_t num, size_t size, const char *file, int32 line, const char *func )
 {
-	void *p = _mmalloc(num * size,file,line,func);
+	memmgr_lock();
+
+	void *p = memmgr_alloc(num * size,file,line,func);
 	memset(p,0,num * size);
 	return p;
 }
@@ -337,8 +354,10 @@ void* _mcalloc(size_t num, size_t size, const char *file, int32 line, const char
 void* _mrealloc(void *memblock, size_t size, const char *file, int32 line, const char *func )
 {
 	size_t old_size;
+	memmgr_lock();
+
 	if(memblock == nullptr) {
-		return _mmalloc(size,file,line,func);
+		return memmgr_alloc(size,file,line,func);
 	}
 
 	old_size = ((struct unit_head *)((char *)memblock - sizeof(struct unit_head) + sizeof(long)))->size;
@@ -350,11 +369,11 @@ void* _mrealloc(void *memblock, size_t size, const char *file, int32 line, const
 		return memblock;
 	}  else {
 		// Size Large
-		void *p = _mmalloc(size,file,line,func);
+		void *p = memmgr_alloc(size,file,line,func);
 		if(p != nullptr) {
 			memcpy(p,memblock,old_size);
 		}
-		_mfree(memblock,file,line,func);
+		memmgr_free(memblock,file,line,func);
 		return p;
 	}
 }
@@ -372,6 +391,13 @@ char* _mstrdup(const char *p, const char *file, int32 line, const char *func )
 }
 
 void _mfree(void *ptr, const char *file, int32 line, const char *func )
+{
+	memmgr_lock();
+
+	memmgr_free(ptr,file,line,func);
+}
+
+static void memmgr_free(void *ptr, const char *file, int32 line, const char *func )
 {
 	struct unit_head *head;
 
@@ -689,6 +715,16 @@ bool malloc_verify_ptr(void* ptr)
 }
 
 
+/// Makes the memory manager safe to use from several threads at once.
+/// Must be called before the second thread starts allocating, it stays enabled until the server stops.
+void malloc_set_threadsafe(void)
+{
+#ifdef USE_MEMMGR
+	memmgr_threadsafe = true;
+#endif
+}
+
+
 size_t malloc_usage (void)
 {
 #ifdef USE_MEMMGR
@@ -0,0 +1,424 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core.hpp"
+#include "showmsg.hpp"
+#include "strlib.hpp"
+
+// Latency histograms use 16 linear sub-buckets per power of two (about 6% precision) for values up to 2^32 microseconds
+#define PROFILER_HISTOGRAM_SUB_BITS 4
+#define PROFILER_HISTOGRAM_SUB ( 1 << PROFILER_HISTOGRAM_SUB_BITS )
+#define PROFILER_HISTOGRAM_SIZE ( PROFILER_HISTOGRAM_SUB + ( 32 - PROFILER_HISTOGRAM_SUB_BITS ) * PROFILER_HISTOGRAM_SUB )
+// Number of slowest calls remembered per loop iteration for the stall detector
+#define PROFILER_STALL_CALLS 5
+
+struct s_profiler_stat{
+	uint64 calls;
+	uint64 total;
+	uint64 max;
+};
+
+struct s_profiler_histogram{
+	uint64 counts[PROFILER_HISTOGRAM_SIZE];
+	uint64 count;
+	uint64 max;
+};
+
+struct s_profiler_sample{
+	e_profiler_type type;
+	uintptr_t key;
+	uint64 duration;
+};
+
+bool profiler_enabled = false;
+int32 profiler_dump_interval = 0;
+char profiler_dump_file[256] = "log/profiler_%s.log";
+int32 profiler_stall_threshold = 0;
+
+static std::unordered_map<uintptr_t, s_profiler_stat> profiler_stats[PROFILER_MAX];
+static s_profiler_histogram profiler_histograms[PROFILER_PHASE_MAX];
+static time_t profiler_start_time;
+
+// State of the current loop iteration
+static s_profiler_sample profiler_slowest[PROFILER_STALL_CALLS];
+static int32 profiler_slowest_count = 0;
+static uint64 profiler_idle = 0;
+static t_tick profiler_stall_last_report = 0;
+static uint32 profiler_stall_suppressed = 0;
+
+static const char* profiler_type_name[PROFILER_MAX] = {
+	"Timer functions",
+	"Packet handlers",
+};
+
+static const char* profiler_phase_name[PROFILER_PHASE_MAX] = {
+	"loop",
+	"timers",
+	"sockets",
+};
+
+/// Adds a measured call to the statistics and remembers it if it is one of the slowest of this loop iteration.
+void profiler_record( e_profiler_type type, uintptr_t key, uint64 duration ){
+	if( profiler_enabled ){
+		s_profiler_stat& stat = profiler_stats[type][key];
+
+		stat.calls++;
+		stat.total += duration;
+
+		if( duration > stat.max ){
+			stat.max = duration;
+		}
+	}
+
+	if( profiler_stall_threshold > 0 ){
+		int32 i = profiler_slowest_count;
+
+		if( i == PROFILER_STALL_CALLS ){
+			if( duration <= profiler_slowest[i - 1].duration ){
+				return;
+			}
+
+			i--;
+		}else{
+			profiler_slowest_count++;
+		}
+
+		// keep the list sorted, slowest first
+		for( ; i > 0 && profiler_slowest[i - 1].duration < duration; i-- ){
+			profiler_slowest[i] = profiler_slowest[i - 1];
+		}
+
+		profiler_slowest[i] = { type, key, duration };
+	}
+}
+
+/// Returns the histogram bucket of a value in microseconds.
+static int32 profiler_histogram_index( uint64 value ){
+	if( value < PROFILER_HISTOGRAM_SUB ){
+		return (int32)value;
+	}
+
+	if( value > UINT32_MAX ){
+		value = UINT32_MAX;
+	}
+
+	int32 shift = 0;
+
+	while( ( value >> shift ) >= 2 * PROFILER_HISTOGRAM_SUB ){
+		shift++;
+	}
+
+	return PROFILER_HISTOGRAM_SUB + shift * PROFILER_HISTOGRAM_SUB + (int32)( value >> shift ) - PROFILER_HISTOGRAM_SUB;
+}
+
+/// Returns the highest value in microseconds that belongs to a histogram bucket.
+static uint64 profiler_histogram_value( int32 index ){
+	if( index < PROFILER_HISTOGRAM_SUB ){
+		return index;
+	}
+
+	int32 shift = ( index - PROFILER_HISTOGRAM_SUB ) / PROFILER_HISTOGRAM_SUB;
+	uint64 base = (uint64)( index - shift * PROFILER_HISTOGRAM_SUB );
+
+	return ( ( base + 1 ) << shift ) - 1;
+}
+
+/// Returns the value in microseconds below which 'percentile' percent of the recorded values are.
+static uint64 profiler_histogram_percentile( const s_profiler_histogram& histogram, double percentile ){
+	uint64 target = (uint64)( percentile / 100.0 * (double)histogram.count + 0.5 );
+	uint64 seen = 0;
+
+	if( target == 0 ){
+		target = 1;
+	}
+
+	for( int32 i = 0; i < PROFILER_HISTOGRAM_SIZE; i++ ){
+		seen += histogram.counts[i];
+
+		if( seen >= target ){
+			return std::min( profiler_histogram_value( i ), histogram.max );
+		}
+	}
+
+	return histogram.max;
+}
+
+/// Clears all statistics.
+void profiler_reset( void ){
+	for( int32 i = 0; i < PROFILER_MAX; i++ ){
+		profiler_stats[i].clear();
+	}
+
+	memset( profiler_histograms, 0, sizeof( profiler_histograms ) );
+
+	profiler_start_time = time( nullptr );
+}
+
+/// Returns a readable name for a profiled key.
+static const char* profiler_key_name( e_profiler_type type, uintptr_t key, char* buf, size_t size ){
+	switch( type ){
+		case PROFILER_TIMER:
+			return search_timer_func_list( (TimerFunc)key );
+		case PROFILER_PACKET:
+			safesnprintf( buf, size, "0x%04x", (uint32)key );
+			return buf;
+		default:
+			return "unknown";
+	}
+}
+
+/// Returns the statistics of a type, sorted by total time spent.
+static std::vector<std::pair<uintptr_t, s_profiler_stat>> profiler_sorted( e_profiler_type type ){
+	std::vector<std::pair<uintptr_t, s_profiler_stat>> entries( profiler_stats[type].begin(), profiler_stats[type].end() );
+
+	std::sort( entries.begin(), entries.end(), []( const std::pair<uintptr_t, s_profiler_stat>& a, const std::pair<uintptr_t, s_profiler_stat>& b ){
+		return a.second.total > b.second.total;
+	} );
+
+	return entries;
+}
+
+/// Converts a gettick_precise difference to microseconds.
+static double profiler_usec( uint64 duration ){
+	uint64 frequency = gettick_precise_frequency();
+
+	if( frequency == 0 ){
+		return 0;
+	}
+
+	return (double)duration * 1000.0 / (double)frequency;
+}
+
+/// Adds time the current loop iteration spent waiting for events, which is not counted as latency.
+void profiler_record_idle( uint64 duration ){
+	profiler_idle += duration;
+}
+
+/// Logs the slowest calls of the current loop iteration.
+static void profiler_stall_report( uint64 loop, uint64 timer, uint64 socket ){
+	t_tick tick = gettick();
+
+	// do not flood the console while the server is overloaded
+	if( DIFF_TICK( tick, profiler_stall_last_report ) < 1000 ){
+		profiler_stall_suppressed++;
+		return;
+	}
+
+	ShowWarning( "Server loop stalled for %.1f ms (timers: %.1f ms, sockets: %.1f ms, %u stalls since the last warning were not logged).\n", profiler_usec( loop ) / 1000.0, profiler_usec( timer ) / 1000.0, profiler_usec( socket ) / 1000.0, profiler_stall_suppressed );
+
+	for( int32 i = 0; i < profiler_slowest_count; i++ ){
+		char buf[32];
+		const s_profiler_sample& sample = profiler_slowest[i];
+
+		ShowMessage( "  %s %s: %.3f ms\n", sample.type == PROFILER_TIMER ? "timer" : "packet", profiler_key_name( sample.type, sample.key, buf, sizeof( buf ) ), profiler_usec( sample.duration ) / 1000.0 );
+	}
+
+	profiler_stall_last_report = tick;
+	profiler_stall_suppressed = 0;
+}
+
+/// Finishes a main loop iteration, records its latencies and checks for a stall.
+/// @param start: gettick_precise at the beginning of the iteration
+/// @param timer_end: gettick_precise after do_timer
+/// @param end: gettick_precise at the end of the iteration
+void profiler_loop( uint64 start, uint64 timer_end, uint64 end ){
+	uint64 timer = timer_end - start;
+	uint64 socket = end - timer_end;
+
+	socket = socket > profiler_idle ? socket - profiler_idle : 0;
+
+	uint64 durations[PROFILER_PHASE_MAX] = { timer + socket, timer, socket };
+
+	for( int32 i = 0; i < PROFILER_PHASE_MAX; i++ ){
+		s_profiler_histogram& histogram = profiler_histograms[i];
+		uint64 usec = (uint64)profiler_usec( durations[i] );
+
+		histogram.counts[profiler_histogram_index( usec )]++;
+		histogram.count++;
+
+		if( usec > histogram.max ){
+			histogram.max = usec;
+		}
+	}
+
+	if( profiler_stall_threshold > 0 && profiler_usec( durations[PROFILER_PHASE_LOOP] ) >= profiler_stall_threshold * 1000.0 ){
+		profiler_stall_report( durations[PROFILER_PHASE_LOOP], timer, socket );
+	}
+
+	profiler_slowest_count = 0;
+	profiler_idle = 0;
+}
+
+/// Formats the percentiles of the loop latency histograms.
+static std::string profiler_latency_table( void ){
+	static const double percentiles[] = { 50, 90, 99, 99.9 };
+	char line[256];
+	std::string table;
+
+	safesnprintf( line, sizeof( line ), "Loop latency in us (%" PRIu64 " iterations):\n  %-10s %10s %10s %10s %10s %10s\n", profiler_histograms[PROFILER_PHASE_LOOP].count, "phase", "p50", "p90", "p99", "p99.9", "max" );
+	table += line;
+
+	for( int32 i = 0; i < PROFILER_PHASE_MAX; i++ ){
+		const s_profiler_histogram& histogram = profiler_histograms[i];
+		uint64 values[ARRAYLENGTH( percentiles )];
+
+		for( size_t j = 0; j < ARRAYLENGTH( percentiles ); j++ ){
+			values[j] = profiler_histogram_percentile( histogram, percentiles[j] );
+		}
+
+		safesnprintf( line, sizeof( line ), "  %-10s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", profiler_phase_name[i], values[0], values[1], values[2], values[3], histogram.max );
+		table += line;
+	}
+
+	return table;
+}
+
+/// Shows the percentiles of the loop latency histograms on the console.
+void profiler_latency_report( void ){
+	ShowInfo( "Server loop latency of the last %.0f seconds:\n", difftime( time( nullptr ), profiler_start_time ) );
+	ShowMessage( "%s", profiler_latency_table().c_str() );
+}
+
+/// Formats the statistics of one type as a table, using at most 'count' lines (0 for all).
+static std::string profiler_table( e_profiler_type type, size_t count ){
+	char buf[32];
+	char line[256];
+	std::string table;
+	std::vector<std::pair<uintptr_t, s_profiler_stat>> entries = profiler_sorted( type );
+
+	if( count == 0 || count > entries.size() ){
+		count = entries.size();
+	}
+
+	safesnprintf( line, sizeof( line ), "%s (%" PRIuPTR " measured):\n", profiler_type_name[type], entries.size() );
+	table += line;
+	safesnprintf( line, sizeof( line ), "  %-40s %12s %12s %10s %10s\n", "name", "calls", "total ms", "avg us", "max us" );
+	table += line;
+
+	for( size_t i = 0; i < count; i++ ){
+		const s_profiler_stat& stat = entries[i].second;
+
+		safesnprintf( line, sizeof( line ), "  %-40s %12" PRIu64 " %12.3f %10.2f %10.2f\n", profiler_key_name( type, entries[i].first, buf, sizeof( buf ) ), stat.calls, profiler_usec( stat.total ) / 1000.0, profiler_usec( stat.total ) / (double)stat.calls, profiler_usec( stat.max ) );
+		table += line;
+	}
+
+	return table;
+}
+
+/// Shows the 'count' most expensive entries of every type on the console.
+void profiler_report( size_t count ){
+	ShowInfo( "Profiler results of the last %.0f seconds (%s):\n", difftime( time( nullptr ), profiler_start_time ), profiler_enabled ? "enabled" : "disabled" );
+
+	for( int32 i = 0; i < PROFILER_MAX; i++ ){
+		ShowMessage( "%s", profiler_table( (e_profiler_type)i, count ).c_str() );
+	}
+}
+
+/// Appends all statistics to a file. A %s in the filename is replaced by the server type.
+bool profiler_dump( const char* filename ){
+	std::string path = filename;
+	size_t pos = path.find( "%s" );
+
+	if( pos != std::string::npos ){
+		const char* server;
+
+		switch( global_core->get_type() ){
+			case rathena::server_core::e_core_type::LOGIN: server = "login"; break;
+			case rathena::server_core::e_core_type::CHARACTER: server = "char"; break;
+			case rathena::server_core::e_core_type::MAP: server = "map"; break;
+			case rathena::server_core::e_core_type::WEB: server = "web"; break;
+			default: server = "tool"; break;
+		}
+
+		path.replace( pos, 2, server );
+	}
+
+	FILE* fp = fopen( path.c_str(), "a" );
+
+	if( fp == nullptr ){
+		ShowError( "profiler_dump: Could not open '%s' for writing.\n", path.c_str() );
+		return false;
+	}
+
+	char timestring[24];
+	time_t now = time( nullptr );
+
+	strftime( timestring, sizeof( timestring ), "%Y-%m-%d %H:%M:%S", localtime( &now ) );
+	fprintf( fp, "[%s] Profiler results of the last %.0f seconds\n", timestring, difftime( now, profiler_start_time ) );
+	fputs( profiler_latency_table().c_str(), fp );
+
+	for( int32 i = 0; i < PROFILER_MAX; i++ ){
+		fputs( profiler_table( (e_profiler_type)i, 0 ).c_str(), fp );
+	}
+
+	fprintf( fp, "\n" );
+	fclose( fp );
+
+	return true;
+}
+
+/// Handles the 'profiler' console command.
+void profiler_console( const char* command ){
+	if( strcmpi( command, "on" ) == 0 ){
+		profiler_reset();
+		profiler_enabled = true;
+		ShowInfo( "Profiler enabled.\n" );
+	}else if( strcmpi( command, "off" ) == 0 ){
+		profiler_enabled = false;
+		ShowInfo( "Profiler disabled.\n" );
+	}else if( strcmpi( command, "reset" ) == 0 ){
+		profiler_reset();
+		ShowInfo( "Profiler results cleared.\n" );
+	}else if( strcmpi( command, "show" ) == 0 ){
+		profiler_report( 10 );
+	}else if( strcmpi( command, "latency" ) == 0 ){
+		profiler_latency_report();
+	}else if( strcmpi( command, "dump" ) == 0 ){
+		if( profiler_dump( profiler_dump_file ) ){
+			ShowInfo( "Profiler results written.\n" );
+		}
+	}else{
+		ShowInfo( "Usage: profiler:<on|off|reset|show|latency|dump>\n" );
+	}
+}
+
+/// Periodically writes the results to the dump file and starts a new interval.
+static TIMER_FUNC( profiler_dump_timer ){
+	if( !profiler_enabled ){
+		return 0;
+	}
+
+	profiler_dump( profiler_dump_file );
+	profiler_reset();
+
+	return 0;
+}
+
+void profiler_init( void ){
+	profiler_start_time = time( nullptr );
+
+	add_timer_func_list( profiler_dump_timer, "profiler_dump_timer" );
+
+	if( profiler_dump_interval > 0 ){
+		add_timer_interval( gettick() + profiler_dump_interval, profiler_dump_timer, 0, 0, profiler_dump_interval );
+	}
+}
+
+void profiler_final( void ){
+	profiler_enabled = false;
+
+	for( int32 i = 0; i < PROFILER_MAX; i++ ){
+		profiler_stats[i].clear();
+	}
+}
@@ -0,0 +1,64 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "cbasetypes.hpp"
+#include "timer.hpp"
+
+/// Kinds of calls measured by the profiler
+enum e_profiler_type : uint8{
+	PROFILER_TIMER = 0, ///< Timer functions, keyed by the function pointer
+	PROFILER_PACKET, ///< Packet handlers, keyed by the packet id
+	PROFILER_MAX
+};
+
+/// Phases of the main server loop with a latency histogram
+enum e_profiler_phase : uint8{
+	PROFILER_PHASE_LOOP = 0, ///< Whole iteration, without the time spent waiting for events
+	PROFILER_PHASE_TIMER, ///< do_timer
+	PROFILER_PHASE_SOCKET, ///< Socket I/O and packet parsing, without the time spent waiting for events
+	PROFILER_PHASE_MAX
+};
+
+extern bool profiler_enabled;
+extern int32 profiler_dump_interval;
+extern char profiler_dump_file[256];
+extern int32 profiler_stall_threshold;
+
+void profiler_record( e_profiler_type type, uintptr_t key, uint64 duration );
+
+/// Starts measuring a call or a part of the main loop. Returns 0 if neither the profiler nor the stall detector is enabled.
+static inline uint64 profiler_begin(){
+	return ( profiler_enabled || profiler_stall_threshold > 0 ) ? gettick_precise() : 0;
+}
+
+/// Finishes measuring a call started with profiler_begin.
+static inline void profiler_end( e_profiler_type type, uintptr_t key, uint64 start ){
+	if( start != 0 ){
+		profiler_record( type, key, gettick_precise() - start );
+	}
+}
+
+void profiler_record_idle( uint64 duration );
+
+/// Finishes measuring a wait for events started with profiler_begin.
+static inline void profiler_loop_idle( uint64 start ){
+	if( start != 0 ){
+		profiler_record_idle( gettick_precise() - start );
+	}
+}
+
+void profiler_loop( uint64 start, uint64 timer_end, uint64 end );
+
+void profiler_reset( void );
+void profiler_latency_report( void );
+void profiler_report( size_t count );
+bool profiler_dump( const char* filename );
+void profiler_console( const char* command );
+
+void profiler_init( void );
+void profiler_final( void );
+
+#endif /* PROFILER_HPP */
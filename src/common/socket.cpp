@@ -9,7 +9,14 @@
 
 // (^~_~^) Gepard Shield End
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #ifdef WIN32
 	#include "winapi.hpp"
@@ -21,6 +28,7 @@
 	#include <sys/ioctl.h>
 	#include <sys/socket.h>
 	#include <sys/time.h>
+	#include <sys/uio.h>
 	#include <unistd.h>
 
 	#if defined(__linux__) || defined(__linux)
@@ -28,6 +36,7 @@
 
 		#ifdef SOCKET_EPOLL
 			#include <sys/epoll.h>
+			#include <sys/eventfd.h>
 		#endif
 	#else 
 		#include <netinet/in.h>
@@ -49,9 +58,12 @@
 #include "cbasetypes.hpp"
 #include "malloc.hpp"
 #include "mmo.hpp"
+#include "profiler.hpp"
 #include "showmsg.hpp"
+#include "spsc_queue.hpp"
 #include "strlib.hpp"
 #include "timer.hpp"
+#include "utils.hpp"
 
 // (^~_~^) Gepard Shield Start
 
@@ -231,6 +243,45 @@ char* sErr(int32 code)
 	#define MSG_NOSIGNAL 0
 #endif
 
+// Scatter-gather send of several buffers with a single system call
+#ifdef WIN32
+typedef WSABUF send_buf;
+
+static inline void send_buf_set(send_buf& b, const uint8* p, size_t l)
+{
+	b.buf = (CHAR*)p;
+	b.len = (ULONG)l;
+}
+
+static int32 sSendv(int32 fd, send_buf* bufs, int32 count, int32 flags)
+{
+	DWORD sent = 0;
+
+	if( WSASend(fd2sock(fd), bufs, count, &sent, flags, nullptr, nullptr) == SOCKET_ERROR )
+		return SOCKET_ERROR;
+
+	return (int32)sent;
+}
+#else
+typedef struct iovec send_buf;
+
+static inline void send_buf_set(send_buf& b, const uint8* p, size_t l)
+{
+	b.iov_base = (void*)p;
+	b.iov_len = l;
+}
+
+static int32 sSendv(int32 fd, send_buf* bufs, int32 count, int32 flags)
+{
+	struct msghdr msg = {};
+
+	msg.msg_iov = bufs;
+	msg.msg_iovlen = count;
+
+	return (int32)sendmsg(fd, &msg, flags);
+}
+#endif
+
 #ifndef SOCKET_EPOLL
 	// Select based Event Dispatcher
 	fd_set readfds;
@@ -608,6 +659,34 @@ void gepard_process_sc_packet(int fd, struct socket_data* s, size_t packet_size)
 	}
 }
 
+/// Whether gepard_process_sc_packet encrypts the packet with the key of the connection
+static bool gepard_is_sc_packet_encrypted(unsigned short packet_id)
+{
+	switch (packet_id)
+	{
+		case SC_GEPARD_INIT:
+		case SC_WHISPER_FROM:
+		case SC_SET_UNIT_IDLE_1:
+		case SC_SET_UNIT_IDLE_2:
+		case SC_SET_UNIT_IDLE_3:
+		case SC_SET_UNIT_IDLE_4:
+		case SC_SET_UNIT_IDLE_5:
+		case SC_SET_UNIT_WALKING_1:
+		case SC_SET_UNIT_WALKING_2:
+		case SC_SET_UNIT_WALKING_3:
+		case SC_SET_UNIT_WALKING_4:
+		case SC_SET_UNIT_WALKING_5:
+		case SC_STATE_CHANGE:
+		case SC_NOTIFY_TIME:
+		case SC_MSG_STATE_CHANGE_1:
+		case SC_MSG_STATE_CHANGE_2:
+		case SC_MSG_STATE_CHANGE_3:
+			return true;
+	}
+
+	return false;
+}
+
 void gepard_send_info(int fd, unsigned short info_type, const char* message)
 {
 	int message_len = (message != NULL) ? (strlen(message) + 1) : 0;
@@ -636,6 +715,11 @@ static size_t socket_max_client_packet = 0x6000;
 static size_t socket_max_client_packet = USHRT_MAX;
 #endif
 
+// Packets shorter than this are copied into the write fifo of every recipient by WFIFOSHARE.
+static size_t wfifo_share_min_size = 64;
+// WFIFOSHARE statistics, bytes queued for all recipients and bytes of it that were copied
+static uint64 wfifo_share_recipients = 0, wfifo_share_sent = 0, wfifo_share_copied = 0;
+
 #ifdef SHOW_SERVER_STATS
 // Data I/O statistics
 static size_t socket_data_i = 0, socket_data_ci = 0, socket_data_qi = 0;
@@ -652,6 +736,14 @@ static time_t socket_data_last_tick = 0;
 // Maximum size of pending data in the write fifo. (for non-server connections)
 // The connection is closed if it goes over the limit.
 #define WFIFO_MAX (1*1024*1024)
+// Maximum number of write buffers passed to a single send call
+#define WFIFO_SEND_BUFS 64
+
+/// Returns the number of bytes of a session waiting to be sent.
+static inline size_t wfifo_pending(struct socket_data* s)
+{
+	return s->wqueue_size + s->wdata_size - s->wdata_pos;
+}
 
 struct socket_data* session[MAXCONN];
 
@@ -661,6 +753,29 @@ size_t send_shortlist_count = 0;// how many fd's are in the shortlist
 uint32 send_shortlist_set[(MAXCONN+31)/32];// to know if specific fd's are already in the shortlist
 #endif
 
+// Sessions that received data, reached eof or still have unparsed data, only these are parsed by do_sockets
+static int32 parse_list_array[MAXCONN];
+static size_t parse_list_count = 0;
+static uint32 parse_list_set[(MAXCONN+31)/32];
+static int32 parse_list_current[MAXCONN];
+
+// Timeout wheel, every session is linked into the slot of the second it times out in.
+// The slots are visited once per second, so idle sessions are not looked at in every loop.
+#define STALL_WHEEL_SIZE 64
+static int32 stall_wheel[STALL_WHEEL_SIZE];
+static time_t stall_wheel_tick = 0; // last second that was checked
+
+static void parse_list_add_fd(int32 fd);
+static void stall_wheel_link(int32 fd, time_t tick);
+static void stall_wheel_unlink(int32 fd);
+#ifdef SOCKET_EPOLL
+static std::vector<std::unique_ptr<struct s_socket_io_thread>> socket_io_threads;
+static void socket_io_rqueue_clear(struct socket_data* s);
+static void socket_io_fill(int32 fd);
+static void socket_io_attach(int32 fd);
+static void socket_io_detach(int32 fd);
+#endif
+
 static int32 create_session(int32 fd, RecvFunc func_recv, SendFunc func_send, ParseFunc func_parse);
 
 #ifndef MINICORE
@@ -755,6 +870,7 @@ void set_eof(int32 fd)
 		// Add this socket to the shortlist for eof handling.
 		send_shortlist_add_fd(fd);
 #endif
+		parse_list_add_fd(fd);
 		session[fd]->flag.eof = 1;
 	}
 }
@@ -785,6 +901,7 @@ int32 recv_to_fifo(int32 fd)
 
 	session[fd]->rdata_size += len;
 	session[fd]->rdata_tick = last_tick;
+	parse_list_add_fd(fd);
 #ifdef SHOW_SERVER_STATS
 	socket_data_i += len;
 	socket_data_qi += len;
@@ -796,26 +913,105 @@ int32 recv_to_fifo(int32 fd)
 	return 0;
 }
 
+/// Frees a write buffer segment, shared packets are only released.
+static void wfifo_segment_free(struct wfifo_segment* seg)
+{
+	if( seg->shared != nullptr )
+		wfifo_shared_release(seg->shared);
+	else
+		aFree(seg->data);
+	aFree(seg);
+}
+
+/// Appends a segment to the write queue of a session.
+static void wfifo_segment_append(struct socket_data* s, struct wfifo_segment* seg)
+{
+	if( s->wqueue_tail )
+		s->wqueue_tail->next = seg;
+	else
+		s->wqueue_head = seg;
+	s->wqueue_tail = seg;
+	s->wqueue_size += seg->size - seg->pos;
+}
+
+/// Drops all data of a session waiting to be sent.
+static void wfifo_clear(struct socket_data* s)
+{
+	struct wfifo_segment* seg;
+
+	while( ( seg = s->wqueue_head ) != nullptr )
+	{
+		s->wqueue_head = seg->next;
+		wfifo_segment_free(seg);
+	}
+
+	s->wqueue_tail = nullptr;
+	s->wqueue_size = 0;
+	s->wdata_size = s->wdata_pos = 0;
+}
+
+/// Marks 'len' bytes of a session as sent and releases the write buffers that were sent completely.
+static void wfifo_consume(struct socket_data* s, size_t len)
+{
+	struct wfifo_segment* seg;
+
+	while( len > 0 && ( seg = s->wqueue_head ) != nullptr )
+	{
+		size_t n = zmin(len, seg->size - seg->pos);
+
+		seg->pos += n;
+		s->wqueue_size -= n;
+		len -= n;
+
+		if( seg->pos == seg->size )
+		{
+			s->wqueue_head = seg->next;
+			if( s->wqueue_head == nullptr )
+				s->wqueue_tail = nullptr;
+			wfifo_segment_free(seg);
+		}
+	}
+
+	s->wdata_pos += len;
+
+	// everything was sent, start over at the beginning of the buffer
+	if( s->wdata_pos == s->wdata_size )
+		s->wdata_size = s->wdata_pos = 0;
+}
+
+/// Sends as much of the queued write buffers and wdata as the socket accepts.
+/// Unsent data stays where it is, the buffers only remember how much of them was sent.
 int32 send_from_fifo(int32 fd)
 {
-	int32 len;
+	send_buf bufs[WFIFO_SEND_BUFS];
+	struct socket_data* s;
+	struct wfifo_segment* seg;
+	int32 count = 0, len;
 
 	if( !session_isValid(fd) )
 		return -1;
 
-	if( session[fd]->wdata_size == 0 )
+	s = session[fd];
+
+	if( wfifo_pending(s) == 0 )
 		return 0; // nothing to send
 
-	len = sSend(fd, (const char *) session[fd]->wdata, (int32)session[fd]->wdata_size, MSG_NOSIGNAL);
+	for( seg = s->wqueue_head; seg != nullptr && count < WFIFO_SEND_BUFS; seg = seg->next )
+		send_buf_set(bufs[count++], seg->data + seg->pos, seg->size - seg->pos);
+
+	if( seg == nullptr && count < WFIFO_SEND_BUFS && s->wdata_size > s->wdata_pos )
+		send_buf_set(bufs[count++], s->wdata + s->wdata_pos, s->wdata_size - s->wdata_pos);
+
+	len = sSendv(fd, bufs, count, MSG_NOSIGNAL);
 
 	if( len == SOCKET_ERROR )
 	{//An exception has occured
 		if( sErrno != S_EWOULDBLOCK ) {
 			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
 #ifdef SHOW_SERVER_STATS
-			socket_data_qo -= session[fd]->wdata_size;
+			socket_data_qo -= wfifo_pending(s);
 #endif
-			session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+			wfifo_clear(s); //Clear the send queue as we can't send anymore. [Skotlex]
 			set_eof(fd);
 		}
 		return 0;
@@ -823,18 +1019,12 @@ int32 send_from_fifo(int32 fd)
 
 	if( len > 0 )
 	{
-		session[fd]->wdata_tick = last_tick;
-
-		// some data could not be transferred?
-		// shift unsent data to the beginning of the queue
-		if( (size_t)len < session[fd]->wdata_size )
-			memmove(session[fd]->wdata, session[fd]->wdata + len, session[fd]->wdata_size - len);
-
-		session[fd]->wdata_size -= len;
+		s->wdata_tick = last_tick;
+		wfifo_consume(s, len);
 #ifdef SHOW_SERVER_STATS
 		socket_data_o += len;
 		socket_data_qo -= len;
-		if (!session[fd]->flag.server)
+		if (!s->flag.server)
 		{
 			socket_data_co += len;
 		}
@@ -902,13 +1092,15 @@ int32 connect_client(int32 listen_fd)
 	sFD_SET(fd,&readfds);
 #else
 	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
-
-	if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
-		ShowError( "connect_client: Failed to add to epoll event dispatcher for new socket #%d: %s\n", fd, error_msg() );
-		sClose( fd );
-		return -1;
+	if( socket_io_threads.empty() ){// otherwise the socket is watched by a network I/O thread, see socket_io_attach
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
+
+		if( epoll_ctl( epfd, EPOLL_CTL_ADD, fd, &epevent ) == SOCKET_ERROR ){
+			ShowError( "connect_client: Failed to add to epoll event dispatcher for new socket #%d: %s\n", fd, error_msg() );
+			sClose( fd );
+			return -1;
+		}
 	}
 #endif
 
@@ -916,6 +1108,9 @@ int32 connect_client(int32 listen_fd)
 
 	create_session(fd, recv_to_fifo, send_from_fifo, default_func_parse);
 	session[fd]->client_addr = ntohl(client_address.sin_addr.s_addr);
+#ifdef SOCKET_EPOLL
+	socket_io_attach(fd);
+#endif
 
 	return fd;
 }
@@ -1126,6 +1321,8 @@ static int32 create_session(int32 fd, RecvFunc func_recv, SendFunc func_send, Pa
 	session[fd]->func_parse = func_parse;
 	session[fd]->rdata_tick = last_tick;
 	session[fd]->wdata_tick = last_tick;
+	if( fd > 0 ) // session[0] is only a placeholder
+		stall_wheel_link(fd, last_tick + stall_time + 1);
 	return 0;
 }
 
@@ -1135,7 +1332,12 @@ static void delete_session(int32 fd)
 	{
 #ifdef SHOW_SERVER_STATS
 		socket_data_qi -= session[fd]->rdata_size - session[fd]->rdata_pos;
-		socket_data_qo -= session[fd]->wdata_size;
+		socket_data_qo -= wfifo_pending(session[fd]);
+#endif
+		stall_wheel_unlink(fd);
+		wfifo_clear(session[fd]);
+#ifdef SOCKET_EPOLL
+		socket_io_rqueue_clear(session[fd]);
 #endif
 		aFree(session[fd]->rdata);
 		aFree(session[fd]->wdata);
@@ -1162,27 +1364,59 @@ int32 _realloc_fifo( int32 fd, uint32 rfifo_size, uint32 wfifo_size, const char*
 }
 
 int32 _realloc_writefifo( int32 fd, size_t addition, const char* file, int32 line, const char* func ){
-	size_t newsize;
+	struct socket_data* s;
+	size_t newsize, unsent, nominal;
+	uint8* wdata;
 
 	if( !session_isValid(fd) ) // might not happen
 		return 0;
 
-	if( session[fd]->wdata_size + addition  > session[fd]->max_wdata )
+	s = session[fd];
+	unsent = s->wdata_size - s->wdata_pos;
+	nominal = s->flag.server ? FIFOSIZE_SERVERLINK : WFIFO_SIZE;
+
+	if( s->wdata_size + addition > s->max_wdata && unsent >= WFIFO_SIZE )
+	{	// a big backlog is never moved, queue the buffer as it is and continue in a new one
+		struct wfifo_segment* seg;
+
+		CREATE(seg, struct wfifo_segment, 1);
+		seg->data = s->wdata;
+		seg->size = s->wdata_size;
+		seg->pos = s->wdata_pos;
+		wfifo_segment_append(s, seg);
+
+		newsize = WFIFO_SIZE;
+		while( addition > newsize ) newsize += WFIFO_SIZE;
+
+		s->wdata = (uint8*)aMalloc2(newsize, file, line, func);
+		s->max_wdata = newsize;
+		s->wdata_size = s->wdata_pos = 0;
+		return 0;
+	}
+
+	if( s->wdata_size + addition > s->max_wdata )
 	{	// grow rule; grow in multiples of WFIFO_SIZE
 		newsize = WFIFO_SIZE;
-		while( session[fd]->wdata_size + addition > newsize ) newsize += WFIFO_SIZE;
+		while( unsent + addition > newsize ) newsize += WFIFO_SIZE;
 	}
 	else
-	if( session[fd]->max_wdata >= (size_t)2*(session[fd]->flag.server?FIFOSIZE_SERVERLINK:WFIFO_SIZE)
-		&& (session[fd]->wdata_size+addition)*4 < session[fd]->max_wdata )
+	if( s->max_wdata >= (size_t)2*nominal && unsent < WFIFO_SIZE && (unsent+addition)*4 < s->max_wdata )
 	{	// shrink rule, shrink by 2 when only a quarter of the fifo is used, don't shrink below nominal size.
-		newsize = session[fd]->max_wdata / 2;
+		newsize = s->max_wdata / 2;
 	}
 	else // no change
 		return 0;
 
-	RECREATE2( session[fd]->wdata, unsigned char, newsize, file, line, func );
-	session[fd]->max_wdata  = newsize;
+	// only the small unsent rest of the old buffer is copied
+	wdata = (uint8*)aMalloc2(newsize, file, line, func);
+	if( unsent > 0 )
+		memcpy(wdata, s->wdata + s->wdata_pos, unsent);
+	aFree(s->wdata);
+
+	s->wdata = wdata;
+	s->max_wdata = newsize;
+	s->wdata_size = unsent;
+	s->wdata_pos = 0;
 
 	return 0;
 }
@@ -1251,7 +1485,7 @@ int32 WFIFOSET(int32 fd, size_t len)
 			return 0;
 		}
 
-		if( s->wdata_size+len > WFIFO_MAX ) {// reached maximum write fifo size
+		if( wfifo_pending(s)+len > WFIFO_MAX ) {// reached maximum write fifo size
 			ShowError("WFIFOSET: Maximum write buffer size for client connection %d exceeded, most likely caused by packet 0x%04x (len=%" PRIuPTR ", ip=%lu.%lu.%lu.%lu).\n", fd, WFIFOW(fd,0), len, CONVIP(s->client_addr));
 			set_eof(fd);
 			return 0;
@@ -1273,7 +1507,7 @@ int32 WFIFOSET(int32 fd, size_t len)
 	socket_data_qo += len;
 #endif
 	//If the interserver has 200% of its normal size full, flush the data.
-	if( s->flag.server && s->wdata_size >= 2*FIFOSIZE_SERVERLINK )
+	if( s->flag.server && wfifo_pending(s) >= 2*FIFOSIZE_SERVERLINK )
 		flush_fifo(fd);
 
 	// always keep a WFIFO_SIZE reserve in the buffer
@@ -1290,6 +1524,842 @@ int32 WFIFOSET(int32 fd, size_t len)
 	return 0;
 }
 
+/// Creates a shared packet from 'len' bytes of 'buf' with one reference held by the caller.
+struct wfifo_shared* wfifo_shared_create(const void* buf, size_t len)
+{
+	struct wfifo_shared* shared;
+
+	// header and packet are kept in a single allocation
+	shared = (struct wfifo_shared*)aMalloc(sizeof(struct wfifo_shared) + len);
+	shared->data = (uint8*)(shared + 1);
+	shared->len = len;
+	shared->refcount = 1;
+	memcpy(shared->data, buf, len);
+
+	return shared;
+}
+
+/// Drops a reference to a shared packet, it is freed with the last one.
+void wfifo_shared_release(struct wfifo_shared* shared)
+{
+	if( --shared->refcount == 0 )
+		aFree(shared);
+}
+
+/// Queues a shared packet for sending, like WFIFOHEAD, memcpy and WFIFOSET would.
+/// The session only references the packet, unless it is short or has to be transformed for this connection.
+int32 WFIFOSHARE(int32 fd, struct wfifo_shared* shared)
+{
+	struct socket_data* s;
+	struct wfifo_segment* seg;
+	size_t len = shared->len, unsent;
+
+	if( !session_isActive(fd) || len == 0 )
+		return 0;
+
+	s = session[fd];
+	unsent = s->wdata_size - s->wdata_pos;
+	wfifo_share_recipients++;
+	wfifo_share_sent += len;
+
+	// Copying is cheaper than referencing when the packet is short, or when the unsent rest of wdata is at least as big as the packet:
+	// referencing would have to move that rest to the queue to keep the order of the packets.
+	bool copy = s->flag.server || len < wfifo_share_min_size || unsent >= len;
+
+// (^~_~^) Gepard Shield Start
+
+	// packets encrypted per connection need a private copy
+	if (is_gepard_active == true && global_core->get_type() != e_core_type::CHARACTER && gepard_is_sc_packet_encrypted(RBUFW(shared->data, 0)))
+	{
+		copy = true;
+	}
+
+// (^~_~^) Gepard Shield End
+
+	if( copy ){
+		WFIFOHEAD(fd, len);
+		memcpy(WFIFOP(fd, 0), shared->data, len);
+		wfifo_share_copied += len;
+		return WFIFOSET(fd, len);
+	}
+
+	if( len > socket_max_client_packet ) {// see declaration of socket_max_client_packet for details
+		ShowError("WFIFOSHARE: Dropped too large client packet 0x%04x (length=%" PRIuPTR ", max=%" PRIuPTR ").\n", RBUFW(shared->data, 0), len, socket_max_client_packet);
+		return 0;
+	}
+
+	if( wfifo_pending(s)+len > WFIFO_MAX ) {// reached maximum write fifo size
+		ShowError("WFIFOSHARE: Maximum write buffer size for client connection %d exceeded, most likely caused by packet 0x%04x (len=%" PRIuPTR ", ip=%lu.%lu.%lu.%lu).\n", fd, RBUFW(shared->data, 0), len, CONVIP(s->client_addr));
+		set_eof(fd);
+		return 0;
+	}
+
+	if( unsent > 0 )
+	{	// the small unsent rest of wdata goes first
+		CREATE(seg, struct wfifo_segment, 1);
+		seg->data = (uint8*)aMalloc(unsent);
+		seg->size = unsent;
+		memcpy(seg->data, s->wdata + s->wdata_pos, unsent);
+		wfifo_segment_append(s, seg);
+		s->wdata_size = s->wdata_pos = 0;
+		wfifo_share_copied += unsent;
+	}
+
+	CREATE(seg, struct wfifo_segment, 1);
+	seg->data = shared->data;
+	seg->size = len;
+	seg->shared = shared;
+	shared->refcount++;
+	wfifo_segment_append(s, seg);
+
+#ifdef SHOW_SERVER_STATS
+	socket_data_qo += len;
+#endif
+#ifdef SEND_SHORTLIST
+	send_shortlist_add_fd(fd);
+#endif
+
+	return 0;
+}
+
+/// Displays how much data WFIFOSHARE had to copy.
+void wfifo_shared_report(void)
+{
+	ShowInfo("Shared packets: %" PRIu64 " recipients, %.03f kB queued, %.03f kB copied (%.01f%%).\n",
+		wfifo_share_recipients, wfifo_share_sent / 1024., wfifo_share_copied / 1024.,
+		wfifo_share_sent > 0 ? 100. * wfifo_share_copied / wfifo_share_sent : 0.);
+}
+
+/// Adds a fd to the list of sessions do_sockets has to parse.
+static void parse_list_add_fd(int32 fd)
+{
+	int32 i = fd/32;
+	int32 bit = fd%32;
+
+	if( (parse_list_set[i]>>bit)&1 )
+		return;// already in the list
+
+	parse_list_set[i] |= 1<<bit;
+	parse_list_array[parse_list_count++] = fd;
+}
+
+/// Parses the input data of all sessions in the parse list.
+/// Sessions that are added while parsing are parsed in the next loop.
+static void parse_list_do_parse(void)
+{
+	size_t i, count = parse_list_count;
+
+	memcpy(parse_list_current, parse_list_array, count * sizeof(parse_list_array[0]));
+	parse_list_count = 0;
+
+	for( i = 0; i < count; i++ )
+	{
+		int32 fd = parse_list_current[i];
+
+		parse_list_set[fd/32] &= ~(1<<(fd%32));
+
+		if( !session[fd] )
+			continue;
+
+#ifdef SOCKET_EPOLL
+		if( session[fd]->io_thread )
+			socket_io_fill(fd);
+#endif
+
+		session[fd]->func_parse(fd);
+
+		if( !session[fd] )
+			continue;
+
+		// after parse, check client's RFIFO size to know if there is an invalid packet (too big and not parsed)
+		if (session[fd]->rdata_size == RFIFO_SIZE && session[fd]->max_rdata == RFIFO_SIZE) {
+			set_eof(fd);
+			continue;
+		}
+		RFIFOFLUSH(fd);
+
+		// the parse function left data for later (incomplete or delayed packets)
+		if( session[fd]->rdata_size > 0 || session[fd]->io_rqueue_head != nullptr )
+			parse_list_add_fd(fd);
+	}
+}
+
+/// Links a session into the timeout wheel slot of 'tick'.
+static void stall_wheel_link(int32 fd, time_t tick)
+{
+	struct socket_data* s = session[fd];
+	int32 slot = (int32)(tick % STALL_WHEEL_SIZE);
+
+	s->stall_tick = tick;
+	s->stall_prev = 0;
+	s->stall_next = stall_wheel[slot];
+	if( s->stall_next )
+		session[s->stall_next]->stall_prev = fd;
+	stall_wheel[slot] = fd;
+}
+
+/// Removes a session from its timeout wheel slot.
+static void stall_wheel_unlink(int32 fd)
+{
+	struct socket_data* s = session[fd];
+
+	if( s->stall_tick == 0 )
+		return; // not linked
+
+	if( s->stall_prev )
+		session[s->stall_prev]->stall_next = s->stall_next;
+	else
+		stall_wheel[s->stall_tick % STALL_WHEEL_SIZE] = s->stall_next;
+	if( s->stall_next )
+		session[s->stall_next]->stall_prev = s->stall_prev;
+
+	s->stall_tick = 0;
+	s->stall_prev = s->stall_next = 0;
+}
+
+/// Checks the sessions of all timeout wheel slots up to last_tick.
+/// Sessions that received data in the meantime are moved to the slot of their new timeout.
+static void stall_wheel_check(void)
+{
+	if( stall_wheel_tick == 0 || DIFF_TICK(last_tick, stall_wheel_tick) > STALL_WHEEL_SIZE )
+		stall_wheel_tick = last_tick - STALL_WHEEL_SIZE; // visit every slot once at most
+
+	while( stall_wheel_tick < last_tick )
+	{
+		int32 slot, fd, next;
+
+		stall_wheel_tick++;
+		slot = (int32)(stall_wheel_tick % STALL_WHEEL_SIZE);
+
+		// detach the slot, every session in it is linked again below
+		fd = stall_wheel[slot];
+		stall_wheel[slot] = 0;
+
+		for( ; fd != 0; fd = next )
+		{
+			struct socket_data* s = session[fd];
+			time_t timeout = s->rdata_tick + stall_time + 1;
+
+			next = s->stall_next;
+			s->stall_tick = 0;
+
+			if( s->rdata_tick == 0 )
+			{	// timeouts are disabled on this socket, look again after a full turn
+				stall_wheel_link(fd, stall_wheel_tick + STALL_WHEEL_SIZE);
+				continue;
+			}
+
+			if( timeout > last_tick )
+			{	// received data in the meantime
+				stall_wheel_link(fd, timeout > stall_wheel_tick ? timeout : stall_wheel_tick + 1);
+				continue;
+			}
+
+			if( s->flag.server ) {/* server is special */
+				if( s->flag.ping != 2 )/* only update if necessary otherwise it'd resend the ping unnecessarily */
+					s->flag.ping = 1;
+				parse_list_add_fd(fd); // the parse function sends the ping and gives up after stall_time * 2
+			} else if( !s->flag.eof ) {
+				ShowInfo("Session #%d timed out\n", fd);
+				set_eof(fd);
+			}
+
+			// look again in the next second until it receives data or is closed
+			stall_wheel_link(fd, stall_wheel_tick + 1);
+		}
+	}
+}
+
+#ifdef SOCKET_EPOLL
+/*======================================
+ *	Network I/O threads
+ *--------------------------------------
+ * When io_threads is set, the client connections of the map-server are handed to a pool of threads.
+ * Each of them has its own epoll and does recv and send for its connections.
+ * The main thread only exchanges data with them through lock-free single producer/single consumer queues,
+ * so packet parsing (including Gepard) and all game logic stay on the main thread.
+ * The memory manager is not thread-safe, buffers passed between the threads are allocated with malloc.
+ * The I/O threads never wait for the main thread: when their queue to it is full they keep their messages
+ * and stop receiving until it caught up, so the main thread waiting for a full queue to an I/O thread cannot deadlock.
+ */
+
+enum e_socket_io_message : uint8{
+	SOCKET_IO_ATTACH = 0, ///< main -> I/O: take over the socket
+	SOCKET_IO_SEND, ///< main -> I/O: send data
+	SOCKET_IO_CLOSE, ///< main -> I/O: send what is left and close the socket
+	SOCKET_IO_RECV, ///< I/O -> main: data was received
+	SOCKET_IO_EOF, ///< I/O -> main: the connection was closed or failed
+};
+
+struct s_socket_io_message{
+	int32 fd;
+	uint32 id; // socket_data::io_id, messages of a closed session are dropped
+	e_socket_io_message type;
+	uint8* data;
+	size_t len;
+};
+
+/// Connection owned by an I/O thread
+struct s_socket_io_connection{
+	uint32 id;
+	std::deque<s_socket_io_message> out; // data waiting to be sent, oldest first
+	size_t out_pos; // bytes of the first element that were already sent
+	size_t out_size; // unsent bytes
+	bool wait_writable; // EPOLLOUT is registered
+	bool eof; // the main thread was told about the eof and will close the connection
+};
+
+struct s_socket_io_thread{
+	std::thread thread;
+	int32 epfd;
+	int32 wakefd; // signalled by the main thread after pushing messages
+	std::unique_ptr<rathena::util::spsc_queue<s_socket_io_message>> to_io;
+	std::unique_ptr<rathena::util::spsc_queue<s_socket_io_message>> to_main;
+	std::unordered_map<int32, s_socket_io_connection> connections; // only used by the thread itself
+	std::deque<s_socket_io_message> backlog; // messages that did not fit into to_main yet, only used by the thread itself
+	bool wake; // main thread pushed messages since the last socket_io_wake
+};
+
+// Number of network I/O threads, 0 to do all network I/O in the main thread
+static int32 socket_io_thread_count = 0;
+// Size of the message queues between the main thread and each I/O thread
+#define SOCKET_IO_QUEUE_SIZE 65536
+// Maximum amount of received data of a session waiting for the main thread
+#define SOCKET_IO_RECV_MAX (1*1024*1024)
+
+static int32 socket_io_wakefd = -1; // signalled by the I/O threads, part of the main epoll
+static std::atomic<bool> socket_io_stop;
+static uint32 socket_io_last_id = 0;
+
+/// Signals an eventfd.
+static void socket_io_signal(int32 efd)
+{
+	uint64 one = 1;
+
+	if( write(efd, &one, sizeof(one)) < 0 ){
+		// the counter is only full if nobody reads it, nothing to do
+	}
+}
+
+/// Pushes a message of the main thread, waits for the I/O thread when the queue is full.
+static void socket_io_push(rathena::util::spsc_queue<s_socket_io_message>& queue, s_socket_io_message&& msg, int32 efd)
+{
+	while( !queue.push(std::move(msg)) ){
+		socket_io_signal(efd);
+		std::this_thread::yield();
+	}
+}
+
+/// Pushes a message of an I/O thread, keeps it in the backlog when the queue is full.
+static void socket_io_push_main(s_socket_io_thread& t, s_socket_io_message&& msg)
+{
+	// keep the order of the messages
+	if( !t.backlog.empty() || !t.to_main->push(std::move(msg)) )
+		t.backlog.push_back(msg);
+}
+
+/// Moves the backlog of an I/O thread into its queue to the main thread.
+/// Returns false if the queue is still full.
+static bool socket_io_push_backlog(s_socket_io_thread& t)
+{
+	while( !t.backlog.empty() ){
+		if( !t.to_main->push(std::move(t.backlog.front())) )
+			return false;
+		t.backlog.pop_front();
+	}
+
+	return true;
+}
+
+/// Sends as much of the pending data of a connection as the socket accepts.
+/// Returns false if the connection failed.
+static bool socket_io_flush(s_socket_io_thread& t, int32 fd, s_socket_io_connection& c)
+{
+	while( !c.out.empty() ){
+		struct iovec bufs[WFIFO_SEND_BUFS];
+		int32 count = 0;
+		size_t pos = c.out_pos;
+
+		for( auto it = c.out.begin(); it != c.out.end() && count < WFIFO_SEND_BUFS; ++it, pos = 0 ){
+			bufs[count].iov_base = it->data + pos;
+			bufs[count].iov_len = it->len - pos;
+			count++;
+		}
+
+		int32 len = sSendv(fd, bufs, count, MSG_NOSIGNAL);
+
+		if( len == SOCKET_ERROR ){
+			if( sErrno != S_EWOULDBLOCK )
+				return false;
+			break;
+		}
+
+		c.out_size -= len;
+
+		while( len > 0 ){
+			s_socket_io_message& front = c.out.front();
+			size_t n = zmin(len, front.len - c.out_pos);
+
+			c.out_pos += n;
+			len -= (int32)n;
+
+			if( c.out_pos == front.len ){
+				free(front.data);
+				c.out.pop_front();
+				c.out_pos = 0;
+			}
+		}
+	}
+
+	// only wait for the socket to become writable while there is something left
+	bool wait = !c.out.empty();
+
+	if( wait != c.wait_writable ){
+		struct epoll_event ev = {};
+
+		ev.data.fd = fd;
+		ev.events = EPOLLIN;
+		if( wait )
+			ev.events |= EPOLLOUT;
+		epoll_ctl(t.epfd, EPOLL_CTL_MOD, fd, &ev);
+		c.wait_writable = wait;
+	}
+
+	return true;
+}
+
+/// Stops handling a connection and tells the main thread about it.
+static void socket_io_eof(s_socket_io_thread& t, int32 fd, s_socket_io_connection& c)
+{
+	if( c.eof )
+		return;
+
+	c.eof = true;
+	epoll_ctl(t.epfd, EPOLL_CTL_DEL, fd, nullptr);
+	socket_io_push_main(t, { fd, c.id, SOCKET_IO_EOF, nullptr, 0 });
+	socket_io_signal(socket_io_wakefd);
+}
+
+/// Closes a connection of an I/O thread.
+static void socket_io_close(s_socket_io_thread& t, int32 fd)
+{
+	auto it = t.connections.find(fd);
+
+	if( it == t.connections.end() )
+		return;
+
+	// try to send what's left, like do_close does
+	if( !it->second.eof )
+		socket_io_flush(t, fd, it->second);
+
+	for( s_socket_io_message& msg : it->second.out )
+		free(msg.data);
+
+	epoll_ctl(t.epfd, EPOLL_CTL_DEL, fd, nullptr);
+	sShutdown(fd, SHUT_RDWR);
+	sClose(fd);
+	t.connections.erase(it);
+}
+
+/// Handles the messages of the main thread.
+static void socket_io_process(s_socket_io_thread& t)
+{
+	s_socket_io_message msg;
+
+	while( t.to_io->pop(msg) ){
+		switch( msg.type ){
+			case SOCKET_IO_ATTACH: {
+				struct epoll_event ev = {};
+				s_socket_io_connection& c = t.connections[msg.fd];
+
+				c.id = msg.id;
+				ev.data.fd = msg.fd;
+				ev.events = EPOLLIN;
+
+				if( epoll_ctl(t.epfd, EPOLL_CTL_ADD, msg.fd, &ev) == SOCKET_ERROR )
+					socket_io_eof(t, msg.fd, c);
+				break;
+			}
+
+			case SOCKET_IO_SEND: {
+				auto it = t.connections.find(msg.fd);
+
+				if( it == t.connections.end() || it->second.id != msg.id || it->second.eof ){
+					free(msg.data);
+					break;
+				}
+
+				s_socket_io_connection& c = it->second;
+
+				c.out_size += msg.len;
+				c.out.push_back(msg);
+
+				if( c.out_size > WFIFO_MAX ){
+					// the client does not read its data, same as the WFIFO_MAX check of WFIFOSET
+					socket_io_eof(t, msg.fd, c);
+				}else if( !c.wait_writable && !socket_io_flush(t, msg.fd, c) ){
+					socket_io_eof(t, msg.fd, c);
+				}
+				break;
+			}
+
+			case SOCKET_IO_CLOSE:
+				socket_io_close(t, msg.fd);
+				break;
+
+			default:
+				free(msg.data);
+				break;
+		}
+	}
+}
+
+/// Main function of a network I/O thread.
+static void socket_io_main(s_socket_io_thread* thread)
+{
+	s_socket_io_thread& t = *thread;
+	struct epoll_event events[256];
+	std::vector<uint8> buffer(64 * 1024);
+
+	while( !socket_io_stop.load(std::memory_order_acquire) ){
+		bool received = false;
+
+		socket_io_process(t);
+
+		if( !socket_io_push_backlog(t) ){
+			// the main thread is behind, leave the data in the sockets until it caught up
+			socket_io_signal(socket_io_wakefd);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		int32 count = epoll_wait(t.epfd, events, ARRAYLENGTH(events), 100);
+
+		for( int32 i = 0; i < count; i++ ){
+			int32 fd = events[i].data.fd;
+
+			if( fd == t.wakefd ){
+				uint64 counter;
+
+				if( read(t.wakefd, &counter, sizeof(counter)) < 0 ){
+					// already reset by an earlier event
+				}
+				continue;
+			}
+
+			auto it = t.connections.find(fd);
+
+			if( it == t.connections.end() || it->second.eof )
+				continue;
+
+			s_socket_io_connection& c = it->second;
+
+			if( events[i].events & EPOLLOUT ){
+				if( !socket_io_flush(t, fd, c) ){
+					socket_io_eof(t, fd, c);
+					continue;
+				}
+			}
+
+			if( events[i].events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) ){
+				int32 len = sRecv(fd, (char*)buffer.data(), (int32)buffer.size(), 0);
+
+				if( len > 0 ){
+					uint8* data = (uint8*)malloc(len);
+
+					memcpy(data, buffer.data(), len);
+					socket_io_push_main(t, { fd, c.id, SOCKET_IO_RECV, data, (size_t)len });
+					received = true;
+				}else if( len == 0 || sErrno != S_EWOULDBLOCK ){
+					socket_io_eof(t, fd, c);
+					received = true;
+				}
+			}
+		}
+
+		if( received )
+			socket_io_signal(socket_io_wakefd);
+	}
+
+	// the main thread closed its sessions before stopping the threads
+	socket_io_process(t);
+
+	while( !t.connections.empty() )
+		socket_io_close(t, t.connections.begin()->first);
+
+	for( s_socket_io_message& msg : t.backlog )
+		free(msg.data);
+	t.backlog.clear();
+}
+
+/// Drops the received data of a session that was not moved to rdata yet.
+static void socket_io_rqueue_clear(struct socket_data* s)
+{
+	struct wfifo_segment* seg;
+
+	while( ( seg = s->io_rqueue_head ) != nullptr ){
+		s->io_rqueue_head = seg->next;
+		free(seg->data);
+		aFree(seg);
+	}
+
+	s->io_rqueue_tail = nullptr;
+	s->io_rqueue_size = 0;
+}
+
+/// Moves received data of a session into rdata, as much as fits.
+static void socket_io_fill(int32 fd)
+{
+	struct socket_data* s = session[fd];
+	struct wfifo_segment* seg;
+
+	while( ( seg = s->io_rqueue_head ) != nullptr && RFIFOSPACE(fd) > 0 ){
+		size_t n = zmin(RFIFOSPACE(fd), seg->size - seg->pos);
+
+		memcpy(s->rdata + s->rdata_size, seg->data + seg->pos, n);
+		s->rdata_size += n;
+		s->io_rqueue_size -= n;
+		seg->pos += n;
+
+		if( seg->pos == seg->size ){
+			s->io_rqueue_head = seg->next;
+			if( s->io_rqueue_head == nullptr )
+				s->io_rqueue_tail = nullptr;
+			free(seg->data);
+			aFree(seg);
+		}
+	}
+}
+
+/// Handles the messages of all I/O threads.
+static void socket_io_receive(void)
+{
+	for( auto& thread : socket_io_threads ){
+		s_socket_io_message msg;
+
+		while( thread->to_main->pop(msg) ){
+			struct socket_data* s = session_isValid(msg.fd) ? session[msg.fd] : nullptr;
+
+			if( s == nullptr || s->io_id != msg.id ){
+				// the session was closed in the meantime
+				free(msg.data);
+				continue;
+			}
+
+			if( msg.type == SOCKET_IO_EOF ){
+				set_eof(msg.fd);
+				continue;
+			}
+
+			if( s->flag.eof || s->io_rqueue_size + msg.len > SOCKET_IO_RECV_MAX ){
+				free(msg.data);
+				set_eof(msg.fd);
+				continue;
+			}
+
+			struct wfifo_segment* seg;
+
+			CREATE(seg, struct wfifo_segment, 1);
+			seg->data = msg.data;
+			seg->size = msg.len;
+
+			if( s->io_rqueue_tail )
+				s->io_rqueue_tail->next = seg;
+			else
+				s->io_rqueue_head = seg;
+			s->io_rqueue_tail = seg;
+			s->io_rqueue_size += msg.len;
+			s->rdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+			socket_data_i += msg.len;
+			socket_data_qi += msg.len;
+			if (!s->flag.server)
+			{
+				socket_data_ci += msg.len;
+			}
+#endif
+			parse_list_add_fd(msg.fd);
+		}
+	}
+}
+
+/// Wakes the I/O threads the main thread pushed messages to.
+static void socket_io_wake(void)
+{
+	for( auto& thread : socket_io_threads ){
+		if( thread->wake ){
+			thread->wake = false;
+			socket_io_signal(thread->wakefd);
+		}
+	}
+}
+
+/// Hands the pending data of a session to its I/O thread (func_send of sessions owned by an I/O thread).
+static int32 socket_io_send(int32 fd)
+{
+	struct socket_data* s;
+	struct wfifo_segment* seg;
+	size_t len, pos = 0;
+	uint8* data;
+
+	if( !session_isValid(fd) )
+		return -1;
+
+	s = session[fd];
+	len = wfifo_pending(s);
+
+	if( len == 0 )
+		return 0; // nothing to send
+
+	// one copy into a buffer the I/O thread can free
+	data = (uint8*)malloc(len);
+
+	for( seg = s->wqueue_head; seg != nullptr; seg = seg->next ){
+		memcpy(data + pos, seg->data + seg->pos, seg->size - seg->pos);
+		pos += seg->size - seg->pos;
+	}
+	memcpy(data + pos, s->wdata + s->wdata_pos, s->wdata_size - s->wdata_pos);
+
+	wfifo_consume(s, len);
+	s->wdata_tick = last_tick;
+#ifdef SHOW_SERVER_STATS
+	socket_data_o += len;
+	socket_data_qo -= len;
+	if (!s->flag.server)
+	{
+		socket_data_co += len;
+	}
+#endif
+
+	s_socket_io_thread& t = *socket_io_threads[s->io_thread - 1];
+
+	socket_io_push(*t.to_io, { fd, s->io_id, SOCKET_IO_SEND, data, len }, t.wakefd);
+	t.wake = true;
+
+	return 0;
+}
+
+/// Reads the eventfd the I/O threads signal, the messages are handled by do_sockets.
+static int32 socket_io_wakeup_recv(int32 fd)
+{
+	uint64 counter;
+
+	if( read(fd, &counter, sizeof(counter)) < 0 ){
+		// already reset
+	}
+
+	return 0;
+}
+
+/// Hands a new client connection to an I/O thread, if there are any.
+static void socket_io_attach(int32 fd)
+{
+	if( socket_io_threads.empty() )
+		return;
+
+	struct socket_data* s = session[fd];
+	s_socket_io_thread& t = *socket_io_threads[fd % socket_io_threads.size()];
+
+	s->io_thread = (uint8)( fd % socket_io_threads.size() + 1 );
+	s->io_id = ++socket_io_last_id;
+	s->func_recv = null_recv;
+	s->func_send = socket_io_send;
+
+	socket_io_push(*t.to_io, { fd, s->io_id, SOCKET_IO_ATTACH, nullptr, 0 }, t.wakefd);
+	t.wake = true;
+}
+
+/// Lets the I/O thread close the socket of a session.
+static void socket_io_detach(int32 fd)
+{
+	struct socket_data* s = session[fd];
+	s_socket_io_thread& t = *socket_io_threads[s->io_thread - 1];
+
+	socket_io_push(*t.to_io, { fd, s->io_id, SOCKET_IO_CLOSE, nullptr, 0 }, t.wakefd);
+	socket_io_signal(t.wakefd);
+}
+
+/// Starts the network I/O threads.
+static void socket_io_init(void)
+{
+	if( socket_io_thread_count <= 0 )
+		return;
+
+	if( global_core->get_type() != e_core_type::MAP ){
+		return; // only the map-server has enough clients to benefit from it
+	}
+
+	socket_io_wakefd = eventfd(0, EFD_NONBLOCK);
+
+	if( socket_io_wakefd == SOCKET_ERROR ){
+		ShowError("socket_io_init: Failed to create eventfd: %s\n", error_msg());
+		return;
+	}
+
+	epevent.data.fd = socket_io_wakefd;
+	epevent.events = EPOLLIN;
+
+	if( epoll_ctl( epfd, EPOLL_CTL_ADD, socket_io_wakefd, &epevent ) == SOCKET_ERROR ){
+		ShowError( "socket_io_init: Failed to add eventfd to epoll event dispatcher: %s\n", error_msg() );
+		sClose(socket_io_wakefd);
+		socket_io_wakefd = -1;
+		return;
+	}
+
+	if( fd_max <= socket_io_wakefd ) fd_max = socket_io_wakefd + 1;
+
+	create_session(socket_io_wakefd, socket_io_wakeup_recv, null_send, null_parse);
+	session[socket_io_wakefd]->rdata_tick = 0; // disable timeouts on this socket
+
+	socket_io_stop = false;
+
+	for( int32 i = 0; i < socket_io_thread_count; i++ ){
+		auto thread = std::make_unique<s_socket_io_thread>();
+		struct epoll_event ev = {};
+
+		thread->epfd = epoll_create( MAXCONN );
+		thread->wakefd = eventfd(0, EFD_NONBLOCK);
+		thread->to_io = std::make_unique<rathena::util::spsc_queue<s_socket_io_message>>(SOCKET_IO_QUEUE_SIZE);
+		thread->to_main = std::make_unique<rathena::util::spsc_queue<s_socket_io_message>>(SOCKET_IO_QUEUE_SIZE);
+		thread->wake = false;
+
+		ev.data.fd = thread->wakefd;
+		ev.events = EPOLLIN;
+		epoll_ctl(thread->epfd, EPOLL_CTL_ADD, thread->wakefd, &ev);
+
+		thread->thread = std::thread(socket_io_main, thread.get());
+		socket_io_threads.push_back(std::move(thread));
+	}
+
+	ShowInfo("Server uses " CL_WHITE "%d" CL_RESET " network I/O threads.\n", socket_io_thread_count);
+}
+
+/// Stops the network I/O threads, after all sessions were closed.
+static void socket_io_final(void)
+{
+	if( socket_io_threads.empty() )
+		return;
+
+	socket_io_stop = true;
+
+	for( auto& thread : socket_io_threads ){
+		s_socket_io_message msg;
+
+		socket_io_signal(thread->wakefd);
+		thread->thread.join();
+
+		while( thread->to_main->pop(msg) )
+			free(msg.data);
+
+		sClose(thread->wakefd);
+		sClose(thread->epfd);
+	}
+
+	socket_io_threads.clear();
+	socket_io_wakefd = -1;
+}
+#endif
+
 int32 do_sockets(t_tick next)
 {
 #ifndef SOCKET_EPOLL
@@ -1302,13 +2372,16 @@ int32 do_sockets(t_tick next)
 	// Send remaining data and process client-side disconnects here.
 #ifdef SEND_SHORTLIST
 	send_shortlist_do_sends();
+#ifdef SOCKET_EPOLL
+	socket_io_wake();
+#endif
 #else
 	for (i = 1; i < fd_max; i++)
 	{
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if( wfifo_pending(session[i]) )
 			session[i]->func_send(i);
 	}
 #endif
@@ -1321,7 +2394,9 @@ int32 do_sockets(t_tick next)
 	timeout.tv_usec = (long)(next%1000*1000);
 
 	memcpy(&rfd, &readfds, sizeof(rfd));
+	uint64 wait_start = profiler_begin();
 	ret = sSelect(fd_max, &rfd, nullptr, nullptr, &timeout);
+	profiler_loop_idle(wait_start);
 
 	if( ret == SOCKET_ERROR )
 	{
@@ -1335,7 +2410,9 @@ int32 do_sockets(t_tick next)
 #else
 	// Epoll based Event Dispatcher
 
+	uint64 wait_start = profiler_begin();
 	ret = epoll_wait( epfd, epevents, epoll_maxevents, next );
+	profiler_loop_idle( wait_start );
 
 	if( ret == SOCKET_ERROR ){
 		if( sErrno != S_EINTR ){
@@ -1377,6 +2454,9 @@ int32 do_sockets(t_tick next)
 			sock->func_recv( fd );
 		}
 	}
+
+	// data received by the network I/O threads
+	socket_io_receive();
 #else
 	// otherwise assume that the fd_set is a bit-array and enumerate it in a standard way
 	for( i = 1; ret && i < fd_max; ++i )
@@ -1392,13 +2472,16 @@ int32 do_sockets(t_tick next)
 	// POSTSEND Send remaining data and handle eof sessions.
 #ifdef SEND_SHORTLIST
 	send_shortlist_do_sends();
+#ifdef SOCKET_EPOLL
+	socket_io_wake();
+#endif
 #else
 	for (i = 1; i < fd_max; i++)
 	{
 		if(!session[i])
 			continue;
 
-		if(session[i]->wdata_size)
+		if( wfifo_pending(session[i]) )
 			session[i]->func_send(i);
 
 		if(session[i]->flag.eof) //func_send can't free a session, this is safe.
@@ -1408,34 +2491,12 @@ int32 do_sockets(t_tick next)
 	}
 #endif
 
-	// parse input data on each socket
-	for(i = 1; i < fd_max; i++)
-	{
-		if(!session[i])
-			continue;
-
-		if (session[i]->rdata_tick && DIFF_TICK(last_tick, session[i]->rdata_tick) > stall_time) {
-			if( session[i]->flag.server ) {/* server is special */
-				if( session[i]->flag.ping != 2 )/* only update if necessary otherwise it'd resend the ping unnecessarily */
-					session[i]->flag.ping = 1;
-			} else {
-				ShowInfo("Session #%d timed out\n", i);
-				set_eof(i);
-			}
-		}
+	// check for timeouts once per second
+	if( last_tick != stall_wheel_tick )
+		stall_wheel_check();
 
-		session[i]->func_parse(i);
-
-		if(!session[i])
-			continue;
-
-		// after parse, check client's RFIFO size to know if there is an invalid packet (too big and not parsed)
-		if (session[i]->rdata_size == RFIFO_SIZE && session[i]->max_rdata == RFIFO_SIZE) {
-			set_eof(i);
-			continue;
-		}
-		RFIFOFLUSH(i);
-	}
+	// parse input data on the sockets that need it
+	parse_list_do_parse();
 
 #ifdef SHOW_SERVER_STATS
 	if (last_tick != socket_data_last_tick)
@@ -1748,6 +2809,24 @@ int32 socket_config_read(const char* cfgName)
 			ddos_autoreset = atoi(w2);
 		else if (!strcmpi(w1,"debug"))
 			access_debug = config_switch(w2);
+		else if (!strcmpi(w1, "io_threads")) {
+#ifdef SOCKET_EPOLL
+			socket_io_thread_count = cap_value(atoi(w2), 0, UINT8_MAX);
+#else
+			if( atoi(w2) > 0 )
+				ShowWarning("socket_config_read: io_threads requires the epoll event dispatcher, ignoring...\n");
+#endif
+		}
+		else if (!strcmpi(w1, "shared_packet_min_size"))
+			wfifo_share_min_size = (size_t)max(atoi(w2), 0);
+		else if (!strcmpi(w1, "profiler"))
+			profiler_enabled = config_switch(w2) != 0;
+		else if (!strcmpi(w1, "profiler_dump_interval"))
+			profiler_dump_interval = atoi(w2);
+		else if (!strcmpi(w1, "profiler_dump_file"))
+			safestrncpy(profiler_dump_file, w2, sizeof(profiler_dump_file));
+		else if (!strcmpi(w1, "profiler_stall_threshold"))
+			profiler_stall_threshold = atoi(w2);
 #ifdef SOCKET_EPOLL
 		else if( !strcmpi( w1, "epoll_maxevents" ) ){
 			epoll_maxevents = atoi(w2);
@@ -1796,7 +2875,12 @@ void socket_final(void)
 		if(session[i])
 			do_close(i);
 
+#ifdef SOCKET_EPOLL
+	socket_io_final();
+#endif
+
 	// session[0]
+	wfifo_clear(session[0]);
 	aFree(session[0]->rdata);
 	aFree(session[0]->wdata);
 	aFree(session[0]->session_data);
@@ -1829,6 +2913,15 @@ void do_close(int32 fd)
 
 	flush_fifo(fd); // Try to send what's left (although it might not succeed since it's a nonblocking socket)
 
+#ifdef SOCKET_EPOLL
+	if( session[fd] && session[fd]->io_thread ){
+		// the network I/O thread sends what's left and closes the socket
+		socket_io_detach(fd);
+		delete_session(fd);
+		return;
+	}
+#endif
+
 #ifndef SOCKET_EPOLL
 	// Select based Event Dispatcher
 	sFD_CLR(fd, &readfds);// this needs to be done before closing the socket
@@ -2021,6 +3114,10 @@ void socket_init(void)
 	// should hold enough buffer (it is a vacuum so to speak) as it is never flushed. [Skotlex]
 	create_session(0, null_recv, null_send, null_parse); //FIXME this is causing leak
 
+#ifdef SOCKET_EPOLL
+	socket_io_init();
+#endif
+
 #ifndef MINICORE
 	// Delete old connection history every 5 minutes
 	memset(connect_history, 0, sizeof(connect_history));
@@ -2151,7 +3248,7 @@ void send_shortlist_do_sends()
 		if( session[fd] )
 		{
 			// Send data
-			if( session[fd]->wdata_size )
+			if( wfifo_pending(session[fd]) )
 				session[fd]->func_send(fd);
 
 			// If it's been marked as eof, call the parse func on it so that
@@ -2161,7 +3258,7 @@ void send_shortlist_do_sends()
 
 			// If the session still exists, is not eof and has things left to
 			// be sent from it we'll re-add it to the shortlist.
-			if( session_isActive(fd) && session[fd]->wdata_size )
+			if( session_isActive(fd) && wfifo_pending(session[fd]) )
 				send_shortlist_add_fd(fd);
 		}
 	}
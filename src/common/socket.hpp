@@ -222,6 +222,24 @@ typedef int32 (*RecvFunc)(int32 fd);
 typedef int32 (*SendFunc)(int32 fd);
 typedef int32 (*ParseFunc)(int32 fd);
 
+/// Filled write buffer of a session that is waiting to be sent, see send_from_fifo
+struct wfifo_segment
+{
+	struct wfifo_segment* next;
+	uint8* data;
+	size_t size; // bytes written to data
+	size_t pos; // bytes of data that were already sent
+	struct wfifo_shared* shared; // set when data belongs to a shared packet instead of the segment
+};
+
+/// Immutable packet referenced by the write queues of several sessions, see WFIFOSHARE
+struct wfifo_shared
+{
+	uint8* data;
+	size_t len;
+	int32 refcount;
+};
+
 struct socket_data
 {
 	struct {
@@ -236,8 +254,17 @@ struct socket_data
 	size_t max_rdata, max_wdata;
 	size_t rdata_size, wdata_size;
 	size_t rdata_pos;
+	size_t wdata_pos; // bytes of wdata that were already sent
+	struct wfifo_segment *wqueue_head, *wqueue_tail; // filled write buffers that are sent before wdata, oldest first
+	size_t wqueue_size; // unsent bytes in the queued write buffers
 	time_t rdata_tick; // time of last recv (for detecting timeouts); zero when timeout is disabled
 	time_t wdata_tick; // time of last send (for detecting timeouts);
+	time_t stall_tick; // second of the timeout wheel slot the session is linked into; zero when not linked
+	int32 stall_prev, stall_next; // neighbours in the timeout wheel slot, zero at the ends
+	uint8 io_thread; // network I/O thread that owns the socket (index + 1); zero when the main thread does the I/O
+	uint32 io_id; // identifies the session in the messages of the I/O thread
+	struct wfifo_segment *io_rqueue_head, *io_rqueue_tail; // data received by the I/O thread that did not fit into rdata yet
+	size_t io_rqueue_size;
 
 	RecvFunc func_recv;
 	SendFunc func_send;
@@ -264,6 +291,10 @@ extern int32 fd_max;
 extern time_t last_tick;
 extern time_t stall_time;
 
+#ifndef MINICORE
+extern int32 ip_rules;
+#endif
+
 //////////////////////////////////
 // some checking on sockets
 extern bool session_isValid(int32 fd);
@@ -279,6 +310,10 @@ int32 make_connection(uint32 ip, uint16 port, bool silent, int32 timeout);
 int32 _realloc_fifo( int32 fd, uint32 rfifo_size, uint32 wfifo_size, const char* file, int32 line, const char* func );
 int32 _realloc_writefifo( int32 fd, size_t addition, const char* file, int32 line, const char* func );
 int32 WFIFOSET(int32 fd, size_t len);
+struct wfifo_shared* wfifo_shared_create(const void* buf, size_t len);
+void wfifo_shared_release(struct wfifo_shared* shared);
+int32 WFIFOSHARE(int32 fd, struct wfifo_shared* shared);
+void wfifo_shared_report(void);
 int32 RFIFOSKIP(int32 fd, size_t len);
 
 int32 do_sockets(t_tick next);
@@ -0,0 +1,93 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace rathena {
+	namespace util {
+		/**
+		 * Bounded lock-free queue for exactly one producer and one consumer thread.
+		 * push() never blocks and fails when the queue is full, so the producer can decide
+		 * whether to drop or retry. The capacity is rounded up to the next power of two.
+		 */
+		template <typename T> class spsc_queue{
+		private:
+			std::vector<T> slots;
+			size_t mask;
+			// Read position, only written by the consumer
+			alignas( 64 ) std::atomic<size_t> head;
+			// Write position, only written by the producer
+			alignas( 64 ) std::atomic<size_t> tail;
+
+		public:
+			spsc_queue( size_t capacity ) : head( 0 ), tail( 0 ){
+				size_t size = 2;
+
+				while( size < capacity ){
+					size <<= 1;
+				}
+
+				this->slots.resize( size );
+				this->mask = size - 1;
+			}
+
+			spsc_queue( const spsc_queue& ) = delete;
+			spsc_queue& operator=( const spsc_queue& ) = delete;
+
+			/**
+			 * Append an element to the queue
+			 * @param value: Element to move into the queue
+			 * @return True on success or false if the queue is full
+			 */
+			bool push( T&& value ){
+				size_t t = this->tail.load( std::memory_order_relaxed );
+
+				if( t - this->head.load( std::memory_order_acquire ) > this->mask ){
+					return false;
+				}
+
+				this->slots[t & this->mask] = std::move( value );
+				this->tail.store( t + 1, std::memory_order_release );
+
+				return true;
+			}
+
+			/**
+			 * Remove the oldest element from the queue
+			 * @param value: Receives the element
+			 * @return True on success or false if the queue is empty
+			 */
+			bool pop( T& value ){
+				size_t h = this->head.load( std::memory_order_relaxed );
+
+				if( h == this->tail.load( std::memory_order_acquire ) ){
+					return false;
+				}
+
+				value = std::move( this->slots[h & this->mask] );
+				this->head.store( h + 1, std::memory_order_release );
+
+				return true;
+			}
+
+			/**
+			 * Number of elements currently in the queue. Only a snapshot when called concurrently.
+			 */
+			size_t size() const{
+				return this->tail.load( std::memory_order_acquire ) - this->head.load( std::memory_order_acquire );
+			}
+
+			size_t capacity() const{
+				return this->mask + 1;
+			}
+		};
+	}
+}
+
+#endif /* SPSC_QUEUE_HPP */
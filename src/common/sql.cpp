@@ -4,6 +4,9 @@
 #include "sql.hpp"
 
 #include <cstdlib>// strtoul
+#include <list>
+#include <string>
+#include <unordered_map>
 
 #include "cbasetypes.hpp"
 #include "cli.hpp"
@@ -23,6 +26,14 @@ void ra_mysql_error_handler(uint32 ecode);
 int32 mysql_reconnect_type;
 uint32 mysql_reconnect_count;
 
+/// Prepared statements kept open for reuse, keyed by their query text
+struct s_sql_statement_cache{
+	size_t max_statements;
+	unsigned long connection_id; ///< Statements are lost when the client reconnects
+	std::list<std::pair<std::string, MYSQL_STMT*>> lru; ///< Most recently returned statement first
+	std::unordered_map<std::string, std::list<std::pair<std::string, MYSQL_STMT*>>::iterator> statements;
+};
+
 /// Sql handle
 struct Sql
 {
@@ -32,6 +43,7 @@ struct Sql
 	MYSQL_ROW row;
 	unsigned long* lengths;
 	int32 keepalive;
+	s_sql_statement_cache* statements;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -51,6 +63,7 @@ Sql* Sql_Malloc(void)
 	self->lengths = nullptr;
 	self->result = nullptr;
 	self->keepalive = INVALID_TIMER;
+	self->statements = nullptr;
 	my_bool reconnect = 1;
 	mysql_options(&self->handle, MYSQL_OPT_RECONNECT, &reconnect);
 	return self;
@@ -220,6 +233,34 @@ static int32 Sql_P_Keepalive(Sql* self)
 
 
 
+/// Removes the keepalive timer of the connection.
+void Sql_DisableKeepalive(Sql* self)
+{
+	if( self && self->keepalive != INVALID_TIMER )
+	{
+		delete_timer(self->keepalive, Sql_P_KeepaliveTimer);
+		self->keepalive = INVALID_TIMER;
+	}
+}
+
+
+
+/// Initializes the client library for the calling thread.
+void Sql_ThreadInit(void)
+{
+	mysql_thread_init();
+}
+
+
+
+/// Releases the client library resources of the calling thread.
+void Sql_ThreadEnd(void)
+{
+	mysql_thread_end();
+}
+
+
+
 /// Escapes a string.
 size_t Sql_EscapeString(Sql* self, char *out_to, const char *from)
 {
@@ -311,6 +352,40 @@ int32 Sql_QueryStr(Sql* self, const char* query)
 
 
 
+/// Executes a query without keeping a copy of it.
+int32 Sql_QueryDirect(Sql* self, const char* query, size_t len)
+{
+	if( self == nullptr )
+		return SQL_ERROR;
+
+	Sql_FreeResult(self);
+	if( mysql_real_query(&self->handle, query, (unsigned long)len) )
+	{
+		ra_mysql_error_handler(mysql_errno(&self->handle));
+		return SQL_ERROR;
+	}
+	self->result = mysql_store_result(&self->handle);
+	if( mysql_errno(&self->handle) != 0 )
+	{
+		ra_mysql_error_handler(mysql_errno(&self->handle));
+		return SQL_ERROR;
+	}
+	return SQL_SUCCESS;
+}
+
+
+
+/// Returns the error message of the last failed query.
+const char* Sql_GetErrorMessage(Sql* self)
+{
+	if( self == nullptr )
+		return "";
+
+	return mysql_error(&self->handle);
+}
+
+
+
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE query.
 uint64 Sql_LastInsertId(Sql* self)
 {
@@ -433,6 +508,7 @@ void Sql_Free(Sql* self)
 	if( self )
 	{
 		Sql_FreeResult(self);
+		Sql_SetStatementCache(self, 0);
 		self->buf.~StringBuf();
 		if( self->keepalive != INVALID_TIMER ) delete_timer(self->keepalive, Sql_P_KeepaliveTimer);
 		Sql_Close(self);
@@ -448,6 +524,123 @@ void Sql_Free(Sql* self)
 
 
 
+/// Closes all cached statements of the connection.
+///
+/// @private
+static void Sql_P_ClearStatementCache(s_sql_statement_cache* cache)
+{
+	for( const auto& it : cache->lru ){
+		mysql_stmt_close( it.second );
+	}
+	cache->lru.clear();
+	cache->statements.clear();
+}
+
+
+
+/// Closes the least recently used statements until at most max_statements are left.
+///
+/// @private
+static void Sql_P_TrimStatementCache(s_sql_statement_cache* cache, size_t max_statements)
+{
+	while( cache->lru.size() > max_statements ){
+		mysql_stmt_close( cache->lru.back().second );
+		cache->statements.erase( cache->lru.back().first );
+		cache->lru.pop_back();
+	}
+}
+
+
+
+/// Drops the cached statements if the client reconnected since they were prepared.
+///
+/// @private
+static void Sql_P_CheckStatementCache(Sql* self)
+{
+	unsigned long connection_id = mysql_thread_id( &self->handle );
+
+	if( self->statements->connection_id != connection_id ){
+		Sql_P_ClearStatementCache( self->statements );
+		self->statements->connection_id = connection_id;
+	}
+}
+
+
+
+/// Enables, resizes or disables the statement cache of the connection.
+void Sql_SetStatementCache(Sql* self, size_t max_statements)
+{
+	if( self == nullptr )
+		return;
+
+	if( max_statements == 0 ){
+		if( self->statements != nullptr ){
+			Sql_P_ClearStatementCache( self->statements );
+			delete self->statements;
+			self->statements = nullptr;
+		}
+		return;
+	}
+
+	if( self->statements == nullptr ){
+		self->statements = new s_sql_statement_cache();
+		self->statements->connection_id = mysql_thread_id( &self->handle );
+	}
+
+	self->statements->max_statements = max_statements;
+	Sql_P_TrimStatementCache( self->statements, max_statements );
+}
+
+
+
+/// Takes the statement prepared for the query out of the cache.
+///
+/// @return the statement or nullptr if the query was not prepared on this connection yet
+/// @private
+static MYSQL_STMT* Sql_P_TakeStatement(Sql* self, const char* query)
+{
+	Sql_P_CheckStatementCache( self );
+
+	auto it = self->statements->statements.find( query );
+
+	if( it == self->statements->statements.end() )
+		return nullptr;
+
+	MYSQL_STMT* stmt = it->second->second;
+
+	self->statements->lru.erase( it->second );
+	self->statements->statements.erase( it );
+
+	return stmt;
+}
+
+
+
+/// Puts a prepared statement back into the cache.
+/// If the cache is full, the statement that was used the longest time ago is closed to make room for it.
+///
+/// @private
+static void Sql_P_CacheStatement(Sql* self, const char* query, MYSQL_STMT* stmt)
+{
+	s_sql_statement_cache* cache = self->statements;
+	unsigned long connection_id = cache->connection_id;
+
+	Sql_P_CheckStatementCache( self );
+
+	// prepared before a reconnect, or another statement with the same query was handed back first
+	if( connection_id != cache->connection_id || cache->statements.find( query ) != cache->statements.end() ){
+		mysql_stmt_close( stmt );
+		return;
+	}
+
+	Sql_P_TrimStatementCache( cache, cache->max_statements - 1 );
+
+	cache->lru.emplace_front( query, stmt );
+	cache->statements.emplace( cache->lru.front().first, cache->lru.begin() );
+}
+
+
+
 /// Returns the mysql integer type for the target size.
 ///
 /// @private
@@ -623,12 +816,17 @@ void SqlStmt::ShowDebugTruncatedColumn( size_t i ){
 
 
 /// Allocates and initializes a new SqlStmt handle.
-SqlStmt::SqlStmt( Sql& sql ){
-	this->stmt = mysql_stmt_init( &sql.handle );
+SqlStmt::SqlStmt( Sql& sql ) : sql( sql ){
+	if( sql.statements != nullptr ){
+		// The statement is taken from the cache once the query is known
+		this->stmt = nullptr;
+	}else{
+		this->stmt = mysql_stmt_init( &sql.handle );
 
-	if( this->stmt == nullptr ){
-		ShowSQL( "DB error - %s\n", mysql_error( &sql.handle ) );
-		throw std::runtime_error( "Out of memory" );
+		if( this->stmt == nullptr ){
+			ShowSQL( "DB error - %s\n", mysql_error( &sql.handle ) );
+			throw std::runtime_error( "Out of memory" );
+		}
 	}
 
 	StringBuf_Init( &this->buf );
@@ -639,6 +837,7 @@ SqlStmt::SqlStmt( Sql& sql ){
 	this->max_columns = 0;
 	this->bind_params = false;
 	this->bind_columns = false;
+	this->reusable = false;
 }
 
 
@@ -659,29 +858,49 @@ int32 SqlStmt::Prepare(const char* query, ...){
 
 /// Prepares the statement.
 int32 SqlStmt::PrepareV(const char* query, va_list args){
-	this->FreeResult();
+	this->ReleaseStatement();
 	StringBuf_Clear( &this->buf );
 	StringBuf_Vprintf( &this->buf, query, args );
 
-	if( mysql_stmt_prepare( this->stmt, StringBuf_Value( &this->buf ), (unsigned long)StringBuf_Length( &this->buf ) ) ){
-		ShowSQL( "DB error - %s\n", mysql_stmt_error( this->stmt ) );
-		ra_mysql_error_handler( mysql_stmt_errno( this->stmt ) );
-		return SQL_ERROR;
-	}
-
-	this->bind_params = false;
-
-	return SQL_SUCCESS;
+	return this->PrepareBuf();
 }
 
 
 
 /// Prepares the statement.
 int32 SqlStmt::PrepareStr(const char* query){
-	this->FreeResult();
+	this->ReleaseStatement();
 	StringBuf_Clear( &this->buf );
 	StringBuf_AppendStr( &this->buf, query );
 
+	return this->PrepareBuf();
+}
+
+
+
+/// Prepares the query in the buffer, or takes the statement from the cache of the connection.
+///
+/// @private
+int32 SqlStmt::PrepareBuf(){
+	if( this->sql.statements != nullptr ){
+		this->stmt = Sql_P_TakeStatement( &this->sql, StringBuf_Value( &this->buf ) );
+
+		if( this->stmt != nullptr ){
+			this->bind_params = false;
+			this->reusable = true;
+			return SQL_SUCCESS;
+		}
+
+		this->stmt = mysql_stmt_init( &this->sql.handle );
+
+		if( this->stmt == nullptr ){
+			ShowSQL( "DB error - %s\n", mysql_error( &this->sql.handle ) );
+			return SQL_ERROR;
+		}
+	}
+
+	this->reusable = false;
+
 	if( mysql_stmt_prepare( this->stmt, StringBuf_Value( &this->buf ), (unsigned long)StringBuf_Length( &this->buf ) ) ){
 		ShowSQL( "DB error - %s\n", mysql_stmt_error( this->stmt ) );
 		ra_mysql_error_handler( mysql_stmt_errno( this->stmt ) );
@@ -689,12 +908,38 @@ int32 SqlStmt::PrepareStr(const char* query){
 	}
 
 	this->bind_params = false;
+	this->reusable = true;
 
 	return SQL_SUCCESS;
 }
 
 
 
+/// Frees the result and, if the connection caches statements, hands the statement back.
+/// Statements that failed are closed instead of being reused.
+///
+/// @private
+void SqlStmt::ReleaseStatement(){
+	if( this->stmt == nullptr )
+		return;
+
+	this->FreeResult();
+
+	if( this->sql.statements == nullptr )
+		return;
+
+	if( this->reusable ){
+		Sql_P_CacheStatement( &this->sql, StringBuf_Value( &this->buf ), this->stmt );
+	}else{
+		mysql_stmt_close( this->stmt );
+	}
+
+	this->stmt = nullptr;
+	this->reusable = false;
+}
+
+
+
 /// Returns the number of parameters in the prepared statement.
 size_t SqlStmt::NumParams(){
 	return (size_t)mysql_stmt_param_count( this->stmt );
@@ -741,6 +986,7 @@ int32 SqlStmt::Execute(){
 	{
 		ShowSQL("DB error - %s\n", mysql_stmt_error(this->stmt));
 		ra_mysql_error_handler(mysql_stmt_errno(this->stmt));
+		this->reusable = false;
 		return SQL_ERROR;
 	}
 
@@ -750,6 +996,7 @@ int32 SqlStmt::Execute(){
 	if( mysql_stmt_store_result( this->stmt ) ){
 		ShowSQL( "DB error - %s\n", mysql_stmt_error( this->stmt ) );
 		ra_mysql_error_handler( mysql_stmt_errno( this->stmt ) );
+		this->reusable = false;
 		return SQL_ERROR;
 	}
 
@@ -913,7 +1160,9 @@ int32 SqlStmt::NextRow(){
 
 /// Frees the result of the statement execution.
 void SqlStmt::FreeResult(){
-	mysql_stmt_free_result( this->stmt );
+	if( this->stmt != nullptr ){
+		mysql_stmt_free_result( this->stmt );
+	}
 }
 
 
@@ -933,7 +1182,7 @@ void SqlStmt::ShowDebug_(const char* debug_file, const unsigned long debug_line)
 
 /// Frees a SqlStmt.
 SqlStmt::~SqlStmt(){
-	this->FreeResult();
+	this->ReleaseStatement();
 	if( this->stmt != nullptr ){
 		mysql_stmt_close( this->stmt );
 		this->stmt = nullptr;
@@ -113,6 +113,33 @@ int32 Sql_Ping(Sql* self);
 
 
 
+/// Removes the keepalive timer of the connection.
+/// Timers are not thread-safe, so handles used by another thread must do this
+/// and take care of pinging the connection themselves.
+void Sql_DisableKeepalive(Sql* self);
+
+
+
+/// Keeps up to max_statements prepared statements open on the connection.
+/// SqlStmt objects created on the handle then take an already prepared statement for
+/// the same query text, instead of preparing it again, and hand it back when they are
+/// done with it. When the cache is full, the least recently used statement is closed.
+/// Pass 0 to close the cached statements and disable the cache.
+void Sql_SetStatementCache(Sql* self, size_t max_statements);
+
+
+
+/// Initializes the client library for the calling thread.
+/// Must be called by every thread other than the main thread before it uses a Sql handle.
+void Sql_ThreadInit(void);
+
+
+
+/// Releases the client library resources of the calling thread.
+void Sql_ThreadEnd(void);
+
+
+
 /// Escapes a string.
 /// The output buffer must be at least strlen(from)*2+1 in size.
 ///
@@ -156,6 +183,25 @@ int32 Sql_QueryStr(Sql* self, const char* query);
 
 
 
+/// Executes a query.
+/// Any previous result is freed.
+/// The query is used directly and is not kept for Sql_ShowDebug.
+/// Does not allocate through the memory manager, so it can be used by
+/// a thread that exclusively owns the handle.
+/// Errors are not shown, the caller reports them with Sql_GetErrorMessage.
+///
+/// @return SQL_SUCCESS or SQL_ERROR
+int32 Sql_QueryDirect(Sql* self, const char* query, size_t len);
+
+
+
+/// Returns the error message of the last failed query.
+///
+/// @return Error message, empty if the last query succeeded
+const char* Sql_GetErrorMessage(Sql* self);
+
+
+
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE query.
 ///
 /// @return Value of the auto-increment column
@@ -242,6 +288,7 @@ typedef struct s_column_length s_column_length;
 // 2) INSERT INTO table(col1,col2) VALUES(?,?)
 class SqlStmt{
 private:
+	Sql& sql;
 	StringBuf buf;
 	MYSQL_STMT* stmt;
 	MYSQL_BIND* params;
@@ -251,8 +298,11 @@ private:
 	size_t max_columns;
 	bool bind_params;
 	bool bind_columns;
+	bool reusable;
 
 	void ShowDebugTruncatedColumn( size_t i );
+	int32 PrepareBuf();
+	void ReleaseStatement();
 
 public:
 	explicit SqlStmt( Sql& sql ) noexcept(false);
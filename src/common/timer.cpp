@@ -3,6 +3,7 @@
 
 #include "timer.hpp"
 
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <utility>
@@ -11,6 +12,7 @@
 #include "db.hpp"
 #include "malloc.hpp"
 #include "nullpo.hpp"
+#include "profiler.hpp"
 #include "showmsg.hpp"
 #include "utils.hpp"
 #ifdef WIN32
@@ -35,6 +37,36 @@ static int32 free_timer_list_max = 0;
 static int32 free_timer_list_pos = 0;
 
 
+#ifdef ENABLE_TIMER_WHEEL
+// Hierarchical timing wheel
+// The root level has one slot per millisecond. Every slot of a higher level covers the
+// whole range of the level below it. Timers are moved down a level (cascaded) when the
+// root level wraps around into the range of their slot.
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS 4 // levels above the root level, covers 2^32 milliseconds
+#define TIMER_WHEEL_EXPIRED (TIMER_WHEEL_ROOT_SIZE + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SIZE) // slot for timers that are already due
+#define TIMER_WHEEL_SLOTS (TIMER_WHEEL_EXPIRED + 1)
+
+/// Position of a timer in the wheel
+struct timer_wheel_link {
+	int32 prev;
+	int32 next;
+	int32 slot; // -1 if the timer is not in the wheel
+};
+
+// links of the timers (array, parallel to timer_data)
+static struct timer_wheel_link* timer_link = nullptr;
+
+// first and last timer of each slot
+static int32 timer_wheel_head[TIMER_WHEEL_SLOTS];
+static int32 timer_wheel_tail[TIMER_WHEEL_SLOTS];
+
+// next tick that will be processed
+static t_tick timer_wheel_tick = 0;
+#else
 /// Comparator for the timer heap. (minimum tick at top)
 /// Returns negative if tid1's tick is smaller, positive if tid2's tick is smaller, 0 if equal.
 ///
@@ -45,6 +77,7 @@ static int32 free_timer_list_pos = 0;
 
 // timer heap (binary heap of tid's)
 static BHEAP_VAR(int32, timer_heap);
+#endif
 
 
 // server startup time
@@ -99,7 +132,6 @@ const char* search_timer_func_list(TimerFunc func)
  *----------------------------*/
 
 #if defined(ENABLE_RDTSC)
-#include <chrono>
 #include <thread>
 
 static t_tick rdtsc_begintick = 0, rdtsc_clock = 0;
@@ -201,6 +233,118 @@ t_tick gettick(void)
 #endif
 //////////////////////////////////////////////////////////////////////////
 
+/// High resolution counter for measuring short durations.
+/// Uses the same source as the tick when RDTSC is enabled, see gettick_precise_frequency for the unit.
+uint64 gettick_precise(void)
+{
+#if defined(ENABLE_RDTSC)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+/// Returns the number of gettick_precise units per millisecond.
+uint64 gettick_precise_frequency(void)
+{
+#if defined(ENABLE_RDTSC)
+	return rdtsc_clock;
+#else
+	return 1000000;
+#endif
+}
+
+#ifdef ENABLE_TIMER_WHEEL
+/*======================================
+ * 	CORE : Timer Wheel
+ *--------------------------------------*/
+
+/// Returns the slot of the wheel a timer expiring at 'tick' belongs to.
+static int32 timer_wheel_slot(t_tick tick)
+{
+	t_tick diff = DIFF_TICK(tick, timer_wheel_tick);
+
+	if( diff < 0 )
+		return TIMER_WHEEL_EXPIRED;
+
+	if( diff < TIMER_WHEEL_ROOT_SIZE )
+		return (int32)( tick & ( TIMER_WHEEL_ROOT_SIZE - 1 ) );
+
+	for( int32 level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+	{
+		int32 shift = TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS;
+
+		if( diff >= ( (t_tick)1 << ( shift + TIMER_WHEEL_LEVEL_BITS ) ) )
+		{
+			if( level < TIMER_WHEEL_LEVELS - 1 )
+				continue;
+			// beyond the range of the wheel, park it in the farthest slot and check again when it is cascaded
+			tick = timer_wheel_tick + ( (t_tick)( TIMER_WHEEL_LEVEL_SIZE - 1 ) << shift );
+		}
+
+		return TIMER_WHEEL_ROOT_SIZE + level * TIMER_WHEEL_LEVEL_SIZE + (int32)( ( tick >> shift ) & ( TIMER_WHEEL_LEVEL_SIZE - 1 ) );
+	}
+
+	return -1; // not reached
+}
+
+/// Adds a timer to the wheel
+static void push_timer_heap(int32 tid)
+{
+	int32 slot = timer_wheel_slot(timer_data[tid].tick);
+
+	timer_link[tid].slot = slot;
+	timer_link[tid].next = -1;
+	timer_link[tid].prev = timer_wheel_tail[slot];
+
+	if( timer_wheel_tail[slot] != -1 )
+		timer_link[timer_wheel_tail[slot]].next = tid;
+	else
+		timer_wheel_head[slot] = tid;
+	timer_wheel_tail[slot] = tid;
+}
+
+/// Removes a timer from the wheel
+static void pop_timer_wheel(int32 tid)
+{
+	struct timer_wheel_link* link = &timer_link[tid];
+
+	if( link->prev != -1 )
+		timer_link[link->prev].next = link->next;
+	else
+		timer_wheel_head[link->slot] = link->next;
+
+	if( link->next != -1 )
+		timer_link[link->next].prev = link->prev;
+	else
+		timer_wheel_tail[link->slot] = link->prev;
+
+	link->slot = -1;
+}
+
+/// Moves all timers of the current slot of a level down to the lower levels.
+/// Returns the index of the processed slot in the level.
+static int32 timer_wheel_cascade(int32 level)
+{
+	int32 shift = TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS;
+	int32 index = (int32)( ( timer_wheel_tick >> shift ) & ( TIMER_WHEEL_LEVEL_SIZE - 1 ) );
+	int32 slot = TIMER_WHEEL_ROOT_SIZE + level * TIMER_WHEEL_LEVEL_SIZE + index;
+	int32 tid = timer_wheel_head[slot];
+
+	timer_wheel_head[slot] = -1;
+	timer_wheel_tail[slot] = -1;
+
+	while( tid != -1 )
+	{
+		int32 next = timer_link[tid].next;
+
+		push_timer_heap(tid);
+		tid = next;
+	}
+
+	return index;
+}
+#else
 /*======================================
  * 	CORE : Timer Heap
  *--------------------------------------*/
@@ -211,6 +355,7 @@ static void push_timer_heap(int32 tid)
 	BHEAP_ENSURE(timer_heap, 1, 256);
 	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP);
 }
+#endif
 
 /*==========================
  * 	Timer Management
@@ -240,6 +385,14 @@ static int32 acquire_timer(void)
 		else
 			CREATE(timer_data, struct TimerData, timer_data_max);
 		memset(timer_data + (timer_data_max - 256), 0, sizeof(struct TimerData)*256);
+#ifdef ENABLE_TIMER_WHEEL
+		if( timer_link )
+			RECREATE(timer_link, struct timer_wheel_link, timer_data_max);
+		else
+			CREATE(timer_link, struct timer_wheel_link, timer_data_max);
+		for( int32 i = timer_data_max - 256; i < timer_data_max; i++ )
+			timer_link[i].slot = -1;
+#endif
 	}
 
 	if( tid >= timer_data_num )
@@ -329,6 +482,25 @@ t_tick addtick_timer(int32 tid, t_tick tick)
 /// Returns the new tick value, or -1 if it fails.
 t_tick settick_timer(int32 tid, t_tick tick)
 {
+#ifdef ENABLE_TIMER_WHEEL
+	if( tid < 0 || tid >= timer_data_num || timer_link[tid].slot == -1 )
+	{
+		ShowError("settick_timer: no such timer %d\n", tid);
+		return -1;
+	}
+
+	if( tick == -1 )
+		tick = 0;// add 1ms to avoid the error value -1
+
+	if( timer_data[tid].tick == tick )
+		return tick;// nothing to do, already in propper position
+
+	// move the timer to its new slot
+	pop_timer_wheel(tid);
+	timer_data[tid].tick = tick;
+	push_timer_heap(tid);
+	return tick;
+#else
 	size_t i;
 
 	// search timer position
@@ -350,6 +522,55 @@ t_tick settick_timer(int32 tid, t_tick tick)
 	timer_data[tid].tick = tick;
 	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP);
 	return tick;
+#endif
+}
+
+/// Runs an expired timer, that was already removed from the timer queue, and requeues or frees it.
+static void run_timer(int32 tid, t_tick tick, t_tick diff)
+{
+	timer_data[tid].type |= TIMER_REMOVE_HEAP;
+
+	if( timer_data[tid].func )
+	{
+		// the callback can reallocate timer_data, remember the function for the profiler
+		TimerFunc func = timer_data[tid].func;
+		uint64 start = profiler_begin();
+
+		if( diff < -1000 )
+			// timer was delayed for more than 1 second, use current tick instead
+			func(tid, tick, timer_data[tid].id, timer_data[tid].data);
+		else
+			func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
+
+		profiler_end(PROFILER_TIMER, (uintptr_t)func, start);
+	}
+
+	// in the case the function didn't change anything...
+	if( timer_data[tid].type & TIMER_REMOVE_HEAP )
+	{
+		timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
+
+		switch( timer_data[tid].type )
+		{
+		default:
+		case TIMER_ONCE_AUTODEL:
+			timer_data[tid].type = 0;
+			if (free_timer_list_pos >= free_timer_list_max) {
+				free_timer_list_max += 256;
+				RECREATE(free_timer_list,int32,free_timer_list_max);
+				memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int32));
+			}
+			free_timer_list[free_timer_list_pos++] = tid;
+		break;
+		case TIMER_INTERVAL:
+			if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
+				timer_data[tid].tick = tick + timer_data[tid].interval;
+			else
+				timer_data[tid].tick += timer_data[tid].interval;
+			push_timer_heap(tid);
+		break;
+		}
+	}
 }
 
 /// Executes all expired timers.
@@ -358,6 +579,43 @@ t_tick do_timer(t_tick tick)
 {
 	t_tick diff = TIMER_MAX_INTERVAL; // return value
 
+#ifdef ENABLE_TIMER_WHEEL
+	// process the expired timers and all slots up to the current tick
+	for( ;; )
+	{
+		int32 slot = (int32)( timer_wheel_tick & ( TIMER_WHEEL_ROOT_SIZE - 1 ) );
+		bool due = DIFF_TICK(timer_wheel_tick, tick) <= 0;
+		int32 tid;
+
+		// timers added by the callbacks that are already due are appended and run as well
+		while( ( tid = timer_wheel_head[TIMER_WHEEL_EXPIRED] ) != -1 || ( due && ( tid = timer_wheel_head[slot] ) != -1 ) )
+		{
+			pop_timer_wheel(tid);
+			run_timer(tid, tick, DIFF_TICK(timer_data[tid].tick, tick));
+		}
+
+		if( !due )
+			break;
+
+		timer_wheel_tick++;
+
+		// the root level wrapped around, bring down the timers of the next range
+		if( ( timer_wheel_tick & ( TIMER_WHEEL_ROOT_SIZE - 1 ) ) == 0 )
+		{
+			for( int32 level = 0; level < TIMER_WHEEL_LEVELS && timer_wheel_cascade(level) == 0; level++ );
+		}
+	}
+
+	// find the next timer in the root level, stop at the next cascade since it can bring down earlier timers
+	for( t_tick t = timer_wheel_tick; DIFF_TICK(t, tick) < TIMER_MAX_INTERVAL; t++ )
+	{
+		if( timer_wheel_head[t & ( TIMER_WHEEL_ROOT_SIZE - 1 )] != -1 || ( ( t + 1 ) & ( TIMER_WHEEL_ROOT_SIZE - 1 ) ) == 0 )
+		{
+			diff = DIFF_TICK(t, tick);
+			break;
+		}
+	}
+#else
 	// process all timers one by one
 	while( BHEAP_LENGTH(timer_heap) )
 	{
@@ -369,44 +627,9 @@ t_tick do_timer(t_tick tick)
 
 		// remove timer
 		BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP);
-		timer_data[tid].type |= TIMER_REMOVE_HEAP;
-
-		if( timer_data[tid].func )
-		{
-			if( diff < -1000 )
-				// timer was delayed for more than 1 second, use current tick instead
-				timer_data[tid].func(tid, tick, timer_data[tid].id, timer_data[tid].data);
-			else
-				timer_data[tid].func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
-		}
-
-		// in the case the function didn't change anything...
-		if( timer_data[tid].type & TIMER_REMOVE_HEAP )
-		{
-			timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
-
-			switch( timer_data[tid].type )
-			{
-			default:
-			case TIMER_ONCE_AUTODEL:
-				timer_data[tid].type = 0;
-				if (free_timer_list_pos >= free_timer_list_max) {
-					free_timer_list_max += 256;
-					RECREATE(free_timer_list,int32,free_timer_list_max);
-					memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int32));
-				}
-				free_timer_list[free_timer_list_pos++] = tid;
-			break;
-			case TIMER_INTERVAL:
-				if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
-					timer_data[tid].tick = tick + timer_data[tid].interval;
-				else
-					timer_data[tid].tick += timer_data[tid].interval;
-				push_timer_heap(tid);
-			break;
-			}
-		}
+		run_timer(tid, tick, diff);
 	}
+#endif
 
 	return cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
 }
@@ -520,6 +743,15 @@ void timer_init(void)
 	rdtsc_calibrate();
 #endif
 
+#ifdef ENABLE_TIMER_WHEEL
+	for( int32 i = 0; i < TIMER_WHEEL_SLOTS; i++ )
+	{
+		timer_wheel_head[i] = -1;
+		timer_wheel_tail[i] = -1;
+	}
+	timer_wheel_tick = gettick_nocache();
+#endif
+
 	time(&start_time);
 }
 
@@ -535,6 +767,10 @@ void timer_final(void)
 	}
 
 	if (timer_data) aFree(timer_data);
+#ifdef ENABLE_TIMER_WHEEL
+	if (timer_link) aFree(timer_link);
+#else
 	BHEAP_CLEAR(timer_heap);
+#endif
 	if (free_timer_list) aFree(free_timer_list);
 }
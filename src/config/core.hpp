@@ -38,6 +38,13 @@
 /// - but is not the official behaviour.
 //#define CIRCULAR_AREA
 
+/// Uncomment to keep a packed copy of the objects of each map block.
+/// map_foreachinrange, map_foreachinarea and their forcount versions then filter the objects of a block
+/// from contiguous coordinate and type arrays instead of walking the block_list chain,
+/// which is faster on maps with a lot of objects in the same area (towns with many vendors, WoE).
+/// Costs some memory and extra work whenever an object is added, removed or moved.
+//#define PACKED_BLOCK_INDEX
+
 /// Comment to disable Guild/Party Bound item system
 /// By default, we recover/remove Guild/Party Bound items automatically
 #define BOUND_ITEMS
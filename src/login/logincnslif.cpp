@@ -9,6 +9,7 @@
 #include <common/cli.hpp>
 #include <common/md5calc.hpp>
 #include <common/mmo.hpp> //cbasetype + NAME_LENGTH
+#include <common/profiler.hpp>
 #include <common/showmsg.hpp> //show notice
 #include <common/strlib.hpp>
 #include <common/timer.hpp>
@@ -87,6 +88,8 @@ int32 cnslif_parse(const char* buf){
 			}
 			ShowStatus("Console: Account '%s' created successfully.\n", username);
 		}
+		if( strcmpi("profiler", type) == 0 )
+			profiler_console(command);
 	}
 	else if( strcmpi("help", type) == 0 ){
 		ShowInfo("Available commands:\n");
@@ -94,6 +97,7 @@ int32 cnslif_parse(const char* buf){
 		ShowInfo("\t server:alive => Checks if the server is running.\n");
 		ShowInfo("\t server:reloadconf => Reload config file: \"%s\"\n", LOGIN_CONF_NAME);
 		ShowInfo("\t create:<username> <password> <sex:M|F> => Creates a new account.\n");
+		ShowInfo("\t profiler:<on|off|reset|show|latency|dump> => Controls the timer function profiler.\n");
 	}
 	return 1;
 }
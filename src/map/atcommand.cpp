@@ -4537,7 +4537,7 @@ ACMD_FUNC(reloadbarterdb){
 ACMD_FUNC(reloadlogconf){
 	nullpo_retr(-1, sd);
 
-	log_config_read(LOG_CONF_NAME);
+	map_reloadlogconf();
 	clif_displaymessage(fd, msg_txt(sd,1536)); // Log configuration has been reloaded.
 
 	return 0;
@@ -12683,6 +12683,7 @@ static const struct _battle_data {
 	{ "assist_range",                       &battle_config.assist_range,                    11,     1,      MAX_WALKPATH,   },
 	{ "major_overweight_rate",              &battle_config.major_overweight_rate,           90,     0,      100             },
 	{ "trade_count_stackable",              &battle_config.trade_count_stackable,           1,      0,      1,              },
+	{ "monster_ai_threads",                 &battle_config.mob_ai_threads,                  0,      0,      64,             },
 
 #include <custom/battle_config_init.inc>
 };
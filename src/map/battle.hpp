@@ -781,6 +781,7 @@ struct Battle_Config
 	int32 open_box_weight_rate;
 	int32 major_overweight_rate;
 	int32 trade_count_stackable;
+	int32 mob_ai_threads;
 
 #include <custom/battle_config_struct.inc>
 };
@@ -17,6 +17,7 @@
 #include <common/grfio.hpp>
 #include <common/malloc.hpp>
 #include <common/nullpo.hpp>
+#include <common/profiler.hpp>
 #include <common/random.hpp>
 #include <common/showmsg.hpp>
 #include <common/socket.hpp>
@@ -503,6 +504,31 @@ static bool clif_session_isValid(map_session_data *sd) {
 	return ( sd != nullptr && session_isActive(sd->fd) );
 }
 
+/// Payload of a clif_send to several players.
+/// It is stored once on the first recipient and the write queues of all recipients reference it.
+struct s_clif_broadcast{
+	const void* buf;
+	int32 len;
+	struct wfifo_shared* shared;
+
+	s_clif_broadcast( const void* buf, int32 len ) : buf( buf ), len( len ), shared( nullptr ){
+	}
+
+	~s_clif_broadcast(){
+		if( this->shared != nullptr ){
+			wfifo_shared_release( this->shared );
+		}
+	}
+
+	void send( int32 fd ){
+		if( this->shared == nullptr ){
+			this->shared = wfifo_shared_create( this->buf, this->len );
+		}
+
+		WFIFOSHARE( fd, this->shared );
+	}
+};
+
 /*==========================================
  * sub process of clif_send
  * Called from a map_foreachinallarea (grabs all players in specific area and subjects them to this function)
@@ -519,8 +545,9 @@ static int32 clif_send_sub(struct block_list *bl, va_list ap)
 	struct block_list* tbl;
 	struct block_list* mbl;
 	map_session_data *sd;
+	struct s_clif_broadcast* broadcast;
 	unsigned char *buf;
-	int32 len, type, fd;
+	int32 type, fd;
 
 	nullpo_ret(bl);
 	nullpo_ret(sd = (map_session_data *)bl);
@@ -531,9 +558,10 @@ static int32 clif_send_sub(struct block_list *bl, va_list ap)
 	}
 
 	buf = va_arg(ap,unsigned char*);
-	len = va_arg(ap,int32);
+	va_arg(ap,int32); // len, the packet is sent through broadcast
 	nullpo_ret(src_bl = va_arg(ap,struct block_list*));
 	type = va_arg(ap,int32);
+	broadcast = va_arg(ap,struct s_clif_broadcast*);
 	
 	if (src_bl->type == BL_PET){ // target 3 == AREA_WOS
 		switch(RBUFW(buf, 0)) {
@@ -666,19 +694,15 @@ static int32 clif_send_sub(struct block_list *bl, va_list ap)
 		!sd->sc.getSCE(SC_INTRAVISION) && battle_check_target(src_bl,sd,BCT_ENEMY) > 0)
 		return 0;
 
-	WFIFOHEAD(fd, len);
 	if (WFIFOP(fd,0) == buf) {
 		ShowError("WARNING: Invalid use of clif_send function\n");
 		ShowError("         Packet x%4x use a WFIFO of a player instead of to use a buffer.\n", WBUFW(buf,0));
 		ShowError("         Please correct your code.\n");
 		// don't send to not move the pointer of the packet for next sessions in the loop
-		//WFIFOSET(fd,0);//## TODO is this ok?
-		//NO. It is not ok. There is the chance WFIFOSET actually sends the buffer data, and shifts elements around, which will corrupt the buffer.
 		return 0;
 	}
 
-	memcpy(WFIFOP(fd,0), buf, len);
-	WFIFOSET(fd,len);
+	broadcast->send(fd);
 
 	return 0;
 }
@@ -697,6 +721,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 	std::shared_ptr<s_battleground_data> bg;
 	int32 x0 = 0, x1 = 0, y0 = 0, y1 = 0, fd;
 	struct s_mapiterator* iter;
+	struct s_clif_broadcast broadcast( buf, len );
 
 	if( type != ALL_CLIENT )
 		nullpo_ret(bl);
@@ -709,9 +734,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 		iter = mapit_getallusers();
 		while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 			if( session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				broadcast.send( fd );
 			}
 		}
 		mapit_free(iter);
@@ -721,9 +744,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 		iter = mapit_getallusers();
 		while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 			if( bl->m == tsd->m && session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				broadcast.send( fd );
 			}
 		}
 		mapit_free(iter);
@@ -737,11 +758,11 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 	case AREA_WOC:
 	case AREA_WOS:
 		map_foreachinallarea(clif_send_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE,
-			BL_PC, buf, len, bl, type);
+			BL_PC, buf, len, bl, type, &broadcast);
 		break;
 	case AREA_CHAT_WOC:
 		map_foreachinallarea(clif_send_sub, bl->m, bl->x-(AREA_SIZE-5), bl->y-(AREA_SIZE-5),
-			bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC, buf, len, bl, AREA_WOC);
+			bl->x+(AREA_SIZE-5), bl->y+(AREA_SIZE-5), BL_PC, buf, len, bl, AREA_WOC, &broadcast);
 		break;
 
 	case CHAT:
@@ -759,9 +780,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 				if (type == CHAT_WOS && cd->usersd[i] == sd)
 					continue;
 				if( session_isActive( fd = cd->usersd[i]->fd ) ){
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					broadcast.send( fd );
 				}
 			}
 		}
@@ -798,9 +817,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 				if( (type == PARTY_AREA || type == PARTY_AREA_WOS) && (sd->x < x0 || sd->y < y0 || sd->x > x1 || sd->y > y1) )
 					continue;
 
-				WFIFOHEAD(fd, len);
-				memcpy(WFIFOP(fd, 0), buf, len);
-				WFIFOSET(fd, len);
+				broadcast.send( fd );
 			}
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
 				break;
@@ -808,9 +825,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 			iter = mapit_getallusers();
 			while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 				if( tsd->partyspy == p->party.party_id && session_isActive( fd = tsd->fd ) ){
-					WFIFOHEAD( fd, len );
-					memcpy( WFIFOP( fd, 0 ), buf, len );
-					WFIFOSET( tsd->fd, len );
+					broadcast.send( fd );
 				}
 			}
 			mapit_free(iter);
@@ -826,9 +841,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 			if( type == DUEL_WOS && bl->id == tsd->id )
 				continue;
 			if( sd->duel_group == tsd->duel_group && session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				broadcast.send( fd );
 			}
 		}
 		mapit_free(iter);
@@ -929,9 +942,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 				if( (type == GUILD_AREA || type == GUILD_AREA_WOS) && (sd->x < x0 || sd->y < y0 || sd->x > x1 || sd->y > y1) )
 					continue;
 
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				broadcast.send( fd );
 			}
 		}
 		if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -940,9 +951,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 		iter = mapit_getallusers();
 		while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 			if( tsd->guildspy == g.guild_id && session_isActive( fd = tsd->fd ) ){
-				WFIFOHEAD( fd, len );
-				memcpy( WFIFOP( fd, 0 ), buf, len );
-				WFIFOSET( fd, len );
+				broadcast.send( fd );
 			}
 		}
 		mapit_free(iter);
@@ -970,9 +979,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 					continue;
 				if( (type == BG_AREA || type == BG_AREA_WOS) && (sd->x < x0 || sd->y < y0 || sd->x > x1 || sd->y > y1) )
 					continue;
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				broadcast.send( fd );
 			}
 		}
 		break;
@@ -985,9 +992,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 					continue;
 				}
 
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				broadcast.send( fd );
 			}
 
 			if (!enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -996,9 +1001,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 			iter = mapit_getallusers();
 			while( ( tsd = (map_session_data*)mapit_next( iter ) ) != nullptr ){
 				if( tsd->clanspy == clan->id && session_isActive( fd = tsd->fd ) ){
-					WFIFOHEAD(fd, len);
-					memcpy(WFIFOP(fd, 0), buf, len);
-					WFIFOSET(fd, len);
+					broadcast.send( fd );
 				}
 			}
 			mapit_free(iter);
@@ -1007,7 +1010,7 @@ int32 clif_send(const void* buf, int32 len, struct block_list* bl, enum send_tar
 
 	case AREA_AUTOATTACK_WOS:
 		map_foreachinallarea(clif_send_sub, bl->m, bl->x-AREA_SIZE, bl->y-AREA_SIZE, bl->x+AREA_SIZE, bl->y+AREA_SIZE,
-			BL_PC, buf, len, bl, type);
+			BL_PC, buf, len, bl, type, &broadcast);
 		break;
 
 	default:
@@ -27192,8 +27195,12 @@ static int32 clif_parse(int32 fd)
 		else
 		if( sd && sd->prev == nullptr && packet_db[cmd].func != clif_parse_LoadEndAck )
 			; //Only valid packet when player is not on a map
-		else
+		else {
+			uint64 start = profiler_begin();
+
 			packet_db[cmd].func(fd, sd);
+			profiler_end(PROFILER_PACKET, cmd, start);
+		}
 	}
 #ifdef DUMP_UNKNOWN_PACKET
 	else DumpUnknown(fd,sd,cmd,packet_len);
@@ -3492,13 +3492,13 @@ static void itemdb_jobid2mapid(uint64 bclass[3], e_mapid jobmask, bool active)
  * @return *item_data or *dummy_item if item not found
  *------------------------------------------*/
 struct item_data* itemdb_search(t_itemid nameid) {
-	std::shared_ptr<item_data> id;
+	struct item_data* id;
 
-	if (!(id = item_db.find(nameid))) {
+	if (!(id = item_db.findRaw(nameid))) {
 		ShowWarning("itemdb_search: Item ID %u does not exists in the item_db. Using dummy data.\n", nameid);
-		id = item_db.find(ITEMID_DUMMY);
+		id = item_db.findRaw(ITEMID_DUMMY);
 	}
-	return id.get();
+	return id;
 }
 
 /** Checks if item is equip type or not
@@ -3,13 +3,26 @@
 
 #include "log.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <common/cbasetypes.hpp>
+#include <common/core.hpp>
 #include <common/nullpo.hpp>
 #include <common/showmsg.hpp>
+#include <common/spsc_queue.hpp>
 #include <common/sql.hpp> // SQL_INNODB
 #include <common/strlib.hpp>
+#include <common/timer.hpp>
+#include <common/utils.hpp>
 
 #include "battle.hpp"
 #include "homunculus.hpp"
@@ -22,6 +35,14 @@
 
 static char log_timestamp_format[20];
 
+/// userspace buffer of every open text log file
+#define LOG_FILE_BUFFER_SIZE (64 * 1024)
+
+/// text log files, kept open instead of being reopened for every line
+static std::unordered_map<std::string, FILE*> log_files;
+/// timer flushing log_files, only running while logs are written to files
+static int32 log_file_flush_tid = INVALID_TIMER;
+
 /// filters for item logging
 typedef enum e_log_filter
 {
@@ -54,6 +75,63 @@ struct Log_Config log_config;
 #define LOG_QUERY "INSERT DELAYED"
 #endif
 
+/// SQL log statements, one per distinct table and column list
+enum e_log_sql_batch : uint8{
+	LOG_SQL_BRANCH = 0,
+	LOG_SQL_PICK,
+	LOG_SQL_ZENY,
+	LOG_SQL_MVPDROP,
+	LOG_SQL_ATCOMMAND,
+	LOG_SQL_NPC,
+	LOG_SQL_NPC_PC,
+	LOG_SQL_CHAT,
+	LOG_SQL_CASH,
+	LOG_SQL_FEEDING,
+	LOG_SQL_MAX
+};
+
+/// A single row waiting to be written by the log writer thread
+struct s_log_sql_record{
+	e_log_sql_batch batch;
+	std::string values;
+};
+
+/// Failed statement, reported by the main thread
+struct s_log_sql_error{
+	std::string error;
+	std::string query;
+};
+
+/// maximum number of failed statements waiting to be reported, further ones are only counted
+#define LOG_SQL_MAX_ERRORS 100
+
+/// Asynchronous SQL log writer
+/// The main thread only formats rows and pushes them into a bounded lock-free queue.
+/// The writer thread owns a separate connection and groups the rows into multi-row INSERTs per table.
+static struct{
+	Sql* handle;
+	std::thread thread;
+	std::unique_ptr<rathena::util::spsc_queue<s_log_sql_record>> queue;
+	std::string prefix[LOG_SQL_MAX];
+	std::atomic<bool> running;
+	std::atomic<bool> stop;
+	uint32 ping_interval;
+	int32 error_timer;
+
+	// failed statements, handed to the main thread
+	std::mutex error_mutex;
+	std::vector<s_log_sql_error> errors;
+	uint64 errors_suppressed;
+
+	// statistics
+	std::atomic<uint64> queued;
+	std::atomic<uint64> dropped;
+	std::atomic<uint64> written;
+	std::atomic<uint64> failed;
+	std::atomic<uint64> statements;
+	size_t peak;
+} log_writer;
+
 
 /// obtain log type character for item/zeny logs
 static char log_picktype2char(e_log_pick_type type)
@@ -141,6 +219,438 @@ static char log_feedingtype2char(e_log_feeding_type type) {
 	return 'O';
 }
 
+/// build the "INSERT INTO `table` (columns) VALUES " part of every log statement
+static void log_sql_build_prefixes(void)
+{
+	StringBuf buf;
+
+	StringBuf_Init(&buf);
+	StringBuf_Printf(&buf, "%s INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`, `enchantgrade`", LOG_QUERY, log_config.log_pick);
+	for( int32 i = 0; i < MAX_SLOTS; ++i )
+		StringBuf_Printf(&buf, ", `card%d`", i);
+	for( int32 i = 0; i < MAX_ITEM_RDM_OPT; ++i ) {
+		StringBuf_Printf(&buf, ", `option_id%d`", i);
+		StringBuf_Printf(&buf, ", `option_val%d`", i);
+		StringBuf_Printf(&buf, ", `option_parm%d`", i);
+	}
+	StringBuf_AppendStr(&buf, ") VALUES ");
+	log_writer.prefix[LOG_SQL_PICK] = StringBuf_Value(&buf);
+
+	log_writer.prefix[LOG_SQL_BRANCH] = std::string(LOG_QUERY " INTO `") + log_config.log_branch + "` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES ";
+	log_writer.prefix[LOG_SQL_ZENY] = std::string(LOG_QUERY " INTO `") + log_config.log_zeny + "` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES ";
+	log_writer.prefix[LOG_SQL_MVPDROP] = std::string(LOG_QUERY " INTO `") + log_config.log_mvpdrop + "` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES ";
+	log_writer.prefix[LOG_SQL_ATCOMMAND] = std::string(LOG_QUERY " INTO `") + log_config.log_gm + "` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES ";
+	log_writer.prefix[LOG_SQL_NPC] = std::string(LOG_QUERY " INTO `") + log_config.log_npc + "` (`npc_date`, `char_name`, `map`, `mes`) VALUES ";
+	log_writer.prefix[LOG_SQL_NPC_PC] = std::string(LOG_QUERY " INTO `") + log_config.log_npc + "` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES ";
+	log_writer.prefix[LOG_SQL_CHAT] = std::string(LOG_QUERY " INTO `") + log_config.log_chat + "` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES ";
+	log_writer.prefix[LOG_SQL_CASH] = std::string(LOG_QUERY " INTO `") + log_config.log_cash + "` (`time`, `char_id`, `type`, `cash_type`, `amount`, `map`) VALUES ";
+	log_writer.prefix[LOG_SQL_FEEDING] = std::string(LOG_QUERY " INTO `") + log_config.log_feeding + "` (`time`, `char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`) VALUES ";
+}
+
+/// escape a string for use inside a quoted SQL value
+static std::string log_sql_escape(const char* str, size_t max_len)
+{
+	size_t len = safestrnlen(str, max_len);
+	std::string escaped(len * 2 + 1, '\0');
+
+	escaped.resize(Sql_EscapeStringLen(logmysql_handle, &escaped[0], str, len));
+
+	return escaped;
+}
+
+/// the current time for FROM_UNIXTIME(), so rows keep the time they were logged at instead of the time they are written
+static int64 log_sql_time(void)
+{
+	return (int64)time(nullptr);
+}
+
+/// hand a formatted row "(...)" over to the log database
+static void log_sql_push(e_log_sql_batch batch, StringBuf* values)
+{
+	if( log_writer.running ) {
+		s_log_sql_record record{ batch, StringBuf_Value(values) };
+
+		if( !log_writer.queue->push(std::move(record)) ) {
+			// never wait for the writer, the main thread must not stall on the log database
+			if( log_writer.dropped++ % 1000 == 0 )
+				ShowWarning("log_sql_push: Log queue is full (%" PRIuPTR " records), dropping log records.\n", log_writer.queue->capacity());
+			return;
+		}
+
+		log_writer.queued++;
+		log_writer.peak = std::max(log_writer.peak, log_writer.queue->size());
+		return;
+	}
+
+	// synchronous fallback
+	std::string query = log_writer.prefix[batch] + StringBuf_Value(values);
+
+	if( SQL_ERROR == Sql_QueryStr(logmysql_handle, query.c_str()) )
+		Sql_ShowDebug(logmysql_handle);
+}
+
+/// rows of a table waiting for the next statement
+struct s_log_sql_pending{
+	std::string query;
+	std::vector<size_t> rows; ///< offset of each row inside query
+	std::chrono::steady_clock::time_point first;
+};
+
+/// remember a failed statement for the main thread
+static void log_sql_writer_error(const char* query, size_t len)
+{
+	std::lock_guard<std::mutex> lock(log_writer.error_mutex);
+
+	if( log_writer.errors.size() >= LOG_SQL_MAX_ERRORS ) {
+		log_writer.errors_suppressed++;
+		return;
+	}
+
+	log_writer.errors.push_back({ Sql_GetErrorMessage(log_writer.handle), std::string(query, len) });
+}
+
+/// write all pending rows of a table with a single statement
+/// If the statement fails the rows are written one by one, so only the rows that fail themselves are lost.
+static void log_sql_writer_flush(e_log_sql_batch batch, s_log_sql_pending& pending)
+{
+	if( pending.rows.empty() )
+		return;
+
+	log_writer.statements++;
+
+	if( SQL_SUCCESS == Sql_QueryDirect(log_writer.handle, pending.query.c_str(), pending.query.length()) ) {
+		log_writer.written += pending.rows.size();
+	} else if( pending.rows.size() == 1 ) {
+		log_sql_writer_error(pending.query.c_str(), pending.query.length());
+		log_writer.failed++;
+	} else {
+		const std::string& prefix = log_writer.prefix[batch];
+		std::string query;
+
+		for( size_t i = 0; i < pending.rows.size(); i++ ) {
+			size_t start = pending.rows[i];
+			size_t end = ( i + 1 < pending.rows.size() ) ? pending.rows[i + 1] - 1 : pending.query.length(); // skip the separating comma
+
+			query.assign(prefix);
+			query.append(pending.query, start, end - start);
+
+			log_writer.statements++;
+			if( SQL_SUCCESS == Sql_QueryDirect(log_writer.handle, query.c_str(), query.length()) ) {
+				log_writer.written++;
+			} else {
+				log_sql_writer_error(query.c_str(), query.length());
+				log_writer.failed++;
+			}
+		}
+	}
+
+	pending.query.clear();
+	pending.rows.clear();
+}
+
+/// log writer thread
+static void log_sql_writer_main(void)
+{
+	using clock = std::chrono::steady_clock;
+
+	s_log_sql_pending pending[LOG_SQL_MAX];
+	clock::time_point last_query = clock::now();
+	const std::chrono::milliseconds interval(log_config.sql_flush_interval);
+
+	Sql_ThreadInit();
+
+	for( ;; ) {
+		// read the flag before draining, everything pushed before stopping is visible afterwards
+		bool stopping = log_writer.stop.load();
+		s_log_sql_record record;
+		uint32 count = 0;
+
+		while( log_writer.queue->pop(record) ) {
+			s_log_sql_pending& batch = pending[record.batch];
+
+			if( batch.rows.empty() ) {
+				batch.query = log_writer.prefix[record.batch];
+				batch.first = clock::now();
+			} else
+				batch.query += ',';
+			batch.rows.push_back(batch.query.length());
+			batch.query += record.values;
+
+			if( batch.rows.size() >= log_config.sql_batch_size ) {
+				log_sql_writer_flush(record.batch, batch);
+				last_query = clock::now();
+			}
+
+			count++;
+		}
+
+		clock::time_point now = clock::now();
+
+		for( int32 i = 0; i < LOG_SQL_MAX; i++ ) {
+			if( !pending[i].rows.empty() && ( stopping || now - pending[i].first >= interval ) ) {
+				log_sql_writer_flush(static_cast<e_log_sql_batch>(i), pending[i]);
+				last_query = now;
+			}
+		}
+
+		if( stopping )
+			break;
+
+		if( count == 0 ) {
+			// the keepalive timer of the main thread can not be used for this connection
+			if( now - last_query >= std::chrono::seconds(log_writer.ping_interval) ) {
+				Sql_Ping(log_writer.handle);
+				last_query = now;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	Sql_ThreadEnd();
+}
+
+/// show the statements that failed in the log writer thread
+static void log_sql_writer_show_errors(void)
+{
+	std::vector<s_log_sql_error> errors;
+	uint64 suppressed;
+
+	{
+		std::lock_guard<std::mutex> lock(log_writer.error_mutex);
+
+		errors.swap(log_writer.errors);
+		suppressed = log_writer.errors_suppressed;
+		log_writer.errors_suppressed = 0;
+	}
+
+	for( const s_log_sql_error& error : errors ) {
+		ShowSQL("DB error - %s\n", error.error.c_str());
+		ShowDebug("Failed log statement - %s\n", error.query.c_str());
+	}
+
+	if( suppressed > 0 )
+		ShowSQL("%" PRIu64 " further log statements failed.\n", suppressed);
+}
+
+static TIMER_FUNC(log_sql_writer_error_timer){
+	log_sql_writer_show_errors();
+	return 0;
+}
+
+/// start writing SQL logs from a separate thread
+/// @param handle: connection to the log database, exclusively owned by the writer from now on
+void log_sql_writer_start(Sql* handle)
+{
+	uint32 timeout = 28800;
+
+	Sql_GetTimeout(handle, &timeout);
+	Sql_DisableKeepalive(handle);
+
+	log_writer.handle = handle;
+	log_writer.ping_interval = std::max<uint32>(timeout, 60) - 30;
+	log_writer.queue = std::make_unique<rathena::util::spsc_queue<s_log_sql_record>>(log_config.sql_queue_size);
+	log_writer.stop = false;
+	log_writer.thread = std::thread(log_sql_writer_main);
+	log_writer.running = true;
+
+	log_writer.error_timer = add_timer_interval(gettick() + 1000, log_sql_writer_error_timer, 0, 0, 1000);
+
+	ShowStatus("Writing SQL logs asynchronously (queue: %" PRIuPTR ", batch: %u rows, flush: %ums).\n", log_writer.queue->capacity(), log_config.sql_batch_size, log_config.sql_flush_interval);
+}
+
+/// flush all queued SQL logs and stop the writer thread
+void log_sql_writer_stop(void)
+{
+	if( !log_writer.running )
+		return;
+
+	log_writer.running = false;
+	log_writer.stop = true;
+	log_writer.thread.join();
+
+	delete_timer(log_writer.error_timer, log_sql_writer_error_timer);
+	log_writer.error_timer = INVALID_TIMER;
+	log_sql_writer_show_errors();
+	log_sql_writer_report();
+
+	Sql_Free(log_writer.handle);
+	log_writer.handle = nullptr;
+	log_writer.queue.reset();
+}
+
+/// show statistics of the SQL log writer
+void log_sql_writer_report(void)
+{
+	if( !log_config.sql_logs ) {
+		ShowInfo("SQL logs are disabled.\n");
+		return;
+	}
+
+	if( log_writer.queue == nullptr ) {
+		ShowInfo("SQL logs are written synchronously.\n");
+		return;
+	}
+
+	ShowInfo("SQL log writer: queue %" PRIuPTR "/%" PRIuPTR " (peak %" PRIuPTR "), queued %" PRIu64 ", written %" PRIu64 " in %" PRIu64 " statements, failed %" PRIu64 ", dropped %" PRIu64 ".\n",
+		log_writer.queue->size(), log_writer.queue->capacity(), log_writer.peak,
+		log_writer.queued.load(), log_writer.written.load(), log_writer.statements.load(), log_writer.failed.load(), log_writer.dropped.load());
+}
+
+/// get the handle of a text log file, opening it on first use
+/// Binary logs are written to the file name with ".bin" appended, so they never mix with text lines.
+static FILE* log_file_get(const char* filename)
+{
+	auto it = log_files.find(filename);
+
+	if( it != log_files.end() )
+		return it->second;
+
+	FILE* fp;
+
+	if( log_config.file_binary ) {
+		std::string binname = std::string(filename) + ".bin";
+
+		if( ( fp = fopen(binname.c_str(), "ab") ) != nullptr ) {
+			fseek(fp, 0, SEEK_END);
+			if( ftell(fp) == 0 ) {
+				fwrite(LOG_FILE_BINARY_SIGNATURE, 1, strlen(LOG_FILE_BINARY_SIGNATURE), fp);
+				fputc(LOG_FILE_BINARY_VERSION, fp);
+			}
+		}
+	} else
+		fp = fopen(filename, "a");
+
+	if( fp != nullptr )
+		setvbuf(fp, nullptr, _IOFBF, LOG_FILE_BUFFER_SIZE);
+	else
+		ShowError("log_file_get: Could not open log file '%s', retrying on the next flush.\n", filename);
+
+	// failures are remembered as well, so we do not try to open the file for every line
+	log_files[filename] = fp;
+
+	return fp;
+}
+
+/// flush and close all text log files
+static void log_file_close_all(void)
+{
+	for( const auto& it : log_files ) {
+		if( it.second != nullptr )
+			fclose(it.second);
+	}
+
+	log_files.clear();
+}
+
+/// write buffered text logs to disk
+static TIMER_FUNC(log_file_flush_timer){
+	if( sig_reopen_logs ) {
+		// files were rotated, start new ones
+		sig_reopen_logs = 0;
+		log_file_close_all();
+		ShowStatus("Reopening log files.\n");
+		return 0;
+	}
+
+	for( auto it = log_files.begin(); it != log_files.end(); ) {
+		if( it->second == nullptr ) {
+			it = log_files.erase(it);
+			continue;
+		}
+
+		fflush(it->second);
+		it++;
+	}
+
+	return 0;
+}
+
+/// timestamp of text log lines, only formatted again when the second changes
+static const char* log_timestamp(void)
+{
+	static char timestring[255];
+	static time_t last = 0;
+	time_t curtime = time(nullptr);
+
+	if( curtime != last ) {
+		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
+		last = curtime;
+	}
+
+	return timestring;
+}
+
+/// append a little endian number to a binary log record
+static void log_file_put_number(std::string& record, uint64 value, size_t bytes)
+{
+	for( size_t i = 0; i < bytes; i++ )
+		record += static_cast<char>( ( value >> ( i * 8 ) ) & 0xFF );
+}
+
+/// write a log line, as text or as binary record
+/// @param filename: log file
+/// @param type: layout of the line, followed by its arguments
+static void log_file_write(const char* filename, e_log_file_record type, ...)
+{
+	FILE* logfp = log_file_get(filename);
+
+	if( logfp == nullptr )
+		return;
+
+	va_list ap;
+
+	va_start(ap, type);
+
+	if( !log_config.file_binary ) {
+		fprintf(logfp, "%s - ", log_timestamp());
+		vfprintf(logfp, log_file_layouts[type], ap);
+		va_end(ap);
+		return;
+	}
+
+	static std::string record;
+	const char* layout = log_file_layouts[type];
+	const char* spec;
+	e_log_file_field field;
+
+	// type, time and the length of the fields, which is filled in at the end
+	record.clear();
+	record += static_cast<char>(type);
+	log_file_put_number(record, static_cast<uint64>(time(nullptr)), sizeof(int64));
+	size_t length_pos = record.length();
+	log_file_put_number(record, 0, sizeof(uint16));
+
+	while( ( field = log_file_next_field(layout, spec) ) != LOG_FIELD_END ) {
+		switch( field ) {
+			case LOG_FIELD_INT:
+				log_file_put_number(record, static_cast<uint64>(static_cast<int64>(va_arg(ap, int))), sizeof(int64));
+				break;
+			case LOG_FIELD_INT64:
+				log_file_put_number(record, va_arg(ap, uint64), sizeof(int64));
+				break;
+			case LOG_FIELD_STRING: {
+				const char* str = va_arg(ap, const char*);
+				size_t len = strnlen(str, UINT16_MAX);
+
+				log_file_put_number(record, len, sizeof(uint16));
+				record.append(str, len);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	va_end(ap);
+
+	size_t length = std::min<size_t>(record.length() - LOG_FILE_RECORD_HEADER_SIZE, UINT16_MAX);
+
+	record[length_pos] = static_cast<char>(length & 0xFF);
+	record[length_pos + 1] = static_cast<char>(length >> 8);
+
+	fwrite(record.data(), 1, record.length(), logfp);
+}
+
 /// check if this item should be logged according the settings
 static bool should_log_item(t_itemid nameid, int32 amount, int32 refine)
 {
@@ -178,28 +688,15 @@ void log_branch(map_session_data* sd)
 		return;
 
 	if( log_config.sql_logs ) {
-		SqlStmt stmt{ *logmysql_handle };
+		StringBuf buf;
 
-		if( SQL_SUCCESS != stmt.Prepare(LOG_QUERY " INTO `%s` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES (NOW(), '%d', '%d', ?, '%s')", log_config.log_branch, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != stmt.BindParam(0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != stmt.Execute() )
-		{
-			SqlStmt_ShowDebug(stmt);
-			return;
-		}
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%d', '%d', '%s', '%s')", log_sql_time(), sd->status.account_id, sd->status.char_id, log_sql_escape(sd->status.name, NAME_LENGTH).c_str(), mapindex_id2name(sd->mapindex));
+		log_sql_push(LOG_SQL_BRANCH, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_branch, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp,"%s - %s[%d:%d]\t%s\n", timestring, sd->status.name, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex));
-		fclose(logfp);
+		log_file_write(log_config.log_branch, LOG_FILE_BRANCH, sd->status.name, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex));
 	}
 }
 
@@ -218,20 +715,11 @@ void log_pick(int32 id, int16 m, e_log_pick_type type, int32 amount, struct item
 	if( log_config.sql_logs )
 	{
 		int32 i;
-		SqlStmt stmt{ *logmysql_handle };
 		StringBuf buf;
 		StringBuf_Init(&buf);
 
-		StringBuf_Printf(&buf, "%s INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `map`, `unique_id`, `bound`, `enchantgrade`", LOG_QUERY, log_config.log_pick);
-		for (i = 0; i < MAX_SLOTS; ++i)
-			StringBuf_Printf(&buf, ", `card%d`", i);
-		for (i = 0; i < MAX_ITEM_RDM_OPT; ++i) {
-			StringBuf_Printf(&buf, ", `option_id%d`", i);
-			StringBuf_Printf(&buf, ", `option_val%d`", i);
-			StringBuf_Printf(&buf, ", `option_parm%d`", i);
-		}
-		StringBuf_Printf(&buf, ") VALUES(NOW(),'%u','%c','%u','%d','%d','%s','%" PRIu64 "','%d','%d'",
-			id, log_picktype2char(type), itm->nameid, amount, itm->refine, map_getmapdata(m)->name[0] ? map_getmapdata(m)->name : "", itm->unique_id, itm->bound, itm->enchantgrade);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "),'%u','%c','%u','%d','%d','%s','%" PRIu64 "','%d','%d'",
+			log_sql_time(), id, log_picktype2char(type), itm->nameid, amount, itm->refine, map_getmapdata(m)->name[0] ? map_getmapdata(m)->name : "", itm->unique_id, itm->bound, itm->enchantgrade);
 
 		for (i = 0; i < MAX_SLOTS; i++)
 			StringBuf_Printf(&buf, ",'%u'", itm->card[i]);
@@ -239,21 +727,11 @@ void log_pick(int32 id, int16 m, e_log_pick_type type, int32 amount, struct item
 			StringBuf_Printf(&buf, ",'%d','%d','%d'", itm->option[i].id, itm->option[i].value, itm->option[i].param);
 		StringBuf_Printf(&buf, ")");
 
-		if (SQL_SUCCESS != stmt.PrepareStr(StringBuf_Value(&buf)) || SQL_SUCCESS != stmt.Execute())
-			SqlStmt_ShowDebug(stmt);
+		log_sql_push(LOG_SQL_PICK, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_pick, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp,"%s - %d\t%c\t%u,%d,%d,%u,%u,%u,%u,%s,'%" PRIu64 "',%d,%d\n", timestring, id, log_picktype2char(type), itm->nameid, amount, itm->refine, itm->card[0], itm->card[1], itm->card[2], itm->card[3], map_getmapdata(m)->name[0]?map_getmapdata(m)->name:"", itm->unique_id, itm->bound, itm->enchantgrade);
-		fclose(logfp);
+		log_file_write(log_config.log_pick, LOG_FILE_PICK, id, log_picktype2char(type), itm->nameid, amount, itm->refine, itm->card[0], itm->card[1], itm->card[2], itm->card[3], map_getmapdata(m)->name[0]?map_getmapdata(m)->name:"", itm->unique_id, itm->bound, itm->enchantgrade);
 	}
 }
 
@@ -281,25 +759,16 @@ void log_zeny(const map_session_data &target_sd, e_log_pick_type type, uint32 sr
 
 	if( log_config.sql_logs )
 	{
-		if (SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES (NOW(), '%d', '%d', '%c', '%d', '%s')",
-			log_config.log_zeny, target_sd.status.char_id, src_id, log_picktype2char(type), amount, mapindex_id2name(target_sd.mapindex)))
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%d', '%d', '%c', '%d', '%s')",
+			log_sql_time(), target_sd.status.char_id, src_id, log_picktype2char(type), amount, mapindex_id2name(target_sd.mapindex));
+		log_sql_push(LOG_SQL_ZENY, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_zeny, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - [%d] ->\t%s[%d]\t%d\t\n", timestring, src_id, target_sd.status.name, target_sd.status.char_id, amount);
-		fclose(logfp);
+		log_file_write(log_config.log_zeny, LOG_FILE_ZENY, src_id, target_sd.status.name, target_sd.status.char_id, amount);
 	}
 }
 
@@ -314,25 +783,16 @@ void log_mvpdrop(map_session_data* sd, int32 monster_id, t_itemid nameid, t_exp
 
 	if( log_config.sql_logs )
 	{
-		if( SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES (NOW(), '%d', '%d', '%u', '%" PRIu64 "', '%s') ",
-			log_config.log_mvpdrop, sd->status.char_id, monster_id, nameid, exp, mapindex_id2name(sd->mapindex)) )
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%d', '%d', '%u', '%" PRIu64 "', '%s')",
+			log_sql_time(), sd->status.char_id, monster_id, nameid, exp, mapindex_id2name(sd->mapindex));
+		log_sql_push(LOG_SQL_MVPDROP, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_mvpdrop,"a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp,"%s - %s[%d:%d]\t%d\t%u,%" PRIu64 "\n", timestring, sd->status.name, sd->status.account_id, sd->status.char_id, monster_id, nameid, exp);
-		fclose(logfp);
+		log_file_write(log_config.log_mvpdrop, LOG_FILE_MVPDROP, sd->status.name, sd->status.account_id, sd->status.char_id, monster_id, nameid, exp);
 	}
 }
 
@@ -348,29 +808,16 @@ void log_atcommand(map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt stmt{ *logmysql_handle };
+		StringBuf buf;
 
-		if( SQL_SUCCESS != stmt.Prepare(LOG_QUERY " INTO `%s` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_gm, sd->status.account_id, sd->status.char_id, sd->mapindex == 0 ? "" : mapindex_id2name(sd->mapindex))
-		||  SQL_SUCCESS != stmt.BindParam(0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != stmt.BindParam(1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != stmt.Execute() )
-		{
-			SqlStmt_ShowDebug(stmt);
-			return;
-		}
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%d', '%d', '%s', '%s', '%s')", log_sql_time(), sd->status.account_id, sd->status.char_id,
+			log_sql_escape(sd->status.name, NAME_LENGTH).c_str(), sd->mapindex == 0 ? "" : mapindex_id2name(sd->mapindex), log_sql_escape(message, 255).c_str());
+		log_sql_push(LOG_SQL_ATCOMMAND, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_gm, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - %s[%d]: %s\n", timestring, sd->status.name, sd->status.account_id, message);
-		fclose(logfp);
+		log_file_write(log_config.log_gm, LOG_FILE_ATCOMMAND, sd->status.name, sd->status.account_id, message);
 	}
 }
 
@@ -383,29 +830,16 @@ void log_npc( struct npc_data* nd, const char* message ){
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt stmt{ *logmysql_handle };
+		StringBuf buf;
 
-		if( SQL_SUCCESS != stmt.Prepare(LOG_QUERY " INTO `%s` (`npc_date`, `char_name`, `map`, `mes`) VALUES (NOW(), ?, '%s', ?)", log_config.log_npc, map_mapid2mapname(nd->m) )
-		||  SQL_SUCCESS != stmt.BindParam(0, SQLDT_STRING, nd->name, strnlen(nd->name, NAME_LENGTH))
-		||  SQL_SUCCESS != stmt.BindParam(1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != stmt.Execute() )
-		{
-			SqlStmt_ShowDebug(stmt);
-			return;
-		}
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%s', '%s', '%s')", log_sql_time(),
+			log_sql_escape(nd->name, NAME_LENGTH).c_str(), map_mapid2mapname(nd->m), log_sql_escape(message, 255).c_str());
+		log_sql_push(LOG_SQL_NPC, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_npc, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - %s: %s\n", timestring, nd->name, message);
-		fclose(logfp);
+		log_file_write(log_config.log_npc, LOG_FILE_NPC, nd->name, message);
 	}
 }
 
@@ -419,29 +853,16 @@ void log_npc(map_session_data* sd, const char* message)
 
 	if( log_config.sql_logs )
 	{
-		SqlStmt stmt{ *logmysql_handle };
+		StringBuf buf;
 
-		if( SQL_SUCCESS != stmt.Prepare(LOG_QUERY " INTO `%s` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", log_config.log_npc, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-		||  SQL_SUCCESS != stmt.BindParam(0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-		||  SQL_SUCCESS != stmt.BindParam(1, SQLDT_STRING, (char*)message, safestrnlen(message, 255))
-		||  SQL_SUCCESS != stmt.Execute() )
-		{
-			SqlStmt_ShowDebug(stmt);
-			return;
-		}
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%d', '%d', '%s', '%s', '%s')", log_sql_time(), sd->status.account_id, sd->status.char_id,
+			log_sql_escape(sd->status.name, NAME_LENGTH).c_str(), mapindex_id2name(sd->mapindex), log_sql_escape(message, 255).c_str());
+		log_sql_push(LOG_SQL_NPC_PC, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_npc, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - %s[%d]: %s\n", timestring, sd->status.name, sd->status.account_id, message);
-		fclose(logfp);
+		log_file_write(log_config.log_npc, LOG_FILE_NPC_PC, sd->status.name, sd->status.account_id, message);
 	}
 }
 
@@ -464,29 +885,16 @@ void log_chat(e_log_chat_type type, int32 type_id, int32 src_charid, int32 src_a
 	}
 
 	if( log_config.sql_logs ) {
-		SqlStmt stmt{ *logmysql_handle };
+		StringBuf buf;
 
-		if( SQL_SUCCESS != stmt.Prepare(LOG_QUERY " INTO `%s` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES (NOW(), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ?, ?)", log_config.log_chat, log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y)
-		||  SQL_SUCCESS != stmt.BindParam(0, SQLDT_STRING, (char*)dst_charname, safestrnlen(dst_charname, NAME_LENGTH))
-		||  SQL_SUCCESS != stmt.BindParam(1, SQLDT_STRING, (char*)message, safestrnlen(message, CHAT_SIZE_MAX))
-		||  SQL_SUCCESS != stmt.Execute() )
-		{
-			SqlStmt_ShowDebug(stmt);
-			return;
-		}
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "(FROM_UNIXTIME(%" PRId64 "), '%c', '%d', '%d', '%d', '%s', '%d', '%d', '%s', '%s')", log_sql_time(), log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y,
+			log_sql_escape(dst_charname, NAME_LENGTH).c_str(), log_sql_escape(message, CHAT_SIZE_MAX).c_str());
+		log_sql_push(LOG_SQL_CHAT, &buf);
 	}
 	else
 	{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
-
-		if( ( logfp = fopen(log_config.log_chat, "a") ) == nullptr )
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - %c,%d,%d,%d,%s,%d,%d,%s,%s\n", timestring, log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y, dst_charname, message);
-		fclose(logfp);
+		log_file_write(log_config.log_chat, LOG_FILE_CHAT, log_chattype2char(type), type_id, src_charid, src_accid, mapname, x, y, dst_charname, message);
 	}
 }
 
@@ -498,23 +906,14 @@ void log_cash( map_session_data* sd, e_log_pick_type type, e_log_cash_type cash_
 		return;
 
 	if( log_config.sql_logs ){
-		if( SQL_ERROR == Sql_Query( logmysql_handle, LOG_QUERY " INTO `%s` ( `time`, `char_id`, `type`, `cash_type`, `amount`, `map` ) VALUES ( NOW(), '%d', '%c', '%c', '%d', '%s' )",
-			log_config.log_cash, sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) ) )
-		{
-			Sql_ShowDebug( logmysql_handle );
-			return;
-		}
-	}else{
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
+		StringBuf buf;
 
-		if( ( logfp = fopen( log_config.log_cash, "a" ) ) == nullptr )
-			return;
-		time( &curtime );
-		strftime( timestring, sizeof( timestring ), log_timestamp_format, localtime( &curtime ) );
-		fprintf( logfp, "%s - %s[%d]\t%d(%c)\t\n", timestring, sd->status.name, sd->status.account_id, amount, log_cashtype2char( cash_type ) );
-		fclose( logfp );
+		StringBuf_Init( &buf );
+		StringBuf_Printf( &buf, "( FROM_UNIXTIME(%" PRId64 "), '%d', '%c', '%c', '%d', '%s' )",
+			log_sql_time(), sd->status.char_id, log_picktype2char( type ), log_cashtype2char( cash_type ), amount, mapindex_id2name( sd->mapindex ) );
+		log_sql_push( LOG_SQL_CASH, &buf );
+	}else{
+		log_file_write(log_config.log_cash, LOG_FILE_CASH, sd->status.name, sd->status.account_id, amount, log_cashtype2char( cash_type ));
 	}
 }
 
@@ -551,24 +950,44 @@ void log_feeding(map_session_data *sd, e_log_feeding_type type, t_itemid nameid)
 	}
 
 	if (log_config.sql_logs) {
-		if (SQL_ERROR == Sql_Query(logmysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `target_id`, `target_class`, `type`, `intimacy`, `item_id`, `map`, `x`, `y`) VALUES ( NOW(), '%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%u', '%s', '%hu', '%hu' )",
-			log_config.log_feeding, sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->x, sd->y))
-		{
-			Sql_ShowDebug(logmysql_handle);
-			return;
-		}
+		StringBuf buf;
+
+		StringBuf_Init(&buf);
+		StringBuf_Printf(&buf, "( FROM_UNIXTIME(%" PRId64 "), '%" PRIu32 "', '%" PRIu32 "', '%hu', '%c', '%" PRIu32 "', '%u', '%s', '%hu', '%hu' )",
+			log_sql_time(), sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->x, sd->y);
+		log_sql_push(LOG_SQL_FEEDING, &buf);
 	} else {
-		char timestring[255];
-		time_t curtime;
-		FILE* logfp;
+		log_file_write(log_config.log_feeding, LOG_FILE_FEEDING, sd->status.name, sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->x, sd->y);
+	}
+}
 
-		if ((logfp = fopen(log_config.log_feeding, "a")) == nullptr)
-			return;
-		time(&curtime);
-		strftime(timestring, sizeof(timestring), log_timestamp_format, localtime(&curtime));
-		fprintf(logfp, "%s - %s[%d]\t%d\t%d(%c)\t%d\t%u\t%s\t%hu,%hu\n", timestring, sd->status.name, sd->status.char_id, target_id, target_class, log_feedingtype2char(type), intimacy, nameid, mapindex_id2name(sd->mapindex), sd->x, sd->y);
-		fclose(logfp);
+/// start or stop flushing the text log files, so it matches the current configuration
+void log_file_timer_update(void)
+{
+	// files are reopened on demand, with the current file names and format
+	log_file_close_all();
+
+	if( log_file_flush_tid != INVALID_TIMER ) {
+		delete_timer(log_file_flush_tid, log_file_flush_timer);
+		log_file_flush_tid = INVALID_TIMER;
 	}
+
+	if( log_config.sql_logs )
+		return;
+
+	signals_init_reopen_logs();
+	log_file_flush_tid = add_timer_interval(gettick() + log_config.file_flush_interval, log_file_flush_timer, 0, 0, log_config.file_flush_interval);
+}
+
+void do_init_log(void)
+{
+	add_timer_func_list(log_file_flush_timer, "log_file_flush_timer");
+	add_timer_func_list(log_sql_writer_error_timer, "log_sql_writer_error_timer");
+}
+
+void do_final_log(void)
+{
+	log_file_close_all();
 }
 
 void log_set_defaults(void)
@@ -581,6 +1000,14 @@ void log_set_defaults(void)
 	log_config.price_items_log  = 1000; // 1000z
 	log_config.amount_items_log = 100;
 
+	// asynchronous SQL log writer
+	log_config.sql_async = true;
+	log_config.sql_queue_size = 32768;
+	log_config.sql_batch_size = 200;
+	log_config.sql_flush_interval = 1000;
+
+	log_config.file_flush_interval = 1000;
+
 	safestrncpy(log_timestamp_format, "%m/%d/%Y %H:%M:%S", sizeof(log_timestamp_format));
 }
 
@@ -611,6 +1038,18 @@ int32 log_config_read(const char* cfgName)
 				log_config.enable_logs = (e_log_pick_type)config_switch(w2);
 			else if( strcmpi(w1, "sql_logs") == 0 )
 				log_config.sql_logs = config_switch(w2) > 0;
+			else if( strcmpi(w1, "sql_logs_async") == 0 )
+				log_config.sql_async = config_switch(w2) > 0;
+			else if( strcmpi(w1, "sql_logs_queue_size") == 0 )
+				log_config.sql_queue_size = cap_value(atoi(w2), 1024, 1048576);
+			else if( strcmpi(w1, "sql_logs_batch_size") == 0 )
+				log_config.sql_batch_size = cap_value(atoi(w2), 1, 1000);
+			else if( strcmpi(w1, "sql_logs_flush_interval") == 0 )
+				log_config.sql_flush_interval = cap_value(atoi(w2), 10, 60000);
+			else if( strcmpi(w1, "log_file_flush_interval") == 0 )
+				log_config.file_flush_interval = cap_value(atoi(w2), 100, 60000);
+			else if( strcmpi(w1, "log_file_binary") == 0 )
+				log_config.file_binary = config_switch(w2) > 0;
 //start of common filter settings
 			else if( strcmpi(w1, "rare_items_log") == 0 )
 				log_config.rare_items_log = atoi(w2);
@@ -676,6 +1115,11 @@ int32 log_config_read(const char* cfgName)
 	{// report final logging state
 		const char* target = log_config.sql_logs ? "table" : "file";
 
+		if( log_config.sql_logs )
+			log_sql_build_prefixes();
+
+		log_file_timer_update();
+
 		if( log_config.enable_logs && log_config.filter )
 		{
 			ShowInfo("Logging item transactions to %s '%s'.\n", target, log_config.log_pick);
@@ -4,6 +4,8 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
+#include <cstring>
+
 #include <common/cbasetypes.hpp>
 #include <common/mmo.hpp>
 
@@ -11,6 +13,7 @@ struct block_list;
 class map_session_data;
 struct mob_data;
 struct item;
+struct Sql;
 
 enum e_log_chat_type : uint8
 {
@@ -75,6 +78,94 @@ enum e_log_feeding_type : uint8
 	LOG_FEED_PET        = 0x2,
 };
 
+/// Text log lines, one per log file layout
+enum e_log_file_record : uint8{
+	LOG_FILE_BRANCH = 0,
+	LOG_FILE_PICK,
+	LOG_FILE_ZENY,
+	LOG_FILE_MVPDROP,
+	LOG_FILE_ATCOMMAND,
+	LOG_FILE_NPC,
+	LOG_FILE_NPC_PC,
+	LOG_FILE_CHAT,
+	LOG_FILE_CASH,
+	LOG_FILE_FEEDING,
+	LOG_FILE_MAX
+};
+
+/// Layout of each text log line, following the "<timestamp> - " prefix.
+/// Binary log files store the arguments of these layouts, logconv prints them again through the same layout.
+inline constexpr const char* log_file_layouts[LOG_FILE_MAX] = {
+	"%s[%d:%d]\t%s\n", // branch
+	"%d\t%c\t%u,%d,%d,%u,%u,%u,%u,%s,'%" PRIu64 "',%d,%d\n", // pick
+	"[%d] ->\t%s[%d]\t%d\t\n", // zeny
+	"%s[%d:%d]\t%d\t%u,%" PRIu64 "\n", // mvpdrop
+	"%s[%d]: %s\n", // atcommand
+	"%s: %s\n", // npc
+	"%s[%d]: %s\n", // npc with player
+	"%c,%d,%d,%d,%s,%d,%d,%s,%s\n", // chat
+	"%s[%d]\t%d(%c)\t\n", // cash
+	"%s[%d]\t%d\t%d(%c)\t%d\t%u\t%s\t%hu,%hu\n", // feeding
+};
+
+/// Binary log files start with this signature, followed by the format version.
+/// Every record is the record type (uint8), the time (int64) and the length of its fields (uint16), followed by the fields.
+/// Numbers are stored as little endian int64, strings as their length (uint16) followed by the characters.
+#define LOG_FILE_BINARY_SIGNATURE "rAlog"
+#define LOG_FILE_BINARY_VERSION 1
+#define LOG_FILE_RECORD_HEADER_SIZE ( sizeof( uint8 ) + sizeof( int64 ) + sizeof( uint16 ) )
+
+/// Argument kinds of a log layout conversion
+enum e_log_file_field : uint8{
+	LOG_FIELD_END = 0, ///< end of the layout
+	LOG_FIELD_INT, ///< anything passed as int
+	LOG_FIELD_INT64,
+	LOG_FIELD_STRING,
+};
+
+/// Find the next conversion of a log layout.
+/// @param layout: current position, set behind the conversion
+/// @param spec: set to the '%' starting the conversion
+/// @return the kind of argument the conversion takes
+inline e_log_file_field log_file_next_field(const char*& layout, const char*& spec){
+	while( *layout != '\0' && *layout != '%' )
+		layout++;
+
+	if( *layout == '\0' ){
+		spec = layout;
+		return LOG_FIELD_END;
+	}
+
+	spec = layout++;
+
+	// flags, width and precision
+	while( *layout != '\0' && strchr( "-+ #0123456789.", *layout ) != nullptr )
+		layout++;
+
+	int32 longs = 0;
+
+	// length modifiers
+	for( ; *layout == 'l' || *layout == 'h' || *layout == 'j' || *layout == 'z'; layout++ ){
+		if( *layout == 'l' )
+			longs++;
+	}
+
+	switch( *layout++ ){
+		case 's':
+			return LOG_FIELD_STRING;
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'x':
+		case 'X':
+			if( longs >= 2 || ( longs == 1 && sizeof( long ) == sizeof( int64 ) ) )
+				return LOG_FIELD_INT64;
+			return LOG_FIELD_INT;
+		default: // c
+			return LOG_FIELD_INT;
+	}
+}
+
 /// new logs
 void log_pick_pc(map_session_data* sd, e_log_pick_type type, int32 amount, struct item* itm);
 void log_pick_mob(struct mob_data* md, e_log_pick_type type, int32 amount, struct item* itm);
@@ -91,12 +182,25 @@ void log_branch(map_session_data* sd);
 void log_mvpdrop(map_session_data* sd, int32 monster_id, t_itemid nameid, t_exp exp);
 
 int32 log_config_read(const char* cfgName);
+void log_file_timer_update(void);
+
+void do_init_log(void);
+void do_final_log(void);
+
+/// asynchronous SQL log writer
+void log_sql_writer_start(Sql* handle);
+void log_sql_writer_stop(void);
+void log_sql_writer_report(void);
 
 extern struct Log_Config
 {
 	e_log_pick_type enable_logs;
 	int32 filter;
 	bool sql_logs;
+	bool sql_async;
+	uint32 sql_queue_size, sql_batch_size, sql_flush_interval; // asynchronous SQL log writer
+	uint32 file_flush_interval; // buffered text logs
+	bool file_binary; // binary instead of text log files
 	bool log_chat_woe_disable;
 	bool cash;
 	int32 rare_items_log,refine_items_log,price_items_log,amount_items_log; //for filter
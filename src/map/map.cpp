@@ -3,8 +3,18 @@
 
 #include "map.hpp"
 
+#include <atomic>
 #include <cstdlib>
 #include <cmath>
+#include <thread>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <config/core.hpp>
 
@@ -13,8 +23,10 @@
 #include <common/core.hpp>
 #include <common/ers.hpp>
 #include <common/grfio.hpp>
+#include <common/id_table.hpp>
 #include <common/malloc.hpp>
 #include <common/nullpo.hpp>
+#include <common/profiler.hpp>
 #include <common/random.hpp>
 #include <common/showmsg.hpp>
 #include <common/socket.hpp> // WFIFO*()
@@ -123,9 +135,32 @@ static DBMap* charid_db=nullptr; /// uint32 char_id -> map_session_data*
 static DBMap* regen_db=nullptr; /// int32 id -> struct block_list* (status_natural_heal processing)
 static DBMap* map_msg_db=nullptr;
 
+/// Direct-indexed tables for the object ids that are handed out by a counter
+/// (npc_get_new_npc_id and map_get_new_object_id).
+/// id_db still holds every object and is used for iteration and for account ids.
+typedef rathena::util::id_table<block_list> MapObjectTable;
+
+static MapObjectTable npc_id_table( START_NPC_NUM ); /// ids from npc_get_new_npc_id (npcs, mobs, pets, homunculi, mercenaries, elementals)
+static MapObjectTable object_id_table( MIN_FLOORITEM ); /// ids from map_get_new_object_id (floor items, skill units, chatrooms)
+
+/// Returns the object table responsible for the id or nullptr if it is looked up in id_db
+static MapObjectTable* map_object_table( int32 id ){
+	if( npc_id_table.contains( id, INT32_MAX ) ){
+		return &npc_id_table;
+	}
+
+	if( object_id_table.contains( id, MAX_FLOORITEM ) ){
+		return &object_id_table;
+	}
+
+	return nullptr;
+}
+
 static int32 map_users=0;
 
 #define BLOCK_SIZE 8
+#define BLOCK_SECTION 4 // Size of a section in blocks, the area that map_hasblock keeps its counters for
+#define SECTION_TYPES 12 // Counters per section, one for each bit of bl_type
 #define block_free_max 1048576
 struct block_list *block_free[block_free_max];
 static int32 block_free_count = 0, block_free_lock = 0;
@@ -174,6 +209,35 @@ struct map_cache_map_info {
 	int32 len;
 };
 
+// This is the main header of the uncompressed map cache (map_cache_raw.dat, written by the mapcache tool with -raw)
+struct map_cache_raw_header {
+	char magic[4]; // MAP_CACHE_RAW_MAGIC
+	uint32 version;
+	uint32 map_count;
+	uint32 index_offset; // offset of the map_cache_raw_info array
+};
+
+// This is the index entry of every map in the uncompressed map cache
+struct map_cache_raw_info {
+	char name[MAP_NAME_LENGTH];
+	int16 xs;
+	int16 ys;
+	uint32 offset; // page aligned offset of the terrain flags (e_map_terrain, one byte per cell)
+};
+
+#define MAP_CACHE_RAW_MAGIC "RAMC"
+#define MAP_CACHE_RAW_VERSION 1
+
+// A map found in one of the map caches
+struct map_cache_entry {
+	struct map_cache_map_info* info; // compressed cells (map_cache.dat)
+	const uint8* terrain; // uncompressed terrain (map_cache_raw.dat)
+	int16 xs, ys;
+};
+
+// Uncompressed map caches, they stay mapped until shutdown since the maps use their terrain directly
+static std::vector<std::pair<void*, size_t>> map_cache_raw;
+
 char motd_txt[256] = "conf/motd.txt";
 char charhelp_txt[256] = "conf/charhelp.txt";
 char channel_conf[256] = "conf/channels.conf";
@@ -434,6 +498,222 @@ static void map_delblcell(struct block_list *bl)
 }
 #endif
 
+#ifdef PACKED_BLOCK_INDEX
+/*==========================================
+ * Packed block index
+ * Keeps a copy of the position and type of every object of a block
+ * in contiguous arrays, in the same order as the block_list chain.
+ *------------------------------------------*/
+static struct map_packed_block* map_packedblock_alloc(int32 max)
+{
+	struct map_packed_block* block;
+	char* data = (char*)aMalloc(sizeof(struct map_packed_block) + max * (sizeof(struct block_list*) + 2 * sizeof(int16) + sizeof(uint16)));
+
+	block = (struct map_packed_block*)data;
+	data += sizeof(struct map_packed_block);
+	block->bl = (struct block_list**)data;
+	data += max * sizeof(struct block_list*);
+	block->x = (int16*)data;
+	data += max * sizeof(int16);
+	block->y = (int16*)data;
+	data += max * sizeof(int16);
+	block->type = (uint16*)data;
+	block->count = 0;
+	block->max = max;
+
+	return block;
+}
+
+/// Appends an object to a packed block, allocating or growing it when needed
+static void map_packedblock_add(struct map_packed_block** blockp, struct block_list* bl)
+{
+	struct map_packed_block* block = *blockp;
+
+	if( block == nullptr )
+		*blockp = block = map_packedblock_alloc(8);
+	else if( block->count == block->max ) {
+		struct map_packed_block* grown = map_packedblock_alloc(block->max * 2);
+
+		memcpy(grown->bl, block->bl, block->count * sizeof(struct block_list*));
+		memcpy(grown->x, block->x, block->count * sizeof(int16));
+		memcpy(grown->y, block->y, block->count * sizeof(int16));
+		memcpy(grown->type, block->type, block->count * sizeof(uint16));
+		grown->count = block->count;
+		aFree(block);
+		*blockp = block = grown;
+	}
+
+	block->bl[block->count] = bl;
+	block->x[block->count] = bl->x;
+	block->y[block->count] = bl->y;
+	block->type[block->count] = (uint16)bl->type;
+	block->count++;
+}
+
+/// Returns the position of an object in a packed block or -1
+static int32 map_packedblock_find(struct map_packed_block* block, struct block_list* bl)
+{
+	if( block == nullptr )
+		return -1;
+
+	// recently added objects are the most likely to move or leave
+	for( int32 i = block->count - 1; i >= 0; i-- ) {
+		if( block->bl[i] == bl )
+			return i;
+	}
+
+	return -1;
+}
+
+/// Removes an object from a packed block, keeping the order of the others
+static void map_packedblock_remove(struct map_packed_block* block, struct block_list* bl)
+{
+	int32 i = map_packedblock_find(block, bl);
+
+	if( i < 0 )
+		return;
+
+	int32 move = block->count - i - 1;
+
+	memmove(block->bl + i, block->bl + i + 1, move * sizeof(struct block_list*));
+	memmove(block->x + i, block->x + i + 1, move * sizeof(int16));
+	memmove(block->y + i, block->y + i + 1, move * sizeof(int16));
+	memmove(block->type + i, block->type + i + 1, move * sizeof(uint16));
+	block->count--;
+}
+
+/// Updates the position of an object that moved inside its block
+static void map_packedblock_move(struct map_packed_block* block, struct block_list* bl)
+{
+	int32 i = map_packedblock_find(block, bl);
+
+	if( i < 0 )
+		return;
+
+	block->x[i] = bl->x;
+	block->y[i] = bl->y;
+}
+
+/// Frees all packed blocks of a map
+static void map_packedblock_free(struct map_packed_block** blocks, int32 count)
+{
+	if( blocks == nullptr )
+		return;
+
+	for( int32 i = 0; i < count; i++ ) {
+		if( blocks[i] != nullptr )
+			aFree(blocks[i]);
+	}
+
+	aFree(blocks);
+}
+
+/// Appends all objects of a packed block that match the type and lie in the area to bl_list, newest first (like the block_list chain)
+static void map_packedblock_getarea(struct map_packed_block* block, int32 type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	uint8 match[64];
+
+	if( block == nullptr )
+		return;
+
+	for( int32 end = block->count; end > 0; end -= ARRAYLENGTH(match) ) {
+		int32 start = i32max(end - (int32)ARRAYLENGTH(match), 0);
+		const int16* x = block->x + start;
+		const int16* y = block->y + start;
+		const uint16* t = block->type + start;
+		int32 n = end - start;
+
+		// branchless filter over the packed arrays, can be vectorized by the compiler
+		for( int32 i = 0; i < n; i++ )
+			match[i] = ( x[i] >= x0 ) & ( x[i] <= x1 ) & ( y[i] >= y0 ) & ( y[i] <= y1 ) & ( ( t[i] & type ) != 0 );
+
+		for( int32 i = n - 1; i >= 0; i-- ) {
+			if( match[i] && bl_list_count < BL_LIST_MAX )
+				bl_list[bl_list_count++] = block->bl[start + i];
+		}
+	}
+}
+
+/// Appends all objects of the given type in an area of a map to bl_list, in the same order as the block_list chains
+static void map_packedblock_getarea(struct map_data* mapdata, int32 type, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	if( type&~BL_MOB ) {
+		for( int32 by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
+			for( int32 bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
+				map_packedblock_getarea(mapdata->block_packed[bx + by * mapdata->bxs], type, x0, y0, x1, y1);
+	}
+
+	if( type&BL_MOB ) {
+		for( int32 by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
+			for( int32 bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
+				map_packedblock_getarea(mapdata->block_mob_packed[bx + by * mapdata->bxs], BL_MOB, x0, y0, x1, y1);
+	}
+}
+#endif
+
+/**
+ * Returns the index of the single bit set in a bl_type, used for map_data::section_count.
+ * @param type: Type of the object
+ * @return Bit index
+ */
+static inline size_t map_blocktype_index(enum bl_type type){
+	size_t i = 0;
+
+	for( uint16 bits = type >> 1; bits != 0; bits >>= 1 ){
+		i++;
+	}
+
+	return i;
+}
+
+/**
+ * Returns the counters of the section that contains a cell.
+ * @param mapdata: Map of the cell
+ * @param x: X coordinate of the cell
+ * @param y: Y coordinate of the cell
+ * @return SECTION_TYPES counters
+ */
+static inline int32* map_section_count(struct map_data* mapdata, int16 x, int16 y){
+	return &mapdata->section_count[( x / BLOCK_SIZE / BLOCK_SECTION + ( y / BLOCK_SIZE / BLOCK_SECTION ) * mapdata->sxs ) * SECTION_TYPES];
+}
+
+/**
+ * Checks if any object of the given types is placed in the sections that cover an area.
+ * Lets periodic area searches skip areas where they cannot find anything.
+ * A section is larger than the area, so objects close to it are reported as well.
+ * @param m: ID of map
+ * @param x0: Left edge of the area, clamped to the map
+ * @param y0: Bottom edge of the area, clamped to the map
+ * @param x1: Right edge of the area, clamped to the map
+ * @param y1: Top edge of the area, clamped to the map
+ * @param type: Types of bl to look for
+ * @return true if an object of the types may be in the area
+ */
+bool map_hasblock(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int32 type){
+	struct map_data* mapdata = map_getmapdata(m);
+
+	if( mapdata == nullptr || mapdata->section_count == nullptr )
+		return false;
+
+	x0 = i16max(x0, 0);
+	y0 = i16max(y0, 0);
+	x1 = i16min(x1, mapdata->xs - 1);
+	y1 = i16min(y1, mapdata->ys - 1);
+
+	for( int32 sy = y0 / BLOCK_SIZE / BLOCK_SECTION; sy <= y1 / BLOCK_SIZE / BLOCK_SECTION; sy++ ){
+		for( int32 sx = x0 / BLOCK_SIZE / BLOCK_SECTION; sx <= x1 / BLOCK_SIZE / BLOCK_SECTION; sx++ ){
+			const int32* count = &mapdata->section_count[( sx + sy * mapdata->sxs ) * SECTION_TYPES];
+
+			for( int32 i = 0; i < SECTION_TYPES; i++ ){
+				if( ( type & ( 1 << i ) ) && count[i] > 0 )
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
 /*==========================================
  * Adds a block to the map.
  * Returns 0 on success, 1 on failure (illegal coordinates).
@@ -485,6 +765,12 @@ int32 map_addblock(struct block_list* bl)
 		mapdata->block[pos] = bl;
 	}
 
+	map_section_count(mapdata, x, y)[map_blocktype_index(bl->type)]++;
+
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_add(bl->type == BL_MOB ? &mapdata->block_mob_packed[pos] : &mapdata->block_packed[pos], bl);
+#endif
+
 #ifdef CELL_NOSTACK
 	map_addblcell(bl);
 #endif
@@ -519,6 +805,13 @@ int32 map_delblock(struct block_list* bl)
 
 	pos = bl->x/BLOCK_SIZE+(bl->y/BLOCK_SIZE)*mapdata->bxs;
 
+	map_section_count(mapdata, bl->x, bl->y)[map_blocktype_index(bl->type)]--;
+
+#ifdef PACKED_BLOCK_INDEX
+	if (mapdata->block_packed != nullptr)
+		map_packedblock_remove(bl->type == BL_MOB ? mapdata->block_mob_packed[pos] : mapdata->block_packed[pos], bl);
+#endif
+
 	if (bl->next)
 		bl->next->prev = bl->prev;
 	if (bl->prev == &bl_head) {
@@ -600,6 +893,14 @@ int32 map_moveblock(struct block_list *bl, int32 x1, int32 y1, t_tick tick)
 #ifdef CELL_NOSTACK
 	else map_addblcell(bl);
 #endif
+#ifdef PACKED_BLOCK_INDEX
+	if (!moveblock) {
+		struct map_data *mapdata = map_getmapdata(bl->m);
+		int32 pos = x1/BLOCK_SIZE+(y1/BLOCK_SIZE)*mapdata->bxs;
+
+		map_packedblock_move(bl->type == BL_MOB ? mapdata->block_mob_packed[pos] : mapdata->block_packed[pos], bl);
+	}
+#endif
 
 	if (bl->type&BL_CHAR) {
 
@@ -774,6 +1075,24 @@ int32 map_foreachinrangeV(int32 (*func)(struct block_list*,va_list),struct block
 	x1 = i16min(center->x + range, mapdata->xs - 1);
 	y1 = i16min(center->y + range, mapdata->ys - 1);
 
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_getarea(mapdata, type, x0, y0, x1, y1);
+
+	// remove the candidates that fail the more expensive checks
+	int32 kept = blockcount;
+
+	for( i = blockcount; i < bl_list_count; i++ ) {
+		bl = bl_list[i];
+#ifdef CIRCULAR_AREA
+		if( !check_distance_bl(center, bl, range) )
+			continue;
+#endif
+		if( wall_check && !path_search_long(nullptr, center->m, center->x, center->y, bl->x, bl->y, CELL_CHKWALL) )
+			continue;
+		bl_list[kept++] = bl;
+	}
+	bl_list_count = kept;
+#else
 	if ( type&~BL_MOB ) {
 		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
 			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
@@ -807,6 +1126,8 @@ int32 map_foreachinrangeV(int32 (*func)(struct block_list*,va_list),struct block
 		}
 	}
 
+#endif
+
 	if( bl_list_count >= BL_LIST_MAX )
 		ShowWarning("map_foreachinrange: block count too many!\n");
 
@@ -846,6 +1167,46 @@ int32 map_foreachinallrange(int32 (*func)(struct block_list*,va_list), struct bl
 	return returnCount;
 }
 
+/**
+ * Collects the objects of the given types in range of a center, like map_foreachinallrange.
+ * It does not use the shared bl_list, so it may run in several threads at once,
+ * as long as the main thread does not change the map meanwhile.
+ * @param list: Objects found are appended to it
+ * @param center: Center of the search
+ * @param range: Range of the search
+ * @param type: Type of bl to search for
+ */
+void map_getallinrange(std::vector<struct block_list*>& list, struct block_list* center, int16 range, int32 type)
+{
+	struct map_data* mapdata = map_getmapdata(center->m);
+
+	if( mapdata == nullptr || mapdata->block == nullptr )
+		return;
+
+	int32 x0 = i16max(center->x - range, 0);
+	int32 y0 = i16max(center->y - range, 0);
+	int32 x1 = i16min(center->x + range, mapdata->xs - 1);
+	int32 y1 = i16min(center->y + range, mapdata->ys - 1);
+
+	for( int32 by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
+		for( int32 bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
+			if( type&~BL_MOB ) {
+				for( struct block_list* bl = mapdata->block[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next ) {
+					if( bl->type&type && bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 && check_distance_bl(center, bl, range) )
+						list.push_back(bl);
+				}
+			}
+
+			if( type&BL_MOB ) {
+				for( struct block_list* bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != nullptr; bl = bl->next ) {
+					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 && check_distance_bl(center, bl, range) )
+						list.push_back(bl);
+				}
+			}
+		}
+	}
+}
+
 /*==========================================
  * Same as foreachinrange, but there must be a shoot-able range between center and target to be counted in. [Skotlex]
  *------------------------------------------*/
@@ -902,6 +1263,20 @@ int32 map_foreachinareaV(int32 (*func)(struct block_list*, va_list), int16 m, in
 		cy = y0 + (y1 - y0) / 2;
 	}
 
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_getarea(mapdata, type, x0, y0, x1, y1);
+
+	if( wall_check ) {
+		int32 kept = blockcount;
+
+		for( i = blockcount; i < bl_list_count; i++ ) {
+			bl = bl_list[i];
+			if( path_search_long(nullptr, m, cx, cy, bl->x, bl->y, CELL_CHKWALL) )
+				bl_list[kept++] = bl;
+		}
+		bl_list_count = kept;
+	}
+#else
 	if( type&~BL_MOB ) {
 		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
 			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
@@ -929,6 +1304,8 @@ int32 map_foreachinareaV(int32 (*func)(struct block_list*, va_list), int16 m, in
 		}
 	}
 
+#endif
+
 	if (bl_list_count >= BL_LIST_MAX)
 		ShowWarning("map_foreachinarea: block count too many!\n");
 
@@ -1002,6 +1379,20 @@ int32 map_forcountinrange(int32 (*func)(struct block_list*,va_list), struct bloc
 	x1 = i16min(center->x + range, mapdata->xs - 1);
 	y1 = i16min(center->y + range, mapdata->ys - 1);
 
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_getarea(mapdata, type, x0, y0, x1, y1);
+
+#ifdef CIRCULAR_AREA
+	int32 kept = blockcount;
+
+	for( i = blockcount; i < bl_list_count; i++ ) {
+		bl = bl_list[i];
+		if( check_distance_bl(center, bl, range) )
+			bl_list[kept++] = bl;
+	}
+	bl_list_count = kept;
+#endif
+#else
 	if ( type&~BL_MOB )
 		for ( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ ) {
 			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ ) {
@@ -1030,6 +1421,8 @@ int32 map_forcountinrange(int32 (*func)(struct block_list*,va_list), struct bloc
 			}
 		}
 
+#endif
+
 	if( bl_list_count >= BL_LIST_MAX )
 		ShowWarning("map_forcountinrange: block count too many!\n");
 
@@ -1076,6 +1469,9 @@ int32 map_forcountinarea(int32 (*func)(struct block_list*,va_list), int16 m, int
 	x1 = i16min(x1, mapdata->xs - 1);
 	y1 = i16min(y1, mapdata->ys - 1);
 
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_getarea(mapdata, type, x0, y0, x1, y1);
+#else
 	if ( type&~BL_MOB )
 		for( by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++ )
 			for( bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++ )
@@ -1090,6 +1486,8 @@ int32 map_forcountinarea(int32 (*func)(struct block_list*,va_list), int16 m, int
 					if( bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1 && bl_list_count < BL_LIST_MAX )
 						bl_list[ bl_list_count++ ] = bl;
 
+#endif
+
 	if( bl_list_count >= BL_LIST_MAX )
 		ShowWarning("map_forcountinarea: block count too many!\n");
 
@@ -1702,7 +2100,7 @@ int32 map_get_new_object_id(void)
 		if( i == MAX_FLOORITEM )
 			i = MIN_FLOORITEM;
 
-		if( !idb_exists(id_db, i) )
+		if( map_blid_available(i) )
 			break;
 
 		++i;
@@ -1724,7 +2122,7 @@ int32 map_get_new_object_id(void)
  * Called each flooritem_lifetime ms
  *------------------------------------------*/
 TIMER_FUNC(map_clearflooritem_timer){
-	struct flooritem_data* fitem = (struct flooritem_data*)idb_get(id_db, id);
+	struct flooritem_data* fitem = (struct flooritem_data*)map_id2bl(id);
 
 	if (fitem == nullptr || fitem->type != BL_ITEM || (fitem->cleartimer != tid)) {
 		ShowError("map_clearflooritem_timer : error\n");
@@ -2232,6 +2630,11 @@ void map_addiddb(struct block_list *bl)
 	if( bl->type & BL_REGEN )
 		idb_put(regen_db, bl->id, bl);
 
+	MapObjectTable* table = map_object_table(bl->id);
+
+	if( table != nullptr )
+		table->insert(bl);
+
 	idb_put(id_db,bl->id,bl);
 }
 
@@ -2257,6 +2660,11 @@ void map_deliddb(struct block_list *bl)
 	if( bl->type & BL_REGEN )
 		idb_remove(regen_db,bl->id);
 
+	MapObjectTable* table = map_object_table(bl->id);
+
+	if( table != nullptr )
+		table->erase(bl);
+
 	idb_remove(id_db,bl->id);
 }
 
@@ -2385,8 +2793,8 @@ map_session_data * map_id2sd(int32 id){
 }
 
 struct mob_data * map_id2md(int32 id){
-	if (id <= 0) return nullptr;
-	return (struct mob_data*)idb_get(mobid_db,id);
+	struct block_list* bl = map_id2bl(id);
+	return BL_CAST(BL_MOB, bl);
 }
 
 struct npc_data * map_id2nd(int32 id){
@@ -2496,9 +2904,14 @@ map_session_data * map_nick2sd(const char *nick, bool allow_partial)
 }
 
 /*==========================================
- * Looksup id_db DBMap and returns BL pointer of 'id' or nullptr if not found
+ * Looksup the object tables or id_db DBMap and returns BL pointer of 'id' or nullptr if not found
  *------------------------------------------*/
 struct block_list * map_id2bl(int32 id) {
+	MapObjectTable* table = map_object_table(id);
+
+	if( table != nullptr )
+		return table->find(id);
+
 	return (struct block_list*)idb_get(id_db,id);
 }
 
@@ -2506,7 +2919,20 @@ struct block_list * map_id2bl(int32 id) {
  * Same as map_id2bl except it only checks for its existence
  **/
 bool map_blid_exists( int32 id ) {
-	return (idb_exists(id_db,id));
+	return map_id2bl(id) != nullptr;
+}
+
+/**
+ * Checks if a new object can use the id without colliding with a live object.
+ * Used by the id allocators.
+ **/
+bool map_blid_available( int32 id ) {
+	MapObjectTable* table = map_object_table(id);
+
+	if( table != nullptr && !table->available(id) )
+		return false;
+
+	return !idb_exists(id_db,id);
 }
 
 /*==========================================
@@ -2854,6 +3280,12 @@ bool map_addnpc(int16 m,struct npc_data *nd)
 		}
 	}
 	mapdata->npc_num++;
+
+	MapObjectTable* table = map_object_table(nd->id);
+
+	if( table != nullptr )
+		table->insert(nd);
+
 	idb_put(id_db,nd->id,nd);
 	return true;
 }
@@ -2905,6 +3337,8 @@ int32 map_addinstancemap(int32 src_m, int32 instance_id, bool no_mapflag)
 	dst_map->ys = src_map->ys;
 	dst_map->bxs = src_map->bxs;
 	dst_map->bys = src_map->bys;
+	dst_map->sxs = src_map->sxs;
+	dst_map->sys = src_map->sys;
 	dst_map->iwall_num = src_map->iwall_num;
 
 	memset(dst_map->npc, 0, sizeof(dst_map->npc));
@@ -2918,10 +3352,25 @@ int32 map_addinstancemap(int32 src_m, int32 instance_id, bool no_mapflag)
 	CREATE( dst_map->cell, struct mapcell, num_cell );
 	memcpy( dst_map->cell, src_map->cell, num_cell * sizeof(struct mapcell) );
 
+	// Share the terrain, unless the source map has its own (changed or not mapped) copy
+	if( src_map->terrain_owned != nullptr ) {
+		CREATE( dst_map->terrain_owned, uint8, num_cell );
+		memcpy( dst_map->terrain_owned, src_map->terrain_owned, num_cell );
+		dst_map->terrain = dst_map->terrain_owned;
+	} else {
+		dst_map->terrain = src_map->terrain;
+		dst_map->terrain_owned = nullptr;
+	}
+
 	size_t size = dst_map->bxs * dst_map->bys * sizeof(struct block_list*);
 
 	dst_map->block = (struct block_list **)aCalloc(1,size);
 	dst_map->block_mob = (struct block_list **)aCalloc(1,size);
+	dst_map->section_count = (int32 *)aCalloc(dst_map->sxs * dst_map->sys * SECTION_TYPES, sizeof(int32));
+#ifdef PACKED_BLOCK_INDEX
+	dst_map->block_packed = (struct map_packed_block **)aCalloc(dst_map->bxs * dst_map->bys, sizeof(struct map_packed_block*));
+	dst_map->block_mob_packed = (struct map_packed_block **)aCalloc(dst_map->bxs * dst_map->bys, sizeof(struct map_packed_block*));
+#endif
 
 	dst_map->index = mapindex_addmap(-1, dst_map->name);
 	dst_map->channel = nullptr;
@@ -3006,12 +3455,25 @@ int32 map_delinstancemap(int32 m)
 	if (mapdata->cell)
 		aFree(mapdata->cell);
 	mapdata->cell = nullptr;
+	if (mapdata->terrain_owned)
+		aFree(mapdata->terrain_owned);
+	mapdata->terrain_owned = nullptr;
+	mapdata->terrain = nullptr;
 	if (mapdata->block)
 		aFree(mapdata->block);
 	mapdata->block = nullptr;
 	if (mapdata->block_mob)
 		aFree(mapdata->block_mob);
 	mapdata->block_mob = nullptr;
+	if (mapdata->section_count)
+		aFree(mapdata->section_count);
+	mapdata->section_count = nullptr;
+#ifdef PACKED_BLOCK_INDEX
+	map_packedblock_free(mapdata->block_packed, mapdata->bxs * mapdata->bys);
+	mapdata->block_packed = nullptr;
+	map_packedblock_free(mapdata->block_mob_packed, mapdata->bxs * mapdata->bys);
+	mapdata->block_mob_packed = nullptr;
+#endif
 
 	map_free_questinfo(mapdata);
 	mapdata->damage_adjust = {};
@@ -3322,38 +3784,64 @@ int32 map_random_dir(struct block_list *bl, int16 *x, int16 *y)
 }
 
 // gat system
-inline static struct mapcell map_gat2cell(int32 gat) {
-	struct mapcell cell;
-
-	memset(&cell,0,sizeof(struct mapcell));
-
+inline static uint8 map_gat2terrain(int32 gat) {
 	switch( gat ) {
-		case 0: cell.walkable = 1; cell.shootable = 1; cell.water = 0; break; // walkable ground
-		case 1: cell.walkable = 0; cell.shootable = 0; cell.water = 0; break; // non-walkable ground
-		case 2: cell.walkable = 1; cell.shootable = 1; cell.water = 0; break; // ???
-		case 3: cell.walkable = 1; cell.shootable = 1; cell.water = 1; break; // walkable water
-		case 4: cell.walkable = 1; cell.shootable = 1; cell.water = 0; break; // ???
-		case 5: cell.walkable = 0; cell.shootable = 1; cell.water = 0; break; // gap (snipable)
-		case 6: cell.walkable = 1; cell.shootable = 1; cell.water = 0; break; // ???
+		case 0: return MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE; // walkable ground
+		case 1: return 0; // non-walkable ground
+		case 2: return MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE; // ???
+		case 3: return MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE|MAP_TERRAIN_WATER; // walkable water
+		case 4: return MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE; // ???
+		case 5: return MAP_TERRAIN_SHOOTABLE; // gap (snipable)
+		case 6: return MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE; // ???
 		default:
-			ShowWarning("map_gat2cell: unrecognized gat type '%d'\n", gat);
-			break;
+			ShowWarning("map_gat2terrain: unrecognized gat type '%d'\n", gat);
+			return 0;
 	}
-
-	return cell;
 }
 
-static int32 map_cell2gat(struct mapcell cell)
+static int32 map_terrain2gat(uint8 terrain)
 {
-	if( cell.walkable == 1 && cell.shootable == 1 && cell.water == 0 ) return 0;
-	if( cell.walkable == 0 && cell.shootable == 0 && cell.water == 0 ) return 1;
-	if( cell.walkable == 1 && cell.shootable == 1 && cell.water == 1 ) return 3;
-	if( cell.walkable == 0 && cell.shootable == 1 && cell.water == 0 ) return 5;
+	switch( terrain ) {
+		case MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE: return 0;
+		case 0: return 1;
+		case MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE|MAP_TERRAIN_WATER: return 3;
+		case MAP_TERRAIN_SHOOTABLE: return 5;
+	}
 
-	ShowWarning("map_cell2gat: cell has no matching gat type\n");
+	ShowWarning("map_terrain2gat: cell has no matching gat type\n");
 	return 1; // default to 'wall'
 }
 
+/// Returns the terrain of a map for modification, a shared terrain is copied first
+static uint8* map_terrain_modify(struct map_data* mapdata)
+{
+	if( mapdata->terrain_owned == nullptr ) {
+		size_t num_cell = mapdata->xs * mapdata->ys;
+
+		CREATE(mapdata->terrain_owned, uint8, num_cell);
+		memcpy(mapdata->terrain_owned, mapdata->terrain, num_cell);
+		mapdata->terrain = mapdata->terrain_owned;
+	}
+
+	mapdata->terrain_version++;
+
+	return mapdata->terrain_owned;
+}
+
+/// Sets or clears a terrain flag of a cell, the terrain is only copied if the flag actually changes
+static void map_terrain_set(struct map_data* mapdata, int32 j, uint8 flag, bool on)
+{
+	if( ( ( mapdata->terrain[j] & flag ) != 0 ) == on )
+		return;
+
+	uint8* terrain = map_terrain_modify(mapdata);
+
+	if( on )
+		terrain[j] |= flag;
+	else
+		terrain[j] &= ~flag;
+}
+
 /*==========================================
  * Confirm if celltype in (m,x,y) match the one given in cellchk
  *------------------------------------------*/
@@ -3368,6 +3856,7 @@ int32 map_getcell(int16 m,int16 x,int16 y,cell_chk cellchk)
 int32 map_getcellp(struct map_data* m,int16 x,int16 y,cell_chk cellchk)
 {
 	struct mapcell cell;
+	uint8 terrain;
 
 	nullpo_ret(m);
 
@@ -3376,22 +3865,23 @@ int32 map_getcellp(struct map_data* m,int16 x,int16 y,cell_chk cellchk)
 		return( cellchk == CELL_CHKNOPASS );
 
 	cell = m->cell[x + y*m->xs];
+	terrain = m->terrain[x + y*m->xs];
 
 	switch(cellchk)
 	{
 		// gat type retrieval
 		case CELL_GETTYPE:
-			return map_cell2gat(cell);
+			return map_terrain2gat(terrain);
 
 		// base gat type checks
 		case CELL_CHKWALL:
-			return (!cell.walkable && !cell.shootable);
+			return !(terrain&(MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE));
 
 		case CELL_CHKWATER:
-			return (cell.water);
+			return (terrain&MAP_TERRAIN_WATER) != 0;
 
 		case CELL_CHKCLIFF:
-			return (!cell.walkable && cell.shootable);
+			return (terrain&(MAP_TERRAIN_WALKABLE|MAP_TERRAIN_SHOOTABLE)) == MAP_TERRAIN_SHOOTABLE;
 
 
 		// base cell type checks
@@ -3418,14 +3908,14 @@ int32 map_getcellp(struct map_data* m,int16 x,int16 y,cell_chk cellchk)
 			if (cell.cell_bl >= battle_config.custom_cell_stack_limit) return 0;
 #endif
 		case CELL_CHKREACH:
-			return (cell.walkable);
+			return (terrain&MAP_TERRAIN_WALKABLE) != 0;
 
 		case CELL_CHKNOPASS:
 #ifdef CELL_NOSTACK
 			if (cell.cell_bl >= battle_config.custom_cell_stack_limit) return 1;
 #endif
 		case CELL_CHKNOREACH:
-			return (!cell.walkable);
+			return !(terrain&MAP_TERRAIN_WALKABLE);
 
 		case CELL_CHKSTACK:
 #ifdef CELL_NOSTACK
@@ -3455,9 +3945,9 @@ void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 	j = x + y*mapdata->xs;
 
 	switch( cell ) {
-		case CELL_WALKABLE:      mapdata->cell[j].walkable = flag;      break;
-		case CELL_SHOOTABLE:     mapdata->cell[j].shootable = flag;     break;
-		case CELL_WATER:         mapdata->cell[j].water = flag;         break;
+		case CELL_WALKABLE:      map_terrain_set(mapdata, j, MAP_TERRAIN_WALKABLE, flag);  break;
+		case CELL_SHOOTABLE:     map_terrain_set(mapdata, j, MAP_TERRAIN_SHOOTABLE, flag); break;
+		case CELL_WATER:         map_terrain_set(mapdata, j, MAP_TERRAIN_WATER, flag);     break;
 
 		case CELL_NPC:           mapdata->cell[j].npc = flag;           break;
 		case CELL_BASILICA:      mapdata->cell[j].basilica = flag;      break;
@@ -3476,7 +3966,7 @@ void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 void map_setgatcell(int16 m, int16 x, int16 y, int32 gat)
 {
 	int32 j;
-	struct mapcell cell;
+	uint8 terrain;
 	struct map_data *mapdata = map_getmapdata(m);
 
 	if( m < 0 || x < 0 || x >= mapdata->xs || y < 0 || y >= mapdata->ys )
@@ -3484,10 +3974,9 @@ void map_setgatcell(int16 m, int16 x, int16 y, int32 gat)
 
 	j = x + y*mapdata->xs;
 
-	cell = map_gat2cell(gat);
-	mapdata->cell[j].walkable = cell.walkable;
-	mapdata->cell[j].shootable = cell.shootable;
-	mapdata->cell[j].water = cell.water;
+	terrain = map_gat2terrain(gat);
+	if( mapdata->terrain[j] != terrain )
+		map_terrain_modify(mapdata)[j] = terrain;
 }
 
 /*==========================================
@@ -3714,51 +4203,142 @@ static char *map_init_mapcache(FILE *fp)
  * Map cache reading
  * [Shinryo]: Optimized some behaviour to speed this up
  *==========================================*/
-int32 map_readfromcache(struct map_data *m, char *buffer, char *decode_buffer)
+/// Adds all maps of a map cache to the lookup index, maps that are already indexed (from a previous cache) are kept
+static void map_indexcache(std::unordered_map<std::string, struct map_cache_entry>& index, char *buffer)
 {
-	int32 i;
 	struct map_cache_main_header *header = (struct map_cache_main_header *)buffer;
-	struct map_cache_map_info *info = nullptr;
 	char *p = buffer + sizeof(struct map_cache_main_header);
 
-	for(i = 0; i < header->map_count; i++) {
-		info = (struct map_cache_map_info *)p;
+	for( int32 i = 0; i < header->map_count; i++ ) {
+		struct map_cache_map_info *info = (struct map_cache_map_info *)p;
 
-		if( strcmp(m->name, info->name) == 0 )
-			break; // Map found
+		index.emplace(info->name, map_cache_entry{ info, nullptr, info->xs, info->ys });
 
 		// Jump to next entry..
 		p += sizeof(struct map_cache_map_info) + info->len;
 	}
+}
 
-	if( info && i < header->map_count ) {
-		unsigned long size, xy;
+/// Maps an uncompressed map cache read-only into memory, so its pages are shared by all map-servers,
+/// and adds its maps to the lookup index.
+/// Returns false if the file does not exist or is invalid.
+static bool map_init_mapcache_raw(const char* filename, std::unordered_map<std::string, struct map_cache_entry>& index)
+{
+	char* data;
+	size_t size;
 
-		if( info->xs <= 0 || info->ys <= 0 )
-			return 0;// Invalid
+#ifndef _WIN32
+	int32 fd = open(filename, O_RDONLY);
+	struct stat st;
 
-		m->xs = info->xs;
-		m->ys = info->ys;
-		size = (unsigned long)info->xs*(unsigned long)info->ys;
+	if( fd < 0 )
+		return false;
 
-		if(size > MAX_MAP_SIZE) {
-			ShowWarning("map_readfromcache: %s exceeded MAX_MAP_SIZE of %d\n", info->name, MAX_MAP_SIZE);
-			return 0; // Say not found to remove it from list.. [Shinryo]
+	if( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct map_cache_raw_header) ) {
+		close(fd);
+		ShowError("map_init_mapcache_raw: Invalid map cache file %s\n", filename);
+		return false;
+	}
+
+	size = (size_t)st.st_size;
+	data = (char*)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if( data == MAP_FAILED ) {
+		ShowError("map_init_mapcache_raw: Could not map %s (%s)\n", filename, strerror(errno));
+		return false;
+	}
+#else
+	// No shared mapping here, just read the file
+	FILE* fp = fopen(filename, "rb");
+
+	if( fp == nullptr )
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	CREATE(data, char, size);
+
+	if( size < sizeof(struct map_cache_raw_header) || fread(data, 1, size, fp) != size ) {
+		fclose(fp);
+		aFree(data);
+		ShowError("map_init_mapcache_raw: Could not read entire map cache file %s\n", filename);
+		return false;
+	}
+
+	fclose(fp);
+#endif
+
+	map_cache_raw.emplace_back(data, size);
+
+	struct map_cache_raw_header *header = (struct map_cache_raw_header *)data;
+
+	if( memcmp(header->magic, MAP_CACHE_RAW_MAGIC, sizeof(header->magic)) != 0 || header->version != MAP_CACHE_RAW_VERSION
+		|| header->index_offset > size || ( size - header->index_offset ) / sizeof(struct map_cache_raw_info) < header->map_count ) {
+		ShowError("map_init_mapcache_raw: %s is not a valid uncompressed map cache (version %d)\n", filename, MAP_CACHE_RAW_VERSION);
+		return false;
+	}
+
+	struct map_cache_raw_info *info = (struct map_cache_raw_info *)( data + header->index_offset );
+
+	for( uint32 i = 0; i < header->map_count; i++, info++ ) {
+		if( info->offset > size || size - info->offset < (size_t)info->xs * (size_t)info->ys ) {
+			ShowError("map_init_mapcache_raw: %s has an invalid entry for map %.*s\n", filename, MAP_NAME_LENGTH, info->name);
+			continue;
 		}
 
-		// TO-DO: Maybe handle the scenario, if the decoded buffer isn't the same size as expected? [Shinryo]
-		decode_zip(decode_buffer, &size, p+sizeof(struct map_cache_map_info), info->len);
+		index.emplace(std::string(info->name, strnlen(info->name, MAP_NAME_LENGTH)), map_cache_entry{ nullptr, (const uint8*)( data + info->offset ), info->xs, info->ys });
+	}
+
+	return true;
+}
 
-		CREATE(m->cell, struct mapcell, size);
+/// Unmaps all uncompressed map caches
+static void map_final_mapcache_raw(void)
+{
+	for( auto& file : map_cache_raw ) {
+#ifndef _WIN32
+		munmap(file.first, file.second);
+#else
+		aFree(file.first);
+#endif
+	}
 
+	map_cache_raw.clear();
+}
 
-		for( xy = 0; xy < size; ++xy )
-			m->cell[xy] = map_gat2cell(decode_buffer[xy]);
+/// Checks the map cache entry of a map and sets up the map dimensions
+static bool map_checkcache(struct map_data *m, const char *name, struct map_cache_entry *entry)
+{
+	unsigned long size;
 
-		return 1;
+	if( entry->xs <= 0 || entry->ys <= 0 )
+		return false;// Invalid
+
+	m->xs = entry->xs;
+	m->ys = entry->ys;
+	size = (unsigned long)entry->xs*(unsigned long)entry->ys;
+
+	if(size > MAX_MAP_SIZE) {
+		ShowWarning("map_readfromcache: %s exceeded MAX_MAP_SIZE of %d\n", name, MAX_MAP_SIZE);
+		return false; // Say not found to remove it from list.. [Shinryo]
 	}
 
-	return 0; // Not found
+	return true;
+}
+
+/// Decodes the cells of a map from its compressed map cache entry into the already allocated terrain.
+/// Called from the map loading threads, so it must not use the memory manager.
+static void map_readfromcache(struct map_data *m, struct map_cache_map_info *info, char *decode_buffer)
+{
+	unsigned long size = (unsigned long)info->xs*(unsigned long)info->ys;
+
+	// TO-DO: Maybe handle the scenario, if the decoded buffer isn't the same size as expected? [Shinryo]
+	decode_zip(decode_buffer, &size, (char *)info + sizeof(struct map_cache_map_info), info->len);
+
+	for( unsigned long xy = 0; xy < size; ++xy )
+		m->terrain_owned[xy] = map_gat2terrain(decode_buffer[xy]);
 }
 
 int32 map_addmap(char* mapname)
@@ -3915,6 +4495,8 @@ int32 map_readgat (struct map_data* m)
 	m->ys = *(int32*)(gat+10);
 	num_cells = m->xs * m->ys;
 	CREATE(m->cell, struct mapcell, num_cells);
+	CREATE(m->terrain_owned, uint8, num_cells);
+	m->terrain = m->terrain_owned;
 
 	water_height = map_waterheight(m->name);
 
@@ -3930,7 +4512,7 @@ int32 map_readgat (struct map_data* m)
 		if( type == 0 && water_height != RSW_NO_WATER && height > water_height )
 			type = 3; // Cell is 0 (walkable) but under water level, set to 3 (walkable water)
 
-		m->cell[xy] = map_gat2cell(type);
+		m->terrain_owned[xy] = map_gat2terrain(type);
 	}
 
 	aFree(gat);
@@ -3959,25 +4541,38 @@ int32 map_readallmaps (void)
 	FILE* fp;
 	// Has the uncompressed gat data of all maps, so just one allocation has to be made
 	std::vector<char *> map_cache_buffer = {};
+	// Map cache entries by map name
+	std::unordered_map<std::string, struct map_cache_entry> map_cache_index;
+	t_tick tick_start = gettick_nocache();
 
 	if( enable_grf )
 		ShowStatus("Loading maps (using GRF files)...\n");
 	else {
 		// Load the map cache files in reverse order to account for import
-		const std::vector<std::string> mapcachefilepath = {
-			"db/" DBIMPORT "/map_cache.dat",
-			"db/" DBPATH "map_cache.dat",
-			"db/map_cache.dat",
+		const std::vector<std::string> mapcachepath = {
+			"db/" DBIMPORT "/",
+			"db/" DBPATH,
+			"db/",
 		};
 
-		for(const auto &mapdat : mapcachefilepath) {
-			ShowStatus( "Loading maps (using %s as map cache)...\n", mapdat.c_str() );
+		for(const auto &path : mapcachepath) {
+			std::string mapraw = path + "map_cache_raw.dat";
+			std::string mapdat = path + "map_cache.dat";
+
+			// The uncompressed map cache takes precedence over the compressed one next to it
+			bool raw = map_init_mapcache_raw(mapraw.c_str(), map_cache_index);
+
+			if( raw )
+				ShowStatus( "Loading maps (using %s as map cache)...\n", mapraw.c_str() );
 
 			if( ( fp = fopen(mapdat.c_str(), "rb")) == nullptr) {
-				ShowFatalError( "Unable to open map cache file " CL_WHITE "%s" CL_RESET "\n", mapdat.c_str());
+				if( !raw )
+					ShowFatalError( "Unable to open map cache file " CL_WHITE "%s" CL_RESET "\n", mapdat.c_str());
 				continue;
 			}
 
+			ShowStatus( "Loading maps (using %s as map cache)...\n", mapdat.c_str() );
+
 			// Init mapcache data. [Shinryo]
 			map_cache_buffer.push_back(map_init_mapcache(fp));
 
@@ -3987,19 +4582,25 @@ int32 map_readallmaps (void)
 			}
 
 			fclose(fp);
+
+			map_indexcache(map_cache_index, map_cache_buffer.back());
 		}
 	}
 
 	int32 maps_removed = 0;
+	// Map cache entry of each loaded map, in the same order as map[]
+	std::vector<struct map_cache_map_info*> map_cache_info; // compressed entries only
+	t_tick tick_read = gettick_nocache();
 
 	ShowStatus("Loading %d maps.\n", map_num);
 
+	// Check the maps, register them and allocate their data in order
 	for (int32 i = 0; i < map_num; i++) {
 		size_t size;
 		bool success = false;
 		uint16 idx = 0;
 		struct map_data *mapdata = &map[i];
-		char map_cache_decode_buffer[MAX_MAP_SIZE];
+		struct map_cache_map_info *info = nullptr;
 
 #ifdef DETAILED_LOADING_OUTPUT
 		// show progress
@@ -4010,10 +4611,12 @@ int32 map_readallmaps (void)
 			// try to load the map
 			success = map_readgat(mapdata) != 0;
 		}else{
-			// try to load the map
-			for (const auto &cache : map_cache_buffer) {
-				if ((success = map_readfromcache(mapdata, cache, map_cache_decode_buffer)) != 0)
-					break;
+			// try to find the map, compressed cells are decoded afterwards
+			auto found = map_cache_index.find(mapdata->name);
+
+			if (found != map_cache_index.end() && (success = map_checkcache(mapdata, found->first.c_str(), &found->second))) {
+				info = found->second.info;
+				mapdata->terrain = found->second.terrain;
 			}
 		}
 
@@ -4033,6 +4636,11 @@ int32 map_readallmaps (void)
 				aFree(mapdata->cell);
 				mapdata->cell = nullptr;
 			}
+			if (mapdata->terrain_owned) {
+				aFree(mapdata->terrain_owned);
+				mapdata->terrain_owned = nullptr;
+			}
+			mapdata->terrain = nullptr;
 			map_delmapid(i);
 			maps_removed++;
 			i--;
@@ -4047,16 +4655,63 @@ int32 map_readallmaps (void)
 
 		mapdata->bxs = (mapdata->xs + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		mapdata->bys = (mapdata->ys + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		mapdata->sxs = (mapdata->bxs + BLOCK_SECTION - 1) / BLOCK_SECTION;
+		mapdata->sys = (mapdata->bys + BLOCK_SECTION - 1) / BLOCK_SECTION;
+
+		// The memory manager is not thread safe, so everything is allocated here and filled by the loading threads
+		if (!enable_grf)
+			mapdata->cell = (struct mapcell*)aMalloc(mapdata->xs * mapdata->ys * sizeof(struct mapcell));
+		if (info != nullptr) {
+			mapdata->terrain_owned = (uint8*)aMalloc(mapdata->xs * mapdata->ys);
+			mapdata->terrain = mapdata->terrain_owned;
+		}
+		map_cache_info.push_back(info);
 
 		size = mapdata->bxs * mapdata->bys * sizeof(struct block_list*);
-		mapdata->block = (struct block_list**)aCalloc(size, 1);
-		mapdata->block_mob = (struct block_list**)aCalloc(size, 1);
+		mapdata->block = (struct block_list**)aMalloc(size);
+		mapdata->block_mob = (struct block_list**)aMalloc(size);
+		mapdata->section_count = (int32*)aCalloc(mapdata->sxs * mapdata->sys * SECTION_TYPES, sizeof(int32));
+#ifdef PACKED_BLOCK_INDEX
+		mapdata->block_packed = (struct map_packed_block**)aCalloc(mapdata->bxs * mapdata->bys, sizeof(struct map_packed_block*));
+		mapdata->block_mob_packed = (struct map_packed_block**)aCalloc(mapdata->bxs * mapdata->bys, sizeof(struct map_packed_block*));
+#endif
 
 		memset(&mapdata->save, 0, sizeof(struct point));
 		mapdata->damage_adjust = {};
 		mapdata->channel = nullptr;
 	}
 
+	t_tick tick_check = gettick_nocache();
+
+	// Decode the cells and clear the cell and block arrays of all maps in parallel
+	std::atomic<int32> next_map(0);
+	int32 threads = i32max(1, i32min((int32)std::thread::hardware_concurrency(), map_num));
+	auto map_loader = [&next_map, &map_cache_info]() {
+		std::vector<char> decode_buffer(MAX_MAP_SIZE);
+
+		for (int32 i = next_map++; i < map_num; i = next_map++) {
+			struct map_data *mapdata = &map[i];
+			size_t size = mapdata->bxs * mapdata->bys * sizeof(struct block_list*);
+
+			if (map_cache_info[i] != nullptr)
+				map_readfromcache(mapdata, map_cache_info[i], decode_buffer.data());
+			if (!enable_grf)
+				memset(mapdata->cell, 0, mapdata->xs * mapdata->ys * sizeof(struct mapcell));
+
+			memset(mapdata->block, 0, size);
+			memset(mapdata->block_mob, 0, size);
+		}
+	};
+	std::vector<std::thread> loaders;
+
+	for (int32 i = 1; i < threads; i++)
+		loaders.emplace_back(map_loader);
+	map_loader(); // the main thread helps as well
+	for (auto &loader : loaders)
+		loader.join();
+
+	t_tick tick_decode = gettick_nocache();
+
 	// intialization and configuration-dependent adjustments of mapflags
 	map_flags_init();
 
@@ -4075,6 +4730,8 @@ int32 map_readallmaps (void)
 
 	// finished map loading
 	ShowInfo("Successfully loaded '" CL_WHITE "%d" CL_RESET "' maps." CL_CLL "\n",map_num);
+	ShowInfo("Map loading took %" PRtf " ms (reading: %" PRtf " ms, checking: %" PRtf " ms, decoding: %" PRtf " ms with %d threads, mapflags: %" PRtf " ms).\n",
+		DIFF_TICK(gettick_nocache(), tick_start), DIFF_TICK(tick_read, tick_start), DIFF_TICK(tick_check, tick_read), DIFF_TICK(tick_decode, tick_check), threads, DIFF_TICK(gettick_nocache(), tick_decode));
 
 	return 0;
 }
@@ -4143,12 +4800,24 @@ int32 parse_console(const char* buf){
 	else if( strcmpi("ers_report", type) == 0 ){
 		ers_report();
 	}
+	else if( strcmpi("log_report", type) == 0 ){
+		log_sql_writer_report();
+	}
+	else if( strcmpi("broadcast_report", type) == 0 ){
+		wfifo_shared_report();
+	}
+	else if( strcmpi("profiler", type) == 0 ){
+		profiler_console(command);
+	}
 	else if( strcmpi("help", type) == 0 ) {
 		ShowInfo("Available commands:\n");
 		ShowInfo("\t admin:@<atcommand> => Uses an atcommand. Do NOT use commands requiring an attached player.\n");
 		ShowInfo("\t admin:map:<map> <x> <y> => Changes the map from which console commands are executed.\n");
 		ShowInfo("\t server:shutdown => Stops the server.\n");
 		ShowInfo("\t ers_report => Displays database usage.\n");
+		ShowInfo("\t log_report => Displays SQL log writer statistics.\n");
+		ShowInfo("\t broadcast_report => Displays how much data of shared packets was copied.\n");
+		ShowInfo("\t profiler:<on|off|reset|show|latency|dump> => Controls the timer and packet handler profiler.\n");
 	}
 
 	return 0;
@@ -4479,6 +5148,7 @@ int32 map_sql_close(void)
 	if (log_config.sql_logs)
 	{
 		ShowStatus("Close Log DB Connection....\n");
+		log_sql_writer_stop();
 		Sql_Free(logmysql_handle);
 		logmysql_handle = nullptr;
 	}
@@ -4486,9 +5156,10 @@ int32 map_sql_close(void)
 	return 0;
 }
 
-int32 log_sql_init(void)
+/// Opens the connection to the log database.
+/// @return false if the connection failed
+static bool log_sql_connect(void)
 {
-	// log db connection
 	logmysql_handle = Sql_Malloc();
 
 	ShowInfo("" CL_WHITE "[SQL]" CL_RESET ": Connecting to the Log Database " CL_WHITE "%s" CL_RESET " At " CL_WHITE "%s" CL_RESET "...\n",log_db_db.c_str(), log_db_ip.c_str());
@@ -4497,7 +5168,8 @@ int32 log_sql_init(void)
 			log_db_id.c_str(), log_db_ip.c_str(), log_db_port, log_db_db.c_str());
 		Sql_ShowDebug(logmysql_handle);
 		Sql_Free(logmysql_handle);
-		exit(EXIT_FAILURE);
+		logmysql_handle = nullptr;
+		return false;
 	}
 	ShowStatus("" CL_WHITE "[SQL]" CL_RESET ": Successfully '" CL_GREEN "connected" CL_RESET "' to Database '" CL_WHITE "%s" CL_RESET "'.\n", log_db_db.c_str());
 
@@ -4505,9 +5177,72 @@ int32 log_sql_init(void)
 		if ( SQL_ERROR == Sql_SetEncoding(logmysql_handle, default_codepage.c_str()) )
 			Sql_ShowDebug(logmysql_handle);
 
+	return true;
+}
+
+/// Starts the log writer thread with a second connection, if SQL logs are written asynchronously.
+static void log_sql_writer_connect(void)
+{
+	if( !log_config.sql_async )
+		return;
+
+	// second connection, exclusively used by the log writer thread
+	Sql* writer_handle = Sql_Malloc();
+
+	if( SQL_ERROR == Sql_Connect(writer_handle, log_db_id.c_str(), log_db_pw.c_str(), log_db_ip.c_str(), log_db_port, log_db_db.c_str()) ){
+		ShowWarning("Couldn't open the log writer connection, SQL logs will be written synchronously.\n");
+		Sql_ShowDebug(writer_handle);
+		Sql_Free(writer_handle);
+		return;
+	}
+
+	if( !default_codepage.empty() )
+		if ( SQL_ERROR == Sql_SetEncoding(writer_handle, default_codepage.c_str()) )
+			Sql_ShowDebug(writer_handle);
+
+	log_sql_writer_start(writer_handle);
+}
+
+int32 log_sql_init(void)
+{
+	// log db connection
+	if( !log_sql_connect() )
+		exit(EXIT_FAILURE);
+
+	log_sql_writer_connect();
+
 	return 0;
 }
 
+/// Reloads the log configuration.
+/// The log writer thread reads the table names and batch settings, so it is stopped while they are read again.
+/// Stopping it writes its queue with the old settings. Afterwards the log database connections are opened,
+/// closed or restarted to match the new configuration.
+void map_reloadlogconf(void)
+{
+	bool sql_logs = log_config.sql_logs;
+
+	log_sql_writer_stop();
+	log_config_read(LOG_CONF_NAME);
+
+	if( sql_logs && !log_config.sql_logs ){
+		ShowStatus("Close Log DB Connection....\n");
+		Sql_Free(logmysql_handle);
+		logmysql_handle = nullptr;
+		return;
+	}
+
+	if( !sql_logs && log_config.sql_logs && !log_sql_connect() ){
+		ShowWarning("SQL logs could not be enabled, logs are still written to files.\n");
+		log_config.sql_logs = false;
+		log_file_timer_update();
+		return;
+	}
+
+	if( log_config.sql_logs )
+		log_sql_writer_connect();
+}
+
 void map_remove_questinfo(int32 m, struct npc_data *nd) {
 	struct map_data *mapdata = map_getmapdata(m);
 
@@ -5127,6 +5862,7 @@ void MapServer::finalize(){
 	do_final_path();
 	do_final_emotions();
 	do_final_rune();
+	do_final_log();
 
 	map_db->destroy(map_db, map_db_final);
 
@@ -5134,8 +5870,14 @@ void MapServer::finalize(){
 		struct map_data *mapdata = map_getmapdata(i);
 
 		if(mapdata->cell) aFree(mapdata->cell);
+		if(mapdata->terrain_owned) aFree(mapdata->terrain_owned);
 		if(mapdata->block) aFree(mapdata->block);
 		if(mapdata->block_mob) aFree(mapdata->block_mob);
+		if(mapdata->section_count) aFree(mapdata->section_count);
+#ifdef PACKED_BLOCK_INDEX
+		map_packedblock_free(mapdata->block_packed, mapdata->bxs * mapdata->bys);
+		map_packedblock_free(mapdata->block_mob_packed, mapdata->bxs * mapdata->bys);
+#endif
 		if(battle_config.dynamic_mobs) { //Dynamic mobs flag by [random]
 			if(mapdata->mob_delete_timer != INVALID_TIMER)
 				delete_timer(mapdata->mob_delete_timer, map_removemobs_timer);
@@ -5145,11 +5887,14 @@ void MapServer::finalize(){
 		mapdata->damage_adjust = {};
 	}
 
+	map_final_mapcache_raw();
 	mapindex_final();
 	if(enable_grf)
 		grfio_final();
 
 	id_db->destroy(id_db, nullptr);
+	npc_id_table.clear();
+	object_id_table.clear();
 	pc_db->destroy(pc_db, nullptr);
 	mobid_db->destroy(mobid_db, nullptr);
 	bossid_db->destroy(bossid_db, nullptr);
@@ -5452,13 +6197,13 @@ bool MapServer::initialize( int32 argc, char *argv[] ){
 	inter_config_read(INTER_CONF_NAME);
 	log_config_read(LOG_CONF_NAME);
 
-	id_db = idb_alloc(DB_OPT_BASE);
-	pc_db = idb_alloc(DB_OPT_BASE);	//Added for reliable map_id2sd() use. [Skotlex]
-	mobid_db = idb_alloc(DB_OPT_BASE);	//Added to lower the load of the lazy mob ai. [Skotlex]
+	id_db = idb_alloc(DB_OPT_HASH_INDEX);
+	pc_db = idb_alloc(DB_OPT_HASH_INDEX);	//Added for reliable map_id2sd() use. [Skotlex]
+	mobid_db = idb_alloc(DB_OPT_HASH_INDEX);	//Added to lower the load of the lazy mob ai. [Skotlex]
 	bossid_db = idb_alloc(DB_OPT_BASE); // Used for Convex Mirror quick MVP search
 	map_db = uidb_alloc(DB_OPT_BASE);
 	nick_db = idb_alloc(DB_OPT_BASE);
-	charid_db = uidb_alloc(DB_OPT_BASE);
+	charid_db = uidb_alloc(DB_OPT_HASH_INDEX);
 	regen_db = idb_alloc(DB_OPT_BASE); // efficient status_natural_heal processing
 	iwall_db = strdb_alloc(DB_OPT_RELEASE_DATA,2*NAME_LENGTH+2+1); // [Zephyrus] Invisible Walls
 
@@ -5518,6 +6263,7 @@ bool MapServer::initialize( int32 argc, char *argv[] ){
 	do_init_buyingstore();
 	do_init_emotions();
 	do_init_rune();
+	do_init_log();
 
 // (^~_~^) Color Nicks Start
 
@@ -793,15 +793,16 @@ enum cell_chk : uint8 {
 
 };
 
+/// Terrain flags of a cell, as stored in the uncompressed map cache
+enum e_map_terrain : uint8 {
+	MAP_TERRAIN_WALKABLE = 0x1,
+	MAP_TERRAIN_SHOOTABLE = 0x2,
+	MAP_TERRAIN_WATER = 0x4,
+};
+
+/// Dynamic flags of a cell, the terrain is kept separately in map_data::terrain
 struct mapcell
 {
-	// terrain flags
-	unsigned char
-		walkable : 1,
-		shootable : 1,
-		water : 1;
-
-	// dynamic flags
 	unsigned char
 		npc : 1,
 		basilica : 1,
@@ -824,15 +825,35 @@ struct iwall_data {
 	bool shootable;
 };
 
+#ifdef PACKED_BLOCK_INDEX
+/// Packed copy of the objects in a block, with one array per field so area checks don't have to follow the block_list chain.
+/// Objects are stored from oldest to newest.
+struct map_packed_block {
+	int32 count, max;
+	struct block_list **bl;
+	int16 *x, *y;
+	uint16 *type;
+};
+#endif
+
 struct map_data {
 	char name[MAP_NAME_LENGTH];
 	uint16 index; // The map index used by the mapindex* functions.
-	struct mapcell* cell; // Holds the information of each map cell (nullptr if the map is not on this map-server).
+	struct mapcell* cell; // Holds the dynamic flags of each map cell (nullptr if the map is not on this map-server).
+	const uint8* terrain; // Terrain flags of each map cell (e_map_terrain), may point into the mapped map cache or be shared with the source map
+	uint8* terrain_owned; // Terrain allocated by this map (nullptr while the terrain is shared), only this one may be modified
+	uint32 terrain_version; // Increased on every runtime change of the terrain
 	struct block_list **block;
 	struct block_list **block_mob;
+	int32 *section_count; // Number of objects placed in each section, one counter per bit of bl_type
+#ifdef PACKED_BLOCK_INDEX
+	struct map_packed_block **block_packed; // same layout as block and allocated together with it, each entry is allocated when its block gets the first object
+	struct map_packed_block **block_mob_packed; // same layout as block_mob and allocated together with it, each entry is allocated when its block gets the first mob
+#endif
 	int16 m;
 	int16 xs,ys; // map dimensions (in cells)
 	int16 bxs,bys; // map dimensions (in blocks)
+	int16 sxs,sys; // map dimensions (in sections of blocks, see map_hasblock)
 	int16 bgscore_lion, bgscore_eagle; // Battleground ScoreBoard
 	int32 npc_num; // number total of npc on the map
 	int32 npc_num_area; // number of npc with a trigger area on the map
@@ -1136,6 +1157,8 @@ int32 map_freeblock_unlock(void);
 // blocklist manipulation
 int32 map_addblock(struct block_list* bl);
 int32 map_delblock(struct block_list* bl);
+bool map_hasblock(int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int32 type);
+void map_getallinrange(std::vector<struct block_list*>& list, struct block_list* center, int16 range, int32 type);
 int32 map_moveblock(struct block_list *, int32, int32, t_tick);
 int32 map_foreachinrange(int32 (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int32 type, ...);
 int32 map_foreachinallrange(int32 (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int32 type, ...);
@@ -1192,6 +1215,7 @@ struct s_elemental_data* map_id2ed(int32 id);
 struct chat_data* map_id2cd(int32 id);
 struct block_list * map_id2bl(int32 id);
 bool map_blid_exists( int32 id );
+bool map_blid_available( int32 id );
 
 #define map_id2index(id) map[(id)].index
 const char* map_mapid2mapname(int32 m);
@@ -1214,6 +1238,7 @@ struct mob_data * map_id2boss(int32 id);
 
 // reload config file looking only for npcs
 void map_reloadnpc(bool clear);
+void map_reloadlogconf(void);
 
 void map_remove_questinfo(int32 m, struct npc_data *nd);
 
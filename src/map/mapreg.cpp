@@ -4,6 +4,8 @@
 #include "mapreg.hpp"
 
 #include <cstdlib>
+#include <string>
+#include <unordered_set>
 
 #include <common/cbasetypes.hpp>
 #include <common/db.hpp>
@@ -23,9 +25,115 @@ bool skip_insert = false;
 
 static char mapreg_table[32] = "mapreg";
 static bool mapreg_dirty = false; // Whether there are modified regs to be saved
+static std::unordered_set<int64> mapreg_deleted; // Permanent variables removed since the last save
 struct reg_db regs;
 
-#define MAPREG_AUTOSAVE_INTERVAL (300*1000)
+static uint32 mapreg_autosave_interval = 300 * 1000;
+static char mapreg_journal_file[256] = ""; // Empty if the journal is disabled
+static FILE* mapreg_journal = nullptr;
+
+// Maximum amount of rows per statement when saving
+#define MAPREG_SAVE_BATCH 500
+
+/**
+ * Escapes tabs, line breaks and backslashes for the journal file.
+ * @param out: output buffer
+ * @param str: string to escape
+ */
+static void mapreg_journal_escape(std::string& out, const char* str)
+{
+	for (; *str != '\0'; str++) {
+		switch (*str) {
+			case '\\': out += "\\\\"; break;
+			case '\t': out += "\\t"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			default: out += *str; break;
+		}
+	}
+}
+
+/**
+ * Reverts mapreg_journal_escape in place.
+ * @param str: string to unescape
+ */
+static void mapreg_journal_unescape(char* str)
+{
+	char* out = str;
+
+	for (; *str != '\0'; str++) {
+		if (*str == '\\' && str[1] != '\0') {
+			switch (*++str) {
+				case 't': *out++ = '\t'; break;
+				case 'n': *out++ = '\n'; break;
+				case 'r': *out++ = '\r'; break;
+				default: *out++ = *str; break;
+			}
+		} else
+			*out++ = *str;
+	}
+	*out = '\0';
+}
+
+/**
+ * Appends a modification of a permanent variable to the journal file.
+ * Each line is either "S<tab>varname<tab>index<tab>value" or "D<tab>varname<tab>index".
+ * @param name: variable name
+ * @param index: array index
+ * @param value: new value or nullptr if the variable was removed
+ */
+static void mapreg_journal_write(const char* name, uint32 index, const char* value)
+{
+	if (mapreg_journal == nullptr)
+		return;
+
+	std::string line = value != nullptr ? "S\t" : "D\t";
+
+	mapreg_journal_escape(line, name);
+	line += '\t';
+	line += std::to_string(index);
+	if (value != nullptr) {
+		line += '\t';
+		mapreg_journal_escape(line, value);
+	}
+	line += '\n';
+
+	fputs(line.c_str(), mapreg_journal);
+	fflush(mapreg_journal); // survive a crash of the map-server
+}
+
+/**
+ * Marks a permanent variable as modified, so it is written on the next save.
+ * @param m: variable
+ * @param name: variable name
+ * @param index: array index
+ */
+static void mapreg_mark_save(struct mapreg_save* m, const char* name, uint32 index)
+{
+	m->save = true;
+	mapreg_dirty = true;
+	mapreg_deleted.erase(m->uid);
+
+	if (mapreg_journal != nullptr) {
+		if (m->is_string)
+			mapreg_journal_write(name, index, m->u.str);
+		else
+			mapreg_journal_write(name, index, std::to_string(m->u.i).c_str());
+	}
+}
+
+/**
+ * Marks a permanent variable as removed, so it is deleted on the next save.
+ * @param uid: variable's unique identifier
+ * @param name: variable name
+ * @param index: array index
+ */
+static void mapreg_mark_delete(int64 uid, const char* name, uint32 index)
+{
+	mapreg_deleted.insert(uid);
+	mapreg_dirty = true;
+	mapreg_journal_write(name, index, nullptr);
+}
 
 
 /**
@@ -69,10 +177,8 @@ bool mapreg_setreg(int64 uid, int64 val)
 	if (val != 0) {
 		if ((m = static_cast<mapreg_save *>(i64db_get(regs.vars, uid)))) {
 			m->u.i = val;
-			if (name[1] != '@') {
-				m->save = true;
-				mapreg_dirty = true;
-			}
+			if (name[1] != '@')
+				mapreg_mark_save(m, name, i);
 		} else {
 			if (i)
 				script_array_update(&regs, uid, false);
@@ -84,12 +190,8 @@ bool mapreg_setreg(int64 uid, int64 val)
 			m->save = false;
 			m->is_string = false;
 
-			if (name[1] != '@' && !skip_insert) {// write new variable to database
-				char esc_name[32 * 2 + 1];
-				Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-				if (SQL_ERROR == Sql_Query(mmysql_handle, "INSERT INTO `%s`(`varname`,`index`,`value`) VALUES ('%s','%" PRIu32 "','%" PRId64 "')", mapreg_table, esc_name, i, val))
-					Sql_ShowDebug(mmysql_handle);
-			}
+			if (name[1] != '@' && !skip_insert) // write new variable to database on the next save
+				mapreg_mark_save(m, name, i);
 			i64db_put(regs.vars, uid, m);
 		}
 	} else { // val == 0
@@ -100,12 +202,8 @@ bool mapreg_setreg(int64 uid, int64 val)
 		}
 		i64db_remove(regs.vars, uid);
 
-		if (name[1] != '@') {// Remove from database because it is unused.
-			char esc_name[32 * 2 + 1];
-			Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-			if (SQL_ERROR == Sql_Query(mmysql_handle, "DELETE FROM `%s` WHERE `varname`='%s' AND `index`='%" PRIu32 "'", mapreg_table, esc_name, i))
-				Sql_ShowDebug(mmysql_handle);
-		}
+		if (name[1] != '@') // Remove from database on the next save because it is unused.
+			mapreg_mark_delete(uid, name, i);
 	}
 
 	return true;
@@ -128,12 +226,8 @@ bool mapreg_setregstr(int64 uid, const char* str)
 	if (str == nullptr || *str == 0) {
 		if (i)
 			script_array_update(&regs, uid, true);
-		if (name[1] != '@') {
-			char esc_name[32 * 2 + 1];
-			Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-			if (SQL_ERROR == Sql_Query(mmysql_handle, "DELETE FROM `%s` WHERE `varname`='%s' AND `index`='%" PRIu32 "'", mapreg_table, esc_name, i))
-				Sql_ShowDebug(mmysql_handle);
-		}
+		if (name[1] != '@')
+			mapreg_mark_delete(uid, name, i);
 		if ((m = static_cast<mapreg_save *>(i64db_get(regs.vars, uid)))) {
 			if (m->u.str != nullptr)
 				aFree(m->u.str);
@@ -145,10 +239,8 @@ bool mapreg_setregstr(int64 uid, const char* str)
 			if (m->u.str != nullptr)
 				aFree(m->u.str);
 			m->u.str = aStrdup(str);
-			if (name[1] != '@') {
-				mapreg_dirty = true;
-				m->save = true;
-			}
+			if (name[1] != '@')
+				mapreg_mark_save(m, name, i);
 		} else {
 			if (i)
 				script_array_update(&regs, uid, false);
@@ -160,14 +252,8 @@ bool mapreg_setregstr(int64 uid, const char* str)
 			m->save = false;
 			m->is_string = true;
 
-			if (name[1] != '@' && !skip_insert) { //put returned null, so we must insert.
-				char esc_name[32 * 2 + 1];
-				char esc_str[255 * 2 + 1];
-				Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-				Sql_EscapeStringLen(mmysql_handle, esc_str, str, strnlen(str, 255));
-				if (SQL_ERROR == Sql_Query(mmysql_handle, "INSERT INTO `%s`(`varname`,`index`,`value`) VALUES ('%s','%" PRIu32 "','%s')", mapreg_table, esc_name, i, esc_str))
-					Sql_ShowDebug(mmysql_handle);
-			}
+			if (name[1] != '@' && !skip_insert) // put returned null, so we must insert on the next save.
+				mapreg_mark_save(m, name, i);
 			i64db_put(regs.vars, uid, m);
 		}
 	}
@@ -224,37 +310,182 @@ static void script_load_mapreg(void)
 	mapreg_dirty = false;
 }
 
+/**
+ * Executes a batched statement and starts a new one.
+ * @param buf: statement, cleared afterwards
+ * @param count: amount of rows in the statement, reset afterwards
+ * @return true on success
+ */
+static bool mapreg_save_flush(StringBuf& buf, int32& count, const char* suffix)
+{
+	if (count == 0)
+		return true;
+
+	StringBuf_AppendStr(&buf, suffix);
+	count = 0;
+
+	if (SQL_ERROR == Sql_QueryStr(mmysql_handle, StringBuf_Value(&buf))) {
+		Sql_ShowDebug(mmysql_handle);
+		StringBuf_Clear(&buf);
+		return false;
+	}
+
+	StringBuf_Clear(&buf);
+	return true;
+}
+
 /**
  * Saves permanent variables to database.
+ * All pending inserts, updates and deletes are written in batched statements inside one transaction.
+ * If anything fails, the changes stay pending and are retried on the next save.
  */
 static void script_save_mapreg(void)
 {
-	if (mapreg_dirty) {
-		DBIterator *iter = db_iterator(regs.vars);
-		struct mapreg_save *m;
-		for (m = static_cast<mapreg_save *>(dbi_first(iter)); dbi_exists(iter); m = static_cast<mapreg_save *>(dbi_next(iter))) {
-			if (m->save) {
-				int32 num = script_getvarid(m->uid);
-				uint32 i = script_getvaridx(m->uid);
-				const char* name = get_str(num);
-				if (!m->is_string) {
-					char esc_name[32 * 2 + 1];
-					Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-					if (SQL_ERROR == Sql_Query(mmysql_handle, "UPDATE `%s` SET `value`='%" PRId64 "' WHERE `varname`='%s' AND `index`='%" PRIu32 "' LIMIT 1", mapreg_table, m->u.i, esc_name, i))
-						Sql_ShowDebug(mmysql_handle);
-				} else {
-					char esc_str[2 * 255 + 1];
-					char esc_name[32 * 2 + 1];
-					Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
-					Sql_EscapeStringLen(mmysql_handle, esc_str, m->u.str, safestrnlen(m->u.str, 255));
-					if (SQL_ERROR == Sql_Query(mmysql_handle, "UPDATE `%s` SET `value`='%s' WHERE `varname`='%s' AND `index`='%" PRIu32 "' LIMIT 1", mapreg_table, esc_str, esc_name, i))
-						Sql_ShowDebug(mmysql_handle);
-				}
-				m->save = false;
-			}
+	if (!mapreg_dirty)
+		return;
+
+	StringBuf buf;
+	int32 count = 0;
+	bool success = true;
+	char esc_name[32 * 2 + 1];
+	char esc_str[2 * 255 + 1];
+
+	StringBuf_Init(&buf);
+
+	if (SQL_ERROR == Sql_QueryStr(mmysql_handle, "START TRANSACTION")) {
+		Sql_ShowDebug(mmysql_handle);
+		return;
+	}
+
+	// Removed variables
+	for (int64 uid : mapreg_deleted) {
+		const char* name = get_str(script_getvarid(uid));
+
+		if (count == 0)
+			StringBuf_Printf(&buf, "DELETE FROM `%s` WHERE (`varname`, `index`) IN (", mapreg_table);
+		else
+			StringBuf_AppendStr(&buf, ",");
+
+		Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
+		StringBuf_Printf(&buf, "('%s','%" PRIu32 "')", esc_name, script_getvaridx(uid));
+
+		if (++count >= MAPREG_SAVE_BATCH && !mapreg_save_flush(buf, count, ")"))
+			success = false;
+	}
+	if (!mapreg_save_flush(buf, count, ")"))
+		success = false;
+
+	// New and modified variables
+	DBIterator *iter = db_iterator(regs.vars);
+	struct mapreg_save *m;
+
+	for (m = static_cast<mapreg_save *>(dbi_first(iter)); dbi_exists(iter); m = static_cast<mapreg_save *>(dbi_next(iter))) {
+		if (!m->save)
+			continue;
+
+		const char* name = get_str(script_getvarid(m->uid));
+
+		if (count == 0)
+			StringBuf_Printf(&buf, "INSERT INTO `%s` (`varname`, `index`, `value`) VALUES ", mapreg_table);
+		else
+			StringBuf_AppendStr(&buf, ",");
+
+		Sql_EscapeStringLen(mmysql_handle, esc_name, name, strnlen(name, 32));
+		if (!m->is_string) {
+			StringBuf_Printf(&buf, "('%s','%" PRIu32 "','%" PRId64 "')", esc_name, script_getvaridx(m->uid), m->u.i);
+		} else {
+			Sql_EscapeStringLen(mmysql_handle, esc_str, m->u.str, safestrnlen(m->u.str, 255));
+			StringBuf_Printf(&buf, "('%s','%" PRIu32 "','%s')", esc_name, script_getvaridx(m->uid), esc_str);
 		}
+
+		if (++count >= MAPREG_SAVE_BATCH && !mapreg_save_flush(buf, count, " ON DUPLICATE KEY UPDATE `value` = VALUES(`value`)"))
+			success = false;
+	}
+	if (!mapreg_save_flush(buf, count, " ON DUPLICATE KEY UPDATE `value` = VALUES(`value`)"))
+		success = false;
+
+	if (!success || SQL_ERROR == Sql_QueryStr(mmysql_handle, "COMMIT")) {
+		Sql_ShowDebug(mmysql_handle);
+		if (SQL_ERROR == Sql_QueryStr(mmysql_handle, "ROLLBACK"))
+			Sql_ShowDebug(mmysql_handle);
 		dbi_destroy(iter);
-		mapreg_dirty = false;
+		ShowError("script_save_mapreg: Failed to save permanent variables, retrying on the next save.\n");
+		return;
+	}
+
+	for (m = static_cast<mapreg_save *>(dbi_first(iter)); dbi_exists(iter); m = static_cast<mapreg_save *>(dbi_next(iter)))
+		m->save = false;
+	dbi_destroy(iter);
+
+	mapreg_deleted.clear();
+	mapreg_dirty = false;
+
+	// Everything is in the database now, start a new journal
+	if (mapreg_journal != nullptr) {
+		fclose(mapreg_journal);
+		mapreg_journal = fopen(mapreg_journal_file, "w");
+	}
+}
+
+/**
+ * Replays the journal of a previous run that was not saved to the database.
+ */
+static void mapreg_journal_replay(void)
+{
+	FILE* fp = fopen(mapreg_journal_file, "r");
+
+	if (fp == nullptr)
+		return;
+
+	char line[1024];
+	int32 count = 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		char* fields[4] = {};
+		int32 n = 0;
+		char* p = line;
+
+		line[strcspn(line, "\r\n")] = '\0';
+
+		// split by tabs, the escaped values do not contain any
+		while (n < 4) {
+			fields[n++] = p;
+			if ((p = strchr(p, '\t')) == nullptr)
+				break;
+			*p++ = '\0';
+		}
+
+		if (n < 3 || (fields[0][0] != 'S' && fields[0][0] != 'D') || (fields[0][0] == 'S' && n < 4)) {
+			ShowWarning("mapreg_journal_replay: Skipping invalid line in '%s'.\n", mapreg_journal_file);
+			continue;
+		}
+
+		mapreg_journal_unescape(fields[1]);
+
+		int64 uid = reference_uid(add_str(fields[1]), (uint32)strtoul(fields[2], nullptr, 10));
+		size_t len = strlen(fields[1]);
+		bool is_string = len > 0 && fields[1][len - 1] == '$';
+
+		if (fields[0][0] == 'D') {
+			if (is_string)
+				mapreg_setregstr(uid, nullptr);
+			else
+				mapreg_setreg(uid, 0);
+		} else {
+			mapreg_journal_unescape(fields[3]);
+			if (is_string)
+				mapreg_setregstr(uid, fields[3]);
+			else
+				mapreg_setreg(uid, strtoll(fields[3], nullptr, 10));
+		}
+		count++;
+	}
+
+	fclose(fp);
+
+	if (count > 0) {
+		ShowStatus("Recovered '" CL_WHITE "%d" CL_RESET "' permanent variable changes from '" CL_WHITE "%s" CL_RESET "'.\n", count, mapreg_journal_file);
+		script_save_mapreg();
 	}
 }
 
@@ -316,6 +547,16 @@ void mapreg_final(void)
 {
 	script_save_mapreg();
 
+	if (mapreg_journal != nullptr) {
+		fclose(mapreg_journal);
+		mapreg_journal = nullptr;
+
+		// Keep the journal if the last save failed, so it can be replayed on the next start
+		if (!mapreg_dirty)
+			remove(mapreg_journal_file);
+	}
+	mapreg_deleted.clear();
+
 	regs.vars->destroy(regs.vars, mapreg_destroyreg);
 
 	ers_destroy(mapreg_ers);
@@ -329,7 +570,7 @@ void mapreg_final(void)
  */
 void mapreg_init(void)
 {
-	regs.vars = i64db_alloc(DB_OPT_BASE);
+	regs.vars = i64db_alloc(DB_OPT_HASH_INDEX);
 	mapreg_ers = ers_new(sizeof(struct mapreg_save), "mapreg.cpp:mapreg_ers", ERS_OPT_CLEAN);
 
 	skip_insert = false;
@@ -337,8 +578,15 @@ void mapreg_init(void)
 
 	script_load_mapreg();
 
+	if (mapreg_journal_file[0] != '\0') {
+		mapreg_journal_replay();
+
+		if ((mapreg_journal = fopen(mapreg_journal_file, mapreg_dirty ? "a" : "w")) == nullptr)
+			ShowError("mapreg_init: Could not open journal file '%s', changes since the last save will be lost on a crash.\n", mapreg_journal_file);
+	}
+
 	add_timer_func_list(script_autosave_mapreg, "script_autosave_mapreg");
-	add_timer_interval(gettick() + MAPREG_AUTOSAVE_INTERVAL, script_autosave_mapreg, 0, 0, MAPREG_AUTOSAVE_INTERVAL);
+	add_timer_interval(gettick() + mapreg_autosave_interval, script_autosave_mapreg, 0, 0, mapreg_autosave_interval);
 }
 
 /**
@@ -348,6 +596,10 @@ bool mapreg_config_read(const char* w1, const char* w2)
 {
 	if(!strcmpi(w1, "mapreg_table"))
 		safestrncpy(mapreg_table, w2, sizeof(mapreg_table));
+	else if(!strcmpi(w1, "mapreg_autosave_interval"))
+		mapreg_autosave_interval = max(atoi(w2), 1) * 1000;
+	else if(!strcmpi(w1, "mapreg_journal"))
+		safestrncpy(mapreg_journal_file, w2, sizeof(mapreg_journal_file));
 	else
 		return false;
 
@@ -4,9 +4,13 @@
 #include "mob.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
 #include <cstdlib>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <sstream> // สำหรับ std::ostringstream
@@ -46,6 +50,7 @@
 using namespace rathena;
 
 #define ACTIVE_AI_RANGE 4	//Distance added on top of 'AREA_SIZE' at which mobs enter active AI mode.
+#define ACTIVE_AI_GROUP_SIZE 8	//Size of the square in cells in which players share one search for active mobs.
 
 const t_tick MOB_MAX_DELAY = 24 * 3600 * 1000;
 #define RUDE_ATTACKED_COUNT 1	//After how many rude-attacks should the skill be used?
@@ -1343,6 +1348,48 @@ int32 mob_target(struct mob_data *md,struct block_list *bl,int32 dist)
 	return 0;
 }
 
+/// Walk path from a monster to a possible target, computed by the AI threads
+struct s_mob_ai_path {
+	int32 id; ///< ID of the target
+	int16 x, y; ///< Position of the target when the path was computed
+	int16 length; ///< Length of the walk path, -1 if there is none
+};
+
+/// Walk paths of an aggressive monster to the possible targets around it
+struct s_mob_ai_search {
+	mob_data* md;
+	int16 m, x, y; ///< Position of the monster when the paths were computed
+	uint32 terrain_version; ///< Terrain version of the map when the paths were computed
+	std::vector<s_mob_ai_path> paths;
+};
+
+/**
+ * Looks up the walk path length from a monster to a target computed by the AI threads.
+ * The result is only used while neither the monster, the target nor the terrain changed since.
+ * @param md: Monster
+ * @param bl: Target
+ * @return Length of the walk path, -1 if there is none or -2 if it has to be computed
+ */
+static int32 mob_ai_search_path(mob_data* md, block_list* bl){
+	const s_mob_ai_search* search = md->ai_search;
+
+	if( search == nullptr || search->m != md->m || search->x != md->x || search->y != md->y || search->terrain_version != map_getmapdata( md->m )->terrain_version ){
+		return -2;
+	}
+
+	for( const s_mob_ai_path& path : search->paths ){
+		if( path.id == bl->id ){
+			if( path.x != bl->x || path.y != bl->y ){
+				return -2;
+			}
+
+			return path.length;
+		}
+	}
+
+	return -2;
+}
+
 /*==========================================
  * The ?? routine of an active monster
  *------------------------------------------*/
@@ -1382,12 +1429,17 @@ static int32 mob_ai_sub_hard_activesearch(struct block_list *bl,va_list ap)
 		battle_check_range(md,bl,md->db->range2)
 	) { //Pick closest target?
 #ifdef ACTIVEPATHSEARCH
-		struct walkpath_data wpd;
-		if (!path_search(&wpd, md->m, md->x, md->y, bl->x, bl->y, 0, CELL_CHKWALL)) // Count walk path cells
+		int32 path_len = mob_ai_search_path(md, bl);
+		if (path_len == -2) {
+			struct walkpath_data wpd;
+			if (!path_search(&wpd, md->m, md->x, md->y, bl->x, bl->y, 0, CELL_CHKWALL)) // Count walk path cells
+				return 0;
+			path_len = wpd.path_len;
+		} else if (path_len < 0)
 			return 0;
 		//Standing monsters use range2, walking monsters use range3
-		if ((md->ud.walktimer == INVALID_TIMER && wpd.path_len > md->db->range2)
-			|| (md->ud.walktimer != INVALID_TIMER && wpd.path_len > md->db->range3))
+		if ((md->ud.walktimer == INVALID_TIMER && path_len > md->db->range2)
+			|| (md->ud.walktimer != INVALID_TIMER && path_len > md->db->range3))
 			return 0;
 #endif
 		(*target) = bl;
@@ -2366,26 +2418,54 @@ TIMER_FUNC(mob_norm_attacked) {
 	return 0;
 }
 
+/// Player of the hard AI pass, keyed by its map and ACTIVE_AI_GROUP_SIZE square for sorting
+using mob_ai_player = std::pair<uint64, map_session_data*>;
+/// Players around which monsters use the hard AI during the current pass
+static std::vector<mob_ai_player> mob_ai_players;
+/// Monsters found in range of at least one player during the current hard AI pass
+static std::vector<mob_data*> mob_ai_active;
+
+/*==========================================
+ * Marks a monster in range of a group of players as active (foreachinarea)
+ *------------------------------------------*/
 static int32 mob_ai_sub_hard_timer(struct block_list *bl,va_list ap)
 {
 	struct mob_data *md = (struct mob_data*)bl;
-	uint32 char_id = va_arg(ap, uint32);
+	mob_ai_player* group = va_arg(ap, mob_ai_player*);
+	size_t count = va_arg(ap, size_t);
+	int32 range = va_arg(ap, int32);
 	t_tick tick = va_arg(ap, t_tick);
-	mob_add_spotted(md, char_id);
-	if (mob_ai_sub_hard(md, tick))
-	{	//Hard AI triggered.
-		md->last_pcneartime = tick;
+	bool spotted = false;
+
+	for( size_t i = 0; i < count; i++ ){
+		map_session_data* sd = group[i].second;
+
+		if( check_distance_bl( sd, bl, range ) ){
+			mob_add_spotted( md, sd->status.char_id );
+			spotted = true;
+		}
+	}
+
+	// Several groups may reach the same monster, its hard AI is only queued once
+	if( spotted && md->active_ai_tick != tick ){
+		md->active_ai_tick = tick;
+		mob_ai_active.push_back( md );
 	}
+
 	return 0;
 }
 
 /*==========================================
- * Serious processing for mob in PC field of view (foreachclient)
+ * Collects the players around which monsters use the hard AI (foreachclient)
  *------------------------------------------*/
 static int32 mob_ai_sub_foreachclient(map_session_data *sd,va_list ap)
 {
-	t_tick tick=va_arg(ap,t_tick);
-	map_foreachinallrange(mob_ai_sub_hard_timer,sd, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB, sd->status.char_id, tick);
+	if( sd->m < 0 )
+		return 0;
+
+	uint64 key = ( static_cast<uint64>( sd->m ) << 32 ) | ( static_cast<uint64>( sd->y / ACTIVE_AI_GROUP_SIZE ) << 16 ) | ( sd->x / ACTIVE_AI_GROUP_SIZE );
+
+	mob_ai_players.emplace_back( key, sd );
 
 	return 0;
 }
@@ -2491,6 +2571,190 @@ static int32 mob_ai_sub_lazy(struct mob_data *md, va_list args)
 	return 0;
 }
 
+/// Threads computing the walk paths of the hard AI pass, see monster_ai_threads
+struct s_mob_ai_pool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake; ///< Signals the threads that a new batch is ready or that they should stop
+	std::condition_variable finished; ///< Signals the main thread that all threads are done with the batch
+	uint64 batch = 0; ///< Number of the current batch
+	size_t busy = 0; ///< Threads still working on the current batch
+	size_t count = 0; ///< Searches in the current batch
+	std::atomic<size_t> next{ 0 }; ///< Next search of the batch to compute
+	bool stop = false;
+};
+
+static s_mob_ai_pool mob_ai_pool;
+/// Whether the memory manager was made thread-safe at startup, the pool can't be started otherwise
+static bool mob_ai_pool_enabled = false;
+/// Searches of the current batch, the entries are reused between passes
+static std::vector<s_mob_ai_search> mob_ai_searches;
+
+/**
+ * Computes the walk paths of a monster to the possible targets of mob_ai_sub_hard_activesearch.
+ * Runs in the AI threads while the main thread waits, so it must only read the map and the objects on it.
+ * @param search: Search to fill
+ * @param targets: Buffer for the objects around the monster
+ */
+static void mob_ai_search_compute( s_mob_ai_search& search, std::vector<block_list*>& targets ){
+	mob_data* md = search.md;
+
+	targets.clear();
+	// Targets farther away than range2 fail the battle_check_range check before the path is needed
+	map_getallinrange( targets, md, md->db->range2, DEFAULT_ENEMY_TYPE( md ) );
+
+	for( block_list* bl : targets ){
+		if( bl == md ){
+			continue;
+		}
+
+		struct walkpath_data wpd;
+		int16 length = path_search( &wpd, md->m, md->x, md->y, bl->x, bl->y, 0, CELL_CHKWALL ) ? wpd.path_len : -1;
+
+		search.paths.push_back( { bl->id, bl->x, bl->y, length } );
+	}
+}
+
+/// Computes searches of the current batch until none are left.
+static void mob_ai_search_work(){
+	static thread_local std::vector<block_list*> targets;
+
+	for( size_t i; ( i = mob_ai_pool.next++ ) < mob_ai_pool.count; ){
+		mob_ai_search_compute( mob_ai_searches[i], targets );
+	}
+}
+
+/**
+ * Main function of an AI thread.
+ * @param batch: Batch that was current when the thread was started
+ */
+static void mob_ai_worker_main( uint64 batch ){
+	for( ;; ){
+		{
+			std::unique_lock<std::mutex> lock( mob_ai_pool.mutex );
+
+			mob_ai_pool.wake.wait( lock, [&batch]{ return mob_ai_pool.stop || mob_ai_pool.batch != batch; } );
+
+			if( mob_ai_pool.stop ){
+				break;
+			}
+
+			batch = mob_ai_pool.batch;
+		}
+
+		mob_ai_search_work();
+
+		std::lock_guard<std::mutex> lock( mob_ai_pool.mutex );
+
+		if( --mob_ai_pool.busy == 0 ){
+			mob_ai_pool.finished.notify_one();
+		}
+	}
+
+	// Release the path heap of this thread
+	do_final_path();
+}
+
+/**
+ * Starts or stops AI threads until the given amount is running.
+ * @param count: Amount of AI threads
+ */
+static void mob_ai_pool_resize( size_t count ){
+	if( count == mob_ai_pool.threads.size() ){
+		return;
+	}
+
+	if( !mob_ai_pool.threads.empty() ){
+		{
+			std::lock_guard<std::mutex> lock( mob_ai_pool.mutex );
+
+			mob_ai_pool.stop = true;
+		}
+
+		mob_ai_pool.wake.notify_all();
+
+		for( std::thread& thread : mob_ai_pool.threads ){
+			thread.join();
+		}
+
+		mob_ai_pool.threads.clear();
+		mob_ai_pool.stop = false;
+	}
+
+	if( count > 0 && !mob_ai_pool_enabled ){
+		ShowWarning( "monster_ai_threads was 0 at startup, restart the server to use AI threads.\n" );
+		battle_config.mob_ai_threads = 0;
+		return;
+	}
+
+	for( size_t i = 0; i < count; i++ ){
+		mob_ai_pool.threads.emplace_back( mob_ai_worker_main, mob_ai_pool.batch );
+	}
+
+	if( count > 0 ){
+		ShowStatus( "Monster AI is using " CL_WHITE "%" PRIuPTR CL_RESET " additional threads.\n", count );
+	}
+}
+
+/**
+ * Computes the walk paths of the aggressive monsters of the hard AI pass in the AI threads.
+ * The monsters still think one after the other afterwards, mob_ai_search_path hands them the results.
+ */
+static void mob_ai_search_run( t_tick tick ){
+	size_t count = 0;
+
+	for( mob_data* md : mob_ai_active ){
+		if( md->prev == nullptr || md->status.hp == 0 || DIFF_TICK( tick, md->next_thinktime ) < 0 ){
+			continue;
+		}
+
+		if( !( status_get_mode( md )&MD_AGGRESSIVE ) && md->state.skillstate != MSS_FOLLOW ){
+			continue;
+		}
+
+		if( count == mob_ai_searches.size() ){
+			mob_ai_searches.emplace_back();
+		}
+
+		s_mob_ai_search& search = mob_ai_searches[count++];
+
+		search.md = md;
+		search.m = md->m;
+		search.x = md->x;
+		search.y = md->y;
+		search.terrain_version = map_getmapdata( md->m )->terrain_version;
+		search.paths.clear();
+	}
+
+	if( count == 0 ){
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mob_ai_pool.mutex );
+
+		mob_ai_pool.count = count;
+		mob_ai_pool.next = 0;
+		mob_ai_pool.busy = mob_ai_pool.threads.size();
+		mob_ai_pool.batch++;
+	}
+
+	mob_ai_pool.wake.notify_all();
+
+	// The main thread helps instead of waiting idle
+	mob_ai_search_work();
+
+	{
+		std::unique_lock<std::mutex> lock( mob_ai_pool.mutex );
+
+		mob_ai_pool.finished.wait( lock, []{ return mob_ai_pool.busy == 0; } );
+	}
+
+	for( size_t i = 0; i < count; i++ ){
+		mob_ai_searches[i].md->ai_search = &mob_ai_searches[i];
+	}
+}
+
 /*==========================================
  * Negligent processing for mob outside PC field of view   (interval timer function)
  *------------------------------------------*/
@@ -2504,10 +2768,56 @@ static TIMER_FUNC(mob_ai_lazy){
  *------------------------------------------*/
 static TIMER_FUNC(mob_ai_hard){
 
-	if (battle_config.mob_ai&0x20)
+	if (battle_config.mob_ai&0x20) {
 		map_foreachmob(mob_ai_sub_lazy,tick);
-	else
-		map_foreachpc(mob_ai_sub_foreachclient,tick);
+		return 0;
+	}
+
+	int32 range = AREA_SIZE + ACTIVE_AI_RANGE;
+
+	// Players standing close to each other share a single area scan instead of one scan per player
+	map_foreachpc(mob_ai_sub_foreachclient);
+	std::sort( mob_ai_players.begin(), mob_ai_players.end(), []( const mob_ai_player& a, const mob_ai_player& b ){
+		return a.first < b.first;
+	} );
+
+	for( size_t i = 0, j; i < mob_ai_players.size(); i = j ){
+		block_list* bl = mob_ai_players[i].second;
+		int16 x0 = bl->x, y0 = bl->y, x1 = bl->x, y1 = bl->y;
+
+		for( j = i + 1; j < mob_ai_players.size() && mob_ai_players[j].first == mob_ai_players[i].first; j++ ){
+			bl = mob_ai_players[j].second;
+			x0 = i16min( x0, bl->x );
+			y0 = i16min( y0, bl->y );
+			x1 = i16max( x1, bl->x );
+			y1 = i16max( y1, bl->y );
+		}
+
+		map_foreachinarea( mob_ai_sub_hard_timer, bl->m, x0 - range, y0 - range, x1 + range, y1 + range, BL_MOB, &mob_ai_players[i], j - i, range, tick );
+	}
+
+	mob_ai_players.clear();
+
+	mob_ai_pool_resize( battle_config.mob_ai_threads );
+
+	if( !mob_ai_pool.threads.empty() ){
+		mob_ai_search_run( tick );
+	}
+
+	// Each active monster thinks once, no matter how many players are around it
+	map_freeblock_lock();
+
+	for( mob_data* md : mob_ai_active ){
+		if( mob_ai_sub_hard( md, tick ) ){
+			//Hard AI triggered.
+			md->last_pcneartime = tick;
+		}
+
+		md->ai_search = nullptr;
+	}
+
+	mob_ai_active.clear();
+	map_freeblock_unlock();
 
 	return 0;
 }
@@ -7499,6 +7809,12 @@ void do_init_mob(void){
 	add_timer_func_list(mob_norm_attacked, "mob_norm_attacked");
 	add_timer_interval(gettick()+MIN_MOBTHINKTIME,mob_ai_hard,0,0,MIN_MOBTHINKTIME);
 	add_timer_interval(gettick()+MIN_MOBTHINKTIME*10,mob_ai_lazy,0,0,MIN_MOBTHINKTIME*10);
+
+	// path_search allocates its heap through the memory manager
+	if( battle_config.mob_ai_threads > 0 ){
+		malloc_set_threadsafe();
+		mob_ai_pool_enabled = true;
+	}
 }
 
 /*==========================================
@@ -7513,5 +7829,6 @@ void do_final_mob(bool is_reload){
 	map_drop_db.clear();
 	if( !is_reload ) {
 		mob_delayed_drops.clear();
+		mob_ai_pool_resize( 0 );
 	}
 }
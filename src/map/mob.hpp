@@ -344,6 +344,8 @@ struct s_dmglog{
 	uint32 flag : 2; //0: Normal. 1: Homunc exp. 2: Pet exp
 };
 
+struct s_mob_ai_search;
+
 struct mob_data : public block_list {
 	struct unit_data  ud;
 	struct view_data *vd;
@@ -386,6 +388,8 @@ struct mob_data : public block_list {
 	int32 bg_id; // BattleGround System
 
 	t_tick next_walktime,next_thinktime,last_linktime,last_pcneartime,last_canmove,last_skillcheck;
+	t_tick active_ai_tick; // Last hard AI pass that found a player in range, so the hard AI runs only once per pass
+	struct s_mob_ai_search* ai_search; // Walk paths computed by the AI threads for the current hard AI pass, nullptr if none
 	t_tick trickcasting; // Special state where you show a fake castbar while moving
 	int16 move_fail_count;
 	int16 lootitem_count;
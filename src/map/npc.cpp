@@ -3,9 +3,14 @@
 
 #include "npc.hpp"
 
+#include <algorithm>
 #include <cerrno>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include <common/cbasetypes.hpp>
@@ -43,6 +48,180 @@ struct npc_data* fake_nd;
 
 std::vector<std::string> npc_src_files;
 
+/// Result of reading a NPC source file
+enum e_npc_src_state : uint8 {
+	NPC_SRC_OK = 0,
+	NPC_SRC_NOT_A_FILE,
+	NPC_SRC_NOT_FOUND,
+	NPC_SRC_READ_ERROR,
+	NPC_SRC_UTF8_BOM,
+};
+
+/// NPC files that are read and lexed ahead of the file that is being parsed, per reader thread
+#define NPC_SRC_READ_AHEAD 4
+
+/// Top-level entry of a NPC source file, split into its fields ahead of parsing
+struct s_npc_src_entry {
+	size_t offset; ///< Start of the entry
+	size_t count; ///< Fields found by sv_parse
+	size_t pos[9]; ///< Positions found by sv_parse
+	size_t end; ///< Where the parse functions are expected to stop, SIZE_MAX if unknown
+	size_t next; ///< Start of the next entry after end
+};
+
+/// NPC source file that was read ahead of parsing
+struct s_npc_src_file {
+	std::string path;
+	e_npc_src_state state;
+	int32 error; ///< errno of a failed read
+	std::vector<char> buffer; ///< Contents of the file, null terminated
+	std::vector<size_t> newlines; ///< Offsets of the line breaks
+	std::vector<s_npc_src_entry> entries; ///< Top-level entries in the order of the file
+	bool ready; ///< Read by a reader thread, guarded by the mutex of npc_loadsrcfiles
+};
+
+static s_npc_src_file* npc_src_current = nullptr; ///< File that is being parsed, used for line lookups
+
+static const char* npc_skip_script( const char* start, const char* buffer, const char* filepath, bool quiet = false );
+
+/// Skips spaces and comments like skip_space, without reporting anything.
+/// Returns nullptr for a block comment that is not closed.
+static const char* npc_lexspace( const char* p ){
+	for(;;){
+		while( ISSPACE( *p ) ){
+			++p;
+		}
+
+		if( *p == '/' && p[1] == '/' ){
+			while( *p && *p != '\n' ){
+				++p;
+			}
+		}else if( *p == '/' && p[1] == '*' ){
+			const char* end = strstr( p + 2, "*/" );
+
+			if( end == nullptr ){
+				return nullptr;
+			}
+
+			p = end + 2;
+		}else{
+			return p;
+		}
+	}
+}
+
+/// Splits a NPC source file into its top-level entries the same way npc_parsesrcbuffer does.
+/// Stops at anything that would be reported, npc_parsesrcbuffer lexes the rest itself.
+static void npc_lexsrcfile( s_npc_src_file& file ){
+	const char* buffer = file.buffer.data();
+	size_t len = file.buffer.size() - 1;
+
+	for( const char* p = npc_lexspace( buffer ); p != nullptr && *p != '\0'; ){
+		s_npc_src_entry entry = {};
+		bool error;
+
+		entry.offset = p - buffer;
+		entry.count = sv_parse( p, len + buffer - p, 0, '\t', entry.pos, ARRAYLENGTH( entry.pos ), SV_TERMINATE_LF|SV_TERMINATE_CRLF, error );
+
+		if( error || entry.count < 3 ){
+			return;
+		}
+
+		// Scripts and functions end after their last right curly, everything else at the end of the line
+		if( entry.count > 3 && entry.pos[5] - entry.pos[4] >= 6 && strncasecmp( p + entry.pos[4], "script", 6 ) == 0 ){
+			p = npc_skip_script( p, buffer, file.path.c_str(), true );
+		}else{
+			p = strchr( p, '\n' );
+		}
+
+		const char* next = ( p != nullptr ) ? npc_lexspace( p ) : nullptr;
+
+		if( next == nullptr ){
+			entry.end = SIZE_MAX;
+			file.entries.push_back( entry );
+			return;
+		}
+
+		entry.end = p - buffer;
+		entry.next = next - buffer;
+		file.entries.push_back( entry );
+		p = next;
+	}
+}
+
+/// Reads a NPC source file, indexes its lines and splits it into its entries.
+/// Does not touch any global state, so it can run on any thread.
+static void npc_readsrcfile( s_npc_src_file& file ){
+	if( check_filepath( file.path.c_str() ) != 2 ){
+		file.state = NPC_SRC_NOT_A_FILE;
+		return;
+	}
+
+	// read whole file to buffer
+	FILE* fp = fopen( file.path.c_str(), "rb" );
+
+	if( fp == nullptr ){
+		file.state = NPC_SRC_NOT_FOUND;
+		return;
+	}
+
+	fseek( fp, 0, SEEK_END );
+	size_t len = ftell( fp );
+	file.buffer.resize( len + 1 );
+	fseek( fp, 0, SEEK_SET );
+	len = fread( file.buffer.data(), 1, len, fp );
+	file.buffer.resize( len + 1 );
+	file.buffer[len] = '\0';
+
+	if( ferror( fp ) ){
+		file.state = NPC_SRC_READ_ERROR;
+		file.error = errno;
+		fclose( fp );
+		return;
+	}
+
+	fclose( fp );
+
+	if( len >= 3 && (unsigned char)file.buffer[0] == 0xEF && (unsigned char)file.buffer[1] == 0xBB && (unsigned char)file.buffer[2] == 0xBF ){
+		file.state = NPC_SRC_UTF8_BOM;
+		return;
+	}
+
+	for( size_t i = 0; i < len; i++ ){
+		if( file.buffer[i] == '\n' ){
+			file.newlines.push_back( i );
+		}
+	}
+
+	npc_lexsrcfile( file );
+
+	file.state = NPC_SRC_OK;
+}
+
+/// Returns the line of p in buffer, like strline.
+/// Uses the line index of the file that is being parsed, if buffer belongs to it.
+static int32 npc_srcline( const char* buffer, const char* p ){
+	if( npc_src_current == nullptr || buffer != npc_src_current->buffer.data() ){
+		return strline( buffer, p - buffer );
+	}
+
+	const std::vector<size_t>& newlines = npc_src_current->newlines;
+
+	return static_cast<int32>( std::lower_bound( newlines.begin(), newlines.end(), static_cast<size_t>( p - buffer ) ) - newlines.begin() ) + 1;
+}
+
+/// Returns the start of the entry after end.
+/// Uses the lexed entry, if its parse function stopped where the reader expected it to.
+static const char* npc_srcnext( const s_npc_src_entry* entry, const char* buffer, const char* end ){
+	if( entry != nullptr && end != nullptr && entry->end == static_cast<size_t>( end - buffer ) ){
+		return buffer + entry->next;
+	}
+
+	return skip_space( end );
+}
+
+static int32 npc_parsesrcbuffer( s_npc_src_file& file );
+
 static int32 npc_id=START_NPC_NUM;
 static int32 npc_warp=0;
 static int32 npc_shop=0;
@@ -72,14 +251,14 @@ TIMER_FUNC(npc_dynamicnpc_removal_timer);
 /// Returns a new npc id that isn't being used in id_db.
 /// Fatal error if nothing is available.
 int32 npc_get_new_npc_id(void) {
-	if( npc_id >= START_NPC_NUM && !map_blid_exists(npc_id) )
+	if( npc_id >= START_NPC_NUM && map_blid_available(npc_id) )
 		return npc_id++;// available
 	else {// find next id
 		int32 base_id = npc_id;
 		while( base_id != ++npc_id ) {
 			if( npc_id < START_NPC_NUM )
 				npc_id = START_NPC_NUM;
-			if( !map_blid_exists(npc_id) )
+			if( map_blid_available(npc_id) )
 				return npc_id++;// available
 		}
 		// full loop, nothing available
@@ -3657,12 +3836,100 @@ void npc_delsrcfile(const char* name)
  */
 void npc_loadsrcfiles() {
 	ShowStatus("Loading NPCs...\n");
-	for (const auto& file : npc_src_files) {
+	script_cache_prepare();
+
+	// Reading and lexing the files does not depend on anything else, so it runs on reader threads.
+	// Parsing them registers NPCs, labels and script strings and stays on the main thread, in file order.
+	// The readers stay at most NPC_SRC_READ_AHEAD files per thread ahead of it, to bound the memory.
+	uint64 start = gettick_precise();
+	std::vector<s_npc_src_file> files( npc_src_files.size() );
+	size_t thread_count = std::min<size_t>( std::max( std::thread::hardware_concurrency(), 1u ), files.size() );
+	size_t read_ahead = thread_count * NPC_SRC_READ_AHEAD;
+	size_t next = 0; ///< Next file to read
+	size_t parsed = 0; ///< Files that were parsed and released
+	std::mutex mutex;
+	std::condition_variable read_cv; ///< Signaled when a file was parsed
+	std::condition_variable parse_cv; ///< Signaled when a file was read
+	std::vector<std::thread> threads;
+	uint64 wait = 0;
+
+	for( size_t i = 0; i < files.size(); i++ ){
+		files[i].path = npc_src_files[i];
+	}
+
+	auto read_files = [&](){
+		for(;;){
+			size_t i;
+
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+
+				read_cv.wait( lock, [&](){ return next >= files.size() || next < parsed + read_ahead; } );
+
+				if( next >= files.size() ){
+					return;
+				}
+
+				i = next++;
+			}
+
+			npc_readsrcfile( files[i] );
+
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+
+				files[i].ready = true;
+			}
+
+			parse_cv.notify_one();
+		}
+	};
+
+	for( size_t i = 0; i < thread_count; i++ ){
+		threads.emplace_back( read_files );
+	}
+
+	for( size_t i = 0; i < files.size(); i++ ){
+		s_npc_src_file& file = files[i];
+		uint64 wait_start = gettick_precise();
+
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+
+			parse_cv.wait( lock, [&file](){ return file.ready; } );
+		}
+
+		wait += gettick_precise() - wait_start;
+
 #ifdef DETAILED_LOADING_OUTPUT
-		ShowStatus("Loading NPC file: %s" CL_CLL "\r", file.c_str());
+		ShowStatus("Loading NPC file: %s" CL_CLL "\r", file.path.c_str());
 #endif
-		npc_parsesrcfile(file.c_str());
+		npc_parsesrcbuffer( file );
+
+		// Release the contents as soon as possible
+		file.buffer = {};
+		file.newlines = {};
+		file.entries = {};
+
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+
+			parsed = i + 1;
+		}
+
+		read_cv.notify_all();
+	}
+
+	for( std::thread& thread : threads ){
+		thread.join();
 	}
+
+	uint64 frequency = std::max<uint64>( gettick_precise_frequency(), 1 );
+
+	ShowInfo( "Loaded '" CL_WHITE "%" PRIuPTR CL_RESET "' NPC files in '" CL_WHITE "%" PRIu64 CL_RESET "' ms using '" CL_WHITE "%" PRIuPTR CL_RESET "' reader threads, waited '" CL_WHITE "%" PRIu64 CL_RESET "' ms for them.\n",
+		files.size(), ( gettick_precise() - start ) / frequency, thread_count, wait / frequency );
+
+	script_cache_save();
 	int32 npc_total = npc_warp + npc_shop + npc_script;
 
 	ShowInfo ("Done loading '" CL_WHITE "%d" CL_RESET "' NPCs:" CL_CLL "\n"
@@ -4320,7 +4587,8 @@ int32 npc_convertlabel_db(DBKey key, DBData *data, va_list ap)
 }
 
 // Skip the contents of a script.
-static const char* npc_skip_script(const char* start, const char* buffer, const char* filepath)
+// Quiet does not report anything, for the reader threads.
+static const char* npc_skip_script(const char* start, const char* buffer, const char* filepath, bool quiet)
 {
 	const char* p;
 	int32 curly_count;
@@ -4332,14 +4600,17 @@ static const char* npc_skip_script(const char* start, const char* buffer, const
 	p = strchr(start,'{');
 	if( p == nullptr )
 	{
-		ShowError("npc_skip_script: Missing left curly in file '%s', line'%d'.", filepath, strline(buffer,start-buffer));
+		if( !quiet )
+			ShowError("npc_skip_script: Missing left curly in file '%s', line'%d'.", filepath, strline(buffer,start-buffer));
 		return nullptr;// can't continue
 	}
 
 	// skip everything
 	for( curly_count = 1; curly_count > 0 ; )
 	{
-		p = skip_space(p+1) ;
+		p = quiet ? npc_lexspace(p+1) : skip_space(p+1);
+		if( p == nullptr )
+			return nullptr;// block comment without end
 		if( *p == '}' )
 		{// right curly
 			--curly_count;
@@ -4356,19 +4627,22 @@ static const char* npc_skip_script(const char* start, const char* buffer, const
 					++p;// escape sequence (not part of a multibyte character)
 				else if( *p == '\0' )
 				{
-					script_error(buffer, filepath, 0, "Unexpected end of string.", p);
+					if( !quiet )
+						script_error(buffer, filepath, 0, "Unexpected end of string.", p);
 					return nullptr;// can't continue
 				}
 				else if( *p == '\n' )
 				{
-					script_error(buffer, filepath, 0, "Unexpected newline at string.", p);
+					if( !quiet )
+						script_error(buffer, filepath, 0, "Unexpected newline at string.", p);
 					return nullptr;// can't continue
 				}
 			}
 		}
 		else if( *p == '\0' )
 		{// end of buffer
-			ShowError("Missing %d right curlys at file '%s', line '%d'.\n", curly_count, filepath, strline(buffer,p-buffer));
+			if( !quiet )
+				ShowError("Missing %d right curlys at file '%s', line '%d'.\n", curly_count, filepath, strline(buffer,p-buffer));
 			return nullptr;// can't continue
 		}
 	}
@@ -4433,7 +4707,7 @@ static const char* npc_parse_script(char* w1, char* w2, char* w3, char* w4, cons
 	if( end == nullptr )
 		return nullptr;// (simple) parse error, don't continue
 
-	script = parse_script(script_start, filepath, strline(buffer,script_start-buffer), SCRIPT_USE_LABEL_DB);
+	script = parse_script(script_start, filepath, npc_srcline(buffer,script_start), SCRIPT_USE_LABEL_DB|SCRIPT_USE_BYTECODE_CACHE);
 	label_list = nullptr;
 	label_list_num = 0;
 	if( script )
@@ -5186,7 +5460,7 @@ static const char* npc_parse_function(char* w1, char* w2, char* w3, char* w4, co
 	if( end == nullptr )
 		return nullptr;// (simple) parse error, don't continue
 
-	script = parse_script(script_start, filepath, strline(buffer,start-buffer), SCRIPT_RETURN_EMPTY_SCRIPT);
+	script = parse_script(script_start, filepath, npc_srcline(buffer,start), SCRIPT_RETURN_EMPTY_SCRIPT|SCRIPT_USE_BYTECODE_CACHE);
 	if( script == nullptr )// parse error, continue
 		return end;
 
@@ -5718,58 +5992,68 @@ static const char* npc_parse_mapflag(char* w1, char* w2, char* w3, char* w4, con
  * @param runOnInit :  should we exec OnInit when it's done ?
  * @return 0:error, 1:success
  */
-int32 npc_parsesrcfile(const char* filepath)
-{
-	if (check_filepath(filepath) != 2) { //this is not a file 
-		ShowDebug("npc_parsesrcfile: Path doesn't seem to be a file skipping it : '%s'.\n", filepath);
-		return 0;
-	} 
-            
-	// read whole file to buffer
-	FILE* fp = fopen(filepath, "rb");
-	if (fp == nullptr) {
-		ShowError("npc_parsesrcfile: File not found '%s'.\n", filepath);
-		return 0;
-	}
-	fseek(fp, 0, SEEK_END);
-	size_t len = ftell(fp);
-	char* buffer = (char*)aMalloc(len+1);
-	fseek(fp, 0, SEEK_SET);
-	len = fread(buffer, 1, len, fp);
-	buffer[len] = '\0';
-	if (ferror(fp)) {
-		ShowError("npc_parsesrcfile: Failed to read file '%s' - %s\n", filepath, strerror(errno));
-		aFree(buffer);
-		fclose(fp);
-		return 0;
-	}
-	fclose(fp);
+/// Parses a NPC source file that was read by npc_readsrcfile.
+/// Registers the NPCs, so it has to run on the main thread and in the order of the files.
+static int32 npc_parsesrcbuffer( s_npc_src_file& file ){
+	const char* filepath = file.path.c_str();
 
-	if ((unsigned char)buffer[0] == 0xEF && (unsigned char)buffer[1] == 0xBB && (unsigned char)buffer[2] == 0xBF) {
-		// UTF-8 BOM. This is most likely an error on the user's part, because:
-		// - BOM is discouraged in UTF-8, and the only place where you see it is Notepad and such.
-		// - It's unlikely that the user wants to use UTF-8 data here, since we don't really support it, nor does the client by default.
-		// - If the user really wants to use UTF-8 (instead of latin1, EUC-KR, SJIS, etc), then they can still do it <without BOM>.
-		// More info at http://unicode.org/faq/utf_bom.html#bom5 and http://en.wikipedia.org/wiki/Byte_order_mark#UTF-8
-		ShowError("npc_parsesrcfile: Detected unsupported UTF-8 BOM in file '%s'. Stopping (please consider using another character set).\n", filepath);
-		aFree(buffer);
-		return 0;
+	switch( file.state ){
+		case NPC_SRC_OK:
+			break;
+		case NPC_SRC_NOT_A_FILE: //this is not a file
+			ShowDebug("npc_parsesrcfile: Path doesn't seem to be a file skipping it : '%s'.\n", filepath);
+			return 0;
+		case NPC_SRC_NOT_FOUND:
+			ShowError("npc_parsesrcfile: File not found '%s'.\n", filepath);
+			return 0;
+		case NPC_SRC_READ_ERROR:
+			ShowError("npc_parsesrcfile: Failed to read file '%s' - %s\n", filepath, strerror(file.error));
+			return 0;
+		case NPC_SRC_UTF8_BOM:
+			// UTF-8 BOM. This is most likely an error on the user's part, because:
+			// - BOM is discouraged in UTF-8, and the only place where you see it is Notepad and such.
+			// - It's unlikely that the user wants to use UTF-8 data here, since we don't really support it, nor does the client by default.
+			// - If the user really wants to use UTF-8 (instead of latin1, EUC-KR, SJIS, etc), then they can still do it <without BOM>.
+			// More info at http://unicode.org/faq/utf_bom.html#bom5 and http://en.wikipedia.org/wiki/Byte_order_mark#UTF-8
+			ShowError("npc_parsesrcfile: Detected unsupported UTF-8 BOM in file '%s'. Stopping (please consider using another character set).\n", filepath);
+			return 0;
 	}
 
+	const char* buffer = file.buffer.data();
+	size_t len = file.buffer.size() - 1;
+	s_npc_src_file* previous = npc_src_current;
+
+	npc_src_current = &file;
+
 	int32 lines = 0;
+	const std::vector<s_npc_src_entry>& entries = file.entries;
+	size_t cursor = 0;
+	const s_npc_src_entry* entry = nullptr; ///< Lexed entry at p, if the reader got there as well
 
 	// parse buffer
-	for ( const char* p = skip_space(buffer); p && *p ; p = skip_space(p) ) {
+	for ( const char* p = entries.empty() ? skip_space(buffer) : buffer + entries[0].offset; p && *p ; p = npc_srcnext(entry, buffer, p) ) {
 		size_t pos[9];
+		size_t count;
 		lines++;
 
-		// w1<TAB>w2<TAB>w3<TAB>w4
-		bool error;
-		size_t count = sv_parse( p, len + buffer - p, 0, '\t', pos, ARRAYLENGTH( pos ), SV_TERMINATE_LF|SV_TERMINATE_CRLF, error );
+		while( cursor < entries.size() && entries[cursor].offset < static_cast<size_t>( p - buffer ) )
+			cursor++;
 
-		if( error ){
-			ShowError("npc_parsesrcfile: Parse error in file '%s', line '%d'. Stopping...\n", filepath, strline(buffer,p-buffer));
-			break;
+		if( cursor < entries.size() && entries[cursor].offset == static_cast<size_t>( p - buffer ) ){
+			entry = &entries[cursor];
+			count = entry->count;
+			memcpy( pos, entry->pos, sizeof( pos ) );
+		}else{
+			entry = nullptr;
+
+			// w1<TAB>w2<TAB>w3<TAB>w4
+			bool error;
+			count = sv_parse( p, len + buffer - p, 0, '\t', pos, ARRAYLENGTH( pos ), SV_TERMINATE_LF|SV_TERMINATE_CRLF, error );
+
+			if( error ){
+				ShowError("npc_parsesrcfile: Parse error in file '%s', line '%d'. Stopping...\n", filepath, strline(buffer,p-buffer));
+				break;
+			}
 		}
 
 		char w1[2048], w2[2048], w3[2048], w4[2048];
@@ -5891,11 +6175,22 @@ int32 npc_parsesrcfile(const char* filepath)
 			p = strchr(p,'\n');// skip and continue
 		}
 	}
-	aFree(buffer);
+
+	npc_src_current = previous;
 
 	return 1;
 }
 
+int32 npc_parsesrcfile(const char* filepath)
+{
+	s_npc_src_file file = {};
+
+	file.path = filepath;
+	npc_readsrcfile( file );
+
+	return npc_parsesrcbuffer( file );
+}
+
 size_t npc_script_event( map_session_data& sd, enum npce_event type ){
 	if (type == NPCE_MAX)
 		return 0;
@@ -15,6 +15,7 @@
 #include <cstdlib> // atoi, strtol, strtoll, exit
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #ifdef PCRE_SUPPORT
@@ -211,6 +212,18 @@ static inline void SETVALUE(unsigned char* buf, int32 i, int32 n)
 	buf[i+2] = GetByte(n, 2);
 }
 
+/// Storage of a variable, resolved from the prefix of its name when the name is added to str_data
+enum e_script_var_scope : uint8 {
+	VAR_SCOPE_CHAR = 0, ///< Permanent character variable (no prefix)
+	VAR_SCOPE_CHAR_TEMP, ///< Temporary character variable ('@')
+	VAR_SCOPE_SERVER, ///< Permanent server variable ('$')
+	VAR_SCOPE_ACCOUNT, ///< Permanent local account variable ('#')
+	VAR_SCOPE_ACCOUNT_GLOBAL, ///< Permanent global account variable ('##')
+	VAR_SCOPE_NPC, ///< NPC variable ('.')
+	VAR_SCOPE_LOCAL, ///< Scope variable ('.@')
+	VAR_SCOPE_INSTANCE, ///< Instance variable ('\'')
+};
+
 // String buffer structures.
 // str_data stores string information
 static struct str_data_struct {
@@ -223,6 +236,9 @@ static struct str_data_struct {
 	int32 next;
 	const char *name;
 	bool deprecated;
+	e_script_var_scope scope; ///< Storage if the name is used as a variable
+	bool is_string; ///< Whether the name ends with '$'
+	bool valid_length; ///< Whether the name fits into the registry
 } *str_data = nullptr;
 static int32 str_data_size = 0; // size of the data
 static int32 str_num = LABEL_START; // next id to be assigned
@@ -247,6 +263,11 @@ static int32 parse_options = 0;
 DBMap* script_get_label_db(void) { return scriptlabel_db; }
 DBMap* script_get_userfunc_db(void) { return userfunc_db; }
 
+// Bytecode cache bookkeeping, see SCRIPT_USE_BYTECODE_CACHE
+static std::vector<int32> parser_names; // ids that went through add_str while parsing a cacheable script
+static bool parser_record_names = false;
+static std::vector<int32> parser_labels; // ids that the last parsed script defined as labels
+
 // important buildin function references for usage in scripts
 static int32 buildin_set_ref = 0;
 static int32 buildin_callsub_ref = 0;
@@ -701,6 +722,24 @@ static int32 search_str(const char* p)
 	return -1;
 }
 
+/// Resolves the storage of a variable from the prefix of its name.
+static e_script_var_scope script_var_scope( const char* name ){
+	switch( name[0] ){
+		case '@':
+			return VAR_SCOPE_CHAR_TEMP;
+		case '$':
+			return VAR_SCOPE_SERVER;
+		case '#':
+			return ( name[1] == '#' ) ? VAR_SCOPE_ACCOUNT_GLOBAL : VAR_SCOPE_ACCOUNT;
+		case '.':
+			return ( name[1] == '@' ) ? VAR_SCOPE_LOCAL : VAR_SCOPE_NPC;
+		case '\'':
+			return VAR_SCOPE_INSTANCE;
+		default:
+			return VAR_SCOPE_CHAR;
+	}
+}
+
 /// Stores a copy of the string and returns its id.
 /// If an identical string is already present, returns its id instead.
 int32 add_str(const char* p)
@@ -719,8 +758,11 @@ int32 add_str(const char* p)
 		int32 i;
 		for( i = str_hash[h]; ; i = str_data[i].next )
 		{
-			if( strcasecmp(get_str(i),p) == 0 )
+			if( strcasecmp(get_str(i),p) == 0 ){
+				if( parser_record_names )
+					parser_names.push_back(i);
 				return i; // string already in list
+			}
 			if( str_data[i].next == 0 )
 				break; // reached the end
 		}
@@ -754,8 +796,14 @@ int32 add_str(const char* p)
 	str_data[str_num].func = nullptr;
 	str_data[str_num].backpatch = -1;
 	str_data[str_num].label = -1;
+	str_data[str_num].scope = script_var_scope(p);
+	str_data[str_num].is_string = ( len > 0 && p[len - 1] == '$' );
+	str_data[str_num].valid_length = script_check_RegistryVariableLength(0, p, nullptr);
 	str_pos += len+1;
 
+	if( parser_record_names )
+		parser_names.push_back(str_num);
+
 	return str_num++;
 }
 
@@ -857,6 +905,7 @@ void set_label(int32 l,int32 pos, const char* script_pos_cur)
 	}
 	str_data[l].type=(str_data[l].type == C_USERFUNC ? C_USERFUNC_POS : C_POS);
 	str_data[l].label=pos;
+	parser_labels.push_back(l);
 	for(i=str_data[l].backpatch;i>=0 && i!=0x00ffffff;){
 		int32 next=GETVALUE(script_buf,i);
 		script_buf[i-1]=(str_data[l].type == C_USERFUNC ? C_USERFUNC_POS : C_POS);
@@ -2475,6 +2524,479 @@ void script_warning(const char* src, const char* file, int32 start_line, const c
 /*==========================================
  * Analysis of the script
  *------------------------------------------*/
+/// Name referenced by a cached script together with the meaning it had when the script was parsed
+struct s_script_cache_name{
+	std::string name;
+	c_op type; ///< C_INT, C_PARAM, C_FUNC, C_POS, C_USERFUNC_POS or C_NAME for variables
+	int64 val; ///< Value of constants and params, position of labels
+};
+
+/// Compiled script stored in the bytecode cache
+struct s_script_cache_entry{
+	uint64 hash; ///< Hash of the parsed source
+	uint32 length; ///< Length of the parsed source
+	std::vector<unsigned char> code; ///< Bytecode, C_NAME operands are indexes into names
+	std::vector<s_script_cache_name> names;
+	std::vector<uint32> labels; ///< Indexes into names of the labels recorded in scriptlabel_db
+	bool used; ///< Whether the entry was used by this server and is saved again
+};
+
+#define SCRIPT_CACHE_MAGIC 0x43424152 // "RABC"
+#define SCRIPT_CACHE_VERSION 1
+
+/// Bytecode cache, key: "<file>:<line>:<options>"
+static std::unordered_map<std::string, s_script_cache_entry> script_cache;
+static bool script_cache_loaded = false;
+static int32 script_cache_hits = 0;
+
+/// Identifies the build and the settings that influence the compiled bytecode.
+static std::string script_cache_build( void ){
+	std::string build = get_git_hash();
+
+	build += " " __DATE__ " " __TIME__;
+	build += script_config.warn_func_mismatch_paramnum ? " 1" : " 0";
+
+	return build;
+}
+
+static uint64 script_cache_hash( const char* src, size_t length ){
+	uint64 hash = 14695981039346656037ULL;
+
+	for( size_t i = 0; i < length; i++ ){
+		hash ^= static_cast<unsigned char>( src[i] );
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static std::string script_cache_key( const char* file, int32 line, int32 options ){
+	return std::string( file ) + ":" + std::to_string( line ) + ":" + std::to_string( options );
+}
+
+/// Calls func with the position of every C_NAME operand in the bytecode.
+template <typename F> static void script_cache_foreachname( unsigned char* buf, int32 size, F func ){
+	for( int32 pos = 0; pos < size; ){
+		switch( get_com( buf, &pos ) ){
+			case C_INT:
+				get_num( buf, &pos );
+				break;
+			case C_POS:
+				pos += 3;
+				break;
+			case C_NAME:
+				func( pos );
+				pos += 3;
+				break;
+			case C_STR:
+				while( buf[pos++] );
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/// Reads the bytecode cache file, if it belongs to this build.
+static void script_cache_read( void ){
+	script_cache_loaded = true;
+
+	if( script_config.bytecode_cache_file[0] == '\0' ){
+		return;
+	}
+
+	FILE* fp = fopen( script_config.bytecode_cache_file, "rb" );
+
+	if( fp == nullptr ){
+		return;
+	}
+
+	std::vector<char> data;
+	char block[65536];
+	size_t n;
+
+	while( ( n = fread( block, 1, sizeof( block ), fp ) ) > 0 ){
+		data.insert( data.end(), block, block + n );
+	}
+
+	fclose( fp );
+
+	size_t pos = 0;
+	bool valid = true;
+
+	auto read = [&]( void* dst, size_t length ){
+		if( !valid || pos + length > data.size() ){
+			valid = false;
+			return;
+		}
+
+		memcpy( dst, &data[pos], length );
+		pos += length;
+	};
+
+	auto read_string = [&]( std::string& str ){
+		uint32 length = 0;
+
+		read( &length, sizeof( length ) );
+
+		if( !valid || pos + length > data.size() ){
+			valid = false;
+			return;
+		}
+
+		str.assign( &data[pos], length );
+		pos += length;
+	};
+
+	uint32 magic = 0, version = 0, count = 0;
+	std::string build;
+
+	read( &magic, sizeof( magic ) );
+	read( &version, sizeof( version ) );
+	read_string( build );
+
+	if( !valid || magic != SCRIPT_CACHE_MAGIC || version != SCRIPT_CACHE_VERSION || build != script_cache_build() ){
+		ShowInfo( "Bytecode cache '" CL_WHITE "%s" CL_RESET "' belongs to a different build, all scripts will be parsed.\n", script_config.bytecode_cache_file );
+		return;
+	}
+
+	read( &count, sizeof( count ) );
+
+	for( uint32 i = 0; valid && i < count; i++ ){
+		std::string key;
+		s_script_cache_entry entry = {};
+		uint32 size = 0;
+
+		read_string( key );
+		read( &entry.hash, sizeof( entry.hash ) );
+		read( &entry.length, sizeof( entry.length ) );
+		read( &size, sizeof( size ) );
+
+		if( !valid || pos + size > data.size() ){
+			valid = false;
+			break;
+		}
+
+		entry.code.assign( data.begin() + pos, data.begin() + pos + size );
+		pos += size;
+
+		read( &size, sizeof( size ) );
+
+		for( uint32 j = 0; valid && j < size; j++ ){
+			s_script_cache_name name;
+			int32 type = 0;
+
+			read_string( name.name );
+			read( &type, sizeof( type ) );
+			read( &name.val, sizeof( name.val ) );
+			name.type = static_cast<c_op>( type );
+			entry.names.push_back( name );
+		}
+
+		read( &size, sizeof( size ) );
+
+		for( uint32 j = 0; valid && j < size; j++ ){
+			uint32 label = 0;
+
+			read( &label, sizeof( label ) );
+
+			if( label >= entry.names.size() ){
+				valid = false;
+			}
+
+			entry.labels.push_back( label );
+		}
+
+		if( valid ){
+			script_cache[key] = std::move( entry );
+		}
+	}
+
+	if( !valid ){
+		ShowWarning( "Bytecode cache '%s' is corrupted, all scripts will be parsed.\n", script_config.bytecode_cache_file );
+		script_cache.clear();
+	}
+}
+
+/// Marks all entries of the bytecode cache as unused before the NPCs are loaded again.
+/// Entries of scripts that are not loaded anymore are dropped by the next script_cache_save.
+void script_cache_prepare( void ){
+	for( auto& it : script_cache ){
+		it.second.used = false;
+	}
+}
+
+/// Writes the entries of the bytecode cache that were used since the last script_cache_prepare.
+/// The cache is written to a temporary file first, so an interrupted write can't leave a truncated cache behind.
+void script_cache_save( void ){
+	if( script_config.bytecode_cache_file[0] == '\0' ){
+		return;
+	}
+
+	std::string data;
+	uint32 count = 0;
+
+	auto write = [&]( const void* src, size_t length ){
+		data.append( static_cast<const char*>( src ), length );
+	};
+
+	auto write_string = [&]( const std::string& str ){
+		uint32 length = static_cast<uint32>( str.size() );
+
+		write( &length, sizeof( length ) );
+		write( str.data(), str.size() );
+	};
+
+	for( const auto& it : script_cache ){
+		if( it.second.used ){
+			count++;
+		}
+	}
+
+	uint32 magic = SCRIPT_CACHE_MAGIC, version = SCRIPT_CACHE_VERSION;
+
+	write( &magic, sizeof( magic ) );
+	write( &version, sizeof( version ) );
+	write_string( script_cache_build() );
+	write( &count, sizeof( count ) );
+
+	for( const auto& it : script_cache ){
+		const s_script_cache_entry& entry = it.second;
+
+		if( !entry.used ){
+			continue;
+		}
+
+		uint32 size = static_cast<uint32>( entry.code.size() );
+
+		write_string( it.first );
+		write( &entry.hash, sizeof( entry.hash ) );
+		write( &entry.length, sizeof( entry.length ) );
+		write( &size, sizeof( size ) );
+		write( entry.code.data(), entry.code.size() );
+
+		size = static_cast<uint32>( entry.names.size() );
+		write( &size, sizeof( size ) );
+
+		for( const s_script_cache_name& name : entry.names ){
+			int32 type = name.type;
+
+			write_string( name.name );
+			write( &type, sizeof( type ) );
+			write( &name.val, sizeof( name.val ) );
+		}
+
+		size = static_cast<uint32>( entry.labels.size() );
+		write( &size, sizeof( size ) );
+		write( entry.labels.data(), entry.labels.size() * sizeof( uint32 ) );
+	}
+
+	std::string tmp_file = std::string( script_config.bytecode_cache_file ) + ".tmp";
+	FILE* fp = fopen( tmp_file.c_str(), "wb" );
+
+	if( fp == nullptr ){
+		ShowError( "Failed to write the bytecode cache '%s'.\n", tmp_file.c_str() );
+		return;
+	}
+
+	bool written = fwrite( data.data(), 1, data.size(), fp ) == data.size();
+
+	if( fclose( fp ) != 0 || !written ){
+		ShowError( "Failed to write the bytecode cache '%s'.\n", tmp_file.c_str() );
+		remove( tmp_file.c_str() );
+		return;
+	}
+
+#ifdef _WIN32
+	remove( script_config.bytecode_cache_file );
+#endif
+	if( rename( tmp_file.c_str(), script_config.bytecode_cache_file ) != 0 ){
+		ShowError( "Failed to replace the bytecode cache '%s' with '%s'.\n", script_config.bytecode_cache_file, tmp_file.c_str() );
+		remove( tmp_file.c_str() );
+		return;
+	}
+
+	ShowStatus( "Done writing '" CL_WHITE "%u" CL_RESET "' scripts to the bytecode cache, '" CL_WHITE "%d" CL_RESET "' were loaded from it.\n", count, script_cache_hits );
+	script_cache_hits = 0;
+}
+
+/// Loads a script from the bytecode cache.
+/// Restores str_data and scriptlabel_db to the state parse_script_ would leave them in.
+/// @return The script buffer or nullptr if the cache has no valid entry for the source
+static unsigned char* script_cache_find( const char* src, const char* file, int32 line, int32 options, int32* size ){
+	if( !script_cache_loaded ){
+		script_cache_read();
+	}
+
+	auto it = script_cache.find( script_cache_key( file, line, options ) );
+
+	if( it == script_cache.end() ){
+		return nullptr;
+	}
+
+	s_script_cache_entry& entry = it->second;
+
+	if( strnlen( src, entry.length ) != entry.length || script_cache_hash( src, entry.length ) != entry.hash ){
+		return nullptr;
+	}
+
+	// without brackets the parser only stops at the end of the source
+	if( ( options&SCRIPT_IGNORE_EXTERNAL_BRACKETS ) && src[entry.length] != '\0' ){
+		return nullptr;
+	}
+
+	// The names must still have the same meaning, otherwise the bytecode would differ
+	std::vector<int32> ids;
+
+	for( const s_script_cache_name& name : entry.names ){
+		int32 id = add_str( name.name.c_str() );
+
+		switch( name.type ){
+			case C_INT:
+			case C_PARAM:
+			case C_FUNC:
+				if( str_data[id].type != name.type || str_data[id].val != name.val ){
+					return nullptr;
+				}
+				break;
+			default:
+				if( str_data[id].type == C_INT || str_data[id].type == C_PARAM || str_data[id].type == C_FUNC ){
+					return nullptr;
+				}
+				break;
+		}
+
+		ids.push_back( id );
+	}
+
+	// labels of the previous script turn into variables, as they would when parsing
+	for( int32 id : parser_labels ){
+		if( str_data[id].type == C_POS || str_data[id].type == C_USERFUNC_POS ){
+			str_data[id].type = C_NAME;
+			str_data[id].label = id;
+			str_data[id].backpatch = -1;
+		}
+	}
+
+	parser_labels.clear();
+
+	for( size_t i = 0; i < entry.names.size(); i++ ){
+		const s_script_cache_name& name = entry.names[i];
+		int32 id = ids[i];
+
+		switch( name.type ){
+			case C_INT:
+			case C_PARAM:
+			case C_FUNC:
+				break;
+			case C_POS:
+			case C_USERFUNC_POS:
+				str_data[id].type = name.type;
+				str_data[id].label = static_cast<int32>( name.val );
+				str_data[id].backpatch = -1;
+				parser_labels.push_back( id );
+				break;
+			default:
+				str_data[id].type = C_NAME;
+				str_data[id].label = id;
+				str_data[id].backpatch = -1;
+				break;
+		}
+	}
+
+	unsigned char* buf;
+
+	CREATE( buf, unsigned char, entry.code.size() );
+	memcpy( buf, entry.code.data(), entry.code.size() );
+
+	script_cache_foreachname( buf, static_cast<int32>( entry.code.size() ), [&]( int32 pos ){
+		SETVALUE( buf, pos, ids[GETVALUE( buf, pos )] );
+	} );
+
+	if( options&SCRIPT_USE_LABEL_DB ){
+		db_clear( scriptlabel_db );
+
+		for( uint32 label : entry.labels ){
+			strdb_iput( scriptlabel_db, get_str( ids[label] ), static_cast<int32>( entry.names[label].val ) );
+		}
+	}
+
+	entry.used = true;
+	script_cache_hits++;
+	*size = static_cast<int32>( entry.code.size() );
+
+	return buf;
+}
+
+/// Stores the script that was just parsed in the bytecode cache.
+static void script_cache_store( const char* src, size_t length, const char* file, int32 line, int32 options ){
+	s_script_cache_entry entry = {};
+	std::unordered_map<int32, uint32> indexes;
+
+	entry.hash = script_cache_hash( src, length );
+	entry.length = static_cast<uint32>( length );
+	entry.code.assign( script_buf, script_buf + script_size );
+	entry.used = true;
+
+	auto index = [&]( int32 id ){
+		auto it = indexes.find( id );
+
+		if( it != indexes.end() ){
+			return it->second;
+		}
+
+		s_script_cache_name name;
+
+		name.name = get_str( id );
+
+		switch( str_data[id].type ){
+			case C_INT:
+			case C_PARAM:
+			case C_FUNC:
+				name.type = str_data[id].type;
+				name.val = str_data[id].val;
+				break;
+			case C_POS:
+			case C_USERFUNC_POS:
+				name.type = str_data[id].type;
+				name.val = str_data[id].label;
+				break;
+			default:
+				name.type = C_NAME;
+				name.val = 0;
+				break;
+		}
+
+		uint32 i = static_cast<uint32>( entry.names.size() );
+
+		entry.names.push_back( name );
+		indexes[id] = i;
+
+		return i;
+	};
+
+	for( int32 id : parser_names ){
+		index( id );
+	}
+
+	script_cache_foreachname( entry.code.data(), static_cast<int32>( entry.code.size() ), [&]( int32 pos ){
+		SETVALUE( entry.code.data(), pos, index( GETVALUE( entry.code.data(), pos ) ) );
+	} );
+
+	if( options&SCRIPT_USE_LABEL_DB ){
+		DBIterator* iter = db_iterator( scriptlabel_db );
+		DBKey key;
+
+		for( iter->first( iter, &key ); dbi_exists( iter ); iter->next( iter, &key ) ){
+			entry.labels.push_back( index( add_str( key.str ) ) );
+		}
+
+		dbi_destroy( iter );
+	}
+
+	script_cache[script_cache_key( file, line, options )] = std::move( entry );
+}
+
 struct script_code* parse_script_( const char *src, const char *file, int32 line, int32 options, const char* src_file, int32 src_line, const char* src_func ){
 	const char *p,*tmpp;
 	int32 i;
@@ -2489,6 +3011,23 @@ struct script_code* parse_script_( const char *src, const char *file, int32 line
 	if( src == nullptr )
 		return nullptr;// empty script
 
+	if( options&SCRIPT_USE_BYTECODE_CACHE ){
+		int32 size;
+		unsigned char* buf = script_cache_find( src, file, line, options, &size );
+
+		if( buf != nullptr ){
+			CREATE2( code, struct script_code, 1, src_file, src_line, src_func );
+			code->script_buf  = buf;
+			code->script_size = size;
+			code->local.vars = nullptr;
+			code->local.arrays = nullptr;
+			return code;
+		}
+
+		parser_names.clear();
+		parser_record_names = true;
+	}
+
 	memset(&syntax,0,sizeof(syntax));
 
 	script_buf=(unsigned char *)aMalloc(SCRIPT_BLOCK_SIZE*sizeof(unsigned char));
@@ -2516,6 +3055,7 @@ struct script_code* parse_script_( const char *src, const char *file, int32 line
 			if(str_data[j].type == C_NOP) str_data[j].type = C_NAME;
 		for(j=0; j<size; j++)
 			linkdb_final(&syntax.curly[j].case_label);
+		parser_record_names = false;
 		return nullptr;
 	}
 
@@ -2530,6 +3070,7 @@ struct script_code* parse_script_( const char *src, const char *file, int32 line
 			script_pos  = 0;
 			script_size = 0;
 			script_buf  = nullptr;
+			parser_record_names = false;
 			return nullptr;
 		}
 		end = '\0';
@@ -2545,12 +3086,14 @@ struct script_code* parse_script_( const char *src, const char *file, int32 line
 			script_pos  = 0;
 			script_size = 0;
 			script_buf  = nullptr;
+			parser_record_names = false;
 			return nullptr;
 		}
 		end = '}';
 	}
 
 	// clear references of labels, variables and internal functions
+	parser_labels.clear();
 	for(i=LABEL_START;i<str_num;i++){
 		if(
 			str_data[i].type==C_POS || str_data[i].type==C_NAME ||
@@ -2655,6 +3198,12 @@ struct script_code* parse_script_( const char *src, const char *file, int32 line
 	}
 #endif
 
+	if( parser_record_names ){
+		parser_record_names = false;
+		// the closing bracket is part of the parsed source
+		script_cache_store( src, p - src + ( end == '}' ? 1 : 0 ), file, line, options );
+	}
+
 	CREATE2( code, struct script_code, 1, src_file, src_line, src_func );
 	code->script_buf  = script_buf;
 	code->script_size = script_size;
@@ -2679,6 +3228,11 @@ static bool script_rid2sd_( struct script_state *st, map_session_data** sd, cons
 	}
 }
 
+/// Whether the variable is stored on the attached player.
+static inline bool script_var_needs_player( e_script_var_scope scope ){
+	return scope != VAR_SCOPE_SERVER && scope != VAR_SCOPE_NPC && scope != VAR_SCOPE_LOCAL && scope != VAR_SCOPE_INSTANCE;
+}
+
 /**
  * Dereferences a variable/constant, replacing it with a copy of the value.
  * @param st Script state
@@ -2687,21 +3241,17 @@ static bool script_rid2sd_( struct script_state *st, map_session_data** sd, cons
  */
 struct script_data *get_val_(struct script_state* st, struct script_data* data, map_session_data *sd)
 {
-	const char* name;
-	char prefix;
-	char postfix;
-
 	if( !data_isreference(data) )
 		return data;// not a variable/constant
 
-	name = reference_getname(data);
-	prefix = name[0];
-	postfix = name[strlen(name) - 1];
+	// scope and type were resolved when the name was added
+	const struct str_data_struct& var = str_data[reference_getid(data)];
+	const char* name = str_buf + var.str;
 
 	//##TODO use reference_tovariable(data) when it's confirmed that it works [FlavioJS]
-	if( !reference_toconstant(data) && not_server_variable(prefix) ) {
+	if( !reference_toconstant(data) && script_var_needs_player(var.scope) ) {
 		if( sd == nullptr && !script_rid2sd(sd) ) {// needs player attached
-			if( postfix == '$' ) {// string variable
+			if( var.is_string ) {// string variable
 				ShowWarning("script:get_val: cannot access player variable '%s', defaulting to \"\"\n", name);
 				data->type = C_CONSTSTR;
 				data->u.str = const_cast<char *>("");
@@ -2714,25 +3264,26 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 		}
 	}
 
-	if( postfix == '$' ) {// string variable
+	if( var.is_string ) {// string variable
 
-		switch( prefix ) {
-			case '@':
+		switch( var.scope ) {
+			case VAR_SCOPE_CHAR_TEMP:
 				data->u.str = pc_readregstr(sd, data->u.num);
 				break;
-			case '$':
+			case VAR_SCOPE_SERVER:
 				data->u.str = mapreg_readregstr(data->u.num);
 				break;
-			case '#':
-				if( name[1] == '#' )
-					data->u.str = pc_readaccountreg2str(sd, data->u.num);// global
-				else
-					data->u.str = pc_readaccountregstr(sd, data->u.num);// local
+			case VAR_SCOPE_ACCOUNT_GLOBAL:
+				data->u.str = pc_readaccountreg2str(sd, data->u.num);
+				break;
+			case VAR_SCOPE_ACCOUNT:
+				data->u.str = pc_readaccountregstr(sd, data->u.num);
 				break;
-			case '.':
+			case VAR_SCOPE_NPC:
+			case VAR_SCOPE_LOCAL:
 				{
 					struct DBMap* n = data->ref ?
-							data->ref->vars : name[1] == '@' ?
+							data->ref->vars : var.scope == VAR_SCOPE_LOCAL ?
 							st->stack->scope.vars : // instance/scope variable
 							st->script->local.vars; // npc variable
 					if( n )
@@ -2741,7 +3292,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 						data->u.str = nullptr;
 				}
 				break;
-			case '\'':
+			case VAR_SCOPE_INSTANCE:
 				{
 					struct DBMap* n = nullptr;
 					if (data->ref)
@@ -2782,23 +3333,24 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 		} else if( reference_toparam(data) ) {
 			data->u.num = pc_readparam(sd, reference_getparamtype(data));
 		} else
-			switch( prefix ) {
-				case '@':
+			switch( var.scope ) {
+				case VAR_SCOPE_CHAR_TEMP:
 					data->u.num = pc_readreg(sd, data->u.num);
 					break;
-				case '$':
+				case VAR_SCOPE_SERVER:
 					data->u.num = mapreg_readreg(data->u.num);
 					break;
-				case '#':
-					if( name[1] == '#' )
-						data->u.num = pc_readaccountreg2(sd, data->u.num);// global
-					else
-						data->u.num = pc_readaccountreg(sd, data->u.num);// local
+				case VAR_SCOPE_ACCOUNT_GLOBAL:
+					data->u.num = pc_readaccountreg2(sd, data->u.num);
+					break;
+				case VAR_SCOPE_ACCOUNT:
+					data->u.num = pc_readaccountreg(sd, data->u.num);
 					break;
-				case '.':
+				case VAR_SCOPE_NPC:
+				case VAR_SCOPE_LOCAL:
 					{
 						struct DBMap* n = data->ref ?
-								data->ref->vars : name[1] == '@' ?
+								data->ref->vars : var.scope == VAR_SCOPE_LOCAL ?
 								st->stack->scope.vars : // instance/scope variable
 								st->script->local.vars; // npc variable
 						if( n )
@@ -2807,7 +3359,7 @@ struct script_data *get_val_(struct script_state* st, struct script_data* data,
 							data->u.num = 0;
 					}
 					break;
-				case '\'':
+				case VAR_SCOPE_INSTANCE:
 					{
 						struct DBMap* n = nullptr;
 						if (data->ref)
@@ -3141,29 +3693,32 @@ void script_array_update(struct reg_db *src, int64 num, bool empty)
  * TODO: return values are screwed up, have been for some time (reaad: years), e.g. some functions return 1 failure and success.
  *------------------------------------------*/
 bool set_reg_str( struct script_state* st, map_session_data* sd, int64 num, const char* name, const char* value, struct reg_db *ref ){
-	char prefix = name[0];
-	size_t vlen = 0;
+	// scope and type were resolved when the name was added
+	const struct str_data_struct& var = str_data[script_getvarid( num )];
 
-	if( !script_check_RegistryVariableLength( 0, name, &vlen ) ){
-		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, vlen );
+	if( !var.valid_length ){
+		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, strlen( name ) );
 		return false;
 	}
 
-	if( !is_string_variable( name ) ){
+	if( !var.is_string ){
 		// integer variable
 		return false;
 	}
 
-	switch( prefix ){
-		case '@':
+	switch( var.scope ){
+		case VAR_SCOPE_CHAR_TEMP:
 			pc_setregstr( sd, num, value );
 			return true;
-		case '$':
+		case VAR_SCOPE_SERVER:
 			return mapreg_setregstr( num, value );
-		case '#':
-			return ( name[1] == '#' ) ? pc_setaccountreg2str( sd, num, value ) : pc_setaccountregstr( sd, num, value );
-		case '.': {
-				struct reg_db *n = ( ref ) ? ref : ( name[1] == '@' ) ? &st->stack->scope : &st->script->local;
+		case VAR_SCOPE_ACCOUNT_GLOBAL:
+			return pc_setaccountreg2str( sd, num, value );
+		case VAR_SCOPE_ACCOUNT:
+			return pc_setaccountregstr( sd, num, value );
+		case VAR_SCOPE_NPC:
+		case VAR_SCOPE_LOCAL: {
+				struct reg_db *n = ( ref ) ? ref : ( var.scope == VAR_SCOPE_LOCAL ) ? &st->stack->scope : &st->script->local;
 
 				if( n ){
 					if( value[0] ){
@@ -3182,7 +3737,7 @@ bool set_reg_str( struct script_state* st, map_session_data* sd, int64 num, cons
 				}
 			}
 			return true;
-		case '\'': {
+		case VAR_SCOPE_INSTANCE: {
 				struct reg_db *src = nullptr;
 
 				if( ref ){
@@ -3221,21 +3776,21 @@ bool set_reg_str( struct script_state* st, map_session_data* sd, int64 num, cons
 }
 
 bool set_reg_num( struct script_state* st, map_session_data* sd, int64 num, const char* name, int64 value, struct reg_db *ref ){
-	char prefix = name[0];
-	size_t vlen = 0;
+	// scope and type were resolved when the name was added
+	const struct str_data_struct& var = str_data[script_getvarid( num )];
 
-	if( !script_check_RegistryVariableLength( 0, name, &vlen ) ){
-		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, vlen );
+	if( !var.valid_length ){
+		ShowError( "set_reg: Variable name length is too long (aid: %d, cid: %d): '%s' sz=%" PRIuPTR "\n", sd ? sd->status.account_id : -1, sd ? sd->status.char_id : -1, name, strlen( name ) );
 		return false;
 	}
 
-	if( is_string_variable( name ) ){
+	if( var.is_string ){
 		// string variable
 		return false;
 	}
 
-	if( str_data[script_getvarid(num)].type == C_PARAM ){
-		if( pc_setparam( sd, str_data[script_getvarid(num)].val, value ) == 0 ){
+	if( var.type == C_PARAM ){
+		if( pc_setparam( sd, var.val, value ) == 0 ){
 			if( st != nullptr ) {
 				ShowError( "script_set_reg: failed to set param '%s' to %" PRId64 ".\n", name, value );
 				script_reportsrc( st );
@@ -3248,16 +3803,19 @@ bool set_reg_num( struct script_state* st, map_session_data* sd, int64 num, cons
 		return true;
 	}
 
-	switch( prefix ){
-		case '@':
+	switch( var.scope ){
+		case VAR_SCOPE_CHAR_TEMP:
 			pc_setreg( sd, num, value );
 			return true;
-		case '$':
+		case VAR_SCOPE_SERVER:
 			return mapreg_setreg( num, value );
-		case '#':
-			return ( name[1] == '#' ) ? pc_setaccountreg2(sd, num, value) :	pc_setaccountreg( sd, num, value );
-		case '.': {
-				struct reg_db *n = ( ref ) ? ref : ( name[1] == '@' ) ? &st->stack->scope : &st->script->local;
+		case VAR_SCOPE_ACCOUNT_GLOBAL:
+			return pc_setaccountreg2( sd, num, value );
+		case VAR_SCOPE_ACCOUNT:
+			return pc_setaccountreg( sd, num, value );
+		case VAR_SCOPE_NPC:
+		case VAR_SCOPE_LOCAL: {
+				struct reg_db *n = ( ref ) ? ref : ( var.scope == VAR_SCOPE_LOCAL ) ? &st->stack->scope : &st->script->local;
 
 				if( n ){
 					if( value != 0 ){
@@ -3276,7 +3834,7 @@ bool set_reg_num( struct script_state* st, map_session_data* sd, int64 num, cons
 				}
 			}
 			return true;
-		case '\'': {
+		case VAR_SCOPE_INSTANCE: {
 				struct reg_db *src = nullptr;
 
 				if( ref ){
@@ -4027,13 +4585,6 @@ static void script_check_buildin_argtype(struct script_state* st, int32 func)
 		}
 		else
 		{
-			const char* name = nullptr;
-
-			if( data_isreference(data) )
-			{// get name for variables to determine the type they refer to
-				name = reference_getname(data);
-			}
-
 			switch( type )
 			{
 				case 'v':
@@ -4045,7 +4596,7 @@ static void script_check_buildin_argtype(struct script_state* st, int32 func)
 					}
 					break;
 				case 's':
-					if( !data_isstring(data) && !( data_isreference(data) && is_string_variable(name) ) )
+					if( !data_isstring(data) && !( data_isreference(data) && reference_isstring(data) ) )
 					{// string
 						ShowWarning("Unexpected type for argument %d. Expected string.\n", idx-1);
 						script_reportdata(data);
@@ -4053,7 +4604,7 @@ static void script_check_buildin_argtype(struct script_state* st, int32 func)
 					}
 					break;
 				case 'i':
-					if( !data_isint(data) && !( data_isreference(data) && ( reference_toparam(data) || reference_toconstant(data) || !is_string_variable(name) ) ) )
+					if( !data_isint(data) && !( data_isreference(data) && ( reference_toparam(data) || reference_toconstant(data) || !reference_isstring(data) ) ) )
 					{// int32 ( params and constants are always int32 )
 						ShowWarning("Unexpected type for argument %d. Expected number.\n", idx-1);
 						script_reportdata(data);
@@ -4564,6 +5115,9 @@ int32 script_config_read(const char *cfgName)
 		else if(strcmpi(w1,"warn_func_mismatch_argtypes")==0) {
 			script_config.warn_func_mismatch_argtypes = config_switch(w2);
 		}
+		else if(strcmpi(w1,"bytecode_cache")==0) {
+			safestrncpy(script_config.bytecode_cache_file, w2, sizeof(script_config.bytecode_cache_file));
+		}
 		else if(strcmpi(w1,"import")==0){
 			script_config_read(w2);
 		}
@@ -4811,6 +5365,7 @@ void do_final_script() {
 	mapreg_final();
 
 	db_destroy(scriptlabel_db);
+	script_cache.clear();
 	userfunc_db->destroy(userfunc_db, db_script_free_code_sub);
 	autobonus_db->destroy(autobonus_db, db_script_free_code_sub);
 
@@ -109,6 +109,8 @@
 #define reference_getconstant(data) ( str_data[reference_getid(data)].val )
 /// Returns the type of param
 #define reference_getparamtype(data) ( str_data[reference_getid(data)].val )
+/// Returns if the reference is a string variable (name ends with '$')
+#define reference_isstring(data) ( str_data[reference_getid(data)].is_string )
 
 /// Composes the uid of a reference from the id and the index
 #define reference_uid(id,idx) ( (int64) ((uint64)(id) & 0xFFFFFFFF) | ((uint64)(idx) << 32) )
@@ -216,6 +218,9 @@ struct Script_Config {
 
 	// Navigation related
 	const char* navi_generate_name;
+
+	// Bytecode cache file of NPC scripts, empty if disabled
+	char bytecode_cache_file[256];
 };
 extern struct Script_Config script_config;
 
@@ -354,7 +359,8 @@ struct script_array {
 enum script_parse_options {
 	SCRIPT_USE_LABEL_DB = 0x1,// records labels in scriptlabel_db
 	SCRIPT_IGNORE_EXTERNAL_BRACKETS = 0x2,// ignores the check for {} brackets around the script
-	SCRIPT_RETURN_EMPTY_SCRIPT = 0x4// returns the script object instead of nullptr for empty scripts
+	SCRIPT_RETURN_EMPTY_SCRIPT = 0x4,// returns the script object instead of nullptr for empty scripts
+	SCRIPT_USE_BYTECODE_CACHE = 0x8// loads the bytecode from the bytecode cache if the source is unchanged
 };
 
 enum e_monsterinfo_types : uint8 {
@@ -2301,6 +2307,8 @@ void run_script_main(struct script_state *st);
 
 void script_stop_scriptinstances(struct script_code *code);
 void script_free_code(struct script_code* code);
+void script_cache_prepare( void );
+void script_cache_save( void );
 void script_free_vars(struct DBMap *storage);
 struct script_state* script_alloc_state(struct script_code* rootscript, int32 pos, int32 rid, int32 oid);
 void script_free_state(struct script_state* st);
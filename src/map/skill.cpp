@@ -138,7 +138,7 @@ uint16 skill_name2id(const char* name) {
  * @return AEGIS Skill name
  **/
 const char* skill_get_name( uint16 skill_id ) {
-	return skill_db.find(skill_id)->name;
+	return skill_db.findRaw(skill_id)->name;
 }
 
 /**
@@ -147,23 +147,30 @@ const char* skill_get_name( uint16 skill_id ) {
  * @return English Skill name
  **/
 const char* skill_get_desc( uint16 skill_id ) {
-	return skill_db.find(skill_id)->desc;
+	return skill_db.findRaw(skill_id)->desc;
 }
 
-static bool skill_check(uint16 id) {
-	if (id == 0 || skill_get_index(id) == 0)
-		return false;
-	return true;
+/**
+ * Skill for the read-only accessors below, without copying the shared pointer
+ * @param id: Skill ID
+ * @return Skill or nullptr if it is undefined
+ **/
+static const s_skill_db* skill_get_db(uint16 id) {
+	if (id == 0)
+		return nullptr;
+	return skill_db.get_by_index(skill_get_index(id));
 }
 
 #define skill_get(id, var) do {\
-	if (!skill_check(id))\
+	const s_skill_db* skill = skill_get_db(id);\
+	if (skill == nullptr)\
 		return 0;\
 	return var;\
 } while(0)
 
 #define skill_get_lv(id, lv, arrvar) do {\
-	if (!skill_check(id))\
+	const s_skill_db* skill = skill_get_db(id);\
+	if (skill == nullptr)\
 		return 0;\
 	int32 lv_idx = min(lv, MAX_SKILL_LEVEL) - 1;\
 	if (lv > MAX_SKILL_LEVEL && arrvar[lv_idx] > 1 && lv_idx > 1) {\
@@ -176,54 +183,54 @@ static bool skill_check(uint16 id) {
 } while(0)
 
 // Skill DB
-e_damage_type skill_get_hit( uint16 skill_id )                     { if (!skill_check(skill_id)) return DMG_NORMAL; return skill_db.find(skill_id)->hit; }
-int32 skill_get_inf( uint16 skill_id )                               { skill_get(skill_id, skill_db.find(skill_id)->inf); }
-int32 skill_get_ele( uint16 skill_id , uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->element); }
-int32 skill_get_max( uint16 skill_id )                               { skill_get(skill_id, skill_db.find(skill_id)->max); }
-int32 skill_get_range( uint16 skill_id , uint16 skill_lv )           { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->range); }
-int32 skill_get_splash_( uint16 skill_id , uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->splash);  }
-int32 skill_get_num( uint16 skill_id ,uint16 skill_lv )              { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->num); }
-int32 skill_get_cast( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->cast); }
-int32 skill_get_delay( uint16 skill_id ,uint16 skill_lv )            { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->delay); }
-int32 skill_get_walkdelay( uint16 skill_id ,uint16 skill_lv )        { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->walkdelay); }
-int32 skill_get_time( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->upkeep_time); }
-int32 skill_get_time2( uint16 skill_id ,uint16 skill_lv )            { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->upkeep_time2); }
-int32 skill_get_castdef( uint16 skill_id )                           { skill_get(skill_id, skill_db.find(skill_id)->cast_def_rate); }
-int32 skill_get_castcancel( uint16 skill_id )                        { skill_get(skill_id, skill_db.find(skill_id)->castcancel); }
-int32 skill_get_maxcount( uint16 skill_id ,uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->maxcount); }
-int32 skill_get_blewcount( uint16 skill_id ,uint16 skill_lv )        { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->blewcount); }
-int32 skill_get_castnodex( uint16 skill_id )                         { skill_get(skill_id, skill_db.find(skill_id)->castnodex); }
-int32 skill_get_delaynodex( uint16 skill_id )                        { skill_get(skill_id, skill_db.find(skill_id)->delaynodex); }
-int32 skill_get_nocast ( uint16 skill_id )                           { skill_get(skill_id, skill_db.find(skill_id)->nocast); }
-int32 skill_get_type( uint16 skill_id )                              { skill_get(skill_id, skill_db.find(skill_id)->skill_type); }
-int32 skill_get_unit_id ( uint16 skill_id )                          { skill_get(skill_id, skill_db.find(skill_id)->unit_id); }
-int32 skill_get_unit_id2 ( uint16 skill_id )                         { skill_get(skill_id, skill_db.find(skill_id)->unit_id2); }
-int32 skill_get_unit_interval( uint16 skill_id )                     { skill_get(skill_id, skill_db.find(skill_id)->unit_interval); }
-int32 skill_get_unit_range( uint16 skill_id, uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->unit_range); }
-int32 skill_get_unit_target( uint16 skill_id )                       { skill_get(skill_id, skill_db.find(skill_id)->unit_target&BCT_ALL); }
-int32 skill_get_unit_bl_target( uint16 skill_id )                    { skill_get(skill_id, skill_db.find(skill_id)->unit_target&BL_ALL); }
-int32 skill_get_unit_layout_type( uint16 skill_id ,uint16 skill_lv ) { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->unit_layout_type); }
-int32 skill_get_cooldown( uint16 skill_id, uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->cooldown); }
-int32 skill_get_giveap( uint16 skill_id, uint16 skill_lv )           { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->giveap); }
+e_damage_type skill_get_hit( uint16 skill_id )                     { const s_skill_db* skill = skill_get_db(skill_id); if (skill == nullptr) return DMG_NORMAL; return skill->hit; }
+int32 skill_get_inf( uint16 skill_id )                               { skill_get(skill_id, skill->inf); }
+int32 skill_get_ele( uint16 skill_id , uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill->element); }
+int32 skill_get_max( uint16 skill_id )                               { skill_get(skill_id, skill->max); }
+int32 skill_get_range( uint16 skill_id , uint16 skill_lv )           { skill_get_lv(skill_id, skill_lv, skill->range); }
+int32 skill_get_splash_( uint16 skill_id , uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill->splash);  }
+int32 skill_get_num( uint16 skill_id ,uint16 skill_lv )              { skill_get_lv(skill_id, skill_lv, skill->num); }
+int32 skill_get_cast( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill->cast); }
+int32 skill_get_delay( uint16 skill_id ,uint16 skill_lv )            { skill_get_lv(skill_id, skill_lv, skill->delay); }
+int32 skill_get_walkdelay( uint16 skill_id ,uint16 skill_lv )        { skill_get_lv(skill_id, skill_lv, skill->walkdelay); }
+int32 skill_get_time( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill->upkeep_time); }
+int32 skill_get_time2( uint16 skill_id ,uint16 skill_lv )            { skill_get_lv(skill_id, skill_lv, skill->upkeep_time2); }
+int32 skill_get_castdef( uint16 skill_id )                           { skill_get(skill_id, skill->cast_def_rate); }
+int32 skill_get_castcancel( uint16 skill_id )                        { skill_get(skill_id, skill->castcancel); }
+int32 skill_get_maxcount( uint16 skill_id ,uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill->maxcount); }
+int32 skill_get_blewcount( uint16 skill_id ,uint16 skill_lv )        { skill_get_lv(skill_id, skill_lv, skill->blewcount); }
+int32 skill_get_castnodex( uint16 skill_id )                         { skill_get(skill_id, skill->castnodex); }
+int32 skill_get_delaynodex( uint16 skill_id )                        { skill_get(skill_id, skill->delaynodex); }
+int32 skill_get_nocast ( uint16 skill_id )                           { skill_get(skill_id, skill->nocast); }
+int32 skill_get_type( uint16 skill_id )                              { skill_get(skill_id, skill->skill_type); }
+int32 skill_get_unit_id ( uint16 skill_id )                          { skill_get(skill_id, skill->unit_id); }
+int32 skill_get_unit_id2 ( uint16 skill_id )                         { skill_get(skill_id, skill->unit_id2); }
+int32 skill_get_unit_interval( uint16 skill_id )                     { skill_get(skill_id, skill->unit_interval); }
+int32 skill_get_unit_range( uint16 skill_id, uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill->unit_range); }
+int32 skill_get_unit_target( uint16 skill_id )                       { skill_get(skill_id, skill->unit_target&BCT_ALL); }
+int32 skill_get_unit_bl_target( uint16 skill_id )                    { skill_get(skill_id, skill->unit_target&BL_ALL); }
+int32 skill_get_unit_layout_type( uint16 skill_id ,uint16 skill_lv ) { skill_get_lv(skill_id, skill_lv, skill->unit_layout_type); }
+int32 skill_get_cooldown( uint16 skill_id, uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill->cooldown); }
+int32 skill_get_giveap( uint16 skill_id, uint16 skill_lv )           { skill_get_lv(skill_id, skill_lv, skill->giveap); }
 #ifdef RENEWAL_CAST
-int32 skill_get_fixed_cast( uint16 skill_id ,uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->fixed_cast); }
+int32 skill_get_fixed_cast( uint16 skill_id ,uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill->fixed_cast); }
 #endif
 // Skill requirements
-int32 skill_get_hp( uint16 skill_id ,uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.hp); }
-int32 skill_get_mhp( uint16 skill_id ,uint16 skill_lv )              { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.mhp); }
-int32 skill_get_sp( uint16 skill_id ,uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.sp); }
-int32 skill_get_ap( uint16 skill_id, uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.ap); }
-int32 skill_get_hp_rate( uint16 skill_id, uint16 skill_lv )          { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.hp_rate); }
-int32 skill_get_sp_rate( uint16 skill_id, uint16 skill_lv )          { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.sp_rate); }
-int32 skill_get_ap_rate(uint16 skill_id, uint16 skill_lv)            { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.ap_rate); }
-int32 skill_get_zeny( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.zeny); }
-int32 skill_get_weapontype( uint16 skill_id )                        { skill_get(skill_id, skill_db.find(skill_id)->require.weapon); }
-int32 skill_get_ammotype( uint16 skill_id )                          { skill_get(skill_id, skill_db.find(skill_id)->require.ammo); }
-int32 skill_get_ammo_qty( uint16 skill_id, uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.ammo_qty); }
-int32 skill_get_state( uint16 skill_id )                             { skill_get(skill_id, skill_db.find(skill_id)->require.state); }
-size_t skill_get_status_count( uint16 skill_id )                   { skill_get(skill_id, skill_db.find(skill_id)->require.status.size()); }
-int32 skill_get_spiritball( uint16 skill_id, uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill_db.find(skill_id)->require.spiritball); }
-sc_type skill_get_sc(int16 skill_id)                               { if (!skill_check(skill_id)) return SC_NONE; return skill_db.find(skill_id)->sc; }
+int32 skill_get_hp( uint16 skill_id ,uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill->require.hp); }
+int32 skill_get_mhp( uint16 skill_id ,uint16 skill_lv )              { skill_get_lv(skill_id, skill_lv, skill->require.mhp); }
+int32 skill_get_sp( uint16 skill_id ,uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill->require.sp); }
+int32 skill_get_ap( uint16 skill_id, uint16 skill_lv )               { skill_get_lv(skill_id, skill_lv, skill->require.ap); }
+int32 skill_get_hp_rate( uint16 skill_id, uint16 skill_lv )          { skill_get_lv(skill_id, skill_lv, skill->require.hp_rate); }
+int32 skill_get_sp_rate( uint16 skill_id, uint16 skill_lv )          { skill_get_lv(skill_id, skill_lv, skill->require.sp_rate); }
+int32 skill_get_ap_rate(uint16 skill_id, uint16 skill_lv)            { skill_get_lv(skill_id, skill_lv, skill->require.ap_rate); }
+int32 skill_get_zeny( uint16 skill_id ,uint16 skill_lv )             { skill_get_lv(skill_id, skill_lv, skill->require.zeny); }
+int32 skill_get_weapontype( uint16 skill_id )                        { skill_get(skill_id, skill->require.weapon); }
+int32 skill_get_ammotype( uint16 skill_id )                          { skill_get(skill_id, skill->require.ammo); }
+int32 skill_get_ammo_qty( uint16 skill_id, uint16 skill_lv )         { skill_get_lv(skill_id, skill_lv, skill->require.ammo_qty); }
+int32 skill_get_state( uint16 skill_id )                             { skill_get(skill_id, skill->require.state); }
+size_t skill_get_status_count( uint16 skill_id )                   { skill_get(skill_id, skill->require.status.size()); }
+int32 skill_get_spiritball( uint16 skill_id, uint16 skill_lv )       { skill_get_lv(skill_id, skill_lv, skill->require.spiritball); }
+sc_type skill_get_sc(int16 skill_id)                               { const s_skill_db* skill = skill_get_db(skill_id); if (skill == nullptr) return SC_NONE; return skill->sc; }
 
 int32 skill_get_splash( uint16 skill_id , uint16 skill_lv ) {
 	int32 splash = skill_get_splash_(skill_id, skill_lv);
@@ -237,7 +244,7 @@ bool skill_get_nk_(uint16 skill_id, std::vector<e_skill_nk> nk) {
 		return false;
 	}
 
-	std::shared_ptr<s_skill_db> skill = skill_db.find(skill_id);
+	const s_skill_db* skill = skill_db.findRaw(skill_id);
 
 	if (!skill)
 		return false;
@@ -255,7 +262,7 @@ bool skill_get_inf2_(uint16 skill_id, std::vector<e_skill_inf2> inf2) {
 		return false;
 	}
 
-	std::shared_ptr<s_skill_db> skill = skill_db.find(skill_id);
+	const s_skill_db* skill = skill_db.findRaw(skill_id);
 
 	if (!skill)
 		return false;
@@ -273,7 +280,7 @@ bool skill_get_unit_flag_(uint16 skill_id, std::vector<e_skill_unit_flag> unit)
 		return false;
 	}
 
-	std::shared_ptr<s_skill_db> skill = skill_db.find(skill_id);
+	const s_skill_db* skill = skill_db.findRaw(skill_id);
 
 	if (!skill)
 		return false;
@@ -22979,10 +22986,13 @@ static int32 skill_unit_timer_sub(DBKey key, DBData *data, va_list ap)
 
 	if( unit->range >= 0 && group->interval != -1 )
 	{
-		if (skill_get_unit_flag(group->skill_id, UF_PATHCHECK))
-			map_foreachinrange(skill_unit_timer_sub_onplace, bl, unit->range, group->bl_flag, bl, tick);
-		else
-			map_foreachinallrange(skill_unit_timer_sub_onplace, bl, unit->range, group->bl_flag, bl, tick);
+		// Skip the area search if nothing the unit could affect is near it
+		if (map_hasblock(unit->m, bl->x - unit->range, bl->y - unit->range, bl->x + unit->range, bl->y + unit->range, group->bl_flag)) {
+			if (skill_get_unit_flag(group->skill_id, UF_PATHCHECK))
+				map_foreachinrange(skill_unit_timer_sub_onplace, bl, unit->range, group->bl_flag, bl, tick);
+			else
+				map_foreachinallrange(skill_unit_timer_sub_onplace, bl, unit->range, group->bl_flag, bl, tick);
+		}
 
 		if(unit->range == -1) //Unit disabled, but it should not be deleted yet.
 			group->unit_id = UNT_USED_TRAPS;
@@ -26300,6 +26310,7 @@ uint64 SkillDatabase::parseBodyNode(const ryml::NodeRef& node) {
 	if (!exists) {
 		this->put(skill_id, skill);
 		this->skilldb_id2idx[skill_id] = this->skill_num;
+		this->skilldb_idx2skill.push_back(skill.get());
 		this->skill_num++;
 	}
 
@@ -26309,6 +26320,7 @@ uint64 SkillDatabase::parseBodyNode(const ryml::NodeRef& node) {
 void SkillDatabase::clear() {
 	TypesafeCachedYamlDatabase::clear();
 	memset( this->skilldb_id2idx, 0, sizeof( this->skilldb_id2idx ) );
+	this->skilldb_idx2skill.assign( 1, nullptr );
 	this->skill_num = 1;
 }
 
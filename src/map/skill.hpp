@@ -6,6 +6,7 @@
 
 #include <array>
 #include <bitset>
+#include <vector>
 
 #include <common/cbasetypes.hpp>
 #include <common/database.hpp>
@@ -314,6 +315,8 @@ class SkillDatabase : public TypesafeCachedYamlDatabase <uint16, s_skill_db> {
 private:
 	/// Skill ID to Index lookup: skill_index = skill_get_index(skill_id) - [FWI] 20160423 the whole index thing should be removed.
 	uint16 skilldb_id2idx[(UINT16_MAX + 1)];
+	/// Skill index to skill lookup, read by the skill_get_* accessors without touching the reference counts
+	std::vector<const s_skill_db*> skilldb_idx2skill;
 	/// Skill count, also as last index
 	uint16 skill_num;
 
@@ -331,6 +334,11 @@ public:
 
 	// Additional
 	uint16 get_index( uint16 skill_id, bool silent, const char* func, const char* file, int32 line );
+
+	/// Skill of an index from get_index, nullptr for index 0
+	const s_skill_db* get_by_index( uint16 idx ){
+		return this->skilldb_idx2skill[idx];
+	}
 };
 
 extern SkillDatabase skill_db;
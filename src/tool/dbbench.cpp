@@ -0,0 +1,261 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/db.hpp>
+#include <common/showmsg.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_dbbench{
+		class DbbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				DbbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_dbbench;
+
+/// Nanoseconds per operation of a database
+struct s_bench_result{
+	double insert, lookup, miss, iterate, remove;
+};
+
+std::vector<uint32> bench_sizes = { 1000, 10000, 100000, 500000 };
+uint32 bench_lookups = 1000000;
+uint32 bench_rounds = 3;
+uint32 bench_errors = 0;
+
+template <typename F> static double bench_time( uint32 operations, F&& function ){
+	auto start = std::chrono::steady_clock::now();
+
+	function();
+
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / std::max<uint32>( operations, 1 );
+}
+
+/// Inserts, looks up, iterates and removes the keys with the way the map-server uses the databases: keys are put in
+/// the order objects are created, lookups hit random existing keys and the entries are removed in random order.
+/// The values are the positions of the keys, every lookup is checked.
+template <typename K> static s_bench_result bench_db( DBMap* db, const std::vector<K>& keys, const std::vector<K>& missing, DBKey (*to_key)( const K& ), std::mt19937& generator ){
+	s_bench_result result = {};
+	std::vector<uint32> order( bench_lookups );
+	std::vector<size_t> removal( keys.size() );
+	uintptr_t sum = 0;
+
+	std::uniform_int_distribution<uint32> position( 0, static_cast<uint32>( keys.size() - 1 ) );
+
+	for( uint32& i : order ){
+		i = position( generator );
+	}
+
+	for( size_t i = 0; i < removal.size(); i++ ){
+		removal[i] = i;
+	}
+
+	std::shuffle( removal.begin(), removal.end(), generator );
+
+	result.insert = bench_time( static_cast<uint32>( keys.size() ), [&](){
+		for( size_t i = 0; i < keys.size(); i++ ){
+			db->put( db, to_key( keys[i] ), db_ui2data( static_cast<uint32>( i ) ), nullptr );
+		}
+	} );
+
+	result.lookup = bench_time( bench_lookups, [&](){
+		for( uint32 i : order ){
+			DBData* data = db->get( db, to_key( keys[i] ) );
+
+			if( data == nullptr || db_data2ui( data ) != i ){
+				bench_errors++;
+			}
+		}
+	} );
+
+	result.miss = bench_time( static_cast<uint32>( missing.size() ), [&](){
+		for( const K& key : missing ){
+			if( db->get( db, to_key( key ) ) != nullptr ){
+				bench_errors++;
+			}
+		}
+	} );
+
+	result.iterate = bench_time( static_cast<uint32>( keys.size() ), [&](){
+		DBIterator* iter = db_iterator( db );
+		size_t count = 0;
+
+		for( DBData* data = iter->first( iter, nullptr ); iter->exists( iter ); data = iter->next( iter, nullptr ) ){
+			sum += db_data2ui( data );
+			count++;
+		}
+
+		dbi_destroy( iter );
+
+		if( count != keys.size() ){
+			bench_errors++;
+		}
+	} );
+
+	result.remove = bench_time( static_cast<uint32>( keys.size() ), [&](){
+		for( size_t i : removal ){
+			if( db->remove( db, to_key( keys[i] ), nullptr ) != 1 ){
+				bench_errors++;
+			}
+		}
+	} );
+
+	if( db_size( db ) != 0 || sum != static_cast<uintptr_t>( keys.size() ) * ( keys.size() - 1 ) / 2 ){
+		bench_errors++;
+	}
+
+	return result;
+}
+
+static void bench_print( const char* name, DBOptions options, const s_bench_result& result ){
+	ShowInfo( "  %-6s %-5s | insert %7.1f | lookup %7.1f | miss %7.1f | iterate %6.1f | remove %7.1f\n",
+		name, ( options & DB_OPT_HASH_INDEX ) ? "index" : "tree",
+		result.insert, result.lookup, result.miss, result.iterate, result.remove );
+}
+
+/// Measures a database with and without the index, keeping the best of the rounds
+template <typename K> static void bench_compare( const char* name, uint32 size, const std::vector<K>& keys, const std::vector<K>& missing, DBMap* (*alloc)( DBOptions ), DBKey (*to_key)( const K& ) ){
+	for( DBOptions options : { DB_OPT_BASE, DB_OPT_HASH_INDEX } ){
+		s_bench_result best = {};
+
+		for( uint32 round = 0; round < bench_rounds; round++ ){
+			std::mt19937 generator( size + round );
+			DBMap* db = alloc( options );
+			s_bench_result result = bench_db( db, keys, missing, to_key, generator );
+
+			db_destroy( db );
+
+			if( round == 0 ){
+				best = result;
+			}else{
+				best.insert = std::min( best.insert, result.insert );
+				best.lookup = std::min( best.lookup, result.lookup );
+				best.miss = std::min( best.miss, result.miss );
+				best.iterate = std::min( best.iterate, result.iterate );
+				best.remove = std::min( best.remove, result.remove );
+			}
+		}
+
+		bench_print( name, options, best );
+	}
+}
+
+static DBMap* bench_int_alloc( DBOptions options ){
+	return idb_alloc( options );
+}
+
+static DBKey bench_int_key( const int32& key ){
+	return db_i2key( key );
+}
+
+static DBMap* bench_str_alloc( DBOptions options ){
+	return strdb_alloc( options, 0 );
+}
+
+static DBKey bench_str_key( const std::string& key ){
+	return db_str2key( key.c_str() );
+}
+
+static void bench_run( uint32 size ){
+	std::mt19937 generator( size );
+	std::vector<int32> ids( size ), missing_ids( size );
+	std::vector<std::string> names( size ), missing_names( size );
+
+	// Like the object ids of the map-server: sequential from a start value, with gaps from removed objects
+	for( uint32 i = 0, id = 110000000; i < size; i++ ){
+		ids[i] = id;
+		missing_ids[i] = id + 1;
+		id += 2 + generator() % 3;
+	}
+
+	// Like the names of script variables: a prefix and a number
+	for( uint32 i = 0; i < size; i++ ){
+		names[i] = "$bench_var_" + std::to_string( generator() ) + "_" + std::to_string( i );
+		missing_names[i] = "$bench_var_" + std::to_string( i );
+	}
+
+	ShowStatus( "%u entries, ns per operation (best of %u rounds):\n", size, bench_rounds );
+	bench_compare<int32>( "int", size, ids, missing_ids, bench_int_alloc, bench_int_key );
+	bench_compare<std::string>( "string", size, names, missing_names, bench_str_alloc, bench_str_key );
+}
+
+/// Needed by the core, the tool does not read the console
+int32 parse_console( const char* buf ){
+	return 0;
+}
+
+void display_helpscreen( bool do_exit ){
+	ShowInfo( "Usage: dbbench [-sizes <n,n,...>] [-lookups <n>] [-rounds <n>]\n" );
+	ShowInfo( "Compares DBMap databases with and without DB_OPT_HASH_INDEX for int and string keys.\n" );
+	ShowInfo( "  -sizes <n,...>    amounts of entries to measure (default: 1000,10000,100000,500000)\n" );
+	ShowInfo( "  -lookups <n>      lookups of existing keys per measurement (default: %u)\n", bench_lookups );
+	ShowInfo( "  -rounds <n>       rounds per measurement, the best one is shown (default: %u)\n", bench_rounds );
+
+	if( do_exit ){
+		exit( EXIT_SUCCESS );
+	}
+}
+
+bool DbbenchTool::initialize( int32 argc, char* argv[] ){
+	this->set_run_once( true );
+
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-sizes" ) == 0 && i + 1 < argc ){
+			const char* p = argv[++i];
+			char* end;
+
+			bench_sizes.clear();
+
+			for( uint32 size = static_cast<uint32>( strtoul( p, &end, 10 ) ); end != p; size = static_cast<uint32>( strtoul( p, &end, 10 ) ) ){
+				bench_sizes.push_back( size );
+				p = ( *end == ',' ) ? end + 1 : end;
+			}
+		}else if( strcmp( argv[i], "-lookups" ) == 0 && i + 1 < argc ){
+			bench_lookups = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-rounds" ) == 0 && i + 1 < argc ){
+			bench_rounds = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else{
+			display_helpscreen( false );
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_rounds == 0 || std::find( bench_sizes.begin(), bench_sizes.end(), 0 ) != bench_sizes.end() ){
+		display_helpscreen( false );
+		return false;
+	}
+
+	for( uint32 size : bench_sizes ){
+		bench_run( size );
+	}
+
+	if( bench_errors > 0 ){
+		ShowError( "%u lookups or removals returned a wrong result.\n", bench_errors );
+		return false;
+	}
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<DbbenchTool>( argc, argv );
+}
@@ -0,0 +1,226 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/showmsg.hpp>
+
+#include <map/log.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_logconv{
+		class LogconvTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				LogconvTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_logconv;
+
+std::string line_timestamp_format = "%m/%d/%Y %H:%M:%S";
+std::vector<std::string> log_files;
+
+// Reads a little endian number of a binary log record
+static uint64 read_number( const unsigned char* p, size_t bytes ){
+	uint64 value = 0;
+
+	for( size_t i = 0; i < bytes; i++ ){
+		value |= static_cast<uint64>( p[i] ) << ( i * 8 );
+	}
+
+	return value;
+}
+
+// Prints the fields of a record through the text layout of its type
+static bool print_record( FILE* out, e_log_file_record type, const unsigned char* data, size_t length ){
+	const char* layout = log_file_layouts[type];
+	const char* text = layout;
+	const char* spec;
+	e_log_file_field field;
+	size_t pos = 0;
+
+	while( ( field = log_file_next_field( layout, spec ) ) != LOG_FIELD_END ){
+		// literal text up to the conversion
+		fwrite( text, 1, spec - text, out );
+		text = layout;
+
+		std::string conversion( spec, layout - spec );
+
+		switch( field ){
+			case LOG_FIELD_INT:
+			case LOG_FIELD_INT64:
+				if( pos + sizeof( int64 ) > length ){
+					return false;
+				}
+
+				if( field == LOG_FIELD_INT ){
+					fprintf( out, conversion.c_str(), static_cast<int>( read_number( data + pos, sizeof( int64 ) ) ) );
+				}else{
+					fprintf( out, conversion.c_str(), read_number( data + pos, sizeof( int64 ) ) );
+				}
+				pos += sizeof( int64 );
+				break;
+
+			case LOG_FIELD_STRING: {
+				if( pos + sizeof( uint16 ) > length ){
+					return false;
+				}
+
+				size_t len = static_cast<size_t>( read_number( data + pos, sizeof( uint16 ) ) );
+
+				pos += sizeof( uint16 );
+
+				if( pos + len > length ){
+					return false;
+				}
+
+				std::string str( reinterpret_cast<const char*>( data + pos ), len );
+
+				fprintf( out, conversion.c_str(), str.c_str() );
+				pos += len;
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	fputs( text, out );
+
+	return pos == length;
+}
+
+// Converts a binary log file, appending its lines to the text log
+static bool convert_file( const std::string& filename ){
+	const std::string suffix = ".bin";
+	std::string outname;
+
+	if( filename.length() > suffix.length() && filename.compare( filename.length() - suffix.length(), suffix.length(), suffix ) == 0 ){
+		outname = filename.substr( 0, filename.length() - suffix.length() );
+	}else{
+		outname = filename + ".txt";
+	}
+
+	FILE* in = fopen( filename.c_str(), "rb" );
+
+	if( in == nullptr ){
+		ShowError( "Could not open binary log '%s'.\n", filename.c_str() );
+		return false;
+	}
+
+	const size_t signature_length = strlen( LOG_FILE_BINARY_SIGNATURE );
+	char signature[16];
+
+	if( fread( signature, 1, signature_length + 1, in ) != signature_length + 1 || memcmp( signature, LOG_FILE_BINARY_SIGNATURE, signature_length ) != 0 ){
+		ShowError( "'%s' is not a binary log file.\n", filename.c_str() );
+		fclose( in );
+		return false;
+	}
+
+	if( signature[signature_length] != LOG_FILE_BINARY_VERSION ){
+		ShowError( "'%s' has the unsupported format version %d.\n", filename.c_str(), signature[signature_length] );
+		fclose( in );
+		return false;
+	}
+
+	FILE* out = fopen( outname.c_str(), "a" );
+
+	if( out == nullptr ){
+		ShowError( "Could not open text log '%s'.\n", outname.c_str() );
+		fclose( in );
+		return false;
+	}
+
+	unsigned char header[LOG_FILE_RECORD_HEADER_SIZE];
+	std::vector<unsigned char> data;
+	uint64 count = 0;
+	bool result = true;
+
+	while( fread( header, 1, sizeof( header ), in ) == sizeof( header ) ){
+		e_log_file_record type = static_cast<e_log_file_record>( header[0] );
+		time_t time = static_cast<time_t>( read_number( header + sizeof( uint8 ), sizeof( int64 ) ) );
+		size_t length = static_cast<size_t>( read_number( header + sizeof( uint8 ) + sizeof( int64 ), sizeof( uint16 ) ) );
+
+		data.resize( length );
+
+		if( type >= LOG_FILE_MAX || fread( data.data(), 1, length, in ) != length ){
+			ShowError( "'%s' is damaged after %" PRIu64 " records.\n", filename.c_str(), count );
+			result = false;
+			break;
+		}
+
+		char timestring[255];
+
+		strftime( timestring, sizeof( timestring ), line_timestamp_format.c_str(), localtime( &time ) );
+		fprintf( out, "%s - ", timestring );
+
+		if( !print_record( out, type, data.data(), length ) ){
+			ShowError( "'%s' has a malformed record after %" PRIu64 " records.\n", filename.c_str(), count );
+			result = false;
+			break;
+		}
+
+		count++;
+	}
+
+	fclose( out );
+	fclose( in );
+
+	ShowStatus( "Converted %" PRIu64 " records of '%s' into '%s'.\n", count, filename.c_str(), outname.c_str() );
+
+	return result;
+}
+
+static void display_helpscreen( void ){
+	ShowInfo( "Usage: logconv [-timestamp <format>] <file.bin>...\n" );
+	ShowInfo( "Appends the lines of each binary log file to the text log named like it without '.bin'.\n" );
+	ShowInfo( "  -timestamp <format>  strftime format of the line timestamps (default: %s)\n", line_timestamp_format.c_str() );
+}
+
+bool LogconvTool::initialize( int32 argc, char* argv[] ){
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-timestamp" ) == 0 && i + 1 < argc ){
+			line_timestamp_format = argv[++i];
+		}else if( strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0 ){
+			display_helpscreen();
+			return true;
+		}else{
+			log_files.push_back( argv[i] );
+		}
+	}
+
+	if( log_files.empty() ){
+		display_helpscreen();
+		return false;
+	}
+
+	bool result = true;
+
+	for( const std::string& filename : log_files ){
+		if( !convert_file( filename ) ){
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<LogconvTool>( argc, argv );
+}
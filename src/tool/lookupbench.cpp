@@ -0,0 +1,169 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/database.hpp>
+#include <common/showmsg.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_lookupbench{
+		class LookupbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				LookupbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_lookupbench;
+
+/// Stand-in for a database entry, about the size of a skill entry
+struct s_lookupbench_entry{
+	int32 value;
+	char payload[1020];
+};
+
+/// Database keyed like the skill database, the cache is indexed by the key
+class LookupbenchCachedDatabase : public TypesafeCachedYamlDatabase<uint16, s_lookupbench_entry>{
+public:
+	LookupbenchCachedDatabase() : TypesafeCachedYamlDatabase( "LOOKUPBENCH_DB", 1 ){
+
+	}
+
+	const std::string getDefaultLocation() override{
+		return "";
+	}
+
+	uint64 parseBodyNode( const ryml::NodeRef& node ) override{
+		return 0;
+	}
+};
+
+/// Database without a cache, lookups go through the unordered_map
+class LookupbenchDatabase : public TypesafeYamlDatabase<uint32, s_lookupbench_entry>{
+public:
+	LookupbenchDatabase() : TypesafeYamlDatabase( "LOOKUPBENCH_DB", 1 ){
+
+	}
+
+	const std::string getDefaultLocation() override{
+		return "";
+	}
+
+	uint64 parseBodyNode( const ryml::NodeRef& node ) override{
+		return 0;
+	}
+};
+
+uint32 bench_entries = 1500;
+uint32 bench_lookups = 1000000;
+uint32 bench_rounds = 20;
+
+/// Runs a lookup over all keys for every round and prints the average time of a single lookup.
+/// The sum of the looked up values keeps the compiler from dropping the lookups.
+template <typename F> static void bench_run( const char* name, const std::vector<uint32>& keys, F lookup ){
+	int64 sum = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for( uint32 round = 0; round < bench_rounds; round++ ){
+		for( uint32 key : keys ){
+			sum += lookup( key );
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>( end - start ).count() / ( static_cast<double>( keys.size() ) * bench_rounds );
+
+	ShowInfo( "%-32s %8.2f ns per lookup (checksum %" PRId64 ")\n", name, ns, sum );
+}
+
+static void display_helpscreen( void ){
+	ShowInfo( "Usage: lookupbench [-entries <n>] [-lookups <n>] [-rounds <n>]\n" );
+	ShowInfo( "Compares the lookup functions of the YAML databases.\n" );
+	ShowInfo( "  -entries <n>  entries in each database (default: %u)\n", bench_entries );
+	ShowInfo( "  -lookups <n>  random keys looked up per round (default: %u)\n", bench_lookups );
+	ShowInfo( "  -rounds <n>   rounds over all keys (default: %u)\n", bench_rounds );
+}
+
+bool LookupbenchTool::initialize( int32 argc, char* argv[] ){
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-entries" ) == 0 && i + 1 < argc ){
+			bench_entries = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-lookups" ) == 0 && i + 1 < argc ){
+			bench_lookups = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-rounds" ) == 0 && i + 1 < argc ){
+			bench_rounds = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else{
+			display_helpscreen();
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_entries == 0 || bench_entries > UINT16_MAX || bench_lookups == 0 || bench_rounds == 0 ){
+		display_helpscreen();
+		return false;
+	}
+
+	LookupbenchCachedDatabase cached_db;
+	LookupbenchDatabase map_db;
+	// flat table of raw pointers, like the one of the skill database
+	std::vector<const s_lookupbench_entry*> table( bench_entries + 1, nullptr );
+
+	for( uint32 key = 1; key <= bench_entries; key++ ){
+		std::shared_ptr<s_lookupbench_entry> entry = std::make_shared<s_lookupbench_entry>();
+
+		entry->value = static_cast<int32>( key );
+		cached_db.put( static_cast<uint16>( key ), entry );
+		map_db.put( key, entry );
+		table[key] = entry.get();
+	}
+
+	cached_db.loadingFinished();
+
+	// random keys, so the lookups don't profit from a predictable pattern
+	std::mt19937 generator( 1 );
+	std::uniform_int_distribution<uint32> distribution( 1, bench_entries );
+	std::vector<uint32> keys( bench_lookups );
+
+	for( uint32& key : keys ){
+		key = distribution( generator );
+	}
+
+	ShowStatus( "Looking up %u random keys of %u entries, %u rounds.\n", bench_lookups, bench_entries, bench_rounds );
+
+	bench_run( "cached find (shared_ptr)", keys, [&cached_db]( uint32 key ){
+		return cached_db.find( static_cast<uint16>( key ) )->value;
+	} );
+	bench_run( "cached findRaw", keys, [&cached_db]( uint32 key ){
+		return cached_db.findRaw( static_cast<uint16>( key ) )->value;
+	} );
+	bench_run( "uncached find (shared_ptr)", keys, [&map_db]( uint32 key ){
+		return map_db.find( key )->value;
+	} );
+	bench_run( "uncached findRaw", keys, [&map_db]( uint32 key ){
+		return map_db.findRaw( key )->value;
+	} );
+	bench_run( "flat table", keys, [&table]( uint32 key ){
+		return table[key]->value;
+	} );
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<LookupbenchTool>( argc, argv );
+}
@@ -39,6 +39,7 @@ std::string grf_list_file = "conf/grf-files.txt";
 std::string map_list_file = "map_index.txt";
 std::string map_cache_file;
 int32 rebuild = 0;
+int32 raw = 0;
 
 FILE *map_cache_fp;
 
@@ -65,6 +66,36 @@ struct map_info {
 	int32 len;
 };
 
+// This is the main header of the uncompressed map cache, must match the map-server
+struct raw_header {
+	char magic[4];
+	uint32 version;
+	uint32 map_count;
+	uint32 index_offset;
+} raw_header;
+
+// This is the index entry of every map in the uncompressed map cache, must match the map-server
+struct raw_info {
+	char name[MAP_NAME_LENGTH];
+	int16 xs;
+	int16 ys;
+	uint32 offset;
+};
+
+#define RAW_MAGIC "RAMC"
+#define RAW_VERSION 1
+// The terrain of every map starts at a multiple of this, so it can be mapped by pages
+#define RAW_ALIGNMENT 4096
+
+// Terrain flags of a cell in the uncompressed map cache, must match e_map_terrain of the map-server
+enum e_raw_terrain : uint8 {
+	RAW_TERRAIN_WALKABLE = 0x1,
+	RAW_TERRAIN_SHOOTABLE = 0x2,
+	RAW_TERRAIN_WATER = 0x4,
+};
+
+std::vector<struct raw_info> raw_index;
+
 
 // Reads a map from GRF's GAT and RSW files
 int32 read_map(char *name, struct map_data *m)
@@ -151,6 +182,58 @@ void cache_map(char *name, struct map_data *m)
 	return;
 }
 
+// Converts a gat type to the terrain flags, like the map-server does
+uint8 gat2terrain(unsigned char gat)
+{
+	switch( gat ) {
+		case 0: case 2: case 4: case 6: return RAW_TERRAIN_WALKABLE|RAW_TERRAIN_SHOOTABLE;
+		case 1: return 0;
+		case 3: return RAW_TERRAIN_WALKABLE|RAW_TERRAIN_SHOOTABLE|RAW_TERRAIN_WATER;
+		case 5: return RAW_TERRAIN_SHOOTABLE;
+		default:
+			ShowWarning("gat2terrain: unrecognized gat type '%d'\n", gat);
+			return 0;
+	}
+}
+
+// Adds a map to the uncompressed cache
+void cache_map_raw(char *name, struct map_data *m)
+{
+	struct raw_info info = {};
+	size_t num_cells = (size_t)m->xs*(size_t)m->ys;
+	long pos = ftell(map_cache_fp);
+
+	// Pad to the next page
+	for( ; pos % RAW_ALIGNMENT; pos++ )
+		fputc(0, map_cache_fp);
+
+	for( size_t xy = 0; xy < num_cells; xy++ )
+		m->cells[xy] = gat2terrain(m->cells[xy]);
+
+	if (strlen(name) > MAP_NAME_LENGTH) // It does not hurt to warn that there are maps with name longer than allowed.
+		ShowWarning ("Map name '%s' size '%" PRIuPTR "' is too long. Truncating to '%d'.\n", name, strlen(name), MAP_NAME_LENGTH);
+	strncpy(info.name, name, MAP_NAME_LENGTH);
+	info.xs = m->xs;
+	info.ys = m->ys;
+	info.offset = (uint32)pos;
+
+	fwrite(m->cells, 1, num_cells, map_cache_fp);
+	raw_index.push_back(info);
+
+	aFree(m->cells);
+}
+
+// Checks whether a map is already in the uncompressed cache
+bool find_map_raw(char *name)
+{
+	for( const auto &info : raw_index ) {
+		if( strncmp(name, info.name, MAP_NAME_LENGTH) == 0 )
+			return true;
+	}
+
+	return false;
+}
+
 // Checks whether a map is already is the cache
 int32 find_map(char *name)
 {
@@ -199,6 +282,8 @@ void process_args(int32 argc, char *argv[])
 				map_cache_file = argv[i];
 		} else if(strcmp(argv[i], "-rebuild") == 0)
 			rebuild = 1;
+		else if(strcmp(argv[i], "-raw") == 0)
+			raw = 1;
 	}
 
 }
@@ -210,6 +295,13 @@ bool MapcacheTool::initialize( int32 argc, char* argv[] ){
 	// Process the command-line arguments
 	process_args(argc, argv);
 
+	// The uncompressed map cache is always rebuilt
+	if (raw) {
+		if (map_cache_file == std::string(db_path) + "/" + std::string(DBPATH) + "map_cache.dat")
+			map_cache_file = std::string(db_path) + "/" + std::string(DBPATH) + "map_cache_raw.dat";
+		rebuild = 1;
+	}
+
 	ShowStatus("Initializing grfio with %s\n", grf_list_file.c_str());
 	grfio_init(grf_list_file.c_str());
 
@@ -223,12 +315,16 @@ bool MapcacheTool::initialize( int32 argc, char* argv[] ){
 		} else
 			fclose(map_cache_fp);
 	}
+	// A rebuild is written to a temporary file that replaces the map cache when it is complete.
+	// Running map-servers keep map_cache_raw.dat mapped, truncating it in place would crash them.
+	std::string output_file = rebuild ? map_cache_file + ".tmp" : map_cache_file;
+
 	if(rebuild)
-		map_cache_fp = fopen(map_cache_file.c_str(), "w+b");
+		map_cache_fp = fopen(output_file.c_str(), "w+b");
 	else
-		map_cache_fp = fopen(map_cache_file.c_str(), "r+b");
+		map_cache_fp = fopen(output_file.c_str(), "r+b");
 	if(map_cache_fp == nullptr) {
-		ShowError("Failure when opening map cache file %s\n", map_cache_file.c_str());
+		ShowError("Failure when opening map cache file %s\n", output_file.c_str());
 		return false;
 	}
 
@@ -243,11 +339,21 @@ bool MapcacheTool::initialize( int32 argc, char* argv[] ){
 		list = fopen(filename.c_str(), "r");
 		if (list == nullptr) {
 			ShowError("Failure when opening maps list file %s\n", filename.c_str());
+			fclose(map_cache_fp);
+			if (rebuild)
+				remove(output_file.c_str());
 			return false;
 		}
 
 		// Initialize the main header
-		if (rebuild) {
+		if (raw) {
+			if (ftell(map_cache_fp) == 0) {
+				// The header is rewritten with the final values when closing
+				memcpy(raw_header.magic, RAW_MAGIC, sizeof(raw_header.magic));
+				raw_header.version = RAW_VERSION;
+				fwrite(&raw_header, sizeof(struct raw_header), 1, map_cache_fp);
+			}
+		} else if (rebuild) {
 			header.file_size = sizeof(struct main_header);
 			header.map_count = 0;
 		} else {
@@ -276,10 +382,13 @@ bool MapcacheTool::initialize( int32 argc, char* argv[] ){
 
 			name[MAP_NAME_LENGTH_EXT - 1] = '\0';
 			remove_extension(name);
-			if (find_map(name))
+			if (raw ? find_map_raw(name) : find_map(name))
 				ShowInfo("Map '" CL_WHITE "%s" CL_RESET "' already in cache.\n", name);
 			else if (read_map(name, &map)) {
-				cache_map(name, &map);
+				if (raw)
+					cache_map_raw(name, &map);
+				else
+					cache_map(name, &map);
 				ShowInfo("Map '" CL_WHITE "%s" CL_RESET "' successfully cached.\n", name);
 			}
 			else
@@ -293,9 +402,38 @@ bool MapcacheTool::initialize( int32 argc, char* argv[] ){
 
 	// Write the main header and close the map cache
 	ShowStatus("Closing map cache: %s\n", map_cache_file.c_str());
-	fseek(map_cache_fp, 0, SEEK_SET);
-	fwrite(&header, sizeof(struct main_header), 1, map_cache_fp);
-	fclose(map_cache_fp);
+	if (raw) {
+		// The index follows the terrain of the last map
+		fseek(map_cache_fp, 0, SEEK_END);
+		raw_header.map_count = (uint32)raw_index.size();
+		raw_header.index_offset = (uint32)ftell(map_cache_fp);
+		if (!raw_index.empty())
+			fwrite(raw_index.data(), sizeof(struct raw_info), raw_index.size(), map_cache_fp);
+		fseek(map_cache_fp, 0, SEEK_SET);
+		fwrite(&raw_header, sizeof(struct raw_header), 1, map_cache_fp);
+		header.map_count = (uint16)raw_index.size();
+	} else {
+		fseek(map_cache_fp, 0, SEEK_SET);
+		fwrite(&header, sizeof(struct main_header), 1, map_cache_fp);
+	}
+	if (fclose(map_cache_fp) != 0) {
+		ShowError("Failure when writing map cache file %s\n", output_file.c_str());
+		if (rebuild)
+			remove(output_file.c_str());
+		return false;
+	}
+
+	if (rebuild) {
+		// Map-servers that mapped the old file keep using it until they restart
+#ifdef _WIN32
+		remove(map_cache_file.c_str());
+#endif
+		if (rename(output_file.c_str(), map_cache_file.c_str()) != 0) {
+			ShowError("Failure when replacing map cache file %s with %s\n", map_cache_file.c_str(), output_file.c_str());
+			remove(output_file.c_str());
+			return false;
+		}
+	}
 
 	ShowStatus("Finalizing grfio\n");
 	grfio_final();
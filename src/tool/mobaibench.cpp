@@ -0,0 +1,285 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/showmsg.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_mobaibench{
+		class MobaibenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				MobaibenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_mobaibench;
+
+// Same values as the map-server: BLOCK_SIZE of map.cpp, ACTIVE_AI_GROUP_SIZE and ACTIVE_AI_RANGE of mob.cpp
+// and the default area_size of the battle configuration
+#define BENCH_BLOCK_SIZE 8
+#define BENCH_GROUP_SIZE 8
+#define BENCH_RANGE ( 14 + 4 )
+#define BENCH_SPOTTED_SIZE 5
+
+struct s_bench_object{
+	int16 x, y;
+};
+
+struct s_bench_mob : s_bench_object{
+	uint32 spotted[BENCH_SPOTTED_SIZE];
+	uint32 active_tick;
+	uint64 state;
+};
+
+/// Map with the objects sorted into blocks, like map_data::block_mob
+struct s_bench_map{
+	int16 xs, ys, bxs, bys;
+	std::vector<std::vector<s_bench_mob*>> blocks;
+};
+
+struct s_bench_result{
+	double ms; ///< time of a pass
+	uint64 scanned; ///< monsters visited by the area scans
+	uint64 thinks; ///< hard AI runs
+};
+
+uint32 bench_map_size = 300;
+uint32 bench_crowd_size = 40;
+uint32 bench_mobs = 1000;
+uint32 bench_think_cost = 500;
+uint32 bench_passes = 50;
+std::vector<uint32> bench_players = { 1, 10, 50, 100, 200, 400 };
+
+/// Stand-in for mob_ai_sub_hard, a fixed amount of work per run
+static void bench_think( s_bench_mob& md ){
+	uint64 state = md.state;
+
+	for( uint32 i = 0; i < bench_think_cost; i++ ){
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	}
+
+	md.state = state;
+}
+
+/// Stand-in for mob_add_spotted
+static void bench_spotted( s_bench_mob& md, uint32 char_id ){
+	for( uint32& id : md.spotted ){
+		if( id == char_id || id == 0 ){
+			id = char_id;
+			return;
+		}
+	}
+
+	md.spotted[char_id % BENCH_SPOTTED_SIZE] = char_id;
+}
+
+static bool bench_in_range( const s_bench_object& a, const s_bench_object& b, int32 range ){
+	return std::abs( a.x - b.x ) <= range && std::abs( a.y - b.y ) <= range;
+}
+
+/// Calls func for every monster in an area, like map_foreachinarea
+template <typename F> static void bench_foreachinarea( s_bench_map& map, int32 x0, int32 y0, int32 x1, int32 y1, uint64& scanned, F func ){
+	x0 = std::max( x0, 0 );
+	y0 = std::max( y0, 0 );
+	x1 = std::min( x1, map.xs - 1 );
+	y1 = std::min( y1, map.ys - 1 );
+
+	for( int32 by = y0 / BENCH_BLOCK_SIZE; by <= y1 / BENCH_BLOCK_SIZE; by++ ){
+		for( int32 bx = x0 / BENCH_BLOCK_SIZE; bx <= x1 / BENCH_BLOCK_SIZE; bx++ ){
+			for( s_bench_mob* md : map.blocks[bx + by * map.bxs] ){
+				scanned++;
+
+				if( md->x >= x0 && md->x <= x1 && md->y >= y0 && md->y <= y1 ){
+					func( *md );
+				}
+			}
+		}
+	}
+}
+
+/// One area scan per player, each monster thinks once per player around it
+static void bench_pass_per_player( s_bench_map& map, std::vector<s_bench_object>& players, s_bench_result& result ){
+	for( size_t i = 0; i < players.size(); i++ ){
+		s_bench_object& sd = players[i];
+
+		bench_foreachinarea( map, sd.x - BENCH_RANGE, sd.y - BENCH_RANGE, sd.x + BENCH_RANGE, sd.y + BENCH_RANGE, result.scanned, [&]( s_bench_mob& md ){
+			bench_spotted( md, static_cast<uint32>( i + 1 ) );
+			bench_think( md );
+			result.thinks++;
+		} );
+	}
+}
+
+/// Players are grouped by square and share an area scan, each monster thinks once
+static void bench_pass_grouped( s_bench_map& map, std::vector<s_bench_object>& players, uint32 tick, s_bench_result& result ){
+	std::vector<std::pair<uint32, uint32>> groups;
+	std::vector<s_bench_mob*> active;
+
+	for( size_t i = 0; i < players.size(); i++ ){
+		groups.emplace_back( ( players[i].y / BENCH_GROUP_SIZE ) << 16 | ( players[i].x / BENCH_GROUP_SIZE ), static_cast<uint32>( i ) );
+	}
+
+	std::sort( groups.begin(), groups.end() );
+
+	for( size_t i = 0, j; i < groups.size(); i = j ){
+		int32 x0 = players[groups[i].second].x, y0 = players[groups[i].second].y, x1 = x0, y1 = y0;
+
+		for( j = i + 1; j < groups.size() && groups[j].first == groups[i].first; j++ ){
+			s_bench_object& sd = players[groups[j].second];
+
+			x0 = std::min<int32>( x0, sd.x );
+			y0 = std::min<int32>( y0, sd.y );
+			x1 = std::max<int32>( x1, sd.x );
+			y1 = std::max<int32>( y1, sd.y );
+		}
+
+		bench_foreachinarea( map, x0 - BENCH_RANGE, y0 - BENCH_RANGE, x1 + BENCH_RANGE, y1 + BENCH_RANGE, result.scanned, [&]( s_bench_mob& md ){
+			bool spotted = false;
+
+			for( size_t k = i; k < j; k++ ){
+				if( bench_in_range( players[groups[k].second], md, BENCH_RANGE ) ){
+					bench_spotted( md, groups[k].second + 1 );
+					spotted = true;
+				}
+			}
+
+			if( spotted && md.active_tick != tick ){
+				md.active_tick = tick;
+				active.push_back( &md );
+			}
+		} );
+	}
+
+	for( s_bench_mob* md : active ){
+		bench_think( *md );
+		result.thinks++;
+	}
+}
+
+/// Runs both passes with a number of players crowded in the middle of the map
+static void bench_run( uint32 player_count ){
+	std::mt19937 generator( player_count );
+	s_bench_map map;
+
+	map.xs = static_cast<int16>( bench_map_size );
+	map.ys = static_cast<int16>( bench_map_size );
+	map.bxs = static_cast<int16>( ( map.xs + BENCH_BLOCK_SIZE - 1 ) / BENCH_BLOCK_SIZE );
+	map.bys = static_cast<int16>( ( map.ys + BENCH_BLOCK_SIZE - 1 ) / BENCH_BLOCK_SIZE );
+	map.blocks.resize( map.bxs * map.bys );
+
+	std::uniform_int_distribution<int32> map_position( 0, bench_map_size - 1 );
+	std::vector<s_bench_mob> mobs( bench_mobs );
+
+	for( s_bench_mob& md : mobs ){
+		md = {};
+		md.x = static_cast<int16>( map_position( generator ) );
+		md.y = static_cast<int16>( map_position( generator ) );
+		map.blocks[md.x / BENCH_BLOCK_SIZE + md.y / BENCH_BLOCK_SIZE * map.bxs].push_back( &md );
+	}
+
+	int32 crowd_start = ( bench_map_size - bench_crowd_size ) / 2;
+	std::uniform_int_distribution<int32> crowd_position( crowd_start, crowd_start + bench_crowd_size - 1 );
+	std::vector<s_bench_object> players( player_count );
+
+	for( s_bench_object& sd : players ){
+		sd.x = static_cast<int16>( crowd_position( generator ) );
+		sd.y = static_cast<int16>( crowd_position( generator ) );
+	}
+
+	s_bench_result per_player = {}, grouped = {};
+	auto start = std::chrono::steady_clock::now();
+
+	for( uint32 pass = 0; pass < bench_passes; pass++ ){
+		bench_pass_per_player( map, players, per_player );
+	}
+
+	auto middle = std::chrono::steady_clock::now();
+
+	for( uint32 pass = 0; pass < bench_passes; pass++ ){
+		bench_pass_grouped( map, players, pass + 1, grouped );
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	per_player.ms = std::chrono::duration<double, std::milli>( middle - start ).count() / bench_passes;
+	grouped.ms = std::chrono::duration<double, std::milli>( end - middle ).count() / bench_passes;
+
+	ShowInfo( "%4u players | per player: %8.3f ms, %7" PRIu64 " scanned, %7" PRIu64 " thinks | grouped: %8.3f ms, %7" PRIu64 " scanned, %7" PRIu64 " thinks\n",
+		player_count,
+		per_player.ms, per_player.scanned / bench_passes, per_player.thinks / bench_passes,
+		grouped.ms, grouped.scanned / bench_passes, grouped.thinks / bench_passes );
+}
+
+static void display_helpscreen( void ){
+	ShowInfo( "Usage: mobaibench [-map <cells>] [-crowd <cells>] [-mobs <n>] [-think <n>] [-passes <n>] [-players <n,n,...>]\n" );
+	ShowInfo( "Models a hard monster AI pass with one area scan per player and with players grouped by square.\n" );
+	ShowInfo( "Does not run the map-server code, a monster AI run is replaced by a fixed amount of work.\n" );
+	ShowInfo( "  -map <cells>      width and height of the map (default: %u)\n", bench_map_size );
+	ShowInfo( "  -crowd <cells>    width and height of the square the players stand in (default: %u)\n", bench_crowd_size );
+	ShowInfo( "  -mobs <n>         monsters spread over the map (default: %u)\n", bench_mobs );
+	ShowInfo( "  -think <n>        work units of a single monster AI run (default: %u)\n", bench_think_cost );
+	ShowInfo( "  -passes <n>       AI passes per measurement (default: %u)\n", bench_passes );
+	ShowInfo( "  -players <n,...>  player counts to measure (default: 1,10,50,100,200,400)\n" );
+}
+
+bool MobaibenchTool::initialize( int32 argc, char* argv[] ){
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-map" ) == 0 && i + 1 < argc ){
+			bench_map_size = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-crowd" ) == 0 && i + 1 < argc ){
+			bench_crowd_size = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-mobs" ) == 0 && i + 1 < argc ){
+			bench_mobs = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-think" ) == 0 && i + 1 < argc ){
+			bench_think_cost = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-passes" ) == 0 && i + 1 < argc ){
+			bench_passes = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-players" ) == 0 && i + 1 < argc ){
+			const char* p = argv[++i];
+			char* end;
+
+			bench_players.clear();
+
+			for( uint32 count = static_cast<uint32>( strtoul( p, &end, 10 ) ); end != p; count = static_cast<uint32>( strtoul( p, &end, 10 ) ) ){
+				bench_players.push_back( count );
+				p = ( *end == ',' ) ? end + 1 : end;
+			}
+		}else{
+			display_helpscreen();
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_map_size == 0 || bench_map_size > INT16_MAX || bench_crowd_size == 0 || bench_crowd_size > bench_map_size || bench_passes == 0 ){
+		display_helpscreen();
+		return false;
+	}
+
+	ShowStatus( "%u monsters on a %ux%u map, players in a %ux%u square in the middle, %u passes each.\n", bench_mobs, bench_map_size, bench_map_size, bench_crowd_size, bench_crowd_size, bench_passes );
+
+	for( uint32 count : bench_players ){
+		bench_run( count );
+	}
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<MobaibenchTool>( argc, argv );
+}
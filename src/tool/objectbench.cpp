@@ -0,0 +1,281 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/db.hpp>
+#include <common/id_table.hpp>
+#include <common/showmsg.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_objectbench{
+		class ObjectbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				ObjectbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_objectbench;
+
+// Same values as the map-server: START_ACCOUNT_NUM of mmo.hpp, MIN_FLOORITEM and MAX_FLOORITEM of map.hpp
+// and START_NPC_NUM of npc.hpp
+#define BENCH_START_ACCOUNT_NUM 2000000
+#define BENCH_MIN_FLOORITEM 2
+#define BENCH_MAX_FLOORITEM BENCH_START_ACCOUNT_NUM
+#define BENCH_START_NPC_NUM 110000000
+
+struct s_bench_object{
+	int32 id;
+};
+
+/// The lookup structures of the map-server, filled with the same objects
+struct s_bench_world{
+	DBMap* id_tree; ///< id_db before DB_OPT_HASH_INDEX, also the pc_db of the players
+	DBMap* id_index; ///< id_db and pc_db with DB_OPT_HASH_INDEX
+	DBMap* pc_tree;
+	DBMap* pc_index;
+	rathena::util::id_table<s_bench_object> npc_table{ BENCH_START_NPC_NUM };
+	rathena::util::id_table<s_bench_object> object_table{ BENCH_MIN_FLOORITEM };
+	int32 npc_id = BENCH_START_NPC_NUM;
+	int32 object_id = BENCH_MIN_FLOORITEM;
+};
+
+uint32 bench_objects = 300000;
+uint32 bench_players = 3000;
+uint32 bench_items = 30000;
+uint32 bench_lookups = 5000000;
+uint32 bench_churn = 20000;
+uint32 bench_stale = 10;
+uint32 bench_errors = 0;
+
+/// Same as map_object_table
+static rathena::util::id_table<s_bench_object>* bench_table( s_bench_world& world, int32 id ){
+	if( world.npc_table.contains( id, INT32_MAX ) ){
+		return &world.npc_table;
+	}
+
+	if( world.object_table.contains( id, BENCH_MAX_FLOORITEM ) ){
+		return &world.object_table;
+	}
+
+	return nullptr;
+}
+
+/// Same as map_id2bl
+static s_bench_object* bench_id2bl( s_bench_world& world, int32 id ){
+	rathena::util::id_table<s_bench_object>* table = bench_table( world, id );
+
+	if( table != nullptr ){
+		return table->find( id );
+	}
+
+	return static_cast<s_bench_object*>( idb_get( world.id_index, id ) );
+}
+
+/// Hands out ids like npc_get_new_npc_id and map_get_new_object_id, skipping the ids of live objects
+static int32 bench_new_id( s_bench_world& world, bool item ){
+	int32& counter = item ? world.object_id : world.npc_id;
+	rathena::util::id_table<s_bench_object>& table = item ? world.object_table : world.npc_table;
+
+	while( !table.available( counter ) ){
+		counter++;
+	}
+
+	return counter++;
+}
+
+static void bench_add( s_bench_world& world, s_bench_object* object ){
+	idb_put( world.id_tree, object->id, object );
+	idb_put( world.id_index, object->id, object );
+
+	rathena::util::id_table<s_bench_object>* table = bench_table( world, object->id );
+
+	if( table != nullptr ){
+		table->insert( object );
+	}else{
+		idb_put( world.pc_tree, object->id, object );
+		idb_put( world.pc_index, object->id, object );
+	}
+}
+
+static void bench_remove( s_bench_world& world, s_bench_object* object ){
+	idb_remove( world.id_tree, object->id );
+	idb_remove( world.id_index, object->id );
+
+	rathena::util::id_table<s_bench_object>* table = bench_table( world, object->id );
+
+	if( table != nullptr ){
+		table->erase( object );
+	}else{
+		idb_remove( world.pc_tree, object->id );
+		idb_remove( world.pc_index, object->id );
+	}
+}
+
+template <typename F> static double bench_time( uint32 operations, F&& function ){
+	auto start = std::chrono::steady_clock::now();
+
+	function();
+
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / std::max<uint32>( operations, 1 );
+}
+
+/// Looks up the ids with one way of resolving them and checks the result
+template <typename F> static double bench_lookup( const std::vector<int32>& ids, const std::vector<s_bench_object*>& expected, F&& find ){
+	return bench_time( static_cast<uint32>( ids.size() ), [&](){
+		for( size_t i = 0; i < ids.size(); i++ ){
+			if( find( ids[i] ) != expected[i] ){
+				bench_errors++;
+			}
+		}
+	} );
+}
+
+/// Needed by the core, the tool does not read the console
+int32 parse_console( const char* buf ){
+	return 0;
+}
+
+void display_helpscreen( bool do_exit ){
+	ShowInfo( "Usage: objectbench [-objects <n>] [-players <n>] [-items <n>] [-lookups <n>] [-churn <n>] [-stale <percent>]\n" );
+	ShowInfo( "Compares the id lookups of the map-server (map_id2bl, map_id2sd) with the objects in id_db with and without\n" );
+	ShowInfo( "DB_OPT_HASH_INDEX and in the direct-indexed object tables.\n" );
+	ShowInfo( "  -objects <n>      live objects (default: %u)\n", bench_objects );
+	ShowInfo( "  -players <n>      players among the objects, looked up in id_db and pc_db (default: %u)\n", bench_players );
+	ShowInfo( "  -items <n>        floor items and skill units among the objects (default: %u)\n", bench_items );
+	ShowInfo( "  -lookups <n>      lookups per measurement (default: %u)\n", bench_lookups );
+	ShowInfo( "  -churn <n>        objects that are removed and spawned again with a new id (default: %u)\n", bench_churn );
+	ShowInfo( "  -stale <percent>  lookups of ids whose objects are gone (default: %u)\n", bench_stale );
+
+	if( do_exit ){
+		exit( EXIT_SUCCESS );
+	}
+}
+
+bool ObjectbenchTool::initialize( int32 argc, char* argv[] ){
+	this->set_run_once( true );
+
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-objects" ) == 0 && i + 1 < argc ){
+			bench_objects = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-players" ) == 0 && i + 1 < argc ){
+			bench_players = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-items" ) == 0 && i + 1 < argc ){
+			bench_items = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-lookups" ) == 0 && i + 1 < argc ){
+			bench_lookups = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-churn" ) == 0 && i + 1 < argc ){
+			bench_churn = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-stale" ) == 0 && i + 1 < argc ){
+			bench_stale = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else{
+			display_helpscreen( false );
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_players == 0 || bench_players + bench_items >= bench_objects || bench_churn > bench_objects - bench_players || bench_stale > 100 ){
+		display_helpscreen( false );
+		return false;
+	}
+
+	std::mt19937 generator( bench_objects );
+	s_bench_world world;
+	std::vector<s_bench_object> objects( bench_objects );
+	std::vector<int32> stale;
+
+	world.id_tree = idb_alloc( DB_OPT_BASE );
+	world.id_index = idb_alloc( DB_OPT_HASH_INDEX );
+	world.pc_tree = idb_alloc( DB_OPT_BASE );
+	world.pc_index = idb_alloc( DB_OPT_HASH_INDEX );
+
+	ShowStatus( "%u objects: %u players, %u floor items and skill units, %u monsters and npcs.\n", bench_objects, bench_players, bench_items, bench_objects - bench_players - bench_items );
+
+	// Players log in with their account ids, the other objects get ids from the counters
+	double insert = bench_time( bench_objects, [&](){
+		for( uint32 i = 0; i < bench_objects; i++ ){
+			if( i < bench_players ){
+				objects[i].id = BENCH_START_ACCOUNT_NUM + static_cast<int32>( generator() % 1000000 ) * 2 + 1;
+
+				if( idb_exists( world.id_tree, objects[i].id ) ){
+					i--;
+					continue;
+				}
+			}else{
+				objects[i].id = bench_new_id( world, i < bench_players + bench_items );
+			}
+
+			bench_add( world, &objects[i] );
+		}
+	} );
+
+	// Monsters die and respawn with a new id, items are picked up and dropped again
+	double churn = bench_time( bench_churn * 2, [&](){
+		for( uint32 i = 0; i < bench_churn; i++ ){
+			s_bench_object& object = objects[bench_players + generator() % ( bench_objects - bench_players )];
+
+			stale.push_back( object.id );
+			bench_remove( world, &object );
+			object.id = bench_new_id( world, object.id < BENCH_MAX_FLOORITEM );
+			bench_add( world, &object );
+		}
+	} );
+
+	ShowInfo( "Spawning: %.1f ns per object, respawning: %.1f ns per removal or insertion (all structures)\n", insert, churn );
+
+	// Lookups of the objects in range of the players, a part of them for ids that are gone
+	std::vector<int32> ids( bench_lookups ), player_ids( bench_lookups );
+	std::vector<s_bench_object*> expected( bench_lookups ), expected_players( bench_lookups );
+
+	for( uint32 i = 0; i < bench_lookups; i++ ){
+		if( !stale.empty() && generator() % 100 < bench_stale ){
+			ids[i] = stale[generator() % stale.size()];
+			expected[i] = static_cast<s_bench_object*>( idb_get( world.id_tree, ids[i] ) );
+		}else{
+			expected[i] = &objects[generator() % bench_objects];
+			ids[i] = expected[i]->id;
+		}
+
+		expected_players[i] = &objects[generator() % bench_players];
+		player_ids[i] = expected_players[i]->id;
+	}
+
+	ShowInfo( "map_id2bl, ns per lookup:\n" );
+	ShowInfo( "  id_db tree           %6.1f\n", bench_lookup( ids, expected, [&]( int32 id ){ return static_cast<s_bench_object*>( idb_get( world.id_tree, id ) ); } ) );
+	ShowInfo( "  id_db index          %6.1f\n", bench_lookup( ids, expected, [&]( int32 id ){ return static_cast<s_bench_object*>( idb_get( world.id_index, id ) ); } ) );
+	ShowInfo( "  object tables        %6.1f\n", bench_lookup( ids, expected, [&]( int32 id ){ return bench_id2bl( world, id ); } ) );
+	ShowInfo( "map_id2sd, ns per lookup:\n" );
+	ShowInfo( "  pc_db tree           %6.1f\n", bench_lookup( player_ids, expected_players, [&]( int32 id ){ return static_cast<s_bench_object*>( idb_get( world.pc_tree, id ) ); } ) );
+	ShowInfo( "  pc_db index          %6.1f\n", bench_lookup( player_ids, expected_players, [&]( int32 id ){ return static_cast<s_bench_object*>( idb_get( world.pc_index, id ) ); } ) );
+
+	db_destroy( world.id_tree );
+	db_destroy( world.id_index );
+	db_destroy( world.pc_tree );
+	db_destroy( world.pc_index );
+
+	if( bench_errors > 0 ){
+		ShowError( "%u lookups returned a wrong object.\n", bench_errors );
+		return false;
+	}
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<ObjectbenchTool>( argc, argv );
+}
@@ -0,0 +1,322 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <vector>
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/showmsg.hpp>
+#include <common/socket.hpp>
+#include <common/timer.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_socketbench{
+		class SocketbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				SocketbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_socketbench;
+
+#define BENCH_PACKET_SIZE 8
+// make_listen_bind listens with a backlog of 5, connects beyond it are dropped and only retried a second later
+#define BENCH_CONNECT_BATCH 4
+
+uint32 bench_connections = 10000;
+uint32 bench_active = 100;
+uint32 bench_loops = 1000;
+uint32 bench_rounds = 200;
+uint32 bench_stall = 20;
+uint16 bench_port = 16900;
+
+uint32 bench_sessions = 0; ///< sessions accepted and not closed yet
+uint64 bench_parses = 0; ///< calls of the parse function
+uint64 bench_packets = 0; ///< packets received
+
+/// Parse function of the sessions, reads everything that arrived and closes the session on eof
+static int32 bench_parse( int32 fd ){
+	bench_parses++;
+
+	if( session[fd]->flag.eof ){
+		do_close( fd );
+		bench_sessions--;
+		return 0;
+	}
+
+	bench_packets += RFIFOREST( fd ) / BENCH_PACKET_SIZE;
+	RFIFOSKIP( fd, RFIFOREST( fd ) - RFIFOREST( fd ) % BENCH_PACKET_SIZE );
+
+	return 0;
+}
+
+/// Counts the sessions that were accepted from the clients
+static uint32 bench_count( void ){
+	uint32 count = 0;
+
+	for( int32 fd = 1; fd <= fd_max; fd++ ){
+		if( session_isValid( fd ) && session[fd]->func_parse == bench_parse ){
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/// Processor time of the process in microseconds, the time do_sockets spends waiting is not counted
+static double bench_cpu( void ){
+	return static_cast<double>( clock() ) * 1000000.0 / CLOCKS_PER_SEC;
+}
+
+#ifndef WIN32
+/// Client side, runs in a child process so that its sockets do not count against MAXCONN of the server side.
+/// Every byte that is written to the command pipe lets it continue: while connecting with the next batch of
+/// connections once the previous one was accepted, afterwards with a packet on the requested amount of random
+/// connections. Everything is closed once the pipe is closed.
+static void bench_clients( int32 command ){
+	std::vector<int32> fds;
+	std::mt19937 generator( bench_connections );
+	sockaddr_in address = {};
+
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	address.sin_port = htons( bench_port );
+
+	char byte;
+
+	for( uint32 i = 0; i < bench_connections; i++ ){
+		if( i > 0 && i % BENCH_CONNECT_BATCH == 0 && read( command, &byte, 1 ) != 1 ){
+			break;
+		}
+
+		int32 fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+		if( fd < 0 || connect( fd, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) != 0 ){
+			perror( "socketbench client" );
+			break;
+		}
+
+		fds.push_back( fd );
+	}
+
+	char packet[BENCH_PACKET_SIZE] = {};
+
+	while( !fds.empty() && read( command, &byte, 1 ) == 1 ){
+		for( uint32 i = 0; i < bench_active; i++ ){
+			if( send( fds[generator() % fds.size()], packet, sizeof( packet ), 0 ) < 0 ){
+				perror( "socketbench client" );
+			}
+		}
+	}
+
+	// Keep the connections open until the server side has closed them
+	while( read( command, &byte, 1 ) == 1 );
+
+	for( int32 fd : fds ){
+		close( fd );
+	}
+}
+#endif
+
+/// Needed by the core, the tool does not read the console
+int32 parse_console( const char* buf ){
+	return 0;
+}
+
+void display_helpscreen( bool do_exit ){
+	ShowInfo( "Usage: socketbench [-connections <n>] [-active <n>] [-loops <n>] [-rounds <n>] [-stall <seconds>] [-port <port>]\n" );
+	ShowInfo( "Measures do_sockets with many idle connections from a client process on the loopback interface.\n" );
+	ShowInfo( "More connections than MAXCONN (%d) need a build with a larger MAXCONN, more than 1024 on Linux need SOCKET_EPOLL.\n", MAXCONN );
+	ShowInfo( "  -connections <n>  connections of the client process (default: %u)\n", bench_connections );
+	ShowInfo( "  -active <n>       connections that send a packet per round (default: %u)\n", bench_active );
+	ShowInfo( "  -loops <n>        do_sockets calls while all connections are idle (default: %u)\n", bench_loops );
+	ShowInfo( "  -rounds <n>       rounds with packets on some of the connections (default: %u)\n", bench_rounds );
+	ShowInfo( "  -stall <seconds>  stall_time after which the idle connections are closed (default: %u)\n", bench_stall );
+	ShowInfo( "  -port <port>      port of the listening socket (default: %hu)\n", bench_port );
+
+	if( do_exit ){
+		exit( EXIT_SUCCESS );
+	}
+}
+
+bool SocketbenchTool::initialize( int32 argc, char* argv[] ){
+	this->set_run_once( true );
+
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-connections" ) == 0 && i + 1 < argc ){
+			bench_connections = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-active" ) == 0 && i + 1 < argc ){
+			bench_active = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-loops" ) == 0 && i + 1 < argc ){
+			bench_loops = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-rounds" ) == 0 && i + 1 < argc ){
+			bench_rounds = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-stall" ) == 0 && i + 1 < argc ){
+			bench_stall = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-port" ) == 0 && i + 1 < argc ){
+			bench_port = static_cast<uint16>( strtoul( argv[++i], nullptr, 10 ) );
+		}else{
+			display_helpscreen( false );
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+#ifdef WIN32
+	ShowError( "socketbench starts its clients in a child process and is not available on Windows.\n" );
+	return false;
+#else
+	// the listening socket and the descriptors of the core need some room as well
+	if( bench_connections == 0 || bench_connections + 32 > MAXCONN || bench_stall < 3 ){
+		display_helpscreen( false );
+		return false;
+	}
+
+	struct rlimit limit;
+
+	if( getrlimit( RLIMIT_NOFILE, &limit ) == 0 && limit.rlim_cur < bench_connections + 32 ){
+		ShowError( "The limit of open files (%u) is too low for %u connections, raise it with ulimit -n.\n", static_cast<uint32>( limit.rlim_cur ), bench_connections );
+		return false;
+	}
+
+	// the packets of the clients are not encrypted
+	is_gepard_active = false;
+	// all clients connect from the loopback address at once, which the ddos protection would refuse
+	ip_rules = 0;
+	stall_time = bench_stall;
+	set_defaultparse( bench_parse );
+
+	if( make_listen_bind( INADDR_LOOPBACK, bench_port ) < 0 ){
+		return false;
+	}
+
+	int32 command[2];
+
+	if( pipe( command ) != 0 ){
+		ShowError( "Could not create the command pipe.\n" );
+		return false;
+	}
+
+	pid_t pid = fork();
+
+	if( pid < 0 ){
+		ShowError( "Could not start the client process.\n" );
+		return false;
+	}
+
+	if( pid == 0 ){
+		close( command[1] );
+		bench_clients( command[0] );
+		_exit( EXIT_SUCCESS );
+	}
+
+	close( command[0] );
+
+#ifdef SOCKET_EPOLL
+	ShowStatus( "Event dispatcher: epoll, MAXCONN %d\n", MAXCONN );
+#else
+	ShowStatus( "Event dispatcher: select, MAXCONN %d\n", MAXCONN );
+#endif
+
+	// Accept all connections
+	auto start = std::chrono::steady_clock::now();
+	uint32 batch_end = std::min<uint32>( BENCH_CONNECT_BATCH, bench_connections );
+
+	while( ( bench_sessions = bench_count() ) < bench_connections && std::chrono::steady_clock::now() - start < std::chrono::seconds( 60 ) ){
+		if( bench_sessions >= batch_end ){
+			batch_end = std::min<uint32>( batch_end + BENCH_CONNECT_BATCH, bench_connections );
+
+			if( write( command[1], "c", 1 ) != 1 ){
+				break;
+			}
+		}
+
+		do_sockets( 10 );
+	}
+
+	ShowInfo( "Accepted %u connections in %.0f ms\n", bench_sessions, std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+
+	if( bench_sessions < bench_connections ){
+		ShowError( "Only %u of %u connections were accepted.\n", bench_sessions, bench_connections );
+		close( command[1] );
+		waitpid( pid, nullptr, 0 );
+		return false;
+	}
+
+	// Idle: nothing arrives, every call only has to find out that there is nothing to do
+	uint64 parses = bench_parses;
+	double cpu = bench_cpu();
+
+	for( uint32 i = 0; i < bench_loops; i++ ){
+		do_sockets( 0 );
+	}
+
+	ShowInfo( "Idle:   %8.2f us per do_sockets call, %.2f parse calls per do_sockets call\n", ( bench_cpu() - cpu ) / bench_loops, static_cast<double>( bench_parses - parses ) / bench_loops );
+
+	// Active: a few connections send a packet, the loop runs until all of them were parsed
+	uint64 calls = 0;
+
+	parses = bench_parses;
+	cpu = bench_cpu();
+
+	for( uint32 round = 0; round < bench_rounds; round++ ){
+		uint64 expected = bench_packets + bench_active;
+
+		if( write( command[1], "p", 1 ) != 1 ){
+			break;
+		}
+
+		for( auto round_start = std::chrono::steady_clock::now(); bench_packets < expected && std::chrono::steady_clock::now() - round_start < std::chrono::seconds( 5 ); calls++ ){
+			do_sockets( 1 );
+		}
+	}
+
+	ShowInfo( "Active: %8.2f us per round of %u packets, %" PRIu64 " do_sockets calls, %.2f parse calls per round\n", ( bench_cpu() - cpu ) / bench_rounds, bench_active, calls, static_cast<double>( bench_parses - parses ) / bench_rounds );
+
+	// Stall: nothing arrives anymore, all connections are closed once they are stall_time seconds idle
+	ShowStatus( "Waiting for the connections to time out after %u seconds...\n", bench_stall );
+
+	start = std::chrono::steady_clock::now();
+	parses = bench_parses;
+	cpu = bench_cpu();
+	calls = 0;
+
+	while( bench_sessions > 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds( bench_stall * 3 ) ){
+		do_sockets( 100 );
+		calls++;
+	}
+
+	ShowInfo( "Stall:  %u connections left after %.1f s, %.2f us per do_sockets call, %" PRIu64 " parse calls\n", bench_sessions, std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count(), ( bench_cpu() - cpu ) / calls, bench_parses - parses );
+
+	close( command[1] );
+	waitpid( pid, nullptr, 0 );
+
+	return bench_sessions == 0;
+#endif
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<SocketbenchTool>( argc, argv );
+}
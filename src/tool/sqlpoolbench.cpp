@@ -0,0 +1,289 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/malloc.hpp>
+#include <common/showmsg.hpp>
+#include <common/sql.hpp>
+#include <web/sqllock.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_sqlpoolbench{
+		class SqlpoolbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				SqlpoolbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_sqlpoolbench;
+
+/// Allocations that are alive at the same time in a thread, like the buffers of a request
+#define BENCH_LIVE_ALLOCATIONS 64
+
+std::vector<uint32> bench_threads = { 1, 2, 4, 8, 16 };
+uint32 bench_allocations = 1000000;
+uint32 bench_connections = 4;
+uint32 bench_requests = 20000;
+bool bench_database = true;
+std::string bench_host = "127.0.0.1";
+uint16 bench_port = 3306;
+std::string bench_user = "ragnarok";
+std::string bench_password = "ragnarok";
+std::string bench_schema = "ragnarok";
+
+std::atomic<uint32> bench_errors( 0 );
+
+template <typename F> static double bench_time( F&& function ){
+	auto start = std::chrono::steady_clock::now();
+
+	function();
+
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+}
+
+/// Runs the function on the given amount of threads at once and returns the wall clock time in nanoseconds
+template <typename F> static double bench_parallel( uint32 threads, F&& function ){
+	return bench_time( [&](){
+		std::vector<std::thread> workers;
+
+		for( uint32 i = 0; i < threads; i++ ){
+			workers.emplace_back( function, i );
+		}
+
+		for( std::thread& worker : workers ){
+			worker.join();
+		}
+	} );
+}
+
+/// Allocates and frees blocks of 16 to 1024 bytes, keeping the last BENCH_LIVE_ALLOCATIONS of them alive
+template <typename A, typename D> static void bench_allocate( uint32 seed, A&& allocate, D&& deallocate ){
+	void* live[BENCH_LIVE_ALLOCATIONS] = {};
+	uint32 state = seed * 2654435761u + 1;
+
+	for( uint32 i = 0; i < bench_allocations; i++ ){
+		void*& slot = live[i % BENCH_LIVE_ALLOCATIONS];
+
+		if( slot != nullptr ){
+			deallocate( slot );
+		}
+
+		state = state * 1103515245u + 12345u;
+		slot = allocate( 16 + ( state >> 16 ) % 1009 );
+		memset( slot, 0, 16 );
+	}
+
+	for( void* ptr : live ){
+		if( ptr != nullptr ){
+			deallocate( ptr );
+		}
+	}
+}
+
+static void* bench_memmgr_alloc( size_t size ){
+	return aMalloc( size );
+}
+
+static void bench_memmgr_free( void* ptr ){
+	aFree( ptr );
+}
+
+static void* bench_system_alloc( size_t size ){
+	return malloc( size );
+}
+
+static void bench_system_free( void* ptr ){
+	free( ptr );
+}
+
+/// Nanoseconds per allocation and free over all threads
+static double bench_allocator( uint32 threads, void* (*allocate)( size_t ), void (*deallocate)( void* ) ){
+	double time = bench_parallel( threads, [&]( uint32 seed ){
+		bench_allocate( seed, allocate, deallocate );
+	} );
+
+	return time / ( static_cast<double>( bench_allocations ) * threads );
+}
+
+/// Compares the memory manager before and after malloc_set_threadsafe with the allocator of the system
+static void bench_memmgr( void ){
+	ShowStatus( "Memory manager, ns per allocation and free over all threads (%u allocations per thread):\n", bench_allocations );
+	ShowInfo( "  %2u thread(s), no lock  memmgr %7.1f | system %7.1f\n", 1, bench_allocator( 1, bench_memmgr_alloc, bench_memmgr_free ), bench_allocator( 1, bench_system_alloc, bench_system_free ) );
+
+	// Same as the web-server before its request threads start, there is no way back
+	malloc_set_threadsafe();
+
+	for( uint32 threads : bench_threads ){
+		ShowInfo( "  %2u thread(s), locked   memmgr %7.1f | system %7.1f\n", threads, bench_allocator( threads, bench_memmgr_alloc, bench_memmgr_free ), bench_allocator( threads, bench_system_alloc, bench_system_free ) );
+	}
+}
+
+/// One request of a web-server handler: holds a pooled connection for a prepared statement
+static void bench_request( int32 value, double& wait ){
+	SQLLock sl( WEB_SQL_LOCK );
+
+	wait += bench_time( [&](){
+		sl.lock();
+	} );
+
+	SqlStmt& stmt = sl.getStatement();
+	int32 result = 0;
+
+	if( SQL_SUCCESS != stmt.Prepare( "SELECT ?" )
+		|| SQL_SUCCESS != stmt.BindParam( 0, SQLDT_INT32, &value, sizeof( value ) )
+		|| SQL_SUCCESS != stmt.Execute()
+		|| SQL_SUCCESS != stmt.BindColumn( 0, SQLDT_INT32, &result, sizeof( result ) )
+		|| SQL_SUCCESS != stmt.NextRow()
+		|| result != value ){
+		bench_errors++;
+	}
+
+	sl.unlock();
+}
+
+/// Runs the requests on several threads that share the pool of the web database, like the http workers
+static bool bench_pool( void ){
+	ShowStatus( "Connecting %u handle(s) to %s:%hu...\n", bench_connections, bench_host.c_str(), bench_port );
+
+	for( uint32 i = 0; i < bench_connections; i++ ){
+		Sql* handle = Sql_Malloc();
+
+		if( SQL_ERROR == Sql_Connect( handle, bench_user.c_str(), bench_password.c_str(), bench_host.c_str(), bench_port, bench_schema.c_str() ) ){
+			ShowError( "Couldn't connect with uname='%s',host='%s',port='%hu',database='%s', use -nodb to skip the pool.\n", bench_user.c_str(), bench_host.c_str(), bench_port, bench_schema.c_str() );
+			Sql_ShowDebug( handle );
+			Sql_Free( handle );
+			sql_pool_final();
+			return false;
+		}
+
+		sql_pool_add( WEB_SQL_LOCK, handle );
+	}
+
+	ShowStatus( "Connection pool, %u requests per measurement:\n", bench_requests );
+
+	for( uint32 threads : bench_threads ){
+		std::vector<double> waits( threads, 0.0 );
+		double time = bench_parallel( threads, [&]( uint32 thread ){
+			Sql_ThreadInit();
+
+			for( uint32 i = thread; i < bench_requests; i += threads ){
+				bench_request( static_cast<int32>( i ), waits[thread] );
+			}
+
+			Sql_ThreadEnd();
+		} );
+		double wait = 0;
+
+		for( double thread_wait : waits ){
+			wait += thread_wait;
+		}
+
+		ShowInfo( "  %2u thread(s) | %8.0f requests/s | %8.1f us per request | %8.1f us waiting for a connection\n",
+			threads, bench_requests * 1e9 / time, time / 1000.0 / bench_requests * threads, wait / 1000.0 / bench_requests );
+	}
+
+	sql_pool_final();
+
+	return true;
+}
+
+/// Needed by the core, the tool does not read the console
+int32 parse_console( const char* buf ){
+	return 0;
+}
+
+void display_helpscreen( bool do_exit ){
+	ShowInfo( "Usage: sqlpoolbench [-threads <n,n,...>] [-allocations <n>] [-connections <n>] [-requests <n>] [-nodb]\n" );
+	ShowInfo( "                    [-host <ip>] [-port <port>] [-user <name>] [-password <password>] [-database <name>]\n" );
+	ShowInfo( "Measures the memory manager with and without its lock and the connection pool of the web-server under concurrent requests.\n" );
+	ShowInfo( "  -threads <n,...>     amounts of threads to measure (default: 1,2,4,8,16)\n" );
+	ShowInfo( "  -allocations <n>     allocations per thread for the memory manager (default: %u)\n", bench_allocations );
+	ShowInfo( "  -connections <n>     connections in the pool (default: %u)\n", bench_connections );
+	ShowInfo( "  -requests <n>        requests per measurement of the pool (default: %u)\n", bench_requests );
+	ShowInfo( "  -nodb                only measure the memory manager\n" );
+	ShowInfo( "  -host, -port, -user, -password, -database\n" );
+	ShowInfo( "                       MySQL server of the pool (default: %s:%hu, %s/%s, %s)\n", bench_host.c_str(), bench_port, bench_user.c_str(), bench_password.c_str(), bench_schema.c_str() );
+
+	if( do_exit ){
+		exit( EXIT_SUCCESS );
+	}
+}
+
+bool SqlpoolbenchTool::initialize( int32 argc, char* argv[] ){
+	this->set_run_once( true );
+
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc ){
+			const char* p = argv[++i];
+			char* end;
+
+			bench_threads.clear();
+
+			for( uint32 threads = static_cast<uint32>( strtoul( p, &end, 10 ) ); end != p; threads = static_cast<uint32>( strtoul( p, &end, 10 ) ) ){
+				bench_threads.push_back( threads );
+				p = ( *end == ',' ) ? end + 1 : end;
+			}
+		}else if( strcmp( argv[i], "-allocations" ) == 0 && i + 1 < argc ){
+			bench_allocations = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-connections" ) == 0 && i + 1 < argc ){
+			bench_connections = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-requests" ) == 0 && i + 1 < argc ){
+			bench_requests = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-nodb" ) == 0 ){
+			bench_database = false;
+		}else if( strcmp( argv[i], "-host" ) == 0 && i + 1 < argc ){
+			bench_host = argv[++i];
+		}else if( strcmp( argv[i], "-port" ) == 0 && i + 1 < argc ){
+			bench_port = static_cast<uint16>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-user" ) == 0 && i + 1 < argc ){
+			bench_user = argv[++i];
+		}else if( strcmp( argv[i], "-password" ) == 0 && i + 1 < argc ){
+			bench_password = argv[++i];
+		}else if( strcmp( argv[i], "-database" ) == 0 && i + 1 < argc ){
+			bench_schema = argv[++i];
+		}else{
+			display_helpscreen( false );
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_threads.empty() || std::find( bench_threads.begin(), bench_threads.end(), 0 ) != bench_threads.end() || bench_allocations == 0 || bench_connections == 0 || bench_requests == 0 ){
+		display_helpscreen( false );
+		return false;
+	}
+
+	bench_memmgr();
+
+	if( bench_database && !bench_pool() ){
+		return false;
+	}
+
+	if( bench_errors > 0 ){
+		ShowError( "%u requests failed or returned a wrong result.\n", bench_errors.load() );
+		return false;
+	}
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<SqlpoolbenchTool>( argc, argv );
+}
@@ -0,0 +1,367 @@
+// Copyright (c) rAthena Dev Teams - Licensed under GNU GPL
+// For more information, see LICENCE in the main folder
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <common/cbasetypes.hpp>
+#include <common/core.hpp>
+#include <common/showmsg.hpp>
+#include <common/timer.hpp>
+
+using namespace rathena::server_core;
+
+namespace rathena{
+	namespace tool_timerbench{
+		class TimerbenchTool : public Core{
+			protected:
+				bool initialize( int32 argc, char* argv[] ) override;
+
+			public:
+				TimerbenchTool() : Core( e_core_type::TOOL ){
+
+				}
+		};
+	}
+}
+
+using namespace rathena::tool_timerbench;
+
+enum e_bench_op : char{
+	BENCH_OP_TICK = 't', ///< run do_timer at the tick
+	BENCH_OP_ADD = 'a', ///< add a timer that runs once
+	BENCH_OP_INTERVAL = 'i', ///< add an interval timer
+	BENCH_OP_SET = 's', ///< move a timer with settick_timer
+	BENCH_OP_DELETE = 'd', ///< delete a timer
+};
+
+/// Operation of a workload, ticks are relative to the start of the replay
+struct s_bench_op{
+	e_bench_op op;
+	uint32 key; ///< timer of the workload, independent of the tid it gets
+	int64 tick;
+	int32 interval;
+};
+
+uint32 bench_timers = 250000;
+uint32 bench_seconds = 60;
+uint32 bench_step = 20;
+uint32 bench_moves = 200;
+uint32 bench_deletes = 20;
+uint32 bench_seed = 1;
+const char* bench_record = nullptr;
+const char* bench_replay = nullptr;
+
+std::vector<s_bench_op> bench_ops;
+std::unordered_map<uint32, int32> bench_tids; ///< key -> tid of the timers that have not run yet
+t_tick bench_base;
+uint64 bench_callbacks;
+uint64 bench_checksum;
+uint64 bench_tick_checksum; ///< callbacks of the current do_timer call
+
+/// Records which callbacks run in which do_timer call. Timers with the same tick may run in any order,
+/// equal checksums mean the same callbacks ran in the same do_timer calls with the same ticks.
+static TIMER_FUNC(bench_timer){
+	uint32 key = static_cast<uint32>( data );
+	uint64 hash = ( ( static_cast<uint64>( key ) << 32 ) | static_cast<uint32>( tick - bench_base ) ) * 0x9E3779B97F4A7C15ULL;
+
+	bench_callbacks++;
+	bench_tick_checksum += hash ^ ( hash >> 29 );
+
+	const TimerData* timer = get_timer( tid );
+
+	if( timer != nullptr && !( timer->type & TIMER_INTERVAL ) ){
+		bench_tids.erase( key );
+	}
+
+	return 0;
+}
+
+/// Picks a delay like the timers of a busy map-server: walk steps and attack delays,
+/// status changes and skill units, and a few long running timers like respawns and expirations
+static int64 bench_delay( std::mt19937& generator ){
+	uint32 kind = generator() % 100;
+
+	if( kind < 60 ){
+		return 100 + generator() % 500;
+	}else if( kind < 90 ){
+		return 1000 + generator() % 59000;
+	}else{
+		return 60000 + generator() % 1740000;
+	}
+}
+
+/// Generates the workload: a steady number of timers, a tenth of them interval timers (monster AI, regeneration),
+/// expired timers are replaced with new ones and on every step some timers are moved or deleted
+static void bench_generate( void ){
+	std::mt19937 generator( bench_seed );
+	// once timers that have not expired, ordered by tick (the generator has to know which keys are still valid)
+	std::priority_queue<std::pair<int64, uint32>, std::vector<std::pair<int64, uint32>>, std::greater<std::pair<int64, uint32>>> expiry;
+	std::vector<uint32> live; ///< once timers that can be moved or deleted
+	std::unordered_map<uint32, std::pair<int64, size_t>> state; ///< key -> tick and position in live
+	uint32 next_key = 0;
+	uint32 intervals = bench_timers / 10;
+
+	auto add = [&]( int64 now ){
+		uint32 key = next_key++;
+		int64 tick = now + bench_delay( generator );
+
+		bench_ops.push_back( { BENCH_OP_ADD, key, tick, 0 } );
+		expiry.emplace( tick, key );
+		state[key] = { tick, live.size() };
+		live.push_back( key );
+	};
+
+	auto remove = [&]( uint32 key ){
+		size_t index = state[key].second;
+
+		live[index] = live.back();
+		state[live[index]].second = index;
+		live.pop_back();
+		state.erase( key );
+	};
+
+	for( uint32 i = 0; i < intervals; i++ ){
+		bench_ops.push_back( { BENCH_OP_INTERVAL, next_key++, static_cast<int64>( 100 + generator() % 900 ), static_cast<int32>( 100 + generator() % 900 ) } );
+	}
+
+	for( uint32 i = intervals; i < bench_timers; i++ ){
+		add( 0 );
+	}
+
+	for( int64 now = bench_step; now <= static_cast<int64>( bench_seconds ) * 1000; now += bench_step ){
+		bench_ops.push_back( { BENCH_OP_TICK, 0, now, 0 } );
+
+		// drop the timers that ran, stale entries of moved timers are skipped
+		while( !expiry.empty() && expiry.top().first <= now ){
+			auto it = state.find( expiry.top().second );
+
+			if( it != state.end() && it->second.first == expiry.top().first ){
+				remove( it->first );
+				add( now );
+			}
+
+			expiry.pop();
+		}
+
+		for( uint32 i = 0; i < bench_moves && !live.empty(); i++ ){
+			uint32 key = live[generator() % live.size()];
+			int64 tick = now + bench_delay( generator );
+
+			bench_ops.push_back( { BENCH_OP_SET, key, tick, 0 } );
+			state[key].first = tick;
+			expiry.emplace( tick, key );
+		}
+
+		for( uint32 i = 0; i < bench_deletes && !live.empty(); i++ ){
+			uint32 key = live[generator() % live.size()];
+
+			bench_ops.push_back( { BENCH_OP_DELETE, key, 0, 0 } );
+			remove( key );
+			add( now );
+		}
+	}
+}
+
+static bool bench_write( const char* path ){
+	FILE* fp = fopen( path, "w" );
+
+	if( fp == nullptr ){
+		ShowError( "Could not open '%s' for writing.\n", path );
+		return false;
+	}
+
+	fprintf( fp, "// timerbench workload: <op> <key> <tick> <interval>\n" );
+
+	for( const s_bench_op& op : bench_ops ){
+		fprintf( fp, "%c %u %" PRId64 " %d\n", op.op, op.key, op.tick, op.interval );
+	}
+
+	fclose( fp );
+	return true;
+}
+
+static bool bench_read( const char* path ){
+	FILE* fp = fopen( path, "r" );
+
+	if( fp == nullptr ){
+		ShowError( "Could not open '%s'.\n", path );
+		return false;
+	}
+
+	char line[128];
+	int32 lines = 0;
+
+	while( fgets( line, sizeof( line ), fp ) != nullptr ){
+		s_bench_op op;
+		char type;
+
+		lines++;
+
+		if( line[0] == '/' && line[1] == '/' ){
+			continue;
+		}
+
+		if( sscanf( line, "%c %u %" SCNd64 " %d", &type, &op.key, &op.tick, &op.interval ) != 4 || strchr( "taisd", type ) == nullptr ){
+			ShowError( "Invalid operation in line %d of '%s'.\n", lines, path );
+			fclose( fp );
+			return false;
+		}
+
+		op.op = static_cast<e_bench_op>( type );
+		bench_ops.push_back( op );
+	}
+
+	fclose( fp );
+	return true;
+}
+
+/// Replays the workload against the timer implementation the tool was built with
+static void bench_run( void ){
+	std::chrono::steady_clock::duration timers{}, operations{};
+	uint64 ticks = 0, adds = 0, moves = 0, deletes = 0;
+
+	bench_base = gettick_nocache();
+
+	for( const s_bench_op& op : bench_ops ){
+		auto start = std::chrono::steady_clock::now();
+
+		switch( op.op ){
+			case BENCH_OP_TICK:
+				do_timer( bench_base + op.tick );
+				timers += std::chrono::steady_clock::now() - start;
+				bench_checksum = ( bench_checksum ^ bench_tick_checksum ) * 1099511628211ULL;
+				bench_tick_checksum = 0;
+				ticks++;
+				continue;
+			case BENCH_OP_ADD:
+				bench_tids[op.key] = add_timer( bench_base + op.tick, bench_timer, 0, op.key );
+				adds++;
+				break;
+			case BENCH_OP_INTERVAL:
+				bench_tids[op.key] = add_timer_interval( bench_base + op.tick, bench_timer, 0, op.key, op.interval );
+				adds++;
+				break;
+			case BENCH_OP_SET:
+			case BENCH_OP_DELETE: {
+				auto it = bench_tids.find( op.key );
+
+				// the timer already ran, an edited workload can refer to it
+				if( it == bench_tids.end() ){
+					continue;
+				}
+
+				if( op.op == BENCH_OP_SET ){
+					settick_timer( it->second, bench_base + op.tick );
+					moves++;
+				}else{
+					delete_timer( it->second, bench_timer );
+					bench_tids.erase( it );
+					deletes++;
+				}
+				break;
+			}
+		}
+
+		operations += std::chrono::steady_clock::now() - start;
+	}
+
+	double timers_ms = std::chrono::duration<double, std::milli>( timers ).count();
+	double operations_ms = std::chrono::duration<double, std::milli>( operations ).count();
+
+	ShowInfo( "%" PRIu64 " do_timer calls: %.1f ms, %" PRIu64 " callbacks\n", ticks, timers_ms, bench_callbacks );
+	ShowInfo( "%" PRIu64 " adds, %" PRIu64 " settick_timer, %" PRIu64 " delete_timer: %.1f ms\n", adds, moves, deletes, operations_ms );
+	ShowInfo( "Total: %.1f ms, checksum %016" PRIx64 "\n", timers_ms + operations_ms, bench_checksum );
+}
+
+/// Needed by the core, the tool does not read the console
+int32 parse_console( const char* buf ){
+	return 0;
+}
+
+void display_helpscreen( bool do_exit ){
+	ShowInfo( "Usage: timerbench [-timers <n>] [-seconds <n>] [-step <ms>] [-moves <n>] [-deletes <n>] [-seed <n>] [-record <file>] [-replay <file>]\n" );
+	ShowInfo( "Replays a timer workload against the timer implementation the tool was built with (binary heap,\n" );
+	ShowInfo( "or the timing wheel with ENABLE_TIMER_WHEEL). The same workload gives the same checksum with both.\n" );
+	ShowInfo( "  -timers <n>       timers that are kept running (default: %u)\n", bench_timers );
+	ShowInfo( "  -seconds <n>      length of the workload (default: %u)\n", bench_seconds );
+	ShowInfo( "  -step <ms>        time between two do_timer calls (default: %u)\n", bench_step );
+	ShowInfo( "  -moves <n>        settick_timer calls per step (default: %u)\n", bench_moves );
+	ShowInfo( "  -deletes <n>      delete_timer calls per step (default: %u)\n", bench_deletes );
+	ShowInfo( "  -seed <n>         seed of the generated workload (default: %u)\n", bench_seed );
+	ShowInfo( "  -record <file>    writes the generated workload to the file\n" );
+	ShowInfo( "  -replay <file>    replays the workload of the file instead of generating one\n" );
+
+	if( do_exit ){
+		exit( EXIT_SUCCESS );
+	}
+}
+
+bool TimerbenchTool::initialize( int32 argc, char* argv[] ){
+	this->set_run_once( true );
+
+	for( int32 i = 1; i < argc; i++ ){
+		if( strcmp( argv[i], "-timers" ) == 0 && i + 1 < argc ){
+			bench_timers = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-seconds" ) == 0 && i + 1 < argc ){
+			bench_seconds = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-step" ) == 0 && i + 1 < argc ){
+			bench_step = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-moves" ) == 0 && i + 1 < argc ){
+			bench_moves = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-deletes" ) == 0 && i + 1 < argc ){
+			bench_deletes = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-seed" ) == 0 && i + 1 < argc ){
+			bench_seed = static_cast<uint32>( strtoul( argv[++i], nullptr, 10 ) );
+		}else if( strcmp( argv[i], "-record" ) == 0 && i + 1 < argc ){
+			bench_record = argv[++i];
+		}else if( strcmp( argv[i], "-replay" ) == 0 && i + 1 < argc ){
+			bench_replay = argv[++i];
+		}else{
+			display_helpscreen( false );
+			return strcmp( argv[i], "-help" ) == 0 || strcmp( argv[i], "--help" ) == 0;
+		}
+	}
+
+	if( bench_step == 0 ){
+		display_helpscreen( false );
+		return false;
+	}
+
+	if( bench_replay != nullptr ){
+		if( !bench_read( bench_replay ) ){
+			return false;
+		}
+
+		ShowStatus( "Replaying %zu operations of '%s'.\n", bench_ops.size(), bench_replay );
+	}else{
+		bench_generate();
+
+		if( bench_record != nullptr && !bench_write( bench_record ) ){
+			return false;
+		}
+
+		ShowStatus( "Replaying %zu operations: %u timers for %u seconds, %u moves and %u deletes every %u ms.\n", bench_ops.size(), bench_timers, bench_seconds, bench_moves, bench_deletes, bench_step );
+	}
+
+#ifdef ENABLE_TIMER_WHEEL
+	ShowStatus( "Timer implementation: timing wheel\n" );
+#else
+	ShowStatus( "Timer implementation: binary heap\n" );
+#endif
+
+	add_timer_func_list( bench_timer, "bench_timer" );
+	bench_run();
+
+	return true;
+}
+
+int32 main( int32 argc, char *argv[] ){
+	return main_core<TimerbenchTool>( argc, argv );
+}
@@ -3,12 +3,19 @@
 
 #include "emblem_controller.hpp"
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <string>
+#include <unordered_map>
 
 #include <common/showmsg.hpp>
 #include <common/socket.hpp>
+#include <common/strlib.hpp>
 
 #include "auth.hpp"
 #include "http.hpp"
@@ -19,36 +26,167 @@
 #define MAX_EMBLEM_SIZE 50000
 #define START_VERSION 1
 
-HANDLER_FUNC(emblem_download) {
-	if (!isAuthorized(req, false)) {
-		res.status = HTTP_BAD_REQUEST;
-		res.set_content("Error", "text/plain");
-		return;
+/// Emblem as it is sent to the clients
+struct s_emblem_cache_entry {
+	std::string key;
+	uint32 version;
+	std::string etag;
+	const char* content_type;
+	std::string data;
+};
+
+/// Recently downloaded emblems, the most recently used one first
+static struct {
+	std::mutex mutex;
+	std::list<std::shared_ptr<const s_emblem_cache_entry>> entries;
+	std::unordered_map<std::string, std::list<std::shared_ptr<const s_emblem_cache_entry>>::iterator> index;
+} emblem_cache;
+
+static struct {
+	std::atomic<uint64> hits;
+	std::atomic<uint64> misses;
+	std::atomic<uint64> not_modified;
+	std::atomic<uint64> evictions;
+} emblem_cache_stats;
+
+static std::string emblem_cache_key(int32 guild_id, const std::string& world_name) {
+	return std::to_string(guild_id) + ":" + world_name;
+}
+
+/**
+ * Entity tag of an emblem version.
+ * Guild IDs are only unique per world, so the world name is part of it.
+ * Characters that may not appear in an entity tag are percent encoded.
+ * @param guild_id: Guild of the emblem
+ * @param world_name: World of the guild
+ * @param version: Version of the emblem
+ * @return the quoted entity tag
+ */
+static std::string emblem_etag(int32 guild_id, const std::string& world_name, uint32 version) {
+	std::string etag = "\"" + std::to_string(guild_id) + ":";
+
+	for (unsigned char c : world_name) {
+		if (c <= 0x20 || c >= 0x7F || c == '"' || c == '%') {
+			char hex[4];
+
+			safesnprintf(hex, sizeof(hex), "%%%02X", c);
+			etag += hex;
+		} else
+			etag += c;
 	}
 
-	bool fail = false;
-	if (!req.has_file("GDID")) {
-		ShowDebug("Missing GuildID field for emblem download.\n");
-		fail = true;
+	etag += ":" + std::to_string(version) + "\"";
+
+	return etag;
+}
+
+/**
+ * Looks up an emblem in the cache.
+ * @param guild_id: Guild of the emblem
+ * @param world_name: World of the guild
+ * @return the emblem or nullptr if it is not cached
+ */
+static std::shared_ptr<const s_emblem_cache_entry> emblem_cache_find(int32 guild_id, const std::string& world_name) {
+	if (web_config.emblem_cache_size == 0) {
+		emblem_cache_stats.misses++;
+		return nullptr;
 	}
-	if (!req.has_file("WorldName")) {
-		ShowDebug("Missing WorldName field for emblem download.\n");
-		fail = true;
+
+	std::lock_guard<std::mutex> lock(emblem_cache.mutex);
+	auto it = emblem_cache.index.find(emblem_cache_key(guild_id, world_name));
+
+	if (it == emblem_cache.index.end()) {
+		emblem_cache_stats.misses++;
+		return nullptr;
 	}
-	if (fail) {
-		res.status = HTTP_BAD_REQUEST;
-		res.set_content("Error", "text/plain");
-		return;
+
+	emblem_cache.entries.splice(emblem_cache.entries.begin(), emblem_cache.entries, it->second);
+	emblem_cache_stats.hits++;
+
+	return *it->second;
+}
+
+/**
+ * Puts an emblem into the cache, replacing an older version of it.
+ * A download that read the emblem before an upload finished can't overwrite the newer version.
+ * @param guild_id: Guild of the emblem
+ * @param world_name: World of the guild
+ * @param version: Version of the emblem
+ * @param content_type: Content type of the image
+ * @param data: Image data
+ * @param length: Length of the image data
+ * @return the current emblem
+ */
+static std::shared_ptr<const s_emblem_cache_entry> emblem_cache_store(int32 guild_id, const std::string& world_name, uint32 version, const char* content_type, const char* data, size_t length) {
+	auto emblem = std::make_shared<s_emblem_cache_entry>();
+
+	emblem->key = emblem_cache_key(guild_id, world_name);
+	emblem->version = version;
+	emblem->etag = emblem_etag(guild_id, world_name, version);
+	emblem->content_type = content_type;
+	emblem->data.assign(data, length);
+
+	if (web_config.emblem_cache_size == 0)
+		return emblem;
+
+	std::lock_guard<std::mutex> lock(emblem_cache.mutex);
+	auto it = emblem_cache.index.find(emblem->key);
+
+	if (it != emblem_cache.index.end()) {
+		emblem_cache.entries.splice(emblem_cache.entries.begin(), emblem_cache.entries, it->second);
+
+		if ((*it->second)->version > version)
+			return *it->second;
+
+		*it->second = emblem;
+		return emblem;
 	}
 
-	auto world_name_str = req.get_file_value("WorldName").content;
+	emblem_cache.entries.push_front(emblem);
+	emblem_cache.index[emblem->key] = emblem_cache.entries.begin();
+
+	while (emblem_cache.entries.size() > static_cast<size_t>(web_config.emblem_cache_size)) {
+		emblem_cache.index.erase(emblem_cache.entries.back()->key);
+		emblem_cache.entries.pop_back();
+		emblem_cache_stats.evictions++;
+	}
+
+	return emblem;
+}
+
+/// Prints the emblem cache statistics to the console.
+void emblem_cache_report(void) {
+	uint64 hits = emblem_cache_stats.hits;
+	uint64 misses = emblem_cache_stats.misses;
+	size_t count, bytes = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(emblem_cache.mutex);
+
+		count = emblem_cache.entries.size();
+		for (const auto& emblem : emblem_cache.entries)
+			bytes += emblem->data.size();
+	}
+
+	ShowInfo("Emblem cache: %" PRIuPTR "/%d emblems, %" PRIuPTR " KB\n", count, web_config.emblem_cache_size, bytes / 1024);
+	ShowInfo("Emblem cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate), %" PRIu64 " evictions\n",
+		hits, misses, hits + misses > 0 ? 100. * hits / (hits + misses) : 0., emblem_cache_stats.evictions.load());
+	ShowInfo("Emblem cache: %" PRIu64 " downloads answered with not modified\n", emblem_cache_stats.not_modified.load());
+}
+
+/**
+ * Reads an emblem from the database and puts it into the cache.
+ * @param guild_id: Guild of the emblem
+ * @param world_name_str: World of the guild
+ * @param res: Response, the error is set in it on failure
+ * @return the emblem or nullptr on failure
+ */
+static std::shared_ptr<const s_emblem_cache_entry> emblem_load(int32 guild_id, const std::string& world_name_str, Response &res) {
 	auto world_name = world_name_str.c_str();
-	auto guild_id = std::stoi(req.get_file_value("GDID").content);
 
 	SQLLock sl(WEB_SQL_LOCK);
 	sl.lock();
-	auto handle = sl.getHandle();
-	SqlStmt stmt{ *handle };
+	SqlStmt& stmt = sl.getStatement();
 	if (SQL_SUCCESS != stmt.Prepare(
 			"SELECT `version`, `file_type`, `file_data` FROM `%s` WHERE (`guild_id` = ? AND `world_name` = ?)",
 			guild_emblems_table)
@@ -60,7 +198,7 @@ HANDLER_FUNC(emblem_download) {
 		sl.unlock();
 		res.status = HTTP_BAD_REQUEST;
 		res.set_content("Error", "text/plain");
-		return;
+		return nullptr;
 	}
 
 	uint32 version = 0;
@@ -73,7 +211,7 @@ HANDLER_FUNC(emblem_download) {
 		sl.unlock();
 		res.status = HTTP_NOT_FOUND;
 		res.set_content("Error", "text/plain");
-		return;
+		return nullptr;
 	}
 
 
@@ -86,7 +224,7 @@ HANDLER_FUNC(emblem_download) {
 		sl.unlock();
 		res.status = HTTP_BAD_REQUEST;
 		res.set_content("Error", "text/plain");
-		return;
+		return nullptr;
 	}
 
 	sl.unlock();
@@ -95,7 +233,7 @@ HANDLER_FUNC(emblem_download) {
 		ShowDebug("Emblem is too big, current size is %d and the max length is %d.\n", emblem_size, MAX_EMBLEM_SIZE);
 		res.status = HTTP_BAD_REQUEST;
 		res.set_content("Error", "text/plain");
-		return;
+		return nullptr;
 	}
 	const char * content_type;
 	if (!strcmp(filetype, "BMP"))
@@ -106,11 +244,63 @@ HANDLER_FUNC(emblem_download) {
 		ShowError("Invalid image type %s, rejecting!\n", filetype);
 		res.status = HTTP_NOT_FOUND;
 		res.set_content("Error", "text/plain");
+		return nullptr;
+	}
+
+	return emblem_cache_store(guild_id, world_name_str, version, content_type, blob, emblem_size);
+}
+
+HANDLER_FUNC(emblem_download) {
+	if (!isAuthorized(req, false)) {
+		res.status = HTTP_BAD_REQUEST;
+		res.set_content("Error", "text/plain");
 		return;
 	}
 
-	res.body.assign(blob, emblem_size);
-	res.set_header("Content-Type", content_type);
+	bool fail = false;
+	if (!req.has_file("GDID")) {
+		ShowDebug("Missing GuildID field for emblem download.\n");
+		fail = true;
+	}
+	if (!req.has_file("WorldName")) {
+		ShowDebug("Missing WorldName field for emblem download.\n");
+		fail = true;
+	}
+	if (fail) {
+		res.status = HTTP_BAD_REQUEST;
+		res.set_content("Error", "text/plain");
+		return;
+	}
+
+	auto world_name_str = req.get_file_value("WorldName").content;
+	auto guild_id = std::stoi(req.get_file_value("GDID").content);
+
+	auto emblem = emblem_cache_find(guild_id, world_name_str);
+
+	if (emblem == nullptr) {
+		emblem = emblem_load(guild_id, world_name_str, res);
+
+		if (emblem == nullptr)
+			return;
+	}
+
+	// clients that already have this version don't need the image again
+	const std::string& etag = emblem->etag;
+
+	res.set_header("ETag", etag);
+
+	if (req.has_header("If-None-Match")) {
+		auto match = req.get_header_value("If-None-Match");
+
+		if (match == "*" || match.find(etag) != std::string::npos) {
+			emblem_cache_stats.not_modified++;
+			res.status = HTTP_NOT_MODIFIED;
+			return;
+		}
+	}
+
+	res.body.assign(emblem->data);
+	res.set_header("Content-Type", emblem->content_type);
 }
 
 
@@ -222,8 +412,7 @@ HANDLER_FUNC(emblem_upload) {
 
 	SQLLock sl(WEB_SQL_LOCK);
 	sl.lock();
-	auto handle = sl.getHandle();
-	SqlStmt stmt{ *handle };
+	SqlStmt& stmt = sl.getStatement();
 	if (SQL_SUCCESS != stmt.Prepare(
 			"SELECT `version` FROM `%s` WHERE (`guild_id` = ? AND `world_name` = ?)",
 			guild_emblems_table)
@@ -273,6 +462,8 @@ HANDLER_FUNC(emblem_upload) {
 
 	sl.unlock();
 
+	emblem_cache_store(guild_id, world_name_str, version, imgtype_str == "GIF" ? "image/gif" : "image/bmp", img_cstr, length);
+
 	std::ostringstream stream;
 	stream << "{\"Type\":1,\"version\":" << version << "}";
 	res.set_content(stream.str(), "application/json");
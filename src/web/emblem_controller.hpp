@@ -9,4 +9,6 @@
 HANDLER_FUNC(emblem_download);
 HANDLER_FUNC(emblem_upload);
 
+void emblem_cache_report(void);
+
 #endif
@@ -3,33 +3,150 @@
 
 #include "sqllock.hpp"
 
+#include <condition_variable>
 #include <mutex>
 
 #include <common/showmsg.hpp>
+#include <common/timer.hpp>
 
-std::mutex dbmutex;
-
-extern Sql * login_handle;
-extern Sql * char_handle;
-extern Sql * map_handle;
-extern Sql * web_handle;
-
-
-SQLLock::SQLLock(locktype lt) : ulock(dbmutex, std::defer_lock), lt(lt) {
-	switch(lt) {
-		case LOGIN_SQL_LOCK:
-			handle = login_handle;
-			break;
-		case CHAR_SQL_LOCK:
-			handle = char_handle;
-			break;
-		case MAP_SQL_LOCK:
-			handle = map_handle;
-			break;
-		case WEB_SQL_LOCK:
-			handle = web_handle;
-			break;
+/// Number of prepared statements kept open on each pooled connection
+#define SQL_POOL_STATEMENT_CACHE 32
+
+/// Connections to one database, each one is used by a single request at a time
+struct s_sql_pool {
+	std::mutex mutex;
+	std::condition_variable available;
+	std::vector<Sql*> handles; ///< All connections of the pool
+	std::vector<Sql*> idle; ///< Connections not held by a SQLLock
+	uint32 ping_interval; ///< Seconds between keepalive pings
+};
+
+static s_sql_pool sql_pools[SQL_LOCK_MAX];
+static int32 sql_pool_keepalive_timer = INVALID_TIMER;
+
+/// Takes an idle connection out of the pool, waits for one if all are in use.
+static Sql * sql_pool_acquire(locktype lt) {
+	s_sql_pool& pool = sql_pools[lt];
+	std::unique_lock<std::mutex> lock(pool.mutex);
+
+	pool.available.wait(lock, [&pool] { return !pool.idle.empty(); });
+
+	Sql * handle = pool.idle.back();
+	pool.idle.pop_back();
+
+	return handle;
+}
+
+/// Hands a connection back to the pool.
+static void sql_pool_release(locktype lt, Sql * handle) {
+	s_sql_pool& pool = sql_pools[lt];
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.idle.push_back(handle);
 	}
+
+	pool.available.notify_one();
+}
+
+/// Pings the idle connections of all pools.
+/// Connections held by a request are in use and can't time out.
+static TIMER_FUNC(sql_pool_keepalive) {
+	for (int32 i = 0; i < SQL_LOCK_MAX; i++) {
+		s_sql_pool& pool = sql_pools[i];
+		std::vector<Sql*> handles;
+
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			handles.swap(pool.idle);
+		}
+
+		for (Sql * handle : handles)
+			Sql_Ping(handle);
+
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			pool.idle.insert(pool.idle.end(), handles.begin(), handles.end());
+		}
+
+		pool.available.notify_all();
+	}
+
+	return 0;
+}
+
+/**
+ * Adds a connected handle to the pool of a database.
+ * The pool takes care of the keepalive, since the handle will be used by the web threads.
+ * @param lt: Database of the handle
+ * @param handle: Connected handle
+ */
+void sql_pool_add(locktype lt, Sql * handle) {
+	s_sql_pool& pool = sql_pools[lt];
+	uint32 timeout = 28800;
+
+	Sql_DisableKeepalive(handle);
+	Sql_GetTimeout(handle, &timeout);
+	Sql_SetStatementCache(handle, SQL_POOL_STATEMENT_CACHE);
+
+	if (timeout < 60)
+		timeout = 60;
+
+	std::lock_guard<std::mutex> lock(pool.mutex);
+
+	if (pool.handles.empty() || timeout - 30 < pool.ping_interval)
+		pool.ping_interval = timeout - 30;
+
+	pool.handles.push_back(handle);
+	pool.idle.push_back(handle);
+}
+
+size_t sql_pool_size(locktype lt) {
+	std::lock_guard<std::mutex> lock(sql_pools[lt].mutex);
+
+	return sql_pools[lt].handles.size();
+}
+
+/// Starts pinging the pooled connections, once all were added.
+void sql_pool_init(void) {
+	uint32 interval = 0;
+
+	for (int32 i = 0; i < SQL_LOCK_MAX; i++) {
+		if (!sql_pools[i].handles.empty() && (interval == 0 || sql_pools[i].ping_interval < interval))
+			interval = sql_pools[i].ping_interval;
+	}
+
+	if (interval == 0)
+		return;
+
+	add_timer_func_list(sql_pool_keepalive, "sql_pool_keepalive");
+	sql_pool_keepalive_timer = add_timer_interval(gettick() + interval * 1000, sql_pool_keepalive, 0, 0, interval * 1000);
+}
+
+/// Closes all pooled connections. No request may be running anymore.
+void sql_pool_final(void) {
+	if (sql_pool_keepalive_timer != INVALID_TIMER) {
+		delete_timer(sql_pool_keepalive_timer, sql_pool_keepalive);
+		sql_pool_keepalive_timer = INVALID_TIMER;
+	}
+
+	for (int32 i = 0; i < SQL_LOCK_MAX; i++) {
+		s_sql_pool& pool = sql_pools[i];
+		std::lock_guard<std::mutex> lock(pool.mutex);
+
+		if (pool.idle.size() != pool.handles.size())
+			ShowWarning("sql_pool_final: %" PRIuPTR " connection(s) still in use.\n", pool.handles.size() - pool.idle.size());
+
+		for (Sql * handle : pool.handles)
+			Sql_Free(handle);
+
+		pool.handles.clear();
+		pool.idle.clear();
+	}
+}
+
+
+SQLLock::SQLLock(locktype lt) : handle(nullptr), lt(lt) {
 }
 
 void SQLLock::lock() {
@@ -47,11 +164,18 @@ void SQLLock::lock() {
 	//         ShowDebug("Locking web sql\n");
 	//         break;
 	// }
-	ulock.lock();
+	if (handle == nullptr)
+		handle = sql_pool_acquire(lt);
 }
 
 void SQLLock::unlock() {
-	ulock.unlock();
+	if (handle == nullptr)
+		return;
+
+	// statements have to be done with the connection before the next request gets it
+	statements.clear();
+	sql_pool_release(lt, handle);
+	handle = nullptr;
 	// switch(lt) {
 	//     case LOGIN_SQL_LOCK:
 	//         ShowDebug("Unlocked login sql\n");
@@ -72,10 +196,15 @@ void SQLLock::unlock() {
 
 // can only get handle if locked
 Sql * SQLLock::getHandle() {
-	if (!ulock.owns_lock())
-		return nullptr;
 	return handle;
 }
 
+// statement on the locked handle, valid until unlock
+SqlStmt& SQLLock::getStatement() {
+	statements.push_back(std::make_unique<SqlStmt>(*handle));
+	return *statements.back();
+}
+
 SQLLock::~SQLLock() {
+	unlock();
 }
@@ -4,7 +4,8 @@
 #ifndef SQLLOCK_HPP
 #define SQLLOCK_HPP
 
-#include <mutex>
+#include <memory>
+#include <vector>
 
 #include <common/sql.hpp>
 
@@ -12,14 +13,17 @@ enum locktype {
 	LOGIN_SQL_LOCK,
 	CHAR_SQL_LOCK,
 	MAP_SQL_LOCK,
-	WEB_SQL_LOCK
+	WEB_SQL_LOCK,
+	SQL_LOCK_MAX
 };
 
+/// Holds one pooled connection of a database while locked.
+/// Statements taken with getStatement are freed on unlock, before the connection is handed to another request.
 class SQLLock {
 private:
-	std::unique_lock<std::mutex> ulock;
 	Sql * handle;
 	locktype lt;
+	std::vector<std::unique_ptr<SqlStmt>> statements;
 
 public:
 	SQLLock(locktype);
@@ -27,7 +31,12 @@ public:
 	void lock();
 	void unlock();
 	Sql * getHandle();
+	SqlStmt& getStatement();
 };
 
+void sql_pool_add(locktype lt, Sql * handle);
+size_t sql_pool_size(locktype lt);
+void sql_pool_init(void);
+void sql_pool_final(void);
 
 #endif
@@ -15,6 +15,7 @@
 #include <common/md5calc.hpp>
 #include <common/mmo.hpp>
 #include <common/msg_conf.hpp>
+#include <common/profiler.hpp>
 #include <common/random.hpp>
 #include <common/showmsg.hpp>
 #include <common/socket.hpp> //ip2str
@@ -30,6 +31,7 @@
 #include "http.hpp"
 #include "merchantstore_controller.hpp"
 #include "partybooking_controller.hpp"
+#include "sqllock.hpp"
 #include "userconfig_controller.hpp"
 
 
@@ -70,11 +72,6 @@ std::string web_server_db = "ragnarok";
 
 std::string default_codepage = "";
 
-Sql * login_handle = nullptr;
-Sql * char_handle = nullptr;
-Sql * map_handle = nullptr;
-Sql * web_handle = nullptr;
-
 char login_table[32] = "login";
 char guild_emblems_table[32] = "guild_emblems";
 char user_configs_table[32] = "user_configs";
@@ -86,6 +83,22 @@ char guild_db_table[32] = "guild";
 char char_db_table[32] = "char";
 
 int32 parse_console(const char * buf) {
+	char type[64];
+	char command[64] = "";
+
+	if (sscanf(buf, "%63[^:]:%63[^\n]", type, command) < 2 && sscanf(buf, "%63[^\n]", type) < 1)
+		return 0;
+
+	if (strcmpi("emblem_report", type) == 0)
+		emblem_cache_report();
+	else if (strcmpi("profiler", type) == 0)
+		profiler_console(command);
+	else {
+		ShowInfo("Available commands:\n");
+		ShowInfo("\t emblem_report => Displays the emblem cache statistics.\n");
+		ShowInfo("\t profiler:<on|off|reset|show|latency|dump> => Controls the timer function profiler.\n");
+	}
+
 	return 1;
 }
 
@@ -148,10 +161,16 @@ bool web_config_read(const char* cfgName, bool normal) {
 			safestrncpy(console_log_filepath, w2, sizeof(console_log_filepath));
 		else if (!strcmpi(w1, "print_req_res"))
 			web_config.print_req_res = config_switch(w2);
+		else if (!strcmpi(w1, "console"))
+			web_config.console = config_switch(w2) == 1;
 		else if (!strcmpi(w1, "import"))
 			web_config_read(w2, normal);
 		else if (!strcmpi(w1, "allow_gifs"))
 			web_config.allow_gifs = config_switch(w2) == 1;
+		else if (!strcmpi(w1, "sql_connections"))
+			web_config.sql_connections = cap_value(atoi(w2), 0, 256);
+		else if (!strcmpi(w1, "emblem_cache_size"))
+			web_config.emblem_cache_size = max(atoi(w2), 0);
 	}
 	fclose(fp);
 	ShowInfo("Finished reading %s.\n", cfgName);
@@ -262,6 +281,9 @@ void web_set_defaults() {
 	safestrncpy(web_config.webconf_name, "conf/web_athena.conf", sizeof(web_config.webconf_name));
 	safestrncpy(web_config.msgconf_name, "conf/msg_conf/web_msg.conf", sizeof(web_config.msgconf_name));
 	web_config.print_req_res = false;
+	web_config.sql_connections = 0;
+	web_config.emblem_cache_size = 1000;
+	web_config.console = false;
 
 	inter_config.emblem_transparency_limit = 100;
 	inter_config.emblem_woe_change = true;
@@ -270,94 +292,59 @@ void web_set_defaults() {
 
 /// Constructor destructor and signal handlers
 
-int32 web_sql_init(void) {
-	// login db connection
-	login_handle = Sql_Malloc();
-	ShowInfo("Connecting to the Login DB server.....\n");
-
-	if (SQL_ERROR == Sql_Connect(login_handle, login_server_id.c_str(), login_server_pw.c_str(), login_server_ip.c_str(), login_server_port, login_server_db.c_str())) {
-		ShowError("Couldn't connect with uname='%s',host='%s',port='%hu',database='%s'\n",
-			login_server_id.c_str(), login_server_ip.c_str(), login_server_port, login_server_db.c_str());
-		Sql_ShowDebug(login_handle);
-		Sql_Free(login_handle);
-		exit(EXIT_FAILURE);
-	}
-	ShowStatus("Connect success! (Login Server Connection)\n");
-
-	if (!default_codepage.empty()) {
-		if (SQL_ERROR == Sql_SetEncoding(login_handle, default_codepage.c_str()))
-			Sql_ShowDebug(login_handle);
-	}
-
-	char_handle = Sql_Malloc();
-	ShowInfo("Connecting to the Char DB server.....\n");
-
-	if (SQL_ERROR == Sql_Connect(char_handle, char_server_id.c_str(), char_server_pw.c_str(), char_server_ip.c_str(), char_server_port, char_server_db.c_str())) {
-		ShowError("Couldn't connect with uname='%s',host='%s',port='%hu',database='%s'\n",
-			char_server_id.c_str(), char_server_ip.c_str(), char_server_port, char_server_db.c_str());
-		Sql_ShowDebug(char_handle);
-		Sql_Free(char_handle);
-		exit(EXIT_FAILURE);
-	}
-	ShowStatus("Connect success! (Char Server Connection)\n");
-
-	if (!default_codepage.empty()) {
-		if (SQL_ERROR == Sql_SetEncoding(char_handle, default_codepage.c_str()))
-			Sql_ShowDebug(char_handle);
-	}
+/**
+ * Opens the connections to one database and adds them to its pool.
+ * @param lt: Database of the connections
+ * @param name: Name of the database for the console
+ * @param count: Number of connections
+ */
+static void web_sql_connect(locktype lt, const char* name, size_t count, const std::string& id, const std::string& pw, const std::string& ip, uint16 port, const std::string& db) {
+	ShowInfo("Connecting to the %s DB server.....\n", name);
+
+	for (size_t i = 0; i < count; i++) {
+		Sql* handle = Sql_Malloc();
+
+		if (SQL_ERROR == Sql_Connect(handle, id.c_str(), pw.c_str(), ip.c_str(), port, db.c_str())) {
+			ShowError("Couldn't connect with uname='%s',host='%s',port='%hu',database='%s'\n",
+				id.c_str(), ip.c_str(), port, db.c_str());
+			Sql_ShowDebug(handle);
+			Sql_Free(handle);
+			exit(EXIT_FAILURE);
+		}
 
-	map_handle = Sql_Malloc();
-	ShowInfo("Connecting to the Map DB server.....\n");
+		if (!default_codepage.empty()) {
+			if (SQL_ERROR == Sql_SetEncoding(handle, default_codepage.c_str()))
+				Sql_ShowDebug(handle);
+		}
 
-	if (SQL_ERROR == Sql_Connect(map_handle, map_server_id.c_str(), map_server_pw.c_str(), map_server_ip.c_str(), map_server_port, map_server_db.c_str())) {
-		ShowError("Couldn't connect with uname='%s',host='%s',port='%hu',database='%s'\n",
-			map_server_id.c_str(), map_server_ip.c_str(), map_server_port, map_server_db.c_str());
-		Sql_ShowDebug(map_handle);
-		Sql_Free(map_handle);
-		exit(EXIT_FAILURE);
+		sql_pool_add(lt, handle);
 	}
-	ShowStatus("Connect success! (Map Server Connection)\n");
 
-	if (!default_codepage.empty()) {
-		if (SQL_ERROR == Sql_SetEncoding(map_handle, default_codepage.c_str()))
-			Sql_ShowDebug(map_handle);
-	}
+	ShowStatus("Connect success! (%s Server Connection, %" PRIuPTR " handle(s))\n", name, count);
+}
 
-	web_handle = Sql_Malloc();
-	ShowInfo("Connecting to the Web DB server.....\n");
+int32 web_sql_init(void) {
+	// Every request runs on a http worker thread and holds at most one connection per database,
+	// more connections than workers would never be used
+	size_t count = CPPHTTPLIB_THREAD_POOL_COUNT;
 
-	if (SQL_ERROR == Sql_Connect(web_handle, web_server_id.c_str(), web_server_pw.c_str(), web_server_ip.c_str(), web_server_port, web_server_db.c_str())) {
-		ShowError("Couldn't connect with uname='%s',host='%s',port='%hu',database='%s'\n",
-			web_server_id.c_str(), web_server_ip.c_str(), web_server_port, web_server_db.c_str());
-		Sql_ShowDebug(web_handle);
-		Sql_Free(web_handle);
-		exit(EXIT_FAILURE);
-	}
-	ShowStatus("Connect success! (Web Server Connection)\n");
+	if (web_config.sql_connections > 0 && static_cast<size_t>(web_config.sql_connections) < count)
+		count = web_config.sql_connections;
 
-	if (!default_codepage.empty()) {
-		if (SQL_ERROR == Sql_SetEncoding(web_handle, default_codepage.c_str()))
-			Sql_ShowDebug(web_handle);
-	}
+	web_sql_connect(LOGIN_SQL_LOCK, "Login", count, login_server_id, login_server_pw, login_server_ip, login_server_port, login_server_db);
+	web_sql_connect(CHAR_SQL_LOCK, "Char", count, char_server_id, char_server_pw, char_server_ip, char_server_port, char_server_db);
+	web_sql_connect(MAP_SQL_LOCK, "Map", count, map_server_id, map_server_pw, map_server_ip, map_server_port, map_server_db);
+	web_sql_connect(WEB_SQL_LOCK, "Web", count, web_server_id, web_server_pw, web_server_ip, web_server_port, web_server_db);
 
+	sql_pool_init();
 
 	return 0;
 }
 
 int32 web_sql_close(void)
 {
-	ShowStatus("Close Login DB Connection....\n");
-	Sql_Free(login_handle);
-	login_handle = nullptr;
-	ShowStatus("Close Char DB Connection....\n");
-	Sql_Free(char_handle);
-	char_handle = nullptr;
-	ShowStatus("Close Map DB Connection....\n");
-	Sql_Free(map_handle);
-	map_handle = nullptr;
-	ShowStatus("Close Web DB Connection....\n");
-	Sql_Free(web_handle);
-	web_handle = nullptr;
+	ShowStatus("Close DB Connections....\n");
+	sql_pool_final();
 
 	return 0;
 }
@@ -445,6 +432,9 @@ bool WebServer::initialize( int32 argc, char* argv[] ){
 
 	ShowStatus("Starting server...\n");
 
+	// requests are handled by several threads at once from here on
+	malloc_set_threadsafe();
+
 	http_server = std::make_shared<httplib::Server>();
 	// set up routes
 	http_server->Post("/charconfig/load", charconfig_load);
@@ -485,13 +475,21 @@ bool WebServer::initialize( int32 argc, char* argv[] ){
 		return false;
 	}
 
+	if( web_config.console ){
+		add_timer_func_list(parse_console_timer, "parse_console_timer");
+		add_timer_interval(gettick()+1000, parse_console_timer, 0, 0, 1000); //start in 1s each 1sec
+	}
+
 	ShowStatus("The web-server is " CL_GREEN "ready" CL_RESET " (Server is listening on the port %u).\n\n", web_config.web_port);
 	return true;
 #endif
 }
 
 void WebServer::handle_main( t_tick next ){
+	uint64 start = profiler_begin();
+
 	std::this_thread::sleep_for( std::chrono::milliseconds( next ) );
+	profiler_loop_idle( start );
 }
 
 int32 main( int32 argc, char *argv[] ){
@@ -44,6 +44,9 @@ struct Web_Config {
 	char webconf_name[256];						/// name of main config file
 	char msgconf_name[256];							/// name of msg_conf config file
 	bool allow_gifs;
+	int32 sql_connections;							// Connections per database, 0 for one per http worker thread
+	int32 emblem_cache_size;						// Number of emblems kept in memory, 0 to disable the cache
+	bool console;									// Whether console commands are read from stdin
 };
 
 struct Inter_Config {
@@ -52,6 +55,7 @@ struct Inter_Config {
 };
 
 enum e_http_status{
+	HTTP_NOT_MODIFIED = 304,
 	HTTP_BAD_REQUEST = 400,
 	HTTP_NOT_FOUND = 404,
 };